@@ -57,16 +57,16 @@ class HeavyRectangle final : public vulkan::shader_builder::VertexShaderInputSet
  private:
   // Convert xy to one of the six corners of the two triangles.
   // Here `vertex` runs from 0 till batch_size ([0, batch_size>).
-  auto position_at(int vertex)
+  static auto position_at(Vector2f const& xy, int vertex)
   {
     glsl::vec4 position;
     position << xy_to_position * (xy + offset[vertex]), 0.0f, 1.0f;     // Homogeneous coordinates.
     return position;
   }
 
-  // Convert xy to one of the four corners of the current square.
+  // Convert xy to one of the four corners of the square at xy.
   // Here `vertex` runs from 0 till batch_size ([0, batch_size>).
-  auto texture_coordinates_at(int vertex)
+  static auto texture_coordinates_at(Vector2f const& xy, int vertex)
   {
     glsl::vec2 coords;
     coords << xy_to_uv * (xy + offset[vertex]);
@@ -90,11 +90,30 @@ class HeavyRectangle final : public vulkan::shader_builder::VertexShaderInputSet
   {
     for (int vertex = 0; vertex < batch_size; ++vertex)
     {
-      input_entry_ptr[vertex].m_position[1] = position_at(vertex);
-      input_entry_ptr[vertex].m_texture_coordinates = texture_coordinates_at(vertex);
+      input_entry_ptr[vertex].m_position[1] = position_at(xy, vertex);
+      input_entry_ptr[vertex].m_texture_coordinates = texture_coordinates_at(xy, vertex);
     }
 
     // Advance to the next square.
     if (++xy.x() == iside) { xy.x() = 0; ++xy.y(); }
   }
+
+  // Every vertex only depends on its index, so the vertices can be generated in parallel.
+  bool supports_fill_range() const override
+  {
+    return true;
+  }
+
+  // Fill the VertexData objects of vertices [begin, end>; this doesn't use or change xy.
+  void create_entries(int begin, int end, VertexData* input_entry_ptr) const override
+  {
+    for (int index = begin; index < end; ++index, ++input_entry_ptr)
+    {
+      int const square = index / batch_size;
+      int const vertex = index % batch_size;
+      Vector2f const square_xy(square % iside, square / iside);
+      input_entry_ptr->m_position[1] = position_at(square_xy, vertex);
+      input_entry_ptr->m_texture_coordinates = texture_coordinates_at(square_xy, vertex);
+    }
+  }
 };
@@ -4,14 +4,20 @@ struct SampleParameters
 {
   static constexpr int s_max_object_count = 3000;
   static constexpr int s_quad_tessellation = 300;
+  static constexpr int s_max_draw_call_count = 1000;
+  static constexpr int s_max_parallel_recorders = 8;
 
   int ObjectCount;
   int PreSubmitCpuWorkTime;
   int PostSubmitCpuWorkTime;
   int SwapchainCount;
   int FrameResourcesCount;
+  int DrawCallCount;                    // The number of draw calls that the objects are divided over.
+  int ParallelRecorders;                // The number of secondary command buffers that those draw calls are recorded into, in parallel (1 means: record inline).
   float m_frame_generation_time;
   float m_total_frame_time;
+  float m_recording_time;               // Wall clock time spent recording the main pass.
+  float m_recording_cpu_time;           // CPU time spent recording the main pass, summed over all recorders.
   bool m_show_fps = true;
 
   SampleParameters() :
@@ -20,8 +26,12 @@ struct SampleParameters
     PostSubmitCpuWorkTime(4),
     SwapchainCount(3),
     FrameResourcesCount(2),
+    DrawCallCount(1),
+    ParallelRecorders(1),
     m_frame_generation_time(0),
-    m_total_frame_time(0)
+    m_total_frame_time(0),
+    m_recording_time(0),
+    m_recording_cpu_time(0)
   {
   }
 };
@@ -13,6 +13,8 @@
 #include "vk_utils/ImageData.h"
 #include "utils/threading/aithreadid.h"
 #include <imgui.h>
+#include <atomic>
+#include <ctime>
 #include "debug.h"
 #include "tracy/CwTracy.h"
 #ifdef TRACY_ENABLE
@@ -291,11 +293,11 @@ void main()
             [=, this](vulkan::descriptor::SetBindingMap const& set_binding_map)
             {
               Dout(dc::vulkan, "Calling set_binding_callback lambda with " << set_binding_map << " [" << this << "]");
-              ShaderCompiler compiler;
 
-              shader_input_data().build_shader(owning_window, shader_vert_index, compiler, set_binding_map
+              // Both shaders are compiled concurrently in the thread pool.
+              shader_input_data().build_shader_async(owning_window, shader_vert_index, set_binding_map
                   COMMA_CWDEBUG_ONLY({ owning_window, "PipelineFactory::m_shader_input_data" }));
-              shader_input_data().build_shader(owning_window, shader_frag_index, compiler, set_binding_map
+              shader_input_data().build_shader_async(owning_window, shader_frag_index, set_binding_map
                   COMMA_CWDEBUG_ONLY({ owning_window, "PipelineFactory::m_shader_input_data" }));
             });
       }
@@ -388,6 +390,14 @@ void main()
   //
   //===========================================================================
 
+  // Return the CPU time used by the calling thread, in nanoseconds.
+  static long thread_cpu_time_ns()
+  {
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+  }
+
   void PerformHardcoreCalculations(int duration) const
   {
     auto start_time = std::chrono::high_resolution_clock::now();
@@ -513,26 +523,60 @@ void main()
       CwTracyVkNamedZone(presentation_surface().tracy_context(), __main_pass2, static_cast<vk::CommandBuffer>(command_buffer), main_pass.name(), true,
           max_number_of_swapchain_images(), swapchain_index);
 
-      command_buffer->beginRenderPass(main_pass.begin_info(), vk::SubpassContents::eInline);
-// FIXME: this is a hack - what we really need is a vector with RenderProxy objects.
-if (!m_graphics_pipeline.handle())
-  Dout(dc::warning, "Pipeline not available");
-else
-{
-      command_buffer->bindPipeline(vk::PipelineBindPoint::eGraphics, vh_graphics_pipeline(m_graphics_pipeline.handle()));
-      command_buffer->bindDescriptorSets(vk::PipelineBindPoint::eGraphics, m_graphics_pipeline.layout(), 0 /* uint32_t first_set */, m_graphics_pipeline.vhv_descriptor_sets(), {});
+      auto recording_begin_time = std::chrono::high_resolution_clock::now();
+      std::atomic<long> recording_cpu_time_ns{0};
+      // Nothing is drawn as long as the pipeline isn't available yet.
+      vk::Pipeline const vh_pipeline = m_graphics_pipeline.handle() ? vh_graphics_pipeline(m_graphics_pipeline.handle()) : vk::Pipeline{};
+      int const number_of_recorders = m_sample_parameters.ParallelRecorders;
+      int const number_of_draw_calls = m_sample_parameters.DrawCallCount;
+      int const number_of_instances = m_sample_parameters.ObjectCount;
+
+      // Record the draw calls of recorder `recorder` into command_buffer (which is secondary if number_of_recorders > 1).
+      // This is called by multiple threads at the same time.
+      auto record_draw_calls = [&](int recorder, vulkan::handle::CommandBuffer command_buffer){
+        long const cpu_time_begin = thread_cpu_time_ns();
+        if (vh_pipeline)
+        {
+          command_buffer->bindPipeline(vk::PipelineBindPoint::eGraphics, vh_pipeline);
+          command_buffer->bindDescriptorSets(vk::PipelineBindPoint::eGraphics, m_graphics_pipeline.layout(), 0 /* uint32_t first_set */, m_graphics_pipeline.vhv_descriptor_sets(), {});
+          {
+            vertex_buffers_type::rat vertex_buffers_r(m_vertex_buffers);
+            vertex_buffers_container_type const& vertex_buffers(*vertex_buffers_r);
+            command_buffer->bindVertexBuffers(0 /* uint32_t first_binding */, { vertex_buffers[0].m_vh_buffer, vertex_buffers[1].m_vh_buffer }, { 0, 0 });
+          }
+          command_buffer->setViewport(0, { viewport });
+          command_buffer->pushConstants(m_graphics_pipeline.layout(), vk::ShaderStageFlagBits::eVertex|vk::ShaderStageFlagBits::eFragment, offsetof(PushConstant, aspect_scale), sizeof(float), &scaling_factor);
+          command_buffer->setScissor(0, { scissor });
+          // Each recorder draws a contiguous range of draw calls; each draw call a contiguous range of instances.
+          int const first_draw_call = recorder * number_of_draw_calls / number_of_recorders;
+          int const last_draw_call = (recorder + 1) * number_of_draw_calls / number_of_recorders;
+          for (int draw_call = first_draw_call; draw_call < last_draw_call; ++draw_call)
+          {
+            int const first_instance = draw_call * number_of_instances / number_of_draw_calls;
+            int const end_instance = (draw_call + 1) * number_of_instances / number_of_draw_calls;
+            command_buffer->draw(6 * SampleParameters::s_quad_tessellation * SampleParameters::s_quad_tessellation, end_instance - first_instance, 0, first_instance);
+          }
+        }
+        recording_cpu_time_ns.fetch_add(thread_cpu_time_ns() - cpu_time_begin, std::memory_order_relaxed);
+      };
+
+      if (number_of_recorders == 1)
       {
-        vertex_buffers_type::rat vertex_buffers_r(m_vertex_buffers);
-        vertex_buffers_container_type const& vertex_buffers(*vertex_buffers_r);
-        command_buffer->bindVertexBuffers(0 /* uint32_t first_binding */, { vertex_buffers[0].m_vh_buffer, vertex_buffers[1].m_vh_buffer }, { 0, 0 });
+        command_buffer->beginRenderPass(main_pass.begin_info(), vk::SubpassContents::eInline);
+        record_draw_calls(0, command_buffer);
+      }
+      else
+      {
+        command_buffer->beginRenderPass(main_pass.begin_info(), vk::SubpassContents::eSecondaryCommandBuffers);
+        record_secondary_command_buffers(command_buffer, main_pass.begin_info(), number_of_recorders, record_draw_calls);
       }
-      command_buffer->setViewport(0, { viewport });
-      //FIXME: this should become something like: update_push_constant(scaling_factor, command_buffer);
-      command_buffer->pushConstants(m_graphics_pipeline.layout(), vk::ShaderStageFlagBits::eVertex|vk::ShaderStageFlagBits::eFragment, offsetof(PushConstant, aspect_scale), sizeof(float), &scaling_factor);
-      command_buffer->setScissor(0, { scissor });
-      command_buffer->draw(6 * SampleParameters::s_quad_tessellation * SampleParameters::s_quad_tessellation, m_sample_parameters.ObjectCount, 0, 0);
-}
       command_buffer->endRenderPass();
+
+      auto recording_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - recording_begin_time);
+      float float_recording_time = static_cast<float>(recording_time.count() * 0.001f);
+      m_sample_parameters.m_recording_time = m_sample_parameters.m_recording_time * 0.99f + float_recording_time * 0.01f;
+      float float_recording_cpu_time = static_cast<float>(recording_cpu_time_ns.load(std::memory_order_relaxed) * 0.000001f);
+      m_sample_parameters.m_recording_cpu_time = m_sample_parameters.m_recording_cpu_time * 0.99f + float_recording_cpu_time * 0.01f;
       TracyVkCollect(presentation_surface().tracy_context(), static_cast<vk::CommandBuffer>(command_buffer));
     }
 #if ENABLE_IMGUI
@@ -594,7 +638,10 @@ else
     ImGui::SliderInt("Frame resources count", &m_sample_parameters.FrameResourcesCount, 1, max_number_of_frame_resources().get_value());
     ImGui::SliderInt("Pre-submit CPU work time [ms]", &m_sample_parameters.PreSubmitCpuWorkTime, 0, 20);
     ImGui::SliderInt("Post-submit CPU work time [ms]", &m_sample_parameters.PostSubmitCpuWorkTime, 0, 20);
+    ImGui::SliderInt("Draw calls", &m_sample_parameters.DrawCallCount, 1, SampleParameters::s_max_draw_call_count);
+    ImGui::SliderInt("Parallel recorders", &m_sample_parameters.ParallelRecorders, 1, SampleParameters::s_max_parallel_recorders);
     ImGui::Text("Frame generation time: %5.2f ms", m_sample_parameters.m_frame_generation_time);
+    ImGui::Text("Recording time: %5.2f ms (CPU time: %5.2f ms)", m_sample_parameters.m_recording_time, m_sample_parameters.m_recording_cpu_time);
     ImGui::Text("Total frame time: %5.2f ms", m_sample_parameters.m_total_frame_time);
     ImGui::End();
 
@@ -203,6 +203,10 @@ void main()
     shader_info[1].load(uniform_buffer_controlled_triangle1_vert_glsl);
     shader_info[2].load(uniform_buffer_controlled_triangle0_frag_glsl);
     shader_info[3].load(uniform_buffer_controlled_triangle1_frag_glsl);
+    // The fragment shaders are used by several pipelines with a different descriptor set layout;
+    // compile them only once and patch the descriptor set indexes and bindings per pipeline.
+    shader_info[2].set_precompiled_template();
+    shader_info[3].set_precompiled_template();
 
     // Inform the application about the shaders that we use.
     // This will call hash() on each ShaderInfo object (which may only called once), and then store it only when that hash doesn't exist yet.
@@ -278,11 +282,11 @@ void main()
             [=, this](vulkan::descriptor::SetBindingMap const& set_binding_map)
             {
               Dout(dc::vulkan, "Calling set_binding_callback lambda with " << set_binding_map << " [" << this << "]");
-              ShaderCompiler compiler;
 
-              shader_input_data().build_shader(owning_window, shader_vert_index, compiler, set_binding_map
+              // Both shaders are compiled concurrently in the thread pool.
+              shader_input_data().build_shader_async(owning_window, shader_vert_index, set_binding_map
                   COMMA_CWDEBUG_ONLY({ owning_window, "PipelineFactory::m_shader_input_data" }));
-              shader_input_data().build_shader(owning_window, shader_frag_index, compiler, set_binding_map
+              shader_input_data().build_shader_async(owning_window, shader_frag_index, set_binding_map
                   COMMA_CWDEBUG_ONLY({ owning_window, "PipelineFactory::m_shader_input_data" }));
             });
       }
@@ -332,6 +336,8 @@ void main()
     m_pipeline_factory0 = create_pipeline_factory(m_graphics_pipeline0, main_pass.vh_render_pass() COMMA_CWDEBUG_ONLY(true));
     m_pipeline_factory0_keep_alive = pipeline_factory(m_pipeline_factory0.factory_index());
     m_pipeline_factory0.add_characteristic<UniformBuffersTestPipelineCharacteristic0>(this);
+    // Create the variants of this factory with one vkCreateGraphicsPipelines call per four pipelines.
+    m_pipeline_factory0.set_batch_size(this, 4);
     m_pipeline_factory0.generate(this);
 
     m_pipeline_factory1 = create_pipeline_factory(m_graphics_pipeline1, main_pass.vh_render_pass() COMMA_CWDEBUG_ONLY(true));
@@ -444,13 +450,13 @@ else
 
       command_buffer->bindPipeline(vk::PipelineBindPoint::eGraphics, vh_graphics_pipeline(m_graphics_pipeline0.handle()));
       command_buffer->bindDescriptorSets(vk::PipelineBindPoint::eGraphics, m_graphics_pipeline0.layout(), 0 /* uint32_t first_set */,
-          m_graphics_pipeline0.vhv_descriptor_sets(), {});
+          m_graphics_pipeline0.vhv_descriptor_sets(), dynamic_offsets(m_graphics_pipeline0));
 
       command_buffer->draw(3, 1, 0, 0);
 
       command_buffer->bindPipeline(vk::PipelineBindPoint::eGraphics, vh_graphics_pipeline(m_graphics_pipeline1.handle()));
       command_buffer->bindDescriptorSets(vk::PipelineBindPoint::eGraphics, m_graphics_pipeline1.layout(), 0 /* uint32_t first_set */,
-          m_graphics_pipeline1.vhv_descriptor_sets(), {});
+          m_graphics_pipeline1.vhv_descriptor_sets(), dynamic_offsets(m_graphics_pipeline1));
 
       command_buffer->draw(3, 1, 0, 0);
 }
@@ -509,14 +515,14 @@ else
     ImGui::SliderFloat("Bottom position", &m_bottom_position, 0.0, 1.0);
     ImGui::End();
 
-    // FIXME: not implemented: currently we're only using the first frame resource!
-    vulkan::FrameResourceIndex const hack0{0};
+    // Each frame resource has its own copy of the uniform buffers.
+    vulkan::FrameResourceIndex const frame_resource_index = m_current_frame.m_resource_index;
 
     if (m_top_buffer.is_ready())
-      ((TopPosition*)(m_top_buffer[hack0].pointer()))[0].x = m_top_position;
+      ((TopPosition*)(m_top_buffer[frame_resource_index].pointer()))[0].x = m_top_position;
     if (m_left_buffer.is_ready())
-      ((LeftPosition*)(m_left_buffer[hack0].pointer()))->y = m_left_position;
+      ((LeftPosition*)(m_left_buffer[frame_resource_index].pointer()))->y = m_left_position;
     if (m_bottom_buffer.is_ready())
-      ((BottomPosition*)(m_bottom_buffer[hack0].pointer()))->x = m_bottom_position;
+      ((BottomPosition*)(m_bottom_buffer[frame_resource_index].pointer()))->x = m_bottom_position;
   }
 };
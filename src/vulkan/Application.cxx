@@ -100,6 +100,9 @@ void Application::initialize(int argc, char** argv)
     // Initialize base directories.
     m_directories.initialize(application_name(), argv[0]);
 
+    // Initialize the SPIR-V disk cache.
+    m_spirv_disk_cache.initialize(path_of(Directory::cache) / "spirv");
+
     // Initialize the thread pool.
     m_thread_pool.change_number_of_threads_to(thread_pool_number_of_worker_threads());
     Debug(m_thread_pool.set_color_functions([](int color){
@@ -425,12 +428,12 @@ void Application::pipeline_factory_done(task::SynchronousWindow const* window, b
   {
     // pipeline_cache_task was moved to pipeline_cache_merger->merged_pipeline_cache.
     pipeline_cache_merger->merged_pipeline_cache->set_is_merger();
-    pipeline_cache_merger->merged_pipeline_cache->signal(task::PipelineCache::factory_finished);
+    pipeline_cache_merger->merged_pipeline_cache->set_factory_finished();
   }
   else
   {
     // This deletes the task.
-    pipeline_cache_task->signal(task::PipelineCache::factory_finished);
+    pipeline_cache_task->set_factory_finished();
   }
   // Was this the last window (now with unlocked m_pipeline_factory_list)?
   if (last_window)
@@ -8,6 +8,7 @@
 #include "GraphicsSettings.h"
 #include "shader_builder/VertexAttribute.h"
 #include "shader_builder/ShaderInfos.h"
+#include "shader_builder/SPIRVDiskCache.h"
 #include "descriptor/SetKeyContext.h"
 #include "statefultask/DefaultMemoryPagePool.h"
 #include "statefultask/Broker.h"
@@ -138,6 +139,8 @@ class Application
 
   // Storage for all shader templates.
   mutable vulkan::shader_builder::ShaderInfos m_shader_infos;    // Mutable because it is updated by register_shaders, which is threadsafe-"const".
+  // Persistent storage of compiled shaders.
+  vulkan::shader_builder::SPIRVDiskCache m_spirv_disk_cache;      // Initialized in initialize(), after m_directories.
 
   // We have one of these for each pipeline cache filename.
   struct PipelineCacheMerger
@@ -301,6 +304,9 @@ class Application
   // Return a reference to the ShaderInfo that corresponds to shader_index, as added by a call to register_shaders.
   vulkan::shader_builder::ShaderInfo const& get_shader_info(vulkan::shader_builder::ShaderIndex shader_index) const;
 
+  // Return the on-disk cache of compiled SPIR-V code (used by ShaderInputData::build_shader).
+  vulkan::shader_builder::SPIRVDiskCache const& spirv_disk_cache() const { return m_spirv_disk_cache; }
+
   // Called by SynchronousWindow::create_pipeline_factory.
   void run_pipeline_factory(boost::intrusive_ptr<task::PipelineFactory> const& factory, task::SynchronousWindow* window, PipelineFactoryIndex index);
   // Called by SynchronousWindow::pipeline_factory_done.
@@ -3,8 +3,11 @@
 #include "Attachment.h"
 #include "CommandPool.h"
 #include "CommandBuffer.h"
+#include "RecordSecondaryCommandBuffer.h"
+#include "descriptor/DescriptorAllocator.h"
 #include "utils/Vector.h"
 #include <memory>
+#include <vector>
 
 namespace vulkan {
 
@@ -19,6 +22,22 @@ struct FrameResourcesData
 
   // Command buffers (currently only one).
   handle::CommandBuffer   m_command_buffer;                     // Freed when the command pool is destructed.
+  handle::CommandBuffer   m_acquire_command_buffer;             // Only used for the acquire barriers of queue family ownership transfers (see SynchronousWindow::submit).
+  handle::CommandBuffer   m_release_command_buffer;             // Only used for the release barriers of queue family ownership transfers (see SynchronousWindow::submit).
+
+  // Secondary command buffers, recorded in parallel by SynchronousWindow::record_secondary_command_buffers.
+  // A command pool may only be used by one thread at a time, so each recorder has its own pool.
+  struct SecondaryCommandBuffers
+  {
+    command_pool_type m_command_pool;
+    std::vector<handle::CommandBuffer> m_command_buffers;       // Freed when m_command_pool is destructed.
+    size_t m_used = 0;                                          // The number of m_command_buffers that were recorded for the current frame (reset by start_frame).
+
+    SecondaryCommandBuffers(LogicalDevice const* logical_device, QueueFamilyPropertiesIndex queue_family
+        COMMA_CWDEBUG_ONLY(Ambifix const& command_pool_debug_name)) :
+      m_command_pool(logical_device, queue_family COMMA_CWDEBUG_ONLY(command_pool_debug_name)) { }
+  };
+  std::vector<SecondaryCommandBuffers> m_secondary_command_buffers;     // Index: recorder. Created on demand.
 
   // Fence that signals when all (aka, the last) command buffers have finished.
   vk::UniqueFence         m_command_buffers_completed;          // This fence should be signaled when the last command buffer used for this frame completed.
@@ -26,14 +45,27 @@ struct FrameResourcesData
   // Overlapping descriptor set handles.
   vk::UniqueDescriptorSet m_overlapping_descriptor_set;         // Used for resources that need to changed during rendering (e.g. uniform buffers).
 
+  // Descriptor sets that are only used while rendering this frame.
+  // All of them are freed at once by SynchronousWindow::wait_command_buffer_completed, after waiting for m_command_buffers_completed.
+  static constexpr uint32_t transient_descriptor_allocator_initial_max_sets = 16;
+  descriptor::DescriptorAllocator m_transient_descriptor_allocator;
+
   FrameResourcesData(
       size_t number_of_attachments,
       // Arguments for m_command_pool.
       LogicalDevice const* logical_device,
       QueueFamilyPropertiesIndex queue_family
-      COMMA_CWDEBUG_ONLY(AmbifixOwner const& command_pool_debug_name)) :
+      COMMA_CWDEBUG_ONLY(AmbifixOwner const& command_pool_debug_name)
+      // Debug name of m_transient_descriptor_allocator.
+      COMMA_CWDEBUG_ONLY(Ambifix const& transient_descriptor_allocator_debug_name)) :
     m_attachments(number_of_attachments),
-    m_command_pool(logical_device, queue_family COMMA_CWDEBUG_ONLY(command_pool_debug_name)) { }
+    m_command_pool(logical_device, queue_family COMMA_CWDEBUG_ONLY(command_pool_debug_name)),
+    m_transient_descriptor_allocator(logical_device, transient_descriptor_allocator_initial_max_sets
+        COMMA_CWDEBUG_ONLY(transient_descriptor_allocator_debug_name))
+  {
+    // Don't move the pools around when adding recorders.
+    m_secondary_command_buffers.reserve(task::RecordSecondaryCommandBuffer::max_number_of_recorders);
+  }
 
   ~FrameResourcesData()
   {
@@ -119,7 +119,7 @@ void ImGui::create_descriptor_set(CWDEBUG_ONLY(Ambifix const& ambifix))
   };
   m_descriptor_set_layout = logical_device()->create_descriptor_set_layout(layout_bindings
       COMMA_CWDEBUG_ONLY(ambifix(".m_descriptor_set_layout")));
-  auto descriptor_sets = logical_device()->allocate_descriptor_sets({ *m_descriptor_set_layout } COMMA_CWDEBUG_ONLY({}), logical_device()->get_descriptor_pool()
+  auto descriptor_sets = logical_device()->allocate_descriptor_sets({ *m_descriptor_set_layout } COMMA_CWDEBUG_ONLY({})
       COMMA_CWDEBUG_ONLY(ambifix(".m_descriptor_set")));
   m_descriptor_set = descriptor_sets[0];        // We only have one descriptor set --^
 }
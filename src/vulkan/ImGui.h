@@ -90,7 +90,7 @@ class ImGui
   shader_builder::shader_resource::Texture m_font_texture{"m_font_texture"};
   utils::Vector<ImGui_FrameResourcesData, FrameResourceIndex> m_frame_resources_list;
   vk::UniqueDescriptorSetLayout m_descriptor_set_layout;
-  vk::DescriptorSet m_descriptor_set;                   // Lifetime is determined by the pool (LogicalDevice::m_descriptor_pool).
+  vk::DescriptorSet m_descriptor_set;                   // Lifetime is determined by the pool (LogicalDevice::m_descriptor_allocators).
   vk::UniquePipelineLayout m_pipeline_layout;
   vk::UniquePipeline m_graphics_pipeline;
   std::filesystem::path m_ini_filename;                 // Cache that io.IniFilename points to.
@@ -6,6 +6,8 @@
 #include "PresentationSurface.h"
 #include "SynchronousWindow.h"
 #include "descriptor/SetBinding.h"
+#include "memory/StagingRing.h"
+#include "pipeline/create_in_batch.h"
 #include "queues/QueueFamilyProperties.h"
 #include "queues/QueueReply.h"
 #include "infos/DeviceCreateInfo.h"
@@ -14,6 +16,8 @@
 #include "utils/is_power_of_two.h"
 #include "utils/MultiLoop.h"
 #include <boost/lexical_cast.hpp>
+#include <algorithm>
+#include <thread>
 #ifdef CWDEBUG
 #include "debug/vulkan_print_on.h"
 #include "debug/DebugSetName.h"
@@ -495,6 +499,7 @@ void LogicalDevice::prepare(
 
     Dout(dc::vulkan, properties);
     m_non_coherent_atom_size    = properties.limits.nonCoherentAtomSize;
+    m_min_uniform_buffer_offset_alignment = properties.limits.minUniformBufferOffsetAlignment;
     m_max_sampler_anisotropy    = properties.limits.maxSamplerAnisotropy;
     m_max_bound_descriptor_sets = properties.limits.maxBoundDescriptorSets;
     m_set_limits = {
@@ -516,6 +521,7 @@ void LogicalDevice::prepare(
     };
 
     Dout(dc::vulkan, "m_non_coherent_atom_size = " << m_non_coherent_atom_size);
+    Dout(dc::vulkan, "m_min_uniform_buffer_offset_alignment = " << m_min_uniform_buffer_offset_alignment);
     Dout(dc::vulkan, "m_max_sampler_anisotropy = " << m_max_sampler_anisotropy);
     Dout(dc::vulkan, "m_max_bound_descriptor_sets = " << m_max_bound_descriptor_sets);
     Dout(dc::vulkan, "m_set_limits = " << m_set_limits);
@@ -613,62 +619,16 @@ void LogicalDevice::prepare(
   };
   m_vh_allocator.create(vma_allocator_create_info);
 
-  {
-    std::vector<vk::DescriptorPoolSize> pool_sizes = {
-      {
-        .type = vk::DescriptorType::eSampler,
-        .descriptorCount = 100
-      },
-      {
-        .type = vk::DescriptorType::eCombinedImageSampler,
-        .descriptorCount = 100
-      },
-      {
-        .type = vk::DescriptorType::eSampledImage,
-        .descriptorCount = 100
-      },
-      {
-        .type = vk::DescriptorType::eStorageImage,
-        .descriptorCount = 100
-      },
-      {
-        .type = vk::DescriptorType::eUniformTexelBuffer,
-        .descriptorCount = 100
-      },
-      {
-        .type = vk::DescriptorType::eStorageTexelBuffer,
-        .descriptorCount = 100
-      },
-      {
-        .type = vk::DescriptorType::eUniformBuffer,
-        .descriptorCount = 100
-      },
-      {
-        .type = vk::DescriptorType::eStorageBuffer,
-        .descriptorCount = 100
-      },
-      {
-        .type = vk::DescriptorType::eUniformBufferDynamic,
-        .descriptorCount = 100
-      },
-      {
-        .type = vk::DescriptorType::eStorageBufferDynamic,
-        .descriptorCount = 100
-      },
-      {
-        .type = vk::DescriptorType::eInputAttachment,
-        .descriptorCount = 100
-      },
-      {
-        .type = vk::DescriptorType::eInlineUniformBlock,
-        .descriptorCount = 100
-      }
-    };
+  m_staging_ring = std::make_unique<memory::StagingRing>();
+  m_staging_ring->create(this, memory::StagingRing::s_default_size COMMA_CWDEBUG_ONLY(debug_name_prefix("m_staging_ring")));
 
-    descriptor_pool_t::wat descriptor_pool_w(m_descriptor_pool);
-    *descriptor_pool_w = create_descriptor_pool(pool_sizes, 2200
-        COMMA_DEBUG_ONLY(debug_name_prefix("m_descriptor_pool")));
-  }
+  // Get signaled as soon as a timeline semaphore reaches the value that a task is waiting for.
+  if (use_semaphore_waiter_thread())
+    m_semaphore_watcher->start_waiter_thread(this);
+
+  for (size_t i = 0; i < number_of_descriptor_allocators; ++i)
+    m_descriptor_allocators[i] = std::make_unique<descriptor_allocator_t>(this, descriptor_allocator_initial_max_sets
+        COMMA_CWDEBUG_ONLY(debug_name_prefix("m_descriptor_allocators[" + std::to_string(i) + "]")));
 }
 
 Queue LogicalDevice::acquire_queue(QueueRequestKey queue_request_key) const
@@ -899,14 +859,23 @@ vk::UniqueFramebuffer LogicalDevice::create_imageless_framebuffer(
 vk::UniqueDescriptorPool LogicalDevice::create_descriptor_pool(
     std::vector<vk::DescriptorPoolSize> const& pool_sizes,
     uint32_t max_sets
-    COMMA_CWDEBUG_ONLY(Ambifix const& debug_name)) const
+    COMMA_CWDEBUG_ONLY(Ambifix const& debug_name),
+    uint32_t max_inline_uniform_block_bindings) const
 {
+  // The number of inline uniform block bindings that can be allocated from a pool must be passed separately
+  // (the descriptorCount of an eInlineUniformBlock pool size is the number of bytes).
+  vk::DescriptorPoolInlineUniformBlockCreateInfo inline_uniform_block_create_info{
+    .maxInlineUniformBlockBindings = max_inline_uniform_block_bindings
+  };
   vk::DescriptorPoolCreateInfo descriptor_pool_create_info{
+    .pNext = max_inline_uniform_block_bindings > 0 ? &inline_uniform_block_create_info : nullptr,
 //    .flags = vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet,
     .maxSets = max_sets,
     .poolSizeCount = static_cast<uint32_t>(pool_sizes.size()),
     .pPoolSizes = pool_sizes.data()
   };
+  ASSERT(max_inline_uniform_block_bindings > 0 || std::none_of(pool_sizes.begin(), pool_sizes.end(),
+      [](vk::DescriptorPoolSize const& pool_size){ return pool_size.type == vk::DescriptorType::eInlineUniformBlock; }));
   vk::UniqueDescriptorPool descriptor_pool = m_device->createDescriptorPoolUnique(descriptor_pool_create_info);
   DebugSetName(descriptor_pool, debug_name, this);
   return descriptor_pool;
@@ -928,19 +897,24 @@ vk::UniqueDescriptorSetLayout LogicalDevice::create_descriptor_set_layout(
 
 std::vector<vk::DescriptorSet> LogicalDevice::allocate_descriptor_sets(
     std::vector<vk::DescriptorSetLayout> const& vhv_descriptor_set_layout
-    COMMA_CWDEBUG_ONLY(std::vector<descriptor::SetIndex> const& set_indexes),
-    descriptor_pool_t const& descriptor_pool
+    COMMA_CWDEBUG_ONLY(std::vector<descriptor::SetIndex> const& set_indexes)
+    COMMA_CWDEBUG_ONLY(Ambifix const& debug_name)) const
+{
+  // Each thread always uses the same allocator.
+  size_t const shard = std::hash<std::thread::id>{}(std::this_thread::get_id()) % number_of_descriptor_allocators;
+  descriptor_allocator_t::wat descriptor_allocator_w(*m_descriptor_allocators[shard]);
+  return allocate_descriptor_sets(*descriptor_allocator_w, vhv_descriptor_set_layout COMMA_CWDEBUG_ONLY(set_indexes) COMMA_CWDEBUG_ONLY(debug_name));
+}
+
+std::vector<vk::DescriptorSet> LogicalDevice::allocate_descriptor_sets(
+    descriptor::DescriptorAllocator& descriptor_allocator,
+    std::vector<vk::DescriptorSetLayout> const& vhv_descriptor_set_layout
+    COMMA_CWDEBUG_ONLY(std::vector<descriptor::SetIndex> const& set_indexes)
     COMMA_CWDEBUG_ONLY(Ambifix const& debug_name)) const
 {
-  DoutEntering(dc::shaderresource|dc::vulkan, "LogicalDevice::allocate_descriptor_sets(" << vhv_descriptor_set_layout << ", " << set_indexes << ", @" << (void*)&descriptor_pool <<
+  DoutEntering(dc::shaderresource|dc::vulkan, "LogicalDevice::allocate_descriptor_sets(@" << (void*)&descriptor_allocator << ", " << vhv_descriptor_set_layout << ", " << set_indexes <<
       ", object_name:\"" << debug_name.object_name() << "\").");
-  descriptor_pool_t::crat descriptor_pool_r(descriptor_pool);
-  vk::DescriptorSetAllocateInfo descriptor_set_allocate_info{
-    .descriptorPool = descriptor_pool_r->get(),
-    .descriptorSetCount = static_cast<uint32_t>(vhv_descriptor_set_layout.size()),
-    .pSetLayouts = vhv_descriptor_set_layout.data()
-  };
-  std::vector<vk::DescriptorSet> descriptor_sets = m_device->allocateDescriptorSets(descriptor_set_allocate_info);
+  std::vector<vk::DescriptorSet> descriptor_sets = descriptor_allocator.allocate(vhv_descriptor_set_layout);
 #ifdef CWDEBUG
   if (set_indexes.empty())
   {
@@ -956,17 +930,34 @@ std::vector<vk::DescriptorSet> LogicalDevice::allocate_descriptor_sets(
   return descriptor_sets;
 }
 
+vk::Result LogicalDevice::try_allocate_descriptor_sets(
+    vk::DescriptorPool vh_descriptor_pool,
+    std::vector<vk::DescriptorSetLayout> const& vhv_descriptor_set_layout,
+    vk::DescriptorSet* descriptor_sets_out) const
+{
+  vk::DescriptorSetAllocateInfo descriptor_set_allocate_info{
+    .descriptorPool = vh_descriptor_pool,
+    .descriptorSetCount = static_cast<uint32_t>(vhv_descriptor_set_layout.size()),
+    .pSetLayouts = vhv_descriptor_set_layout.data()
+  };
+  return m_device->allocateDescriptorSets(&descriptor_set_allocate_info, descriptor_sets_out);
+}
+
+void LogicalDevice::reset_descriptor_pool(vk::DescriptorPool vh_descriptor_pool) const
+{
+  m_device->resetDescriptorPool(vh_descriptor_pool);
+}
+
 std::vector<vk::UniqueDescriptorSet> LogicalDevice::allocate_descriptor_sets_unique(
     std::vector<vk::DescriptorSetLayout> const& vhv_descriptor_set_layout
     COMMA_CWDEBUG_ONLY(std::vector<descriptor::SetIndex> const& set_indexes),
-    descriptor_pool_t const& descriptor_pool
+    vk::DescriptorPool vh_descriptor_pool
     COMMA_CWDEBUG_ONLY(Ambifix const& debug_name)) const
 {
-  DoutEntering(dc::shaderresource|dc::vulkan, "LogicalDevice::allocate_descriptor_sets_unique(" << vhv_descriptor_set_layout << ", " << set_indexes << ", @" << (void*)&descriptor_pool <<
+  DoutEntering(dc::shaderresource|dc::vulkan, "LogicalDevice::allocate_descriptor_sets_unique(" << vhv_descriptor_set_layout << ", " << set_indexes << ", " << vh_descriptor_pool <<
       ", object_name:\"" << debug_name.object_name() << "\").");
-  descriptor_pool_t::crat descriptor_pool_r(descriptor_pool);
   vk::DescriptorSetAllocateInfo descriptor_set_allocate_info{
-    .descriptorPool = descriptor_pool_r->get(),
+    .descriptorPool = vh_descriptor_pool,
     .descriptorSetCount = static_cast<uint32_t>(vhv_descriptor_set_layout.size()),
     .pSetLayouts = vhv_descriptor_set_layout.data()
   };
@@ -1060,6 +1051,12 @@ void LogicalDevice::update_descriptor_set(
   m_device->updateDescriptorSets(1, &descriptor_writes, 0, nullptr);
 }
 
+void LogicalDevice::update_descriptor_sets(std::vector<vk::WriteDescriptorSet> const& descriptor_writes) const
+{
+  DoutEntering(dc::shaderresource|dc::vulkan, "LogicalDevice::update_descriptor_sets(<" << descriptor_writes.size() << " writes>)");
+  m_device->updateDescriptorSets(descriptor_writes.size(), descriptor_writes.data(), 0, nullptr);
+}
+
 vk::UniquePipelineLayout LogicalDevice::create_pipeline_layout(
     std::vector<vk::DescriptorSetLayout> const& vhv_sorted_descriptor_set_layouts,
     std::vector<vk::PushConstantRange> const& push_constant_ranges
@@ -1107,6 +1104,30 @@ vk::UniquePipeline LogicalDevice::create_graphics_pipeline(
   return pipeline;
 }
 
+std::vector<vk::UniquePipeline> LogicalDevice::create_graphics_pipelines(
+    vk::PipelineCache vh_pipeline_cache,
+    vk::ArrayProxy<vk::GraphicsPipelineCreateInfo const> const& graphics_pipeline_create_infos
+    COMMA_CWDEBUG_ONLY(Ambifix const& debug_name)) const
+{
+  DoutEntering(dc::vulkan, "LogicalDevice::create_graphics_pipelines(" << vh_pipeline_cache << ", " << graphics_pipeline_create_infos << ")");
+  // vkCreateGraphicsPipelines can fail for some of the create infos while creating the others;
+  // createGraphicsPipelinesUnique would throw and leak the latter. Use the non-throwing overload
+  // and let create_in_batch recreate the failed ones singly (see create_graphics_pipeline).
+  std::vector<vk::UniquePipeline> pipelines = pipeline::create_in_batch<vk::UniquePipeline, vk::Pipeline>(graphics_pipeline_create_infos,
+      [&](uint32_t count, vk::GraphicsPipelineCreateInfo const* create_infos, vk::Pipeline* pipelines_out){
+        return m_device->createGraphicsPipelines(vh_pipeline_cache, count, create_infos, nullptr, pipelines_out);
+      },
+      [&](vk::Pipeline vh_pipeline){
+        return vk::UniquePipeline(vh_pipeline, vk::ObjectDestroy<vk::Device, VULKAN_HPP_DEFAULT_DISPATCHER_TYPE>(*m_device));
+      },
+      [&](vk::GraphicsPipelineCreateInfo const& create_info){
+        return create_graphics_pipeline(vh_pipeline_cache, create_info COMMA_CWDEBUG_ONLY(debug_name));
+      });
+  for (vk::UniquePipeline const& pipeline : pipelines)
+    DebugSetName(pipeline, debug_name, this);
+  return pipelines;
+}
+
 Swapchain::images_type LogicalDevice::get_swapchain_images(
     task::SynchronousWindow const* owning_window,
     vk::SwapchainKHR vh_swapchain
@@ -1218,53 +1239,72 @@ boost::uuids::uuid LogicalDevice::get_pipeline_cache_UUID() const
   return uuid;
 }
 
-vk::DescriptorSetLayout LogicalDevice::realize_descriptor_set_layout(std::vector<vk::DescriptorSetLayoutBinding>& sorted_descriptor_set_layout_bindings) /*threadsafe-*/const
+vk::DescriptorSetLayout LogicalDevice::realize_descriptor_set_layout(std::vector<vk::DescriptorSetLayoutBinding>& sorted_descriptor_set_layout_bindings, size_t hash) /*threadsafe-*/const
 {
-  DoutEntering(dc::vulkan, "LogicalDevice::realize_descriptor_set_layout(" << sorted_descriptor_set_layout_bindings << ")");
+  DoutEntering(dc::vulkan, "LogicalDevice::realize_descriptor_set_layout(" << sorted_descriptor_set_layout_bindings << ", " << hash << ")");
   // Bug in library: this vector should never be empty. If it is, it probably means it was never initalized.
   ASSERT(!sorted_descriptor_set_layout_bindings.empty());
-  // So we can continue from the top when two threads try to convert the read-lock to a write-lock at the same time.
-  for (;;)
+  // The passed hash must match the bindings.
+  ASSERT(hash == descriptor::hash_sorted_bindings(sorted_descriptor_set_layout_bindings));
+  descriptor::SortedBindingsKey const key{sorted_descriptor_set_layout_bindings, hash};
+  // Lock-free lookup.
+  descriptor_set_layouts_container_t::value_type const* entry = m_descriptor_set_layouts.find(key);
+  bool created = false;
+  if (!entry)
   {
-    try
-    {
-      descriptor_set_layouts_t::rat descriptor_set_layouts_r(m_descriptor_set_layouts);
-      auto iter = descriptor_set_layouts_r->find(sorted_descriptor_set_layout_bindings);
-      if (iter == descriptor_set_layouts_r->end())
-      {
-        vk::UniqueDescriptorSetLayout layout = create_descriptor_set_layout(sorted_descriptor_set_layout_bindings
-            COMMA_CWDEBUG_ONLY(debug_name_prefix("m_descriptor_set_layouts[" +
-                boost::lexical_cast<std::string>(sorted_descriptor_set_layout_bindings) + "]")));
-        descriptor_set_layouts_t::wat descriptor_set_layouts_w(descriptor_set_layouts_r);
-        auto res = descriptor_set_layouts_w->try_emplace(sorted_descriptor_set_layout_bindings, std::move(layout));
-        // We just used find and couldn't find it?!
-        ASSERT(res.second);
-        iter = res.first;
-        Dout(dc::shaderresource, "Created handle " << *iter->second << " with key: " << sorted_descriptor_set_layout_bindings << ".");
-      }
-      else
-      {
-        // Fix the binding values in the passed vector.
-        std::vector<vk::DescriptorSetLayoutBinding> const& key = iter->first;
-        // Using find() key was a returned as matching sorted_descriptor_set_layout_bindings.
-        ASSERT(key.size() == sorted_descriptor_set_layout_bindings.size());
-        for (int i = 0; i < key.size(); ++i)
-        {
-          sorted_descriptor_set_layout_bindings[i].binding = key[i].binding;
-          // Now the elements much be exactly equal.
-          ASSERT(sorted_descriptor_set_layout_bindings[i] == key[i]);
-        }
-        Dout(dc::shaderresource, "Found in cache (vk::DescriptorSetLayout " << *iter->second << "). Using: " << sorted_descriptor_set_layout_bindings << ".");
-      }
-      ASSERT(*iter->second);
-      return *iter->second;
-    }
-    catch (std::exception const&)
+    // Create the layout without holding any lock. If another thread creates the same layout
+    // at the same time, then the one that is inserted last is destroyed again.
+    vk::UniqueDescriptorSetLayout layout = create_descriptor_set_layout(sorted_descriptor_set_layout_bindings
+        COMMA_CWDEBUG_ONLY(debug_name_prefix("m_descriptor_set_layouts[" +
+            boost::lexical_cast<std::string>(sorted_descriptor_set_layout_bindings) + "]")));
+    std::tie(entry, created) = m_descriptor_set_layouts.insert(sorted_descriptor_set_layout_bindings, std::move(layout));
+    if (created)
+      Dout(dc::shaderresource, "Created handle " << *entry->second << " with key: " << sorted_descriptor_set_layout_bindings << ".");
+    else
+      Dout(dc::shaderresource, "Another thread created the same layout first: destroyed ours.");
+  }
+  // The layout is published by the insert above, but its pool sizes might not be yet (if another thread
+  // inserted it and didn't get here yet). Never return a handle whose pool sizes can not be found.
+  publish_descriptor_set_layout_pool_sizes(*entry->second, entry->first);
+  if (!created)
+  {
+    // Fix the binding values in the passed vector.
+    std::vector<vk::DescriptorSetLayoutBinding> const& cached_key = entry->first;
+    // Using find() cached_key was a returned as matching sorted_descriptor_set_layout_bindings.
+    ASSERT(cached_key.size() == sorted_descriptor_set_layout_bindings.size());
+    for (int i = 0; i < cached_key.size(); ++i)
     {
-      Dout(dc::shaderresource, "Another thread is also trying to convert read to write lock: dropping creation and trying again...");
-      m_descriptor_set_layouts.rd2wryield();
+      sorted_descriptor_set_layout_bindings[i].binding = cached_key[i].binding;
+      // Now the elements much be exactly equal.
+      ASSERT(sorted_descriptor_set_layout_bindings[i] == cached_key[i]);
     }
+    Dout(dc::shaderresource, "Found in cache (vk::DescriptorSetLayout " << *entry->second << "). Using: " << sorted_descriptor_set_layout_bindings << ".");
   }
+  ASSERT(*entry->second);
+  return *entry->second;
+}
+
+void LogicalDevice::publish_descriptor_set_layout_pool_sizes(vk::DescriptorSetLayout vh_descriptor_set_layout,
+    std::vector<vk::DescriptorSetLayoutBinding> const& sorted_descriptor_set_layout_bindings) const
+{
+  // Lock-free lookup; this is the common case.
+  if (m_descriptor_set_layout_pool_sizes.find(vh_descriptor_set_layout))
+    return;
+  // Remember how many descriptors of each type a descriptor set with this layout needs (see DescriptorAllocator).
+  // Inline uniform blocks get one entry per binding, because DescriptorAllocator must also count those bindings.
+  std::vector<vk::DescriptorPoolSize> pool_sizes;
+  for (vk::DescriptorSetLayoutBinding const& binding : sorted_descriptor_set_layout_bindings)
+  {
+    auto pool_size = binding.descriptorType == vk::DescriptorType::eInlineUniformBlock ? pool_sizes.end() :
+      std::find_if(pool_sizes.begin(), pool_sizes.end(),
+        [&](vk::DescriptorPoolSize const& pool_size){ return pool_size.type == binding.descriptorType; });
+    if (pool_size == pool_sizes.end())
+      pool_sizes.push_back({ .type = binding.descriptorType, .descriptorCount = binding.descriptorCount });
+    else
+      pool_size->descriptorCount += binding.descriptorCount;
+  }
+  // If another thread inserted the same pool sizes first, then ours are destroyed again.
+  m_descriptor_set_layout_pool_sizes.insert(vh_descriptor_set_layout, std::move(pool_sizes));
 }
 
 // sorted_descriptor_set_layouts_container_t is a std::vector of SetLayout objects
@@ -1373,79 +1413,70 @@ vk::PipelineLayout LogicalDevice::realize_pipeline_layout(
   // What do you think you are doing?
   ASSERT(set_binding_map_out.empty());
 #endif
-  // So we can continue from the top when two threads try to convert the read-lock to a write-lock at the same time.
-  for (;;)
+  // Look up the layout without copying realized_descriptor_set_layouts and sorted_push_constant_ranges, and without taking a lock.
+  pipeline::PipelineLayoutKey const key{*realized_descriptor_set_layouts, sorted_push_constant_ranges};
+  pipeline_layouts_container_t::value_type const* entry = m_pipeline_layouts.find(key);
+  bool created = false;
+  if (!entry)
   {
-    try
+    std::vector<vk::DescriptorSetLayout> vhv_realized_descriptor_set_layouts(realized_descriptor_set_layouts->size());
+    for (auto&& layout : *realized_descriptor_set_layouts)
+      vhv_realized_descriptor_set_layouts[layout.set_index_hint().get_value()] = layout.handle();
+    // Create the layout without holding any lock. If another thread creates the same layout
+    // at the same time, then the one that is inserted last is destroyed again.
+    vk::UniquePipelineLayout layout = create_pipeline_layout(vhv_realized_descriptor_set_layouts, sorted_push_constant_ranges
+        COMMA_CWDEBUG_ONLY(Ambifix{"m_pipeline_layouts[...]"}));
+    std::tie(entry, created) = m_pipeline_layouts.insert(std::make_pair(*realized_descriptor_set_layouts, sorted_push_constant_ranges), std::move(layout));
+    if (created)
     {
-      using pipeline_layouts_t = LogicalDevice::pipeline_layouts_t;
-      pipeline_layouts_t::rat pipeline_layouts_r(m_pipeline_layouts);
-      auto key = std::make_pair(*realized_descriptor_set_layouts, sorted_push_constant_ranges);
-      auto iter = pipeline_layouts_r->find(key);
-      if (iter == pipeline_layouts_r->end())
-      {
-        std::vector<vk::DescriptorSetLayout> vhv_realized_descriptor_set_layouts(realized_descriptor_set_layouts->size());
-        for (auto&& layout : *realized_descriptor_set_layouts)
-        {
-          vhv_realized_descriptor_set_layouts[layout.set_index_hint().get_value()] = layout.handle();
-          // Create an identity set binding map.
-          set_binding_map_out.add_from_to(layout.set_index_hint(), layout.set_index_hint());
-          for (vk::DescriptorSetLayoutBinding const& descriptor_set_layout_binding : layout.sorted_bindings())
-          {
-            descriptor::SetBinding set_binding(layout.set_index_hint(), descriptor_set_layout_binding.binding);
-            set_binding_map_out.add_from_to(set_binding, set_binding.binding());
-          }
-        }
-        vk::UniquePipelineLayout layout = create_pipeline_layout(vhv_realized_descriptor_set_layouts, sorted_push_constant_ranges
-            COMMA_CWDEBUG_ONLY(Ambifix{"m_pipeline_layouts[...]"}));
-        pipeline_layouts_t::wat pipeline_layouts_w(pipeline_layouts_r);
-        auto res = pipeline_layouts_w->try_emplace(key, std::move(layout));
-        // We just used find and couldn't find it?!
-        ASSERT(res.second);
-        iter = res.first;
-        Dout(dc::shaderresource, "Created vk::PipelineLayout " << *iter->second << " with key: " << key << ".");
-      }
-      else
+      // Create an identity set binding map.
+      for (auto&& layout : *realized_descriptor_set_layouts)
       {
-        sorted_descriptor_set_layouts_container_t const& sorted_descriptor_set_layouts = iter->first.first;
-        // This should always be the case: they compared equal as key!?
-        ASSERT(realized_descriptor_set_layouts->size() == sorted_descriptor_set_layouts.size());
-        auto set_layout_in = realized_descriptor_set_layouts->begin();
-        auto set_layout_out = sorted_descriptor_set_layouts.begin();
-        while (set_layout_in != realized_descriptor_set_layouts->end())
+        set_binding_map_out.add_from_to(layout.set_index_hint(), layout.set_index_hint());
+        for (vk::DescriptorSetLayoutBinding const& descriptor_set_layout_binding : layout.sorted_bindings())
         {
-          // Same.
-          ASSERT(set_layout_in->sorted_bindings().size() == set_layout_out->sorted_bindings().size());
-          auto binding_in = set_layout_in->sorted_bindings().begin();
-          auto binding_out = set_layout_out->sorted_bindings().begin();
-          set_binding_map_out.add_from_to(set_layout_in->set_index_hint(), set_layout_out->set_index_hint());
-          while (binding_in != set_layout_in->sorted_bindings().end())
-          {
-            descriptor::SetBinding set_binding_in(set_layout_in->set_index_hint(), binding_in->binding);
-            descriptor::SetBinding set_binding_out(set_layout_out->set_index_hint(), binding_out->binding);
-            // I think this shouldn't happen no? *confused*
-            ASSERT(set_binding_in.binding() == binding_out->binding);
-            set_binding_map_out.add_from_to(set_binding_in, binding_out->binding);
-            binding_in->binding = binding_out->binding;
-            ++binding_in;
-            ++binding_out;
-          }
-          ++set_layout_in;
-          ++set_layout_out;
+          descriptor::SetBinding set_binding(layout.set_index_hint(), descriptor_set_layout_binding.binding);
+          set_binding_map_out.add_from_to(set_binding, set_binding.binding());
         }
-        Dout(dc::shaderresource, "Found in cache (vk::PipelineLayout " << *iter->second << "). Using: " << key << " with translation: " << set_binding_map_out << ".");
       }
-      ASSERT(*iter->second);
-      Dout(dc::shaderresource, "Leaving LogicalDevice::realize_pipeline_layout");
-      return *iter->second;
+      Dout(dc::shaderresource, "Created vk::PipelineLayout " << *entry->second << " with key: " << entry->first << ".");
     }
-    catch (std::exception const&)
+    else
+      Dout(dc::shaderresource, "Another thread created the same vk::PipelineLayout first: destroyed ours.");
+  }
+  if (!created)
+  {
+    sorted_descriptor_set_layouts_container_t const& sorted_descriptor_set_layouts = entry->first.first;
+    // This should always be the case: they compared equal as key!?
+    ASSERT(realized_descriptor_set_layouts->size() == sorted_descriptor_set_layouts.size());
+    auto set_layout_in = realized_descriptor_set_layouts->begin();
+    auto set_layout_out = sorted_descriptor_set_layouts.begin();
+    while (set_layout_in != realized_descriptor_set_layouts->end())
     {
-      Dout(dc::shaderresource, "Another thread is also trying to convert read to write lock: dropping creation and trying again...");
-      m_pipeline_layouts.rd2wryield();
-      set_binding_map_out.clear();
+      // Same.
+      ASSERT(set_layout_in->sorted_bindings().size() == set_layout_out->sorted_bindings().size());
+      auto binding_in = set_layout_in->sorted_bindings().begin();
+      auto binding_out = set_layout_out->sorted_bindings().begin();
+      set_binding_map_out.add_from_to(set_layout_in->set_index_hint(), set_layout_out->set_index_hint());
+      while (binding_in != set_layout_in->sorted_bindings().end())
+      {
+        descriptor::SetBinding set_binding_in(set_layout_in->set_index_hint(), binding_in->binding);
+        descriptor::SetBinding set_binding_out(set_layout_out->set_index_hint(), binding_out->binding);
+        // I think this shouldn't happen no? *confused*
+        ASSERT(set_binding_in.binding() == binding_out->binding);
+        set_binding_map_out.add_from_to(set_binding_in, binding_out->binding);
+        binding_in->binding = binding_out->binding;
+        ++binding_in;
+        ++binding_out;
+      }
+      ++set_layout_in;
+      ++set_layout_out;
     }
+    Dout(dc::shaderresource, "Found in cache (vk::PipelineLayout " << *entry->second << "). Using: " << entry->first << " with translation: " << set_binding_map_out << ".");
   }
+  ASSERT(*entry->second);
+  Dout(dc::shaderresource, "Leaving LogicalDevice::realize_pipeline_layout");
+  return *entry->second;
 }
 
 LogicalDevice::LogicalDevice() : m_semaphore_watcher(statefultask::create<task::AsyncSemaphoreWatcher>(CWDEBUG_ONLY(true)))
@@ -1455,6 +1486,9 @@ LogicalDevice::LogicalDevice() : m_semaphore_watcher(statefultask::create<task::
 
 LogicalDevice::~LogicalDevice()
 {
+  Dout(dc::vulkan, "Descriptor set cache statistics: " << m_descriptor_set_cache.statistics());
+  // The waiter thread uses m_device.
+  m_semaphore_watcher->stop_waiter_thread();
 }
 
 #ifdef TRACY_ENABLE
@@ -13,16 +13,18 @@
 #include "queues/QueueReply.h"
 #include "memory/Allocator.h"
 #include "descriptor/SetLimits.h"
-#include "descriptor/LayoutBindingCompare.h"
+#include "descriptor/SortedBindingsHash.h"
 #include "descriptor/SetLayout.h"
 #include "descriptor/SetBindingMap.h"
-#include "pipeline/PushConstantRangeCompare.h"
+#include "descriptor/DescriptorAllocator.h"
+#include "descriptor/DescriptorSetCache.h"
+#include "pipeline/PipelineLayoutHash.h"
 #include "vk_utils/print_list.h"
+#include "vk_utils/InsertOnlyHashMap.h"
 #include "statefultask/AIStatefulTask.h"
 #include "statefultask/TaskEvent.h"
 #include "threadsafe/AIReadWriteMutex.h"
 #include "utils/Badge.h"
-#include "utils/PairCompare.h"
 #include <boost/intrusive_ptr.hpp>
 #include <boost/uuid/uuid.hpp>
 #include <vk_mem_alloc.h>
@@ -63,6 +65,7 @@ class RenderPass;
 namespace memory {
 class Buffer;
 class Image;
+class StagingRing;
 } // namespace memory
 
 // The collection of queue family properties for a given physical device.
@@ -104,6 +107,7 @@ class LogicalDevice
 
   // Physical device properties.
   vk::DeviceSize m_non_coherent_atom_size;              // Allocated non-coherent memory must be a multiple of this value in size.
+  vk::DeviceSize m_min_uniform_buffer_offset_alignment; // Offsets into uniform buffers (including dynamic offsets) must be a multiple of this value.
   float m_max_sampler_anisotropy;                       // GraphicsSettingsPOD::maxAnisotropy must be less than or equal this value.
   uint32_t m_max_bound_descriptor_sets;                 // Each pipeline object can use up to m_max_bound_descriptor_sets descriptor sets.
   descriptor::SetLimits m_set_limits;
@@ -115,24 +119,57 @@ class LogicalDevice
   bool m_supports_cache_control = {};
   memory::Allocator m_vh_allocator;                     // Handle to VMA allocator object.
   QueueRequestKey::request_cookie_type m_transfer_request_cookie = {};  // The cookie that was used to request eTransfer queues (set in LogicalDevice::prepare).
-  boost::intrusive_ptr<task::AsyncSemaphoreWatcher> m_semaphore_watcher;// Asynchronous task that polls timeline semaphores.
-
-  using descriptor_pool_t = aithreadsafe::Wrapper<vk::UniqueDescriptorPool, aithreadsafe::policy::Primitive<std::mutex>>;
-  descriptor_pool_t m_descriptor_pool;
-
-  using descriptor_set_layouts_container_t = std::map<std::vector<vk::DescriptorSetLayoutBinding>, vk::UniqueDescriptorSetLayout, utils::VectorCompare<descriptor::LayoutBindingCompare>>;
-  using descriptor_set_layouts_t = aithreadsafe::Wrapper<descriptor_set_layouts_container_t, aithreadsafe::policy::ReadWrite<AIReadWriteMutex>>;
+  boost::intrusive_ptr<task::AsyncSemaphoreWatcher> m_semaphore_watcher;// Asynchronous task that watches timeline semaphores.
+  std::unique_ptr<memory::StagingRing> m_staging_ring;  // Staging memory shared by all task::CopyDataToGPU tasks. Must be destroyed before m_vh_allocator.
+
+  // Descriptor sets that live as long as the logical device are allocated from one of these allocators,
+  // selected by the id of the calling thread, so that threads don't all contend for the same mutex.
+  static constexpr size_t number_of_descriptor_allocators = 8;
+  static constexpr uint32_t descriptor_allocator_initial_max_sets = 64;
+  using descriptor_allocator_t = aithreadsafe::Wrapper<descriptor::DescriptorAllocator, aithreadsafe::policy::Primitive<std::mutex>>;
+  std::array<std::unique_ptr<descriptor_allocator_t>, number_of_descriptor_allocators> m_descriptor_allocators;
+
+  // The number of descriptors of each type that are needed for a descriptor set with a given layout.
+  // Only layouts created by realize_descriptor_set_layout are in here (they are never destroyed before the logical device).
+  struct DescriptorSetLayoutHandleHash
+  {
+    // A vk::DescriptorSetLayout is a non-dispatchable handle: an opaque 64-bit value that isn't necessarily a pointer.
+    // Mix all of its bits (the finalizer of MurmurHash3), because InsertOnlyHashMap only uses the low bits of the hash.
+    size_t operator()(vk::DescriptorSetLayout vh_descriptor_set_layout) const
+    {
+      uint64_t h = reinterpret_cast<uint64_t>(static_cast<VkDescriptorSetLayout>(vh_descriptor_set_layout));
+      h ^= h >> 33;
+      h *= 0xff51afd7ed558ccdULL;
+      h ^= h >> 33;
+      h *= 0xc4ceb9fe1a85ec53ULL;
+      h ^= h >> 33;
+      return h;
+    }
+  };
+  using descriptor_set_layout_pool_sizes_container_t = vk_utils::InsertOnlyHashMap<vk::DescriptorSetLayout, std::vector<vk::DescriptorPoolSize>,
+        DescriptorSetLayoutHandleHash>;
+  mutable descriptor_set_layout_pool_sizes_container_t m_descriptor_set_layout_pool_sizes;
+  // Called by realize_descriptor_set_layout before it returns vh_descriptor_set_layout: add its pool sizes if they aren't there yet.
+  void publish_descriptor_set_layout_pool_sizes(vk::DescriptorSetLayout vh_descriptor_set_layout,
+      std::vector<vk::DescriptorSetLayoutBinding> const& sorted_descriptor_set_layout_bindings) const;
+
+  // Descriptor sets, allocated from m_descriptor_allocators, by content (see ShaderInputData::update_missing_descriptor_sets).
+  mutable descriptor::DescriptorSetCache m_descriptor_set_cache;
+
+  // The layout caches below are insert-only: looking up an existing layout never takes a lock.
+  using descriptor_set_layouts_container_t = vk_utils::InsertOnlyHashMap<std::vector<vk::DescriptorSetLayoutBinding>, vk::UniqueDescriptorSetLayout,
+        descriptor::SortedBindingsHash, descriptor::SortedBindingsEqual>;
   // Using "threadsafe-"const for member functions that access this. Since the 'const' then only
-  // means that it is thread-safe, we need to add a mutable here, so that it is possible to obtain a write-lock.
-  mutable descriptor_set_layouts_t m_descriptor_set_layouts;
+  // means that it is thread-safe, we need to add a mutable here, so that it is possible to insert new layouts.
+  mutable descriptor_set_layouts_container_t m_descriptor_set_layouts;
 
   // The same type as ShaderInputData::sorted_descriptor_set_layouts_container_t.
   using sorted_descriptor_set_layouts_container_t = std::vector<descriptor::SetLayout>;
   using pipeline_layouts_container_key_t = std::pair<sorted_descriptor_set_layouts_container_t, std::vector<vk::PushConstantRange>>;
-  using pipeline_layouts_container_t = std::map<pipeline_layouts_container_key_t, vk::UniquePipelineLayout,
-        utils::PairCompare<descriptor::SetLayoutCompare, pipeline::PushConstantRangeCompare>>;
-  using pipeline_layouts_t = aithreadsafe::Wrapper<pipeline_layouts_container_t, aithreadsafe::policy::ReadWrite<AIReadWriteMutex>>;
-  mutable pipeline_layouts_t m_pipeline_layouts;
+  // Looked up with a pipeline::PipelineLayoutKey, so that no copy of the key has to be made unless a new layout is inserted.
+  using pipeline_layouts_container_t = vk_utils::InsertOnlyHashMap<pipeline_layouts_container_key_t, vk::UniquePipelineLayout,
+        pipeline::PipelineLayoutHash, pipeline::PipelineLayoutEqual>;
+  mutable pipeline_layouts_container_t m_pipeline_layouts;
 
 #ifdef CWDEBUG
   std::string m_debug_name;
@@ -153,9 +190,12 @@ class LogicalDevice
   bool supports_sampler_anisotropy() const { return m_supports_sampler_anisotropy; }
   bool supports_cache_control() const { return m_supports_cache_control; }
   vk::DeviceSize non_coherent_atom_size() const { return m_non_coherent_atom_size; }
+  vk::DeviceSize min_uniform_buffer_offset_alignment() const { return m_min_uniform_buffer_offset_alignment; }
   float max_sampler_anisotropy() const { return m_max_sampler_anisotropy; }
   uint32_t max_bound_descriptor_sets() const { return m_max_bound_descriptor_sets; }
+  descriptor::SetLimits const& set_limits() const { return m_set_limits; }
   bool has_explicit_transfer_support() const { return m_queue_families.has_explicit_transfer_support(); }
+  QueueFlags queue_flags(QueueFamilyPropertiesIndex qfpi) const { return m_queue_families[qfpi].get_queue_flags(); }
   QueueRequestKey::request_cookie_type transfer_request_cookie() const { return m_transfer_request_cookie; }
 
   void print_on(std::ostream& os) const { char const* prefix = ""; os << '{'; print_members(os, prefix); os << '}'; }
@@ -179,7 +219,8 @@ class LogicalDevice
   // Called by pipeline::Characteristic derived user classes when they need a new (or existing) descriptor set layout.
   // The binding numbers in sorted_descriptor_set_layout_bindings will be updated if the layout already existed (this
   // does not influence the ordering; so it stays sorted the same way).
-  vk::DescriptorSetLayout realize_descriptor_set_layout(std::vector<vk::DescriptorSetLayoutBinding>& sorted_descriptor_set_layout_bindings) /*threadsafe-*/const;
+  // hash must be the value returned by descriptor::hash_sorted_bindings for sorted_descriptor_set_layout_bindings (see SetLayout::hash).
+  vk::DescriptorSetLayout realize_descriptor_set_layout(std::vector<vk::DescriptorSetLayoutBinding>& sorted_descriptor_set_layout_bindings, size_t hash) /*threadsafe-*/const;
 
   // This function realizes a pipeline layout, using realized_descriptor_set_layouts and sorted_push_constant_ranges,
   // and returns an updated set_binding_map_out (see explanation in LogicalDevice.cxx).
@@ -258,20 +299,43 @@ class LogicalDevice
       COMMA_CWDEBUG_ONLY(Ambifix const& debug_name)) const;
   vk::UniqueFramebuffer create_imageless_framebuffer(RenderPass const& render_graph_pass, vk::Extent2D extent, uint32_t layers
       COMMA_CWDEBUG_ONLY(Ambifix const& ambifix)) const;
+  // If pool_sizes contains eInlineUniformBlock then max_inline_uniform_block_bindings must be larger than zero.
   vk::UniqueDescriptorPool create_descriptor_pool(std::vector<vk::DescriptorPoolSize> const& pool_sizes, uint32_t max_sets
-      COMMA_CWDEBUG_ONLY(Ambifix const& debug_name)) const;
+      COMMA_CWDEBUG_ONLY(Ambifix const& debug_name), uint32_t max_inline_uniform_block_bindings = 0) const;
   vk::UniqueDescriptorSetLayout create_descriptor_set_layout(std::vector<vk::DescriptorSetLayoutBinding> const& layout_bindings
       COMMA_CWDEBUG_ONLY(Ambifix const& debug_name)) const;
-  std::vector<vk::DescriptorSet> allocate_descriptor_sets(std::vector<vk::DescriptorSetLayout> const& vhv_descriptor_set_layout COMMA_CWDEBUG_ONLY(std::vector<descriptor::SetIndex> const& set_indexes), descriptor_pool_t const& descriptor_pool
+  // Allocate descriptor sets that live as long as the logical device.
+  std::vector<vk::DescriptorSet> allocate_descriptor_sets(std::vector<vk::DescriptorSetLayout> const& vhv_descriptor_set_layout COMMA_CWDEBUG_ONLY(std::vector<descriptor::SetIndex> const& set_indexes)
+      COMMA_CWDEBUG_ONLY(Ambifix const& debug_name)) const;
+  // Allocate descriptor sets from a caller provided allocator (e.g. the transient allocator of a frame).
+  std::vector<vk::DescriptorSet> allocate_descriptor_sets(descriptor::DescriptorAllocator& descriptor_allocator,
+      std::vector<vk::DescriptorSetLayout> const& vhv_descriptor_set_layout COMMA_CWDEBUG_ONLY(std::vector<descriptor::SetIndex> const& set_indexes)
       COMMA_CWDEBUG_ONLY(Ambifix const& debug_name)) const;
-  std::vector<vk::UniqueDescriptorSet> allocate_descriptor_sets_unique(std::vector<vk::DescriptorSetLayout> const& vhv_descriptor_set_layout COMMA_CWDEBUG_ONLY(std::vector<descriptor::SetIndex> const& set_indexes), descriptor_pool_t const& descriptor_pool
+  // The pool must have been created with vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet.
+  std::vector<vk::UniqueDescriptorSet> allocate_descriptor_sets_unique(std::vector<vk::DescriptorSetLayout> const& vhv_descriptor_set_layout COMMA_CWDEBUG_ONLY(std::vector<descriptor::SetIndex> const& set_indexes), vk::DescriptorPool vh_descriptor_pool
       COMMA_CWDEBUG_ONLY(Ambifix const& debug_name)) const;
+  // Used by descriptor::DescriptorAllocator.
+  vk::Result try_allocate_descriptor_sets(vk::DescriptorPool vh_descriptor_pool, std::vector<vk::DescriptorSetLayout> const& vhv_descriptor_set_layout, vk::DescriptorSet* descriptor_sets_out) const;
+  void reset_descriptor_pool(vk::DescriptorPool vh_descriptor_pool) const;
+  // Access the descriptor set cache (thread-safe).
+  descriptor::DescriptorSetCache& descriptor_set_cache() const { return m_descriptor_set_cache; }
+
+  // Accessor for the staging memory that is shared by all uploads (thread-safe).
+  memory::StagingRing const& staging_ring() const { return *m_staging_ring; }
+  // Returns nullptr if vh_descriptor_set_layout wasn't created by realize_descriptor_set_layout.
+  std::vector<vk::DescriptorPoolSize> const* descriptor_set_layout_pool_sizes(vk::DescriptorSetLayout vh_descriptor_set_layout) const
+  {
+    auto const* entry = m_descriptor_set_layout_pool_sizes.find(vh_descriptor_set_layout);
+    return entry ? &entry->second : nullptr;
+  }
   void allocate_command_buffers(vk::CommandPool vh_pool, vk::CommandBufferLevel level, uint32_t count, vk::CommandBuffer* command_buffers_out
       COMMA_CWDEBUG_ONLY(Ambifix const& debug_name, bool is_array = true)) const;
   void free_command_buffers(vk::CommandPool vh_pool, uint32_t count, vk::CommandBuffer const* command_buffers) const;
   void update_descriptor_set(vk::DescriptorSet vh_descriptor_set, vk::DescriptorType descriptor_type, uint32_t binding, uint32_t array_element,
       std::vector<vk::DescriptorImageInfo> const& image_infos = {}, std::vector<vk::DescriptorBufferInfo> const& buffer_infos = {},
       std::vector<vk::BufferView> const& buffer_views = {}) const;
+  // Perform all descriptor writes with a single call (see descriptor::DescriptorUpdateBatch).
+  void update_descriptor_sets(std::vector<vk::WriteDescriptorSet> const& descriptor_writes) const;
   vk::UniquePipelineLayout create_pipeline_layout(std::vector<vk::DescriptorSetLayout> const& vhv_descriptor_set_layouts, std::vector<vk::PushConstantRange> const& push_constant_ranges
       COMMA_CWDEBUG_ONLY(Ambifix const& debug_name)) const;
   vk::UniqueSwapchainKHR create_swapchain(vk::Extent2D extent, uint32_t min_image_count, PresentationSurface const& presentation_surface,
@@ -279,6 +343,8 @@ class LogicalDevice
       COMMA_CWDEBUG_ONLY(Ambifix const& debug_name)) const;
   vk::UniquePipeline create_graphics_pipeline(vk::PipelineCache vh_pipeline_cache, vk::GraphicsPipelineCreateInfo const& graphics_pipeline_create_info
       COMMA_CWDEBUG_ONLY(Ambifix const& debug_name)) const;
+  std::vector<vk::UniquePipeline> create_graphics_pipelines(vk::PipelineCache vh_pipeline_cache, vk::ArrayProxy<vk::GraphicsPipelineCreateInfo const> const& graphics_pipeline_create_infos
+      COMMA_CWDEBUG_ONLY(Ambifix const& debug_name)) const;
   Swapchain::images_type get_swapchain_images(task::SynchronousWindow const* owning_window, vk::SwapchainKHR vh_swapchain
       COMMA_CWDEBUG_ONLY(Ambifix const& ambifix)) const;
 
@@ -393,10 +459,6 @@ class LogicalDevice
     DoutEntering(dc::vulkan, "LogicalDevice::get_image_memory_requirements(" << vh_image << ")");
     return m_device->getImageMemoryRequirements(vh_image);
   }
-  descriptor_pool_t const& get_descriptor_pool() const
-  {
-    return m_descriptor_pool;
-  }
 #ifdef CWDEBUG
   vk_utils::MemoryTypeBitsPrinter memory_type_bits_printer() const { return { m_memory_type_count }; }
   vk_utils::MemoryRequirementsPrinter memory_requirements_printer() const { return { m_memory_type_count, m_memory_heap_count }; }
@@ -412,6 +474,10 @@ class LogicalDevice
 
   // Override this function to add QueueRequest objects. The default will create a graphics and presentation queue.
   virtual void prepare_logical_device(DeviceCreateInfo& device_create_info) const { }
+
+  // Override this function to return false to poll timeline semaphores (every 4 ms) instead of
+  // using a thread that blocks in vkWaitSemaphores (see task::AsyncSemaphoreWatcher).
+  virtual bool use_semaphore_waiter_thread() const { return true; }
 };
 
 } // namespace vulkan
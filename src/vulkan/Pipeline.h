@@ -20,12 +20,14 @@ class Pipeline
   vk::PipelineLayout m_vh_layout;       // Vulkan handle to the pipeline layout.
   pipeline::Handle m_handle;            // Handle to the pipeline.
   utils::Vector<vk::DescriptorSet, descriptor::SetIndex> m_vhv_descriptor_sets;
+  uint32_t m_number_of_dynamic_offsets{};                      // The number of dynamic offsets that must be passed when binding m_vhv_descriptor_sets.
 
  public:
   Pipeline() = default;
   Pipeline(Pipeline&&) = default;
-  Pipeline(vk::PipelineLayout vh_layout, pipeline::Handle handle, utils::Vector<vk::DescriptorSet, descriptor::SetIndex> const& vhv_descriptor_sets) :
-    m_vh_layout(vh_layout), m_handle(handle), m_vhv_descriptor_sets(vhv_descriptor_sets) { }
+  Pipeline(vk::PipelineLayout vh_layout, pipeline::Handle handle, utils::Vector<vk::DescriptorSet, descriptor::SetIndex> const& vhv_descriptor_sets,
+      uint32_t number_of_dynamic_offsets) :
+    m_vh_layout(vh_layout), m_handle(handle), m_vhv_descriptor_sets(vhv_descriptor_sets), m_number_of_dynamic_offsets(number_of_dynamic_offsets) { }
 
   Pipeline& operator=(Pipeline&&) = default;
 
@@ -33,6 +35,7 @@ class Pipeline
   vk::PipelineLayout layout() const { return m_vh_layout; }
   pipeline::Handle const& handle() const { return m_handle; }
   utils::Vector<vk::DescriptorSet, descriptor::SetIndex> const& vhv_descriptor_sets() const { return m_vhv_descriptor_sets; }
+  uint32_t number_of_dynamic_offsets() const { return m_number_of_dynamic_offsets; }
 
 #ifdef CWDEBUG
   void print_on(std::ostream& os) const;
@@ -0,0 +1,67 @@
+#include "sys.h"
+#include "RecordSecondaryCommandBuffer.h"
+#include <Tracy.hpp>
+#include "debug.h"
+
+namespace task {
+
+void RecordSecondaryCommandBuffer::Recorders::record_unclaimed()
+{
+  int recorder;
+  while ((recorder = m_next_recorder.fetch_add(1, std::memory_order_relaxed)) < m_number_of_recorders)
+  {
+    vulkan::handle::CommandBuffer command_buffer = m_command_buffers[recorder];
+    command_buffer->begin({
+      .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit | vk::CommandBufferUsageFlagBits::eRenderPassContinue,
+      .pInheritanceInfo = &m_inheritance_info
+    });
+    (*m_record)(recorder, command_buffer);
+    command_buffer->end();
+    if (m_finished_recorders.fetch_add(1, std::memory_order_release) + 1 == m_number_of_recorders)
+      m_finished_recorders.notify_one();
+  }
+}
+
+void RecordSecondaryCommandBuffer::Recorders::wait_until_finished()
+{
+  // All recorders are claimed, so we only wait for recorders that are being recorded by another thread.
+  int finished_recorders;
+  while ((finished_recorders = m_finished_recorders.load(std::memory_order_acquire)) != m_number_of_recorders)
+    m_finished_recorders.wait(finished_recorders, std::memory_order_acquire);
+}
+
+RecordSecondaryCommandBuffer::~RecordSecondaryCommandBuffer()
+{
+  DoutEntering(dc::statefultask(mSMDebug), "RecordSecondaryCommandBuffer::~RecordSecondaryCommandBuffer() [" << this << "]");
+}
+
+char const* RecordSecondaryCommandBuffer::state_str_impl(state_type run_state) const
+{
+  switch (run_state)
+  {
+    AI_CASE_RETURN(RecordSecondaryCommandBuffer_record);
+  }
+  AI_NEVER_REACHED
+}
+
+char const* RecordSecondaryCommandBuffer::task_name_impl() const
+{
+  return "RecordSecondaryCommandBuffer";
+}
+
+void RecordSecondaryCommandBuffer::multiplex_impl(state_type run_state)
+{
+  switch (run_state)
+  {
+    case RecordSecondaryCommandBuffer_record:
+    {
+      ZoneScopedN("RecordSecondaryCommandBuffer_record");
+      // This does nothing if the render loop (or other tasks) already recorded everything.
+      m_recorders->record_unclaimed();
+      finish();
+      break;
+    }
+  }
+}
+
+} // namespace task
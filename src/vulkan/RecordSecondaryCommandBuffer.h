@@ -0,0 +1,79 @@
+#pragma once
+
+#include "CommandBuffer.h"
+#include "statefultask/AIStatefulTask.h"
+#include <array>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include "debug.h"
+
+namespace task {
+
+// Record secondary command buffers of a render pass, in the thread pool.
+//
+// These tasks are created by SynchronousWindow::record_secondary_command_buffers. The secondary
+// command buffers that must be recorded are claimed one by one, by these tasks and by the render
+// loop itself, so that the render loop never waits for a recorder that didn't start yet (the
+// render loop runs in the thread pool too). Each secondary command buffer was allocated from the
+// command pool of its recorder, so that they can be recorded concurrently.
+class RecordSecondaryCommandBuffer : public AIStatefulTask
+{
+ public:
+  // The function that records the commands; called with the index of the recorder and the (already begun) secondary command buffer.
+  using record_function_type = std::function<void(int, vulkan::handle::CommandBuffer)>;
+
+  static constexpr int max_number_of_recorders = 16;
+
+  // The recorders of one call to SynchronousWindow::record_secondary_command_buffers.
+  struct Recorders
+  {
+    record_function_type const* m_record;                       // Only used while the render loop waits in wait_until_finished.
+    vk::CommandBufferInheritanceInfo m_inheritance_info;        // The render pass (and framebuffer) that the commands will be executed in.
+    std::array<vulkan::handle::CommandBuffer, max_number_of_recorders> m_command_buffers;       // The secondary command buffer of each recorder.
+    int m_number_of_recorders;
+    std::atomic_int m_next_recorder{0};                         // The next recorder that wasn't claimed yet.
+    std::atomic_int m_finished_recorders{0};                    // The number of recorders that finished recording.
+
+    Recorders(record_function_type const* record, vk::CommandBufferInheritanceInfo const& inheritance_info, int number_of_recorders) :
+      m_record(record), m_inheritance_info(inheritance_info), m_number_of_recorders(number_of_recorders) { }
+
+    // Record recorders that weren't claimed yet by another thread, until none are left.
+    void record_unclaimed();
+
+    // Wait until all claimed recorders finished. Call record_unclaimed() first.
+    void wait_until_finished();
+  };
+
+ private:
+  std::shared_ptr<Recorders> m_recorders;                       // This task might run after the render loop stopped waiting.
+
+ protected:
+  using direct_base_type = AIStatefulTask;
+
+  // The different states of the task.
+  enum RecordSecondaryCommandBuffer_state_type {
+    RecordSecondaryCommandBuffer_record = direct_base_type::state_end
+  };
+
+ public:
+  // One beyond the largest state of this task.
+  static constexpr state_type state_end = RecordSecondaryCommandBuffer_record + 1;
+
+ public:
+  RecordSecondaryCommandBuffer(std::shared_ptr<Recorders> recorders COMMA_CWDEBUG_ONLY(bool debug = false)) :
+    direct_base_type(CWDEBUG_ONLY(debug)), m_recorders(std::move(recorders))
+  {
+    DoutEntering(dc::statefultask(mSMDebug), "RecordSecondaryCommandBuffer::RecordSecondaryCommandBuffer(" << m_recorders.get() << ") [" << this << "]");
+  }
+
+ protected:
+  ~RecordSecondaryCommandBuffer() override;
+
+  // Implementation of virtual functions of AIStatefulTask.
+  char const* state_str_impl(state_type run_state) const override;
+  char const* task_name_impl() const override;
+  void multiplex_impl(state_type run_state) override;
+};
+
+} // namespace task
@@ -1,5 +1,7 @@
 #include "sys.h"
 #include "SemaphoreWatcher.h"
+#include "LogicalDevice.h"
+#include <limits>
 
 namespace task {
 
@@ -12,11 +14,160 @@ char const* AsyncSemaphoreWatcher::condition_str_impl(condition_type condition)
   return SemaphoreWatcher<vulkan::AsyncTask>::condition_str_impl(condition);
 }
 
+void AsyncSemaphoreWatcher::add(vulkan::TimelineSemaphore const* timeline_semaphore, uint64_t signal_value, AIStatefulTask* task, AIStatefulTask::condition_type condition)
+{
+  // Only a new semaphore needs to be added to the semaphores that the waiter thread is waiting for.
+  if (SemaphoreWatcher<vulkan::AsyncTask>::add(timeline_semaphore, signal_value, task, condition) &&
+      m_waiter_thread_running.load(std::memory_order::acquire))
+  {
+    // Make the waiter thread wait for the new set of semaphores.
+    std::lock_guard<std::mutex> lock(m_waiter_mutex);
+    signal_wake_up_semaphore();
+  }
+}
+
+void AsyncSemaphoreWatcher::remove(vulkan::TimelineSemaphore const* timeline_semaphore)
+{
+  SemaphoreWatcher<vulkan::AsyncTask>::remove(timeline_semaphore);
+  if (m_waiter_thread_running.load(std::memory_order::acquire))
+  {
+    // The timeline semaphore is about to be destroyed; it may not be used by vkWaitSemaphores anymore.
+    // If the waiter thread isn't waiting then it will not use timeline_semaphore anymore: the next
+    // time it collects the watched semaphores, timeline_semaphore was already removed.
+    std::unique_lock<std::mutex> lock(m_waiter_mutex);
+    if (!m_waiting)
+      return;
+    // Otherwise wake it up and wait until it returned from vkWaitSemaphores.
+    uint64_t const wait_generation = m_wait_generation;
+    signal_wake_up_semaphore();
+    m_waiter_condition_variable.wait(lock, [&](){ return m_wait_generation != wait_generation; });
+  }
+}
+
+void AsyncSemaphoreWatcher::signal_wake_up_semaphore()
+{
+  // Timeline semaphore values must be strictly increasing, this is why m_waiter_mutex must be locked.
+  if (!m_wake_up_semaphore)
+    return;
+  vk::SemaphoreSignalInfo semaphore_signal_info{
+    .semaphore = *m_wake_up_semaphore,
+    .value = ++m_wake_up_value
+  };
+  m_logical_device->signal_timeline_semaphore(semaphore_signal_info);
+}
+
+bool AsyncSemaphoreWatcher::start_waiter_thread(vulkan::LogicalDevice const* logical_device)
+{
+  DoutEntering(dc::notice, "AsyncSemaphoreWatcher::start_waiter_thread(" << logical_device << ")");
+  // Don't call start_waiter_thread twice.
+  ASSERT(!m_waiter_thread_running);
+  try
+  {
+    std::lock_guard<std::mutex> lock(m_waiter_mutex);
+    m_logical_device = logical_device;
+    m_wake_up_value = 0;
+    m_wake_up_semaphore = logical_device->create_timeline_semaphore(m_wake_up_value
+        COMMA_CWDEBUG_ONLY(vulkan::Ambifix{"AsyncSemaphoreWatcher::m_wake_up_semaphore"}));
+    m_terminate_waiter_thread = false;
+    m_waiter_thread = std::thread([this](){ waiter_thread_main(); });
+  }
+  catch (std::exception const& error)
+  {
+    Dout(dc::warning, "Could not start the semaphore waiter thread (" << error.what() << "); falling back to polling.");
+    m_wake_up_semaphore.reset();
+    return false;
+  }
+  m_waiter_thread_running.store(true, std::memory_order::release);
+  // Let the waiter thread handle the semaphores that are already being watched.
+  {
+    std::lock_guard<std::mutex> lock(m_waiter_mutex);
+    signal_wake_up_semaphore();
+  }
+  return true;
+}
+
+void AsyncSemaphoreWatcher::stop_waiter_thread()
+{
+  DoutEntering(dc::notice, "AsyncSemaphoreWatcher::stop_waiter_thread()");
+  if (!m_waiter_thread.joinable())
+    return;
+  m_waiter_thread_running.store(false, std::memory_order::release);
+  {
+    std::lock_guard<std::mutex> lock(m_waiter_mutex);
+    m_terminate_waiter_thread = true;
+    signal_wake_up_semaphore();
+  }
+  m_waiter_thread.join();
+  {
+    std::lock_guard<std::mutex> lock(m_waiter_mutex);
+    m_wake_up_semaphore.reset();
+  }
+  // Poll the semaphores that are still being watched, if any; this task is waiting for have_semaphores.
+  signal(have_semaphores);
+}
+
+void AsyncSemaphoreWatcher::waiter_thread_main()
+{
+  Debug(NAMESPACE_DEBUG::init_thread("SemaphoreWaiter"));
+  std::vector<vk::Semaphore> vh_semaphores;
+  std::vector<uint64_t> signal_values;
+  for (;;)
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_waiter_mutex);
+      if (m_terminate_waiter_thread)
+        break;
+      m_waiting = true;
+      // Wake up when any of the below semaphores reaches its value, or when m_wake_up_semaphore is signaled.
+      // Because this value is read before collecting the watched semaphores, changes made after that will wake us up.
+      vh_semaphores.assign(1, *m_wake_up_semaphore);
+      signal_values.assign(1, m_wake_up_value + 1);
+    }
+    append_watched_semaphores(vh_semaphores, signal_values);
+    vk::SemaphoreWaitInfo const semaphore_wait_info{
+      .flags = vk::SemaphoreWaitFlagBits::eAny,
+      .semaphoreCount = static_cast<uint32_t>(vh_semaphores.size()),
+      .pSemaphores = vh_semaphores.data(),
+      .pValues = signal_values.data()
+    };
+    bool failed = false;
+    try
+    {
+      m_logical_device->wait_semaphores(semaphore_wait_info, std::numeric_limits<uint64_t>::max());
+    }
+    catch (std::exception const& error)
+    {
+      Dout(dc::warning, "vkWaitSemaphores failed (" << error.what() << "); falling back to polling.");
+      failed = true;
+    }
+    {
+      std::lock_guard<std::mutex> lock(m_waiter_mutex);
+      m_waiting = false;
+      ++m_wait_generation;
+    }
+    m_waiter_condition_variable.notify_all();
+    if (AI_UNLIKELY(failed))
+    {
+      m_waiter_thread_running.store(false, std::memory_order::release);
+      signal(have_semaphores);
+      break;
+    }
+    // Signal the tasks whose semaphore reached the awaited value, and stop watching those semaphores.
+    poll();
+  }
+}
+
 void AsyncSemaphoreWatcher::multiplex_impl(state_type run_state)
 {
   switch (run_state)
   {
     case SemaphoreWatcher_poll:
+      if (m_waiter_thread_running.load(std::memory_order::acquire))
+      {
+        // The waiter thread takes care of all watched semaphores.
+        wait(have_semaphores);
+        break;
+      }
       m_poll_rate_limiter.start(m_poll_rate_interval);
       if (poll())
       {
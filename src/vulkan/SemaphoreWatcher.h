@@ -4,10 +4,16 @@
 #include "AsyncTask.h"
 #include "SynchronousTask.h"
 #include "utils/Vector.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 #include <type_traits>
+#include <vector>
 
 namespace vulkan {
 class TimelineSemaphore;
+class LogicalDevice;
 } // namespace vulkan
 
 namespace task {
@@ -90,13 +96,17 @@ class SemaphoreWatcher : public BASE
   using BASE::wait;
   using BASE::signal;
 
-  void add(vulkan::TimelineSemaphore const* timeline_semaphore, uint64_t signal_value, AIStatefulTask* task, AIStatefulTask::condition_type condition);
+  // Returns true if timeline_semaphore wasn't watched yet; false if signal_value was added to an already watched semaphore.
+  bool add(vulkan::TimelineSemaphore const* timeline_semaphore, uint64_t signal_value, AIStatefulTask* task, AIStatefulTask::condition_type condition);
   void remove(vulkan::TimelineSemaphore const* timeline_semaphore);
   bool poll();
 
  protected:
   ~SemaphoreWatcher() override = default;
 
+  // Append all watched semaphores, and the counter value that each must reach, to vh_semaphores and signal_values respectively.
+  void append_watched_semaphores(std::vector<vk::Semaphore>& vh_semaphores, std::vector<uint64_t>& signal_values);
+
   // Implementation of virtual functions of AIStatefulTask.
   char const* condition_str_impl(condition_type condition) const override;
   char const* state_str_impl(state_type run_state) const override;
@@ -105,6 +115,15 @@ class SemaphoreWatcher : public BASE
   void initialize_impl() override;
 };
 
+// The SemaphoreWatcher of a LogicalDevice.
+//
+// This task has two modes. By default it polls all watched semaphores, at most once every 4 ms,
+// for as long as there are watched semaphores. Once start_waiter_thread was called (LogicalDevice::prepare
+// does that) a dedicated thread blocks in vkWaitSemaphores (with eAny) on all watched semaphores
+// and signals the tasks immediately when a semaphore reaches the awaited value. Changes to the set of
+// watched semaphores wake up that thread by signaling an internal timeline semaphore (m_wake_up_semaphore).
+//
+// If the waiter thread can't be started, or vkWaitSemaphores fails, the task falls back to polling.
 class AsyncSemaphoreWatcher : public SemaphoreWatcher<vulkan::AsyncTask>
 {
  public:
@@ -114,9 +133,37 @@ class AsyncSemaphoreWatcher : public SemaphoreWatcher<vulkan::AsyncTask>
   threadpool::Timer::Interval m_poll_rate_interval{threadpool::Interval<4, std::chrono::milliseconds>{}};      // The minimum time between two polls.
   threadpool::Timer m_poll_rate_limiter{[this](){ signal(poll_timer); }};
 
+  // Event-driven mode.
+  std::atomic_bool m_waiter_thread_running{false};      // Set while the waiter thread takes care of the watched semaphores.
+  std::thread m_waiter_thread;                          // The thread that blocks in vkWaitSemaphores.
+  vulkan::LogicalDevice const* m_logical_device{};      // The logical device of all watched semaphores.
+  std::mutex m_waiter_mutex;                            // Protects the members below.
+  std::condition_variable m_waiter_condition_variable;  // Notified each time the waiter thread returned from vkWaitSemaphores.
+  vk::UniqueSemaphore m_wake_up_semaphore;              // Timeline semaphore that is signaled to wake up the waiter thread.
+  uint64_t m_wake_up_value{};                           // The last value that m_wake_up_semaphore was signaled with.
+  bool m_waiting{};                                     // Set while the waiter thread is (about to be) blocked in vkWaitSemaphores.
+  uint64_t m_wait_generation{};                         // Incremented each time the waiter thread returned from vkWaitSemaphores.
+  bool m_terminate_waiter_thread{};                     // Set to make the waiter thread exit.
+
+  void waiter_thread_main();
+  // Wake up the waiter thread. m_waiter_mutex must be locked.
+  void signal_wake_up_semaphore();
+
  public:
   using SemaphoreWatcher<vulkan::AsyncTask>::SemaphoreWatcher;
 
+  // Hide the functions of the base class, to wake up the waiter thread when the set of watched semaphores changes.
+  // Adding a larger signal value to a semaphore that is already watched doesn't change that set: the waiter
+  // thread is already waiting for a smaller value of the same semaphore.
+  void add(vulkan::TimelineSemaphore const* timeline_semaphore, uint64_t signal_value, AIStatefulTask* task, AIStatefulTask::condition_type condition);
+  void remove(vulkan::TimelineSemaphore const* timeline_semaphore);
+
+  // Switch to the event-driven mode. Returns false if that failed (this task then keeps polling).
+  // All watched semaphores must belong to logical_device.
+  bool start_waiter_thread(vulkan::LogicalDevice const* logical_device);
+  // Switch back to polling. Must be called before the logical device is destroyed.
+  void stop_waiter_thread();
+
  protected:
   char const* condition_str_impl(condition_type condition) const override;
   void multiplex_impl(state_type run_state) override;
@@ -136,7 +183,7 @@ class AsyncSemaphoreWatcher : public SemaphoreWatcher<vulkan::AsyncTask>
 namespace task {
 
 template<TaskType BASE>
-void SemaphoreWatcher<BASE>::add(vulkan::TimelineSemaphore const* timeline_semaphore, uint64_t signal_value, AIStatefulTask* task, AIStatefulTask::condition_type condition)
+bool SemaphoreWatcher<BASE>::add(vulkan::TimelineSemaphore const* timeline_semaphore, uint64_t signal_value, AIStatefulTask* task, AIStatefulTask::condition_type condition)
 {
   DoutEntering(dc::notice, "SemaphoreWatcher::add(" << timeline_semaphore << ", " << signal_value << ", " << task << ", " << task->print_conditions(condition) << ")");
   watch_set_type::wat watch_set_w(m_watch_set);
@@ -149,12 +196,13 @@ void SemaphoreWatcher<BASE>::add(vulkan::TimelineSemaphore const* timeline_semap
           signal_value >= watch_set_w->m_notify_data[wsi].m_value_task_condition_triplets.back().m_signal_value);
       // Append to SemaphoreWatcherWatchSet::m_notify_data[wsi].m_value_task_condition_triplets a SemaphoreWatcherValueTaskConditionTriplet,
       watch_set_w->m_notify_data[wsi].m_value_task_condition_triplets.emplace_back(signal_value, task, condition);
-      return;
+      return false;
     }
   // New semaphore.
   watch_set_w->m_watch_data.emplace_back(timeline_semaphore, signal_value);
   watch_set_w->m_notify_data.emplace_back(signal_value, task, condition);
   signal(have_semaphores);
+  return true;
 }
 
 template<TaskType BASE>
@@ -212,6 +260,17 @@ bool SemaphoreWatcher<BASE>::poll()
   return !watch_set_w->m_watch_data.empty();
 }
 
+template<TaskType BASE>
+void SemaphoreWatcher<BASE>::append_watched_semaphores(std::vector<vk::Semaphore>& vh_semaphores, std::vector<uint64_t>& signal_values)
+{
+  watch_set_type::wat watch_set_w(m_watch_set);
+  for (SemaphoreWatcherWatchData const& watch_data : watch_set_w->m_watch_data)
+  {
+    vh_semaphores.push_back(*watch_data.m_timeline_semaphore->vh_semaphore_ptr());
+    signal_values.push_back(watch_data.m_signal_value);
+  }
+}
+
 template<TaskType BASE>
 char const* SemaphoreWatcher<BASE>::condition_str_impl(typename BASE::condition_type condition) const
 {
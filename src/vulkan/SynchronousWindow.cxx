@@ -808,6 +808,10 @@ void SynchronousWindow::start_frame()
   m_current_frame.m_resource_index = (m_current_frame.m_resource_index + 1) % m_current_frame.m_resource_count;
   m_current_frame.m_frame_resources = m_frame_resources_list[m_current_frame.m_resource_index].get();
 
+  // The secondary command buffers of these frame resources can be recorded again (after waiting for m_command_buffers_completed).
+  for (vulkan::FrameResourcesData::SecondaryCommandBuffers& secondary_command_buffers : m_current_frame.m_frame_resources->m_secondary_command_buffers)
+    secondary_command_buffers.m_used = 0;
+
   if (m_use_imgui)
   {
     m_imgui.start_frame(m_timer.get_delta_ms() * 0.001f);
@@ -815,6 +819,15 @@ void SynchronousWindow::start_frame()
   }
 }
 
+std::vector<vk::DescriptorSet> SynchronousWindow::allocate_transient_descriptor_sets(
+    std::vector<vk::DescriptorSetLayout> const& vhv_descriptor_set_layout
+    COMMA_CWDEBUG_ONLY(std::vector<vulkan::descriptor::SetIndex> const& set_indexes)
+    COMMA_CWDEBUG_ONLY(vulkan::Ambifix const& debug_name)) const
+{
+  return m_logical_device->allocate_descriptor_sets(m_current_frame.m_frame_resources->m_transient_descriptor_allocator,
+      vhv_descriptor_set_layout COMMA_CWDEBUG_ONLY(set_indexes) COMMA_CWDEBUG_ONLY(debug_name));
+}
+
 void SynchronousWindow::wait_command_buffer_completed()
 {
   CwZoneScopedN("m_command_buffers_completed", max_number_of_frame_resources(), m_current_frame.m_resource_index);
@@ -827,6 +840,58 @@ void SynchronousWindow::wait_command_buffer_completed()
   if (m_logical_device->wait_for_fences({ *m_current_frame.m_frame_resources->m_command_buffers_completed }, VK_FALSE, 1000000000) != vk::Result::eSuccess)
     throw std::runtime_error("Waiting for a fence takes too long!");
 #endif
+  // The GPU is done with the previous use of these frame resources: free the transient descriptor sets of that frame.
+  if (m_current_frame.m_frame_resources->m_transient_descriptor_allocator.has_allocations())
+    m_current_frame.m_frame_resources->m_transient_descriptor_allocator.reset();
+}
+
+void SynchronousWindow::record_secondary_command_buffers(vulkan::handle::CommandBuffer command_buffer, vk::RenderPassBeginInfo const& render_pass_begin_info,
+    int number_of_recorders, task::RecordSecondaryCommandBuffer::record_function_type const& record)
+{
+  ZoneScopedN("SynchronousWindow::record_secondary_command_buffers");
+  DoutEntering(dc::vkframe, "SynchronousWindow::record_secondary_command_buffers(" << command_buffer << ", render_pass_begin_info, " << number_of_recorders << ", record)");
+  using vulkan::FrameResourcesData;
+  using Recorders = task::RecordSecondaryCommandBuffer::Recorders;
+  FrameResourcesData* frame_resources = m_current_frame.m_frame_resources;
+  ASSERT(0 < number_of_recorders && number_of_recorders <= task::RecordSecondaryCommandBuffer::max_number_of_recorders);
+
+  auto recorders = std::make_shared<Recorders>(&record, vk::CommandBufferInheritanceInfo{
+      .renderPass = render_pass_begin_info.renderPass,
+      .subpass = 0,
+      .framebuffer = render_pass_begin_info.framebuffer
+    }, number_of_recorders);
+
+  // Get an unused secondary command buffer from the pool of each recorder.
+  for (int recorder = 0; recorder < number_of_recorders; ++recorder)
+  {
+#ifdef CWDEBUG
+    vulkan::AmbifixOwner const ambifix = debug_name_prefix("m_frame_resources_list[" + to_string(m_current_frame.m_resource_index) +
+        "]->m_secondary_command_buffers[" + std::to_string(recorder) + "]");
+#endif
+    if (recorder == static_cast<int>(frame_resources->m_secondary_command_buffers.size()))
+      frame_resources->m_secondary_command_buffers.emplace_back(m_logical_device, m_presentation_surface.graphics_queue().queue_family()
+          COMMA_CWDEBUG_ONLY(ambifix(".m_command_pool")));
+    FrameResourcesData::SecondaryCommandBuffers& pool = frame_resources->m_secondary_command_buffers[recorder];
+    if (pool.m_used == pool.m_command_buffers.size())
+      pool.m_command_buffers.push_back(pool.m_command_pool.allocate_secondary_buffer(
+          CWDEBUG_ONLY(ambifix(".m_command_buffers[" + std::to_string(pool.m_used) + "]"))));
+    recorders->m_command_buffers[recorder] = pool.m_command_buffers[pool.m_used++];
+  }
+
+  // Let the thread pool help with recording.
+  for (int recorder = 1; recorder < number_of_recorders; ++recorder)
+    statefultask::create<task::RecordSecondaryCommandBuffer>(recorders COMMA_CWDEBUG_ONLY(mSMDebug))->
+      run(vulkan::Application::instance().high_priority_queue(), [](bool){ });
+
+  // Record everything that wasn't picked up by those tasks yet ourselves, then wait for the ones that were.
+  recorders->record_unclaimed();
+  {
+    ZoneScopedN("wait for recorders");
+    recorders->wait_until_finished();
+  }
+
+  // Stitch them together in order.
+  command_buffer->executeCommands(number_of_recorders, recorders->m_command_buffers[0].get_array());
 }
 
 void SynchronousWindow::finish_frame()
@@ -956,6 +1021,27 @@ void SynchronousWindow::finish_impl()
   if (have_synchronous_task(atomic_flags()))
     handle_synchronous_tasks(CWDEBUG_ONLY(mSMDebug));
 
+  // Uploads that wait for the release of resources of this window by a submit that will never come would block m_task_counter_gate;
+  // signal their value with an empty submit (the resources are being destroyed anyway).
+  {
+    queue_family_ownership_releases_t::wat releases_w(m_queue_family_ownership_releases);
+    if (AI_UNLIKELY(!releases_w->empty()))
+    {
+      uint64_t const signal_value = releases_w->signal_value();
+      vk::TimelineSemaphoreSubmitInfo timeline_semaphore_submit_info{
+        .signalSemaphoreValueCount = 1,
+        .pSignalSemaphoreValues = &signal_value
+      };
+      vk::SubmitInfo submit_info{
+        .pNext = &timeline_semaphore_submit_info,
+        .signalSemaphoreCount = 1,
+        .pSignalSemaphores = &*m_queue_family_ownership_release_semaphore
+      };
+      presentation_surface().vh_graphics_queue().submit({ submit_info });
+      releases_w->clear();
+    }
+  }
+
   // Wait for (certain) tasks to be finished.
   m_task_counter_gate.wait();
 }
@@ -1067,6 +1153,10 @@ void SynchronousWindow::create_frame_resources()
 
   Dout(dc::vulkan, "Creating " << number_of_frame_resources.get_value() << " frame resources.");
   m_frame_resources_list.resize(number_of_frame_resources.get_value());
+  m_uniform_ring_buffer.create(m_logical_device, number_of_frame_resources, s_uniform_ring_buffer_region_size
+      COMMA_CWDEBUG_ONLY(debug_name_prefix("m_uniform_ring_buffer")));
+  m_queue_family_ownership_release_semaphore = m_logical_device->create_timeline_semaphore(0
+      COMMA_CWDEBUG_ONLY(debug_name_prefix("m_queue_family_ownership_release_semaphore")));
   for (vulkan::FrameResourceIndex i = m_frame_resources_list.ibegin(); i != m_frame_resources_list.iend(); ++i)
   {
 #ifdef CWDEBUG
@@ -1078,7 +1168,9 @@ void SynchronousWindow::create_frame_resources()
         number_of_registered_attachments(),
         // Constructor arguments for m_command_pool.
         m_logical_device, m_presentation_surface.graphics_queue().queue_family()
-        COMMA_CWDEBUG_ONLY(ambifix("->m_command_pool")));
+        COMMA_CWDEBUG_ONLY(ambifix("->m_command_pool"))
+        // Debug name of m_transient_descriptor_allocator.
+        COMMA_CWDEBUG_ONLY(ambifix("->m_transient_descriptor_allocator")));
 
     // A handle alias for the newly created frame resources object.
     auto& frame_resources = m_frame_resources_list[i];
@@ -1089,6 +1181,10 @@ void SynchronousWindow::create_frame_resources()
     // Create the command buffer.
     frame_resources->m_command_buffer = frame_resources->m_command_pool.allocate_buffer(
         CWDEBUG_ONLY(ambifix("->m_command_buffer")));
+    frame_resources->m_acquire_command_buffer = frame_resources->m_command_pool.allocate_buffer(
+        CWDEBUG_ONLY(ambifix("->m_acquire_command_buffer")));
+    frame_resources->m_release_command_buffer = frame_resources->m_command_pool.allocate_buffer(
+        CWDEBUG_ONLY(ambifix("->m_release_command_buffer")));
 
 #if 0 // FIXME: See FIXME above.
     // Move the overlapping descriptor set into m_frame_resources_list.
@@ -1135,6 +1231,63 @@ void SynchronousWindow::submit(vulkan::handle::CommandBuffer command_buffer)
     .pSignalSemaphores = swapchain().vhp_current_rendering_finished_semaphore()
   };
 
+  // If resources were uploaded by a queue of another queue family, then acquire their ownership before executing command_buffer.
+  // This also waits for the timeline semaphores of the queues that released them.
+  std::vector<vk::Semaphore> vh_wait_semaphores;
+  std::vector<vk::PipelineStageFlags> wait_dst_stage_masks;
+  std::vector<uint64_t> wait_values;
+  std::array<vk::CommandBuffer, 3> vh_command_buffers;
+  uint32_t command_buffer_count = 0;
+  vk::TimelineSemaphoreSubmitInfo timeline_semaphore_submit_info;
+  {
+    queue_family_ownership_acquires_t::wat acquires_w(m_queue_family_ownership_acquires);
+    if (AI_UNLIKELY(!acquires_w->empty()))
+    {
+      vulkan::handle::CommandBuffer acquire_command_buffer = m_current_frame.m_frame_resources->m_acquire_command_buffer;
+      acquires_w->record(acquire_command_buffer);
+      vh_command_buffers[command_buffer_count++] = *acquire_command_buffer.get_array();
+      // The first wait is for the (binary) image-available semaphore; its value is ignored.
+      vh_wait_semaphores.push_back(*swapchain().vhp_current_image_available_semaphore());
+      wait_dst_stage_masks.push_back(wait_dst_stage_mask);
+      wait_values.push_back(0);
+      for (size_t i = 0; i < acquires_w->wait_semaphores().size(); ++i)
+      {
+        vh_wait_semaphores.push_back(acquires_w->wait_semaphores()[i]);
+        wait_dst_stage_masks.push_back(acquires_w->consuming_stages());
+        wait_values.push_back(acquires_w->wait_values()[i]);
+      }
+      acquires_w->clear();
+      timeline_semaphore_submit_info.setWaitSemaphoreValues(wait_values);
+      submit_info.setPNext(&timeline_semaphore_submit_info);
+      submit_info.setWaitSemaphores(vh_wait_semaphores);
+      submit_info.setPWaitDstStageMask(wait_dst_stage_masks.data());
+    }
+  }
+  vh_command_buffers[command_buffer_count++] = *command_buffer.get_array();
+
+  // If resources of this window are about to be overwritten by a queue of another queue family, then release their ownership
+  // after executing command_buffer and signal the value that those uploads wait for.
+  std::array<vk::Semaphore, 2> vh_signal_semaphores;
+  std::array<uint64_t, 2> signal_values;
+  {
+    queue_family_ownership_releases_t::wat releases_w(m_queue_family_ownership_releases);
+    if (AI_UNLIKELY(!releases_w->empty()))
+    {
+      vulkan::handle::CommandBuffer release_command_buffer = m_current_frame.m_frame_resources->m_release_command_buffer;
+      releases_w->record(release_command_buffer);
+      vh_command_buffers[command_buffer_count++] = *release_command_buffer.get_array();
+      // The first signal is of the (binary) rendering-finished semaphore; its value is ignored.
+      vh_signal_semaphores = { *swapchain().vhp_current_rendering_finished_semaphore(), *m_queue_family_ownership_release_semaphore };
+      signal_values = { 0, releases_w->signal_value() };
+      releases_w->clear();
+      timeline_semaphore_submit_info.setSignalSemaphoreValues(signal_values);
+      submit_info.setPNext(&timeline_semaphore_submit_info);
+      submit_info.setSignalSemaphores(vh_signal_semaphores);
+    }
+  }
+  submit_info.setCommandBufferCount(command_buffer_count);
+  submit_info.setPCommandBuffers(vh_command_buffers.data());
+
   Dout(dc::vkframe, "Submitting command buffer: submit({" << submit_info << "}, " << *m_current_frame.m_frame_resources->m_command_buffers_completed << ")");
   presentation_surface().vh_graphics_queue().submit({ submit_info }, *m_current_frame.m_frame_resources->m_command_buffers_completed);
 
@@ -1206,9 +1359,9 @@ vulkan::pipeline::FactoryHandle SynchronousWindow::create_pipeline_factory(vulka
   return index;
 }
 
-void SynchronousWindow::have_new_pipeline(vulkan::Pipeline&& pipeline_handle_and_layout, vk::UniquePipeline&& pipeline)
+void SynchronousWindow::have_new_pipeline(vulkan::Pipeline&& pipeline_handle_and_layout, vulkan::pipeline::SharedPipelinePtr&& pipeline)
 {
-  DoutEntering(dc::vulkan, "SynchronousWindow::have_new_pipeline(" << pipeline_handle_and_layout << ", " << *pipeline << ")");
+  DoutEntering(dc::vulkan, "SynchronousWindow::have_new_pipeline(" << pipeline_handle_and_layout << ", " << pipeline->vh_pipeline() << ")");
   vulkan::pipeline::Handle const& pipeline_handle = pipeline_handle_and_layout.handle();
   auto& factory_pipelines = m_pipelines[pipeline_handle.m_pipeline_factory_index];
   if (factory_pipelines.iend() <= pipeline_handle.m_pipeline_index)
@@ -1219,13 +1372,15 @@ void SynchronousWindow::have_new_pipeline(vulkan::Pipeline&& pipeline_handle_and
 
 vk::Pipeline SynchronousWindow::vh_graphics_pipeline(vulkan::pipeline::Handle pipeline_handle) const
 {
-  return *m_pipelines[pipeline_handle.m_pipeline_factory_index][pipeline_handle.m_pipeline_index];
+  return m_pipelines[pipeline_handle.m_pipeline_factory_index][pipeline_handle.m_pipeline_index]->vh_pipeline();
 }
 
 void SynchronousWindow::pipeline_factory_done(utils::Badge<synchronous::MoveNewPipelines>, PipelineFactoryIndex index)
 {
   DoutEntering(dc::notice, "SynchronousWindow::pipeline_factory_done(" << index << ")");
   boost::intrusive_ptr<PipelineCache> pipeline_cache(m_pipeline_factories[index]->detach_pipeline_cache_task());
+  m_deduplicated_pipelines += m_pipeline_factories[index]->deduplicated_pipelines();
+  Dout(dc::vulkan, "Pipeline factory " << index << " deduplicated " << m_pipeline_factories[index]->deduplicated_pipelines() << " pipeline variants.");
   m_pipeline_factories[index].reset();          // Delete the pipeline factory task.
   m_application->pipeline_factory_done(this, std::move(pipeline_cache));
 }
@@ -15,6 +15,7 @@
 #include "InputEvent.h"
 #include "GraphicsSettings.h"
 #include "Pipeline.h"
+#include "RecordSecondaryCommandBuffer.h"
 #include "queues/QueueReply.h"
 #include "pipeline/Handle.h"
 #include "rendergraph/RenderGraph.h"
@@ -23,6 +24,9 @@
 #include "shader_builder/shader_resource/Texture.h"
 #include "ImGui.h"
 #include "vk_utils/TimerData.h"
+#include "memory/UniformRingBuffer.h"
+#include "queues/QueueFamilyOwnershipAcquires.h"
+#include "queues/QueueFamilyOwnershipReleases.h"
 #include "statefultask/Broker.h"
 #include "statefultask/TaskEvent.h"
 #include "statefultask/AIEngine.h"
@@ -217,11 +221,25 @@ class SynchronousWindow : public AIStatefulTask, protected vulkan::SynchronousEn
   statefultask::RunningTasksTracker m_dependent_tasks;                    // Tasks that should be aborted before this window is destructed.
   statefultask::TaskCounterGate m_task_counter_gate;                      // Number of running task that we should wait for before this window is destructed.
 
+ private:
+  // The acquire halves of queue family ownership transfers of resources that were uploaded for this window by a queue of another queue family.
+  // These are executed (on the graphics queue) as part of the next call to submit.
+  using queue_family_ownership_acquires_t = aithreadsafe::Wrapper<vulkan::QueueFamilyOwnershipAcquires, aithreadsafe::policy::Primitive<std::mutex>>;
+  mutable queue_family_ownership_acquires_t m_queue_family_ownership_acquires;
+  // The release halves of queue family ownership transfers of resources of this window that are about to be overwritten by a queue of another queue family.
+  // These are executed (on the graphics queue) after the command buffer of the next call to submit, which then signals m_queue_family_ownership_release_semaphore.
+  using queue_family_ownership_releases_t = aithreadsafe::Wrapper<vulkan::QueueFamilyOwnershipReleases, aithreadsafe::policy::Primitive<std::mutex>>;
+  mutable queue_family_ownership_releases_t m_queue_family_ownership_releases;
+  vk::UniqueSemaphore m_queue_family_ownership_release_semaphore;       // Timeline semaphore, created by create_frame_resources.
+
+ public:
+
   void close() { set_must_close(); }
 
  protected:
   static constexpr vk::Format s_default_depth_format = vk::Format::eD16Unorm;
   static constexpr vulkan::FrameResourceIndex s_default_max_number_of_frame_resources{2};       // Default size of m_frame_resources_list.
+  static constexpr vk::DeviceSize s_uniform_ring_buffer_region_size = 64 * 1024;                // The size of one region of a block of m_uniform_ring_buffer; more blocks are added when needed.
   static constexpr vulkan::SwapchainIndex s_default_max_number_of_swapchain_images{3};          // The default number of maximum number of swapchain images
                                                                                                 // that the application has to take into account (for example,
                                                                                                 // used for static creation of Tracy GPU zone labels).
@@ -247,6 +265,7 @@ class SynchronousWindow : public AIStatefulTask, protected vulkan::SynchronousEn
  protected:
   utils::Vector<std::unique_ptr<vulkan::FrameResourcesData>, vulkan::FrameResourceIndex> m_frame_resources_list;        // Vector with frame resources.
   vulkan::CurrentFrameData m_current_frame = { nullptr, vulkan::FrameResourceIndex{0}, vulkan::FrameResourceIndex{0} };
+  vulkan::memory::UniformRingBuffer m_uniform_ring_buffer;     // The memory of all uniform buffer shader resources, one region per frame resource.
 
   // Initialized by create_imgui. Deinitialized by destruction.
   vk_utils::TimerData m_timer;
@@ -401,6 +420,15 @@ class SynchronousWindow : public AIStatefulTask, protected vulkan::SynchronousEn
     return m_logical_device;
   }
 
+  // The uniform ring buffer that uniform buffer shader resources allocate their memory from.
+  vulkan::memory::UniformRingBuffer const& uniform_ring_buffer() const { return m_uniform_ring_buffer; }
+
+  // Return the dynamic offsets to pass to bindDescriptorSets when binding the descriptor sets of pipeline for the current frame.
+  vk::ArrayProxy<uint32_t const> dynamic_offsets(vulkan::Pipeline const& pipeline) const
+  {
+    return m_uniform_ring_buffer.dynamic_offsets(m_current_frame.m_resource_index, pipeline.number_of_dynamic_offsets());
+  }
+
   vulkan::Swapchain& swapchain() { return m_swapchain; }
   vulkan::Swapchain const& swapchain() const { return m_swapchain; }
   void no_swapchain(utils::Badge<vulkan::Swapchain>) const { vulkan::SynchronousEngine::no_swapchain(); }
@@ -439,7 +467,8 @@ class SynchronousWindow : public AIStatefulTask, protected vulkan::SynchronousEn
 
  protected:
   utils::Vector<boost::intrusive_ptr<task::PipelineFactory>> m_pipeline_factories;
-  utils::Vector<utils::Vector<vk::UniquePipeline, vulkan::pipeline::Index>, PipelineFactoryIndex> m_pipelines;
+  utils::Vector<utils::Vector<vulkan::pipeline::SharedPipelinePtr, vulkan::pipeline::Index>, PipelineFactoryIndex> m_pipelines;
+  int m_deduplicated_pipelines = 0;     // The number of pipeline variants of finished factories that share their vk::Pipeline with another variant.
 //  std::map<vulkan::FlatPipelineLayout, vk::UniquePipelineLayout> m_pipeline_layouts;
 
   // Called from create_graphics_pipelines of derived class.
@@ -449,7 +478,10 @@ class SynchronousWindow : public AIStatefulTask, protected vulkan::SynchronousEn
   vk::Pipeline vh_graphics_pipeline(vulkan::pipeline::Handle pipeline_handle) const;
 
  public:
-  void have_new_pipeline(vulkan::Pipeline&& pipeline_handle_and_layout, vk::UniquePipeline&& pipeline);
+  void have_new_pipeline(vulkan::Pipeline&& pipeline_handle_and_layout, vulkan::pipeline::SharedPipelinePtr&& pipeline);
+
+  // Return the total number of pipeline variants, of all finished pipeline factories, that didn't need their own vk::Pipeline.
+  int deduplicated_pipelines() const { return m_deduplicated_pipelines; }
 
   // Called by state MoveNewPipelines_done.
   void pipeline_factory_done(utils::Badge<synchronous::MoveNewPipelines>, PipelineFactoryIndex index);
@@ -514,7 +546,45 @@ class SynchronousWindow : public AIStatefulTask, protected vulkan::SynchronousEn
   void finish_frame();
   void acquire_image();
 
+  // Record the commands of a render pass in parallel, into number_of_recorders secondary command buffers.
+  //
+  // Calls record(recorder, secondary_command_buffer) for recorder = 0, 1, ..., number_of_recorders - 1, concurrently,
+  // in the calling thread and in the thread pool (so record must be thread-safe); the secondary command buffers are begun
+  // and ended by this function. Returns when all of them are recorded, after adding them with executeCommands to command_buffer
+  // in the order of recorder. Hence, command_buffer must be inside the render pass of render_pass_begin_info, begun with
+  // vk::SubpassContents::eSecondaryCommandBuffers. This may be called more than once per frame (e.g. for each render pass,
+  // in render graph order), but not before wait_command_buffer_completed() was called for the current frame.
+  void record_secondary_command_buffers(vulkan::handle::CommandBuffer command_buffer, vk::RenderPassBeginInfo const& render_pass_begin_info,
+      int number_of_recorders, task::RecordSecondaryCommandBuffer::record_function_type const& record);
+
  public:
+  // Called by task::CopyDataToGPU after a resource of this window was uploaded, and released, by a queue of another queue family (thread-safe).
+  // The acquire barrier is executed before the command buffer of the next submit, after vh_semaphore reached signal_value.
+  template<typename MemoryBarrier>
+  void add_queue_family_ownership_acquire(vk::Semaphore vh_semaphore, uint64_t signal_value, vk::PipelineStageFlags consuming_stages, MemoryBarrier const& barrier) const
+  {
+    queue_family_ownership_acquires_t::wat(m_queue_family_ownership_acquires)->add(vh_semaphore, signal_value, consuming_stages, barrier);
+  }
+
+  // Called by task::CopyDataToGPU before a resource of this window, that might still be in use, is uploaded by a queue of another queue family (thread-safe).
+  // The release barrier is executed after the command buffer of the next submit; the upload must wait until the returned semaphore reached the returned value.
+  template<typename MemoryBarrier>
+  std::pair<vk::Semaphore, uint64_t> add_queue_family_ownership_release(vk::PipelineStageFlags generating_stages, MemoryBarrier const& barrier) const
+  {
+    // Uploads are only started after create_frame_resources.
+    ASSERT(m_queue_family_ownership_release_semaphore);
+    uint64_t signal_value = queue_family_ownership_releases_t::wat(m_queue_family_ownership_releases)->add(generating_stages, barrier);
+    return { *m_queue_family_ownership_release_semaphore, signal_value };
+  }
+
+  // Allocate descriptor sets that are only used while rendering the current frame.
+  // They are freed automatically when the same frame resources are used again (see wait_command_buffer_completed);
+  // therefore this may only be called after wait_command_buffer_completed() was called for the current frame.
+  // Only call this from the render loop (it uses the transient descriptor allocator of the current frame resources).
+  std::vector<vk::DescriptorSet> allocate_transient_descriptor_sets(std::vector<vk::DescriptorSetLayout> const& vhv_descriptor_set_layout
+      COMMA_CWDEBUG_ONLY(std::vector<vulkan::descriptor::SetIndex> const& set_indexes)
+      COMMA_CWDEBUG_ONLY(vulkan::Ambifix const& debug_name)) const;
+
 #ifdef CWDEBUG
   vulkan::AmbifixOwner debug_name_prefix(std::string prefix) const;
 #endif
@@ -0,0 +1,136 @@
+#include "sys.h"
+#include "DescriptorAllocator.h"
+#include "LogicalDevice.h"
+#include "utils/AIAlert.h"
+#include <algorithm>
+#include "debug.h"
+
+namespace vulkan::descriptor {
+
+DescriptorAllocator::DescriptorAllocator(LogicalDevice const* logical_device, uint32_t initial_max_sets COMMA_CWDEBUG_ONLY(Ambifix const& debug_name)) :
+  m_logical_device(logical_device), m_initial_max_sets(initial_max_sets) COMMA_CWDEBUG_ONLY(m_debug_name(debug_name))
+{
+}
+
+bool DescriptorAllocator::next_pool(uint32_t request_sets, std::array<uint32_t, number_of_descriptor_types> const& request_descriptors,
+    uint32_t request_inline_uniform_block_bindings)
+{
+  DoutEntering(dc::vulkan, "DescriptorAllocator::next_pool(" << request_sets << ", ..., " << request_inline_uniform_block_bindings << ") [" << this << "]");
+
+  bool const first_pool = !m_current_pool && m_full_pools.empty();
+  if (m_current_pool)
+    m_full_pools.push_back(std::move(m_current_pool));
+  // What was allocated from the previous pool.
+  uint32_t const used_sets = m_allocated_sets;
+  std::array<uint32_t, number_of_descriptor_types> const used_descriptors = m_allocated_descriptors;
+  uint32_t const used_inline_uniform_block_bindings = m_allocated_inline_uniform_block_bindings;
+
+  m_allocated_sets = 0;
+  m_allocated_descriptors.fill(0);
+  m_allocated_inline_uniform_block_bindings = 0;
+
+  // Reuse a pool that was reset, if any.
+  if (!m_free_pools.empty())
+  {
+    m_current_pool = std::move(m_free_pools.back());
+    m_free_pools.pop_back();
+    return false;
+  }
+
+  // Size the new pool after what was allocated from the previous one: twice as much of everything that was used.
+  std::vector<vk::DescriptorPoolSize> pool_sizes;
+  uint32_t max_sets;
+  uint32_t max_inline_uniform_block_bindings;
+  if (first_pool)
+  {
+    max_sets = std::max(m_initial_max_sets, request_sets);
+    for (size_t i = 0; i < number_of_descriptor_types - 1; ++i)
+      pool_sizes.push_back({ .type = index_to_type(i), .descriptorCount = std::max(m_initial_max_sets, request_descriptors[i]) });
+    max_inline_uniform_block_bindings = request_inline_uniform_block_bindings;
+  }
+  else
+  {
+    max_sets = std::max(m_initial_max_sets, 2 * (used_sets + request_sets));
+    for (size_t i = 0; i < number_of_descriptor_types - 1; ++i)
+      pool_sizes.push_back({ .type = index_to_type(i),
+          .descriptorCount = std::max(s_minimum_descriptors_per_type, 2 * (used_descriptors[i] + request_descriptors[i])) });
+    max_inline_uniform_block_bindings = 2 * (used_inline_uniform_block_bindings + request_inline_uniform_block_bindings);
+  }
+  // Inline uniform blocks are only added when they are used: that type requires VK_EXT_inline_uniform_block (or Vulkan 1.3).
+  if (max_inline_uniform_block_bindings > 0)
+  {
+    size_t const i = type_index(vk::DescriptorType::eInlineUniformBlock);
+    uint32_t const bytes = first_pool ? request_descriptors[i] : 2 * (used_descriptors[i] + request_descriptors[i]);
+    // The size of an inline uniform block must be a multiple of four.
+    pool_sizes.push_back({ .type = vk::DescriptorType::eInlineUniformBlock, .descriptorCount = (bytes + 3) & ~uint32_t{3} });
+  }
+  Dout(dc::vulkan, "Creating descriptor pool with maxSets = " << max_sets << ", pool sizes " << pool_sizes <<
+      " and maxInlineUniformBlockBindings = " << max_inline_uniform_block_bindings);
+  m_current_pool = m_logical_device->create_descriptor_pool(pool_sizes, max_sets
+      COMMA_CWDEBUG_ONLY(m_debug_name("[" + std::to_string(m_number_of_pools) + "]")), max_inline_uniform_block_bindings);
+  Debug(++m_number_of_pools);
+  return true;
+}
+
+std::vector<vk::DescriptorSet> DescriptorAllocator::allocate(std::vector<vk::DescriptorSetLayout> const& vhv_descriptor_set_layouts)
+{
+  DoutEntering(dc::vulkan, "DescriptorAllocator::allocate(" << vhv_descriptor_set_layouts << ") [" << this << "]");
+
+  // Count what is requested, per descriptor type.
+  uint32_t const request_sets = vhv_descriptor_set_layouts.size();
+  std::array<uint32_t, number_of_descriptor_types> request_descriptors{};
+  uint32_t request_inline_uniform_block_bindings = 0;
+  for (vk::DescriptorSetLayout vh_descriptor_set_layout : vhv_descriptor_set_layouts)
+    if (std::vector<vk::DescriptorPoolSize> const* pool_sizes = m_logical_device->descriptor_set_layout_pool_sizes(vh_descriptor_set_layout))
+      for (vk::DescriptorPoolSize const& pool_size : *pool_sizes)
+      {
+        request_descriptors[type_index(pool_size.type)] += pool_size.descriptorCount;
+        // There is one pool size per inline uniform block binding (see LogicalDevice::realize_descriptor_set_layout).
+        if (pool_size.type == vk::DescriptorType::eInlineUniformBlock)
+          ++request_inline_uniform_block_bindings;
+      }
+
+  bool new_pool = false;
+  if (!m_current_pool)
+    new_pool = next_pool(request_sets, request_descriptors, request_inline_uniform_block_bindings);
+
+  std::vector<vk::DescriptorSet> descriptor_sets(request_sets);
+  int failures_with_new_pool = 0;
+  for (;;)
+  {
+    vk::Result result = m_logical_device->try_allocate_descriptor_sets(*m_current_pool, vhv_descriptor_set_layouts, descriptor_sets.data());
+    if (result == vk::Result::eSuccess)
+      break;
+    // A new pool is created large enough for this request, unless the sizes of the layouts are unknown; try at most twice.
+    if ((result != vk::Result::eErrorOutOfPoolMemory && result != vk::Result::eErrorFragmentedPool) || (new_pool && ++failures_with_new_pool == 2))
+      THROW_ALERTC(result, "allocateDescriptorSets");
+    Dout(dc::vulkan, "Descriptor pool exhausted (" << result << ") after " << m_allocated_sets << " sets; moving on to the next pool.");
+    new_pool = next_pool(request_sets, request_descriptors, request_inline_uniform_block_bindings);
+  }
+
+  m_allocated_sets += request_sets;
+  for (size_t i = 0; i < number_of_descriptor_types; ++i)
+    m_allocated_descriptors[i] += request_descriptors[i];
+  m_allocated_inline_uniform_block_bindings += request_inline_uniform_block_bindings;
+  return descriptor_sets;
+}
+
+void DescriptorAllocator::reset()
+{
+  DoutEntering(dc::vulkan, "DescriptorAllocator::reset() [" << this << "]");
+  if (m_current_pool)
+  {
+    m_logical_device->reset_descriptor_pool(*m_current_pool);
+    m_allocated_sets = 0;
+    m_allocated_descriptors.fill(0);
+    m_allocated_inline_uniform_block_bindings = 0;
+  }
+  for (vk::UniqueDescriptorPool& pool : m_full_pools)
+  {
+    m_logical_device->reset_descriptor_pool(*pool);
+    m_free_pools.push_back(std::move(pool));
+  }
+  m_full_pools.clear();
+}
+
+} // namespace vulkan::descriptor
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+#include <array>
+#include <vector>
+#ifdef CWDEBUG
+#include "debug/DebugSetName.h"
+#endif
+#include "debug.h"
+
+namespace vulkan {
+class LogicalDevice;
+} // namespace vulkan
+
+namespace vulkan::descriptor {
+
+// Allocates descriptor sets from a chain of descriptor pools.
+//
+// When the current pool is exhausted (eErrorOutOfPoolMemory or eErrorFragmentedPool)
+// a new pool is created and added to the chain. The size of the new pool is based on
+// what was actually allocated from the previous pool, per vk::DescriptorType (see
+// LogicalDevice::descriptor_set_layout_pool_sizes).
+//
+// The descriptorCount of eInlineUniformBlock is the number of bytes of the blocks;
+// the number of inline uniform block bindings is accounted for separately, because
+// it must be passed to the pool in a vk::DescriptorPoolInlineUniformBlockCreateInfo.
+//
+// This class is not thread-safe. LogicalDevice keeps a number of these (one per
+// group of threads), each protected by its own mutex, for descriptor sets that live
+// as long as the logical device. Each FrameResourcesData has one for transient,
+// per-frame descriptor sets; those are all freed at once with reset().
+class DescriptorAllocator
+{
+ public:
+  // The minimum number of descriptors of each type in a pool that is not the first pool.
+  static constexpr uint32_t s_minimum_descriptors_per_type = 16;
+  // The descriptor types that are accounted for (the first eInputAttachment + 1 types, and eInlineUniformBlock).
+  static constexpr size_t number_of_descriptor_types = static_cast<size_t>(vk::DescriptorType::eInputAttachment) + 2;
+
+ private:
+  LogicalDevice const* m_logical_device;
+  uint32_t m_initial_max_sets;                                          // The maxSets of the first pool.
+  vk::UniqueDescriptorPool m_current_pool;                              // The pool that is allocated from.
+  std::vector<vk::UniqueDescriptorPool> m_full_pools;                   // Exhausted pools; kept alive because the descriptor sets allocated from them are still in use.
+  std::vector<vk::UniqueDescriptorPool> m_free_pools;                   // Pools that were reset and can be reused (transient allocators only).
+  uint32_t m_allocated_sets = 0;                                        // The number of sets allocated from m_current_pool.
+  std::array<uint32_t, number_of_descriptor_types> m_allocated_descriptors{}; // The number of descriptors allocated from m_current_pool, per type.
+  uint32_t m_allocated_inline_uniform_block_bindings = 0;               // The number of inline uniform block bindings allocated from m_current_pool.
+#ifdef CWDEBUG
+  Ambifix m_debug_name;
+  int m_number_of_pools = 0;
+#endif
+
+  static size_t type_index(vk::DescriptorType descriptor_type)
+  {
+    return descriptor_type == vk::DescriptorType::eInlineUniformBlock ? number_of_descriptor_types - 1 : static_cast<size_t>(descriptor_type);
+  }
+
+  static vk::DescriptorType index_to_type(size_t index)
+  {
+    return index == number_of_descriptor_types - 1 ? vk::DescriptorType::eInlineUniformBlock : static_cast<vk::DescriptorType>(index);
+  }
+
+  // Make a new m_current_pool, moving the old one (if any) to m_full_pools.
+  // A newly created pool will have room for at least request_sets more sets, with request_descriptors more descriptors
+  // and request_inline_uniform_block_bindings more inline uniform block bindings.
+  // Returns true if a new pool was created, false if a pool was reused from m_free_pools.
+  bool next_pool(uint32_t request_sets, std::array<uint32_t, number_of_descriptor_types> const& request_descriptors,
+      uint32_t request_inline_uniform_block_bindings);
+
+ public:
+  DescriptorAllocator(LogicalDevice const* logical_device, uint32_t initial_max_sets COMMA_CWDEBUG_ONLY(Ambifix const& debug_name));
+
+  // Allocate one descriptor set per layout in vhv_descriptor_set_layouts.
+  std::vector<vk::DescriptorSet> allocate(std::vector<vk::DescriptorSetLayout> const& vhv_descriptor_set_layouts);
+
+  // Free all descriptor sets that were allocated, by resetting all pools.
+  // The caller must make sure that none of the descriptor sets is still in use by the GPU.
+  void reset();
+
+  // Return true if any descriptor set was allocated since the last reset().
+  bool has_allocations() const { return m_allocated_sets > 0 || !m_full_pools.empty(); }
+};
+
+} // namespace vulkan::descriptor
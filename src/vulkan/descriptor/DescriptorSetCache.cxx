@@ -0,0 +1,99 @@
+#include "sys.h"
+#include "DescriptorSetCache.h"
+#include <boost/container_hash/hash.hpp>
+#include <algorithm>
+#include "debug.h"
+
+namespace vulkan::descriptor {
+
+void DescriptorSetKey::sort()
+{
+  std::sort(m_bindings.begin(), m_bindings.end(), [](binding_type const& lhs, binding_type const& rhs){ return lhs.first < rhs.first; });
+}
+
+size_t DescriptorSetKey::hash() const
+{
+  size_t seed = std::hash<vk::DescriptorSetLayout>{}(m_layout);
+  for (binding_type const& binding : m_bindings)
+  {
+    boost::hash_combine(seed, binding.first);
+    boost::hash_combine(seed, binding.second);
+  }
+  return seed;
+}
+
+vk::DescriptorSet DescriptorSetCache::find(DescriptorSetKey const& key) const
+{
+  // The key must be sorted.
+  ASSERT(std::is_sorted(key.m_bindings.begin(), key.m_bindings.end(),
+        [](DescriptorSetKey::binding_type const& lhs, DescriptorSetKey::binding_type const& rhs){ return lhs.first < rhs.first; }));
+  cache_t::crat cache_r(m_cache);
+  auto entry = cache_r->find(key);
+  if (entry == cache_r->end())
+  {
+    m_misses.fetch_add(1, std::memory_order_relaxed);
+    return {};
+  }
+  m_hits.fetch_add(1, std::memory_order_relaxed);
+  return entry->second.m_vh_descriptor_set;
+}
+
+void DescriptorSetCache::insert(DescriptorSetKey&& key, vk::DescriptorSet vh_descriptor_set, uint32_t number_of_descriptors)
+{
+  DoutEntering(dc::shaderresource, "DescriptorSetCache::insert({" << key.m_layout << ", ...}, " << vh_descriptor_set << ", " << number_of_descriptors << ")");
+  [[maybe_unused]] bool inserted = cache_t::wat(m_cache)->try_emplace(std::move(key), Entry{vh_descriptor_set, number_of_descriptors}).second;
+  // Creation of a descriptor set with the same contents is serialized by the set layout binding lock of its first shader resource.
+  ASSERT(inserted);
+  m_descriptor_sets.fetch_add(1, std::memory_order_relaxed);
+  m_descriptors.fetch_add(number_of_descriptors, std::memory_order_relaxed);
+}
+
+void DescriptorSetCache::remove(SetKey shader_resource_set_key)
+{
+  DoutEntering(dc::shaderresource, "DescriptorSetCache::remove(" << shader_resource_set_key << ")");
+  size_t const id = shader_resource_set_key.id();
+  size_t removed_descriptor_sets = 0;
+  size_t removed_descriptors = 0;
+  {
+    cache_t::wat cache_w(m_cache);
+    for (auto entry = cache_w->begin(); entry != cache_w->end();)
+    {
+      auto const& bindings = entry->first.m_bindings;
+      if (std::none_of(bindings.begin(), bindings.end(), [id](DescriptorSetKey::binding_type const& binding){ return binding.second == id; }))
+      {
+        ++entry;
+        continue;
+      }
+      ++removed_descriptor_sets;
+      removed_descriptors += entry->second.m_number_of_descriptors;
+      entry = cache_w->erase(entry);
+    }
+  }
+  Dout(dc::shaderresource, "Removed " << removed_descriptor_sets << " descriptor sets.");
+  m_descriptor_sets.fetch_sub(removed_descriptor_sets, std::memory_order_relaxed);
+  m_descriptors.fetch_sub(removed_descriptors, std::memory_order_relaxed);
+}
+
+DescriptorSetCache::Statistics DescriptorSetCache::statistics() const
+{
+  return {
+    .m_hits = m_hits.load(std::memory_order_relaxed),
+    .m_misses = m_misses.load(std::memory_order_relaxed),
+    .m_descriptor_sets = m_descriptor_sets.load(std::memory_order_relaxed),
+    .m_descriptors = m_descriptors.load(std::memory_order_relaxed)
+  };
+}
+
+#ifdef CWDEBUG
+void DescriptorSetCache::Statistics::print_on(std::ostream& os) const
+{
+  os << '{';
+  os << "hits:" << m_hits <<
+      ", misses:" << m_misses <<
+      ", descriptor_sets:" << m_descriptor_sets <<
+      ", descriptors:" << m_descriptors;
+  os << '}';
+}
+#endif
+
+} // namespace vulkan::descriptor
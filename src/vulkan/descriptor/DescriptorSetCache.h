@@ -0,0 +1,98 @@
+#pragma once
+
+#include "SetKey.h"
+#include "threadsafe/aithreadsafe.h"
+#include "threadsafe/AIReadWriteSpinLock.h"
+#include <vulkan/vulkan.hpp>
+#include <atomic>
+#include <iosfwd>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "debug.h"
+
+namespace vulkan::descriptor {
+
+// The contents of a descriptor set: its layout and the shader resource that is bound to each binding.
+//
+// Shader resources are identified by the id of their SetKey (see shader_resource::Base::descriptor_set_key),
+// not by their address: ids are never reused, so a shader resource that is created at the address of
+// a destroyed one can not find the descriptor sets of the latter.
+struct DescriptorSetKey
+{
+  using binding_type = std::pair<uint32_t, size_t>;     // The binding number and the SetKey id of the shader resource bound to it.
+
+  vk::DescriptorSetLayout m_layout;
+  std::vector<binding_type> m_bindings;                 // Sorted by binding number (see sort()).
+
+  void add(uint32_t binding, SetKey shader_resource_set_key) { m_bindings.emplace_back(binding, shader_resource_set_key.id()); }
+  void sort();
+  size_t hash() const;
+
+  friend bool operator==(DescriptorSetKey const& lhs, DescriptorSetKey const& rhs)
+  {
+    return lhs.m_layout == rhs.m_layout && lhs.m_bindings == rhs.m_bindings;
+  }
+};
+
+struct DescriptorSetKeyHash
+{
+  size_t operator()(DescriptorSetKey const& key) const { return key.hash(); }
+};
+
+// A content-addressed cache of descriptor sets, shared by all pipeline factories of a LogicalDevice.
+//
+// Pipelines that bind the same shader resources at the same bindings of the same descriptor set
+// layout use the same vk::DescriptorSet. The entries that contain a shader resource are removed when
+// that shader resource is destroyed (see shader_resource::Base::~Base). The descriptor sets themselves
+// are not freed: they live as long as the logical device (they are allocated from LogicalDevice::m_descriptor_allocators,
+// whose pools are not created with vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet).
+//
+// Creating a descriptor set that is missing is serialized by ShaderInputData::update_missing_descriptor_sets,
+// which locks the set layout binding of the first shader resource of the set.
+class DescriptorSetCache
+{
+ public:
+  struct Statistics
+  {
+    size_t m_hits;                                      // The number of times that find() returned an existing descriptor set.
+    size_t m_misses;                                    // The number of times that find() returned a null handle.
+    size_t m_descriptor_sets;                           // The number of descriptor sets in the cache.
+    size_t m_descriptors;                               // The total number of descriptors of those sets.
+
+#ifdef CWDEBUG
+    void print_on(std::ostream& os) const;
+#endif
+  };
+
+ private:
+  struct Entry
+  {
+    vk::DescriptorSet m_vh_descriptor_set;
+    uint32_t m_number_of_descriptors;                   // Only used for the statistics.
+  };
+  using cache_container_t = std::unordered_map<DescriptorSetKey, Entry, DescriptorSetKeyHash>;
+  using cache_t = aithreadsafe::Wrapper<cache_container_t, aithreadsafe::policy::ReadWrite<AIReadWriteSpinLock>>;
+
+  mutable cache_t m_cache;
+  mutable std::atomic<size_t> m_hits{0};
+  mutable std::atomic<size_t> m_misses{0};
+  std::atomic<size_t> m_descriptor_sets{0};
+  std::atomic<size_t> m_descriptors{0};
+
+ public:
+  // Return the descriptor set with contents key, or VK_NULL_HANDLE if it isn't cached (yet).
+  // key must be sorted.
+  vk::DescriptorSet find(DescriptorSetKey const& key) const;
+
+  // Add a newly created descriptor set. number_of_descriptors is only used for the statistics.
+  void insert(DescriptorSetKey&& key, vk::DescriptorSet vh_descriptor_set, uint32_t number_of_descriptors);
+
+  // Remove all descriptor sets that the shader resource with SetKey shader_resource_set_key is bound to.
+  // Called when that shader resource is destroyed.
+  void remove(SetKey shader_resource_set_key);
+
+  Statistics statistics() const;
+};
+
+} // namespace vulkan::descriptor
@@ -0,0 +1,97 @@
+#include "sys.h"
+#include "DescriptorUpdateBatch.h"
+#include "LogicalDevice.h"
+#include "debug.h"
+
+namespace vulkan::descriptor {
+
+void DescriptorUpdateBatch::add(vk::DescriptorSet vh_descriptor_set, vk::DescriptorType descriptor_type, uint32_t binding, uint32_t array_element,
+    std::vector<vk::DescriptorImageInfo> const& image_infos)
+{
+  // These are the descriptor types that use pImageInfo.
+  ASSERT(descriptor_type == vk::DescriptorType::eSampler || descriptor_type == vk::DescriptorType::eCombinedImageSampler ||
+      descriptor_type == vk::DescriptorType::eSampledImage || descriptor_type == vk::DescriptorType::eStorageImage ||
+      descriptor_type == vk::DescriptorType::eInputAttachment);
+  m_writes.push_back({
+    .dstSet = vh_descriptor_set,
+    .dstBinding = binding,
+    .dstArrayElement = array_element,
+    .descriptorCount = static_cast<uint32_t>(image_infos.size()),
+    .descriptorType = descriptor_type
+  });
+  m_info_offsets.push_back(m_image_infos.size());
+  m_image_infos.insert(m_image_infos.end(), image_infos.begin(), image_infos.end());
+}
+
+void DescriptorUpdateBatch::add(vk::DescriptorSet vh_descriptor_set, vk::DescriptorType descriptor_type, uint32_t binding, uint32_t array_element,
+    std::vector<vk::DescriptorBufferInfo> const& buffer_infos)
+{
+  // These are the descriptor types that use pBufferInfo.
+  ASSERT(descriptor_type == vk::DescriptorType::eUniformBuffer || descriptor_type == vk::DescriptorType::eStorageBuffer ||
+      descriptor_type == vk::DescriptorType::eUniformBufferDynamic || descriptor_type == vk::DescriptorType::eStorageBufferDynamic);
+  m_writes.push_back({
+    .dstSet = vh_descriptor_set,
+    .dstBinding = binding,
+    .dstArrayElement = array_element,
+    .descriptorCount = static_cast<uint32_t>(buffer_infos.size()),
+    .descriptorType = descriptor_type
+  });
+  m_info_offsets.push_back(m_buffer_infos.size());
+  m_buffer_infos.insert(m_buffer_infos.end(), buffer_infos.begin(), buffer_infos.end());
+}
+
+void DescriptorUpdateBatch::add(vk::DescriptorSet vh_descriptor_set, vk::DescriptorType descriptor_type, uint32_t binding, uint32_t array_element,
+    std::vector<vk::BufferView> const& buffer_views)
+{
+  // These are the descriptor types that use pTexelBufferView.
+  ASSERT(descriptor_type == vk::DescriptorType::eUniformTexelBuffer || descriptor_type == vk::DescriptorType::eStorageTexelBuffer);
+  m_writes.push_back({
+    .dstSet = vh_descriptor_set,
+    .dstBinding = binding,
+    .dstArrayElement = array_element,
+    .descriptorCount = static_cast<uint32_t>(buffer_views.size()),
+    .descriptorType = descriptor_type
+  });
+  m_info_offsets.push_back(m_buffer_views.size());
+  m_buffer_views.insert(m_buffer_views.end(), buffer_views.begin(), buffer_views.end());
+}
+
+void DescriptorUpdateBatch::flush(LogicalDevice const* logical_device)
+{
+  DoutEntering(dc::shaderresource|dc::vulkan, "DescriptorUpdateBatch::flush(" << logical_device << ") with " << m_writes.size() << " writes [" << this << "]");
+
+  if (m_writes.empty())
+    return;
+
+  // Now that no more infos will be added, point the writes to their infos.
+  for (size_t i = 0; i < m_writes.size(); ++i)
+  {
+    vk::WriteDescriptorSet& write = m_writes[i];
+    switch (write.descriptorType)
+    {
+      case vk::DescriptorType::eUniformTexelBuffer:
+      case vk::DescriptorType::eStorageTexelBuffer:
+        write.pTexelBufferView = m_buffer_views.data() + m_info_offsets[i];
+        break;
+      case vk::DescriptorType::eUniformBuffer:
+      case vk::DescriptorType::eStorageBuffer:
+      case vk::DescriptorType::eUniformBufferDynamic:
+      case vk::DescriptorType::eStorageBufferDynamic:
+        write.pBufferInfo = m_buffer_infos.data() + m_info_offsets[i];
+        break;
+      default:
+        write.pImageInfo = m_image_infos.data() + m_info_offsets[i];
+        break;
+    }
+  }
+
+  logical_device->update_descriptor_sets(m_writes);
+
+  m_writes.clear();
+  m_info_offsets.clear();
+  m_image_infos.clear();
+  m_buffer_infos.clear();
+  m_buffer_views.clear();
+}
+
+} // namespace vulkan::descriptor
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+#include <vector>
+#include "debug.h"
+
+namespace vulkan {
+class LogicalDevice;
+} // namespace vulkan
+
+namespace vulkan::descriptor {
+
+// Collects descriptor writes and performs them with a single call to vkUpdateDescriptorSets.
+//
+// The image infos, buffer infos and buffer views of all writes are stored in one vector per kind;
+// the pointers in the vk::WriteDescriptorSet structs are only set by flush(), so that adding
+// more writes (and reallocating those vectors) doesn't invalidate anything.
+class DescriptorUpdateBatch
+{
+ private:
+  std::vector<vk::WriteDescriptorSet> m_writes;
+  std::vector<size_t> m_info_offsets;                   // The index into m_image_infos, m_buffer_infos or m_buffer_views of the first info of each write.
+  std::vector<vk::DescriptorImageInfo> m_image_infos;
+  std::vector<vk::DescriptorBufferInfo> m_buffer_infos;
+  std::vector<vk::BufferView> m_buffer_views;
+
+ public:
+  // Add a write of image_infos.size() descriptors (starting at array_element) of binding `binding` of vh_descriptor_set.
+  void add(vk::DescriptorSet vh_descriptor_set, vk::DescriptorType descriptor_type, uint32_t binding, uint32_t array_element,
+      std::vector<vk::DescriptorImageInfo> const& image_infos);
+  // Idem, for buffers.
+  void add(vk::DescriptorSet vh_descriptor_set, vk::DescriptorType descriptor_type, uint32_t binding, uint32_t array_element,
+      std::vector<vk::DescriptorBufferInfo> const& buffer_infos);
+  // Idem, for texel buffers.
+  void add(vk::DescriptorSet vh_descriptor_set, vk::DescriptorType descriptor_type, uint32_t binding, uint32_t array_element,
+      std::vector<vk::BufferView> const& buffer_views);
+
+  bool empty() const { return m_writes.empty(); }
+  size_t size() const { return m_writes.size(); }
+
+  // Perform all writes that were added and clear the batch (keeping the allocated memory).
+  void flush(LogicalDevice const* logical_device);
+};
+
+} // namespace vulkan::descriptor
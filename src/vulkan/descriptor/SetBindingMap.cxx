@@ -1,11 +1,40 @@
 #include "sys.h"
-#ifdef CWDEBUG
 #include "SetBindingMap.h"
-#endif
+#include "vk_utils/fnv1a.h"
+#include <boost/container_hash/hash.hpp>
+#include <limits>
 #include "debug.h"
 
 namespace vulkan::descriptor {
 
+size_t SetBindingMap::hash() const
+{
+  size_t seed = m_set_map.size();
+  for (SetIndexHint set_index_hint = m_set_map.ibegin(); set_index_hint != m_set_map.iend(); ++set_index_hint)
+  {
+    SetData const& set_data = m_set_map[set_index_hint];
+    boost::hash_combine(seed, set_data.m_set_index.undefined() ? std::numeric_limits<size_t>::max() : set_data.m_set_index.get_value());
+    boost::hash_combine(seed, boost::hash_range(set_data.m_binding_map.begin(), set_data.m_binding_map.end()));
+  }
+  return seed;
+}
+
+uint64_t SetBindingMap::stable_hash() const
+{
+  uint64_t hash = vk_utils::fnv1a_offset_basis;
+  for (SetIndexHint set_index_hint = m_set_map.ibegin(); set_index_hint != m_set_map.iend(); ++set_index_hint)
+  {
+    SetData const& set_data = m_set_map[set_index_hint];
+    uint32_t const set_index = set_data.m_set_index.undefined() ? 0xffffffff : static_cast<uint32_t>(set_data.m_set_index.get_value());
+    // Also hash the number of bindings, so that the boundaries between the sets are part of the hash.
+    uint32_t const number_of_bindings = set_data.m_binding_map.size();
+    hash = vk_utils::fnv1a(&set_index, sizeof(set_index), hash);
+    hash = vk_utils::fnv1a(&number_of_bindings, sizeof(number_of_bindings), hash);
+    hash = vk_utils::fnv1a(set_data.m_binding_map.data(), number_of_bindings * sizeof(uint32_t), hash);
+  }
+  return hash;
+}
+
 #ifdef CWDEBUG
 void SetBindingMap::print_on(std::ostream& os) const
 {
@@ -57,6 +57,12 @@ class SetBindingMap
   // Accessor.
   bool empty() const { return m_set_map.empty(); }
 
+  // Return a hash of the full map.
+  size_t hash() const;
+
+  // Idem, but one that is the same for every build (used for the key of SPIRVDiskCache).
+  uint64_t stable_hash() const;
+
 #ifdef CWDEBUG
   void print_on(std::ostream& os) const;
 #endif
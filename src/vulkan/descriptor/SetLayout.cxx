@@ -7,7 +7,7 @@ namespace vulkan::descriptor {
 void SetLayout::realize_handle(LogicalDevice const* logical_device)
 {
   // Get cached or new vk::DescriptorSetLayout handle.
-  m_handle = logical_device->realize_descriptor_set_layout(m_sorted_bindings);
+  m_handle = logical_device->realize_descriptor_set_layout(m_sorted_bindings, m_hash);
 }
 
 } // namespace vulkan::descriptor
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "LayoutBindingCompare.h"
+#include "SortedBindingsHash.h"
 #include "shader_builder/ShaderResourceDeclarationContext.h"
 #include "utils/VectorCompare.h"
 #include "utils/sorted_vector_insert.h"
@@ -27,6 +28,7 @@ class SetLayout
   std::vector<vk::DescriptorSetLayoutBinding> m_sorted_bindings;        // The bindings "key" from which m_handle was created.
   SetIndexHint m_set_index_hint;                                        // The set index (hint) that this SetLayout refers to. It is not used for sorting (not part of the 'key').
   vk::DescriptorSetLayout m_handle;
+  size_t m_hash = 0;                                                    // The hash of m_sorted_bindings (see hash_sorted_bindings); it doesn't depend on the `binding` values.
 
  public:
   SetLayout(SetIndexHint set_index_hint) : m_set_index_hint(set_index_hint) { }
@@ -35,6 +37,7 @@ class SetLayout
   {
     DoutEntering(dc::vulkan, "SetLayout::insert_descriptor_set_layout_binding(" << descriptor_set_layout_binding << ")");
     utils::sorted_vector_insert(m_sorted_bindings, descriptor_set_layout_binding, LayoutBindingCompare{});
+    m_hash = hash_sorted_bindings(m_sorted_bindings);
   }
 
   // Look up m_sorted_bindings in cache, and create a new handle if it doesn't already exist.
@@ -47,6 +50,7 @@ class SetLayout
   SetIndexHint set_index_hint() const { return m_set_index_hint; }
   void set_set_index_hint(SetIndexHint set_index) { m_set_index_hint = set_index; }
   vk::DescriptorSetLayout handle() const { return m_handle; }
+  size_t hash() const { return m_hash; }
 
   // Called from LogicalDevice::realize_pipeline_layout.
   explicit operator vk::DescriptorSetLayout() const
@@ -86,6 +90,15 @@ struct SetLayoutCompare
   }
 };
 
+// Equality that matches SetLayoutCompare.
+struct SetLayoutEqual
+{
+  bool operator()(SetLayout const& lhs, SetLayout const& rhs) const
+  {
+    return lhs.hash() == rhs.hash() && SortedBindingsEqual::equal(lhs.sorted_bindings(), rhs.sorted_bindings());
+  }
+};
+
 struct CompareHint
 {
   SetIndexHint m_set_index_hint;
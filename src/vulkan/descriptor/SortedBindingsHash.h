@@ -0,0 +1,69 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+#include <boost/container_hash/hash.hpp>
+#include <algorithm>
+#include <span>
+#include <vector>
+#include "debug.h"
+
+namespace vulkan::descriptor {
+
+// Equality that matches LayoutBindingCompare: two bindings are equal when neither is less than the other.
+// In particular, the `binding` member is ignored.
+struct LayoutBindingEqual
+{
+  bool operator()(vk::DescriptorSetLayoutBinding const& lhs, vk::DescriptorSetLayoutBinding const& rhs) const
+  {
+    return lhs.pImmutableSamplers == rhs.pImmutableSamplers &&
+           lhs.descriptorType == rhs.descriptorType &&
+           lhs.stageFlags == rhs.stageFlags &&
+           lhs.descriptorCount == rhs.descriptorCount;
+  }
+};
+
+// Return a hash of a sorted vector of bindings that is consistent with LayoutBindingEqual.
+inline size_t hash_sorted_bindings(std::span<vk::DescriptorSetLayoutBinding const> sorted_bindings)
+{
+  size_t seed = sorted_bindings.size();
+  for (vk::DescriptorSetLayoutBinding const& binding : sorted_bindings)
+  {
+    boost::hash_combine(seed, static_cast<uint32_t>(binding.descriptorType));
+    boost::hash_combine(seed, static_cast<vk::ShaderStageFlags::MaskType>(binding.stageFlags));
+    boost::hash_combine(seed, binding.descriptorCount);
+    boost::hash_combine(seed, binding.pImmutableSamplers);
+  }
+  return seed;
+}
+
+// A key to look up a std::vector<vk::DescriptorSetLayoutBinding> without copying it, with a precomputed hash.
+struct SortedBindingsKey
+{
+  std::span<vk::DescriptorSetLayoutBinding const> m_sorted_bindings;
+  size_t m_hash;
+};
+
+// Hash and equality functors for LogicalDevice::descriptor_set_layouts_container_t; both support lookup with a SortedBindingsKey.
+struct SortedBindingsHash
+{
+  using is_transparent = void;
+
+  size_t operator()(std::vector<vk::DescriptorSetLayoutBinding> const& sorted_bindings) const { return hash_sorted_bindings(sorted_bindings); }
+  size_t operator()(SortedBindingsKey const& key) const { return key.m_hash; }
+};
+
+struct SortedBindingsEqual
+{
+  using is_transparent = void;
+
+  static bool equal(std::span<vk::DescriptorSetLayoutBinding const> lhs, std::span<vk::DescriptorSetLayoutBinding const> rhs)
+  {
+    return std::equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(), LayoutBindingEqual{});
+  }
+
+  bool operator()(std::vector<vk::DescriptorSetLayoutBinding> const& lhs, std::vector<vk::DescriptorSetLayoutBinding> const& rhs) const { return equal(lhs, rhs); }
+  bool operator()(SortedBindingsKey const& lhs, std::vector<vk::DescriptorSetLayoutBinding> const& rhs) const { return equal(lhs.m_sorted_bindings, rhs); }
+  bool operator()(std::vector<vk::DescriptorSetLayoutBinding> const& lhs, SortedBindingsKey const& rhs) const { return equal(lhs, rhs.m_sorted_bindings); }
+};
+
+} // namespace vulkan::descriptor
@@ -1,6 +1,8 @@
 #pragma once
 
+#include "utils/AIAlert.h"
 #include <cstdint>
+#include "debug.h"
 
 namespace vulkan {
 
@@ -20,6 +22,11 @@ namespace vulkan {
 //   df.get_chunks(ptr);
 // }
 //
+// Alternatively, if supports_fill_range() returns true, the caller may call fill_range
+// for disjoint ranges of chunks that together cover [0, chunk_count()), in any order and
+// concurrently from different threads (see task::CopyDataToGPU). In that case next_batch
+// and get_chunks are not called.
+//
 class DataFeeder
 {
  public:
@@ -38,6 +45,18 @@ class DataFeeder
 
   // Fills in N chunks, where N is the value that was returned by the last call to next_batch().
   virtual void get_chunks(unsigned char* chunk_ptr) = 0;
+
+  // Return true if fill_range is implemented.
+  virtual bool supports_fill_range() const { return false; }
+
+  // Fills in the chunks [begin, end), where chunk_ptr points to where chunk `begin` must be written.
+  // Must be thread-safe with respect to concurrent calls for disjoint ranges.
+  // May throw an AIAlert::Error, which aborts the upload (see task::FillRange).
+  virtual void fill_range(int /*begin*/, int /*end*/, unsigned char* /*chunk_ptr*/) const
+  {
+    // Only call fill_range when supports_fill_range() returns true.
+    THROW_ALERT("DataFeeder::fill_range called on a data feeder that doesn't support it");
+  }
 };
 
 } // namespace vulkan
@@ -0,0 +1,115 @@
+#include "sys.h"
+#include "StagingRing.h"
+#include "LogicalDevice.h"
+#include <algorithm>
+#include <numeric>
+#include "debug.h"
+
+namespace vulkan::memory {
+
+void StagingRing::create(LogicalDevice const* logical_device, vk::DeviceSize size COMMA_CWDEBUG_ONLY(Ambifix const& ambifix))
+{
+  DoutEntering(dc::vulkan, "StagingRing::create(" << logical_device << ", " << size << ")");
+
+  // Regions are flushed individually, and copied to images from (bufferOffset must be a multiple of four for
+  // depth/stencil formats; the texel block size of the image is passed to reserve).
+  m_alignment = std::max(vk::DeviceSize{16}, logical_device->non_coherent_atom_size());
+  m_buffer = StagingBuffer(logical_device, size COMMA_CWDEBUG_ONLY(ambifix));
+}
+
+bool RingReservations::reserve(vk::DeviceSize size, vk::DeviceSize ring_size, vk::DeviceSize& begin_out, uint64_t& sequence_number_out, vk::DeviceSize alignment)
+{
+  // Never reserve zero bytes, so that the head and tail can only be equal when the ring is full.
+  ASSERT(size > 0);
+  if (size > ring_size)
+    return false;
+
+  vk::DeviceSize begin = 0;
+  if (!m_deque.empty())
+  {
+    vk::DeviceSize const tail = m_deque.front().m_begin;
+    // The padding in front of an aligned range is recycled together with the range before it.
+    vk::DeviceSize const aligned_head = (m_head + alignment - 1) / alignment * alignment;
+    if (tail < m_head)
+    {
+      // The free space is [m_head, ring_size) followed by [0, tail).
+      if (aligned_head + size <= ring_size)
+        begin = aligned_head;
+      else if (size > tail)
+        return false;
+      // Otherwise wrap around; the space at the end of the buffer is skipped until the tail passes it.
+    }
+    else if (aligned_head + size <= tail)
+    {
+      // The free space is [m_head, tail).
+      begin = aligned_head;
+    }
+    else
+      return false;
+  }
+
+  begin_out = begin;
+  sequence_number_out = m_front_sequence_number + m_deque.size();
+  m_deque.push_back({ begin, begin + size, false });
+  m_head = begin + size;
+  return true;
+}
+
+void RingReservations::release(uint64_t sequence_number, vk::DeviceSize begin)
+{
+  // Releasing a range twice, or one that was never reserved?
+  ASSERT(sequence_number - m_front_sequence_number < m_deque.size());
+  Reservation& reservation = m_deque[sequence_number - m_front_sequence_number];
+  ASSERT(!reservation.m_released && reservation.m_begin == begin);
+  reservation.m_released = true;
+  // Recycle all released ranges at the tail.
+  while (!m_deque.empty() && m_deque.front().m_released)
+  {
+    m_deque.pop_front();
+    ++m_front_sequence_number;
+  }
+  if (m_deque.empty())
+    m_head = 0;
+}
+
+StagingRingRegion StagingRing::reserve(vk::DeviceSize size, vk::DeviceSize offset_alignment) const
+{
+  DoutEntering(dc::vulkan, "StagingRing::reserve(" << size << ", " << offset_alignment << ")");
+
+  StagingRingRegion region;
+  // Keep every region aligned (and never reserve zero bytes).
+  vk::DeviceSize const aligned_size = std::max(m_alignment, (size + m_alignment - 1) / m_alignment * m_alignment);
+  // The sizes of all regions are a multiple of m_alignment, so the offset of a region must only be padded if it has to be
+  // a multiple of something that m_alignment isn't (like the texel size 3 of a VK_FORMAT_R8G8B8_UNORM image).
+  vk::DeviceSize const alignment = std::lcm(m_alignment, offset_alignment);
+  vk::DeviceSize begin;
+  if (!reservations_t::wat(m_reservations)->reserve(aligned_size, m_buffer.m_size, begin, region.m_sequence_number, alignment))
+  {
+    Dout(dc::vulkan, "The staging ring is full.");
+    return region;
+  }
+
+  region.m_offset = begin;
+  region.m_pointer = static_cast<char*>(m_buffer.m_pointer) + begin;
+  Dout(dc::vulkan, "Returning " << region);
+  return region;
+}
+
+void StagingRing::release(StagingRingRegion const& region) const
+{
+  DoutEntering(dc::vulkan, "StagingRing::release(" << region << ")");
+  reservations_t::wat(m_reservations)->release(region.m_sequence_number, region.m_offset);
+}
+
+#ifdef CWDEBUG
+void StagingRingRegion::print_on(std::ostream& os) const
+{
+  os << '{';
+  os << "m_offset:" << m_offset <<
+      ", m_pointer:" << m_pointer <<
+      ", m_sequence_number:" << m_sequence_number;
+  os << '}';
+}
+#endif
+
+} // namespace vulkan::memory
@@ -0,0 +1,103 @@
+#pragma once
+
+#include "StagingBuffer.h"
+#include "threadsafe/aithreadsafe.h"
+#include <vulkan/vulkan.hpp>
+#include <deque>
+#include <mutex>
+#include "debug.h"
+
+namespace vulkan::memory {
+
+// A part of the StagingRing that was reserved for one upload.
+struct StagingRingRegion
+{
+  vk::DeviceSize m_offset{};                                    // The offset of this region in the buffer of the ring.
+  void* m_pointer{};                                            // Pointer to the mapped memory of this region, or nullptr if the reservation failed.
+  uint64_t m_sequence_number{};                                 // Passed back to StagingRing::release.
+
+  // Return true if this is an actual reservation.
+  explicit operator bool() const { return m_pointer; }
+
+#ifdef CWDEBUG
+  void print_on(std::ostream& os) const;
+#endif
+};
+
+// The bookkeeping of a StagingRing: ranges of offsets in a ring of a given size are reserved
+// at the head and recycled at the tail, once they and all ranges reserved before them were released.
+//
+// This class is not thread-safe (StagingRing wraps it in an aithreadsafe::Wrapper).
+class RingReservations
+{
+ private:
+  struct Reservation
+  {
+    vk::DeviceSize m_begin;
+    vk::DeviceSize m_end;
+    bool m_released;
+  };
+
+  std::deque<Reservation> m_deque;                              // All ranges that were reserved but not yet recycled, in the order of reservation.
+  uint64_t m_front_sequence_number = 0;                         // The sequence number of m_deque.front().
+  vk::DeviceSize m_head = 0;                                    // Where the next reservation starts (unless it doesn't fit there and wraps around).
+
+ public:
+  // Reserve size bytes of a ring of ring_size bytes, starting at a multiple of alignment. Returns false if there is not enough contiguous free space.
+  // Otherwise begin_out is set to the offset of the reserved range and sequence_number_out to the number that must be passed to release.
+  bool reserve(vk::DeviceSize size, vk::DeviceSize ring_size, vk::DeviceSize& begin_out, uint64_t& sequence_number_out, vk::DeviceSize alignment = 1);
+
+  // Release the range with sequence number sequence_number, that starts at begin.
+  void release(uint64_t sequence_number, vk::DeviceSize begin);
+
+  // Return true if no range is reserved (all ranges were recycled).
+  bool empty() const { return m_deque.empty(); }
+
+  // Return the offset where the oldest range that was not recycled yet starts (only valid if !empty()).
+  vk::DeviceSize tail() const { return m_deque.front().m_begin; }
+};
+
+// One large, persistently mapped, host-visible staging buffer that is shared by all uploads
+// (task::CopyDataToGPU) of a logical device.
+//
+// Regions are reserved at the head of the ring and recycled at its tail: a region is released
+// once the transfer that reads from it has finished, but the memory only becomes available again
+// when all regions that were reserved before it were released too. Since uploads finish in
+// (roughly) the order in which they were submitted this normally doesn't waste anything.
+//
+// A reservation fails (returns a region that converts to false) when the ring doesn't have
+// enough free space, in which case the caller should use a dedicated StagingBuffer instead.
+class StagingRing
+{
+ public:
+  // The size of the staging ring of a LogicalDevice.
+  static constexpr vk::DeviceSize s_default_size = 32 * 1024 * 1024;
+
+ private:
+  using reservations_t = aithreadsafe::Wrapper<RingReservations, aithreadsafe::policy::Primitive<std::mutex>>;
+
+  StagingBuffer m_buffer;                                       // The buffer of the ring.
+  vk::DeviceSize m_alignment{};                                 // The alignment of all regions.
+  mutable reservations_t m_reservations;
+
+ public:
+  StagingRing() = default;
+
+  // Allocate the buffer with size bytes.
+  void create(LogicalDevice const* logical_device, vk::DeviceSize size COMMA_CWDEBUG_ONLY(Ambifix const& ambifix));
+
+  // Reserve a region of size bytes (thread-safe).
+  // The offset of the region is a multiple of offset_alignment too (for example, the texel block size of an image that is copied from it).
+  StagingRingRegion reserve(vk::DeviceSize size, vk::DeviceSize offset_alignment = 1) const;
+
+  // Release a region that was returned by reserve (thread-safe).
+  // The caller must make sure that the GPU is done reading from it.
+  void release(StagingRingRegion const& region) const;
+
+  // Accessors.
+  vk::Buffer vh_buffer() const { return m_buffer.m_vh_buffer; }
+  VmaAllocation vh_allocation() const { return m_buffer.m_vh_allocation; }
+  vk::DeviceSize size() const { return m_buffer.m_size; }
+};
+
+} // namespace vulkan::memory
@@ -0,0 +1,71 @@
+#include "sys.h"
+#include "UniformRingBuffer.h"
+#include "LogicalDevice.h"
+#include "utils/AIAlert.h"
+#include "debug.h"
+
+namespace vulkan::memory {
+
+void UniformRingBuffer::create(LogicalDevice const* logical_device, FrameResourceIndex number_of_frame_resources, vk::DeviceSize region_size
+    COMMA_CWDEBUG_ONLY(Ambifix const& ambifix))
+{
+  DoutEntering(dc::vulkan, "UniformRingBuffer::create(" << logical_device << ", " << number_of_frame_resources << ", " << region_size << ")");
+
+  m_logical_device = logical_device;
+  m_number_of_frame_resources = number_of_frame_resources;
+  Debug(m_ambifix = ambifix);
+  m_alignment = logical_device->min_uniform_buffer_offset_alignment();
+  // Make the regions a multiple of the alignment, so that the offset of each region can be used as dynamic offset.
+  m_region_size = (region_size + m_alignment - 1) / m_alignment * m_alignment;
+  {
+    std::lock_guard<std::mutex> lock(m_blocks_mutex);
+    add_block();
+  }
+  // Every dynamic uniform buffer that a pipeline layout may contain gets the same dynamic offset.
+  // Dynamic storage buffers are not supported (see ShaderInputData::number_of_dynamic_offsets).
+  uint32_t const max_number_of_dynamic_offsets = logical_device->set_limits().maxDescriptorSetUniformBuffersDynamic;
+  m_dynamic_offsets.resize(number_of_frame_resources.get_value());
+  for (FrameResourceIndex i = m_dynamic_offsets.ibegin(); i != m_dynamic_offsets.iend(); ++i)
+    m_dynamic_offsets[i].assign(max_number_of_dynamic_offsets, i.get_value() * m_region_size);
+}
+
+void UniformRingBuffer::add_block() const
+{
+  DoutEntering(dc::vulkan, "UniformRingBuffer::add_block() [" << this << "]");
+  m_blocks.emplace_back(m_logical_device, m_number_of_frame_resources.get_value() * m_region_size
+      COMMA_CWDEBUG_ONLY(m_ambifix("[" + std::to_string(m_blocks.size()) + "]")));
+  m_allocated = 0;
+}
+
+UniformRingBuffer::Slot UniformRingBuffer::allocate(vk::DeviceSize size) const
+{
+  DoutEntering(dc::vulkan, "UniformRingBuffer::allocate(" << size << ")");
+  // Keep every slot aligned.
+  vk::DeviceSize const aligned_size = (size + m_alignment - 1) / m_alignment * m_alignment;
+  // A slot must fit in a region, because all blocks use the same dynamic offsets.
+  if (AI_UNLIKELY(aligned_size > m_region_size))
+    THROW_ALERT("Uniform buffer of [SIZE] bytes does not fit in a uniform ring buffer region of [REGION_SIZE] bytes.",
+        AIArgs("[SIZE]", size)("[REGION_SIZE]", m_region_size));
+  std::lock_guard<std::mutex> lock(m_blocks_mutex);
+  if (m_allocated + aligned_size > m_region_size)
+  {
+    Dout(dc::vulkan, "The regions of block " << (m_blocks.size() - 1) << " are full (" << m_allocated << " bytes in use); adding a block.");
+    add_block();
+  }
+  vk::DeviceSize const offset = m_allocated;
+  m_allocated += aligned_size;
+  UniformBuffer const& block = m_blocks.back();
+  Dout(dc::vulkan, "Returning offset " << offset << " in block " << (m_blocks.size() - 1));
+  return { block.m_vh_buffer, offset, static_cast<char*>(block.pointer()) + offset };
+}
+
+#ifdef CWDEBUG
+void UniformBufferSlice::print_on(std::ostream& os) const
+{
+  os << '{';
+  os << "m_pointer:" << m_pointer;
+  os << '}';
+}
+#endif
+
+} // namespace vulkan::memory
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "UniformBuffer.h"
+#include "FrameResourceIndex.h"
+#include "utils/Vector.h"
+#include <vulkan/vulkan.hpp>
+#include <deque>
+#include <mutex>
+#include <vector>
+#include "debug.h"
+
+namespace vulkan::memory {
+
+// The memory of one uniform buffer shader resource for one frame resource: a part of a UniformRingBuffer region.
+struct UniformBufferSlice
+{
+  void* m_pointer{};
+
+  // Accessor.
+  void* pointer() const
+  {
+    // Did you forget to call 'create' on your UniformBuffer?
+    ASSERT(m_pointer);
+    return m_pointer;
+  }
+
+#ifdef CWDEBUG
+  void print_on(std::ostream& os) const;
+#endif
+};
+
+// One large, persistently mapped, host-visible uniform buffer, divided into one region per frame resource.
+//
+// Each uniform buffer shader resource gets a slot of the same size at the same offset in every region.
+// The descriptor of a slot (eUniformBufferDynamic) points into the first region; the region of the
+// frame that is being rendered is selected with a dynamic offset when binding the descriptor sets,
+// which is the same for all dynamic uniform buffers (see dynamic_offsets).
+//
+// Slot offsets and the region size are multiples of minUniformBufferOffsetAlignment, as required
+// for both the offset in the descriptor and the dynamic offset.
+//
+// Slots are never freed. When the regions are full, another buffer with the same region size is
+// added (a block); because all blocks have the same region size, the dynamic offsets are the same
+// for every slot. Each slot therefore has its own vk::Buffer.
+class UniformRingBuffer
+{
+ public:
+  // A slot of the same size in every region of one block.
+  struct Slot
+  {
+    vk::Buffer m_vh_buffer;                                     // The buffer of the block that this slot is part of.
+    vk::DeviceSize m_offset;                                    // The offset of the slot relative to the start of each region.
+    char* m_pointer;                                            // The mapped memory of the slot in the first region.
+  };
+
+ private:
+  LogicalDevice const* m_logical_device{};
+  FrameResourceIndex m_number_of_frame_resources;
+  vk::DeviceSize m_alignment{};                                 // minUniformBufferOffsetAlignment.
+  vk::DeviceSize m_region_size{};                               // The size of one region.
+  mutable std::mutex m_blocks_mutex;                            // Protects m_blocks and m_allocated.
+  mutable std::deque<UniformBuffer> m_blocks;                   // The buffers with all regions. Never shrinks, so pointers to the mapped memory stay valid.
+  mutable vk::DeviceSize m_allocated{0};                        // The number of bytes allocated in each region of the last block.
+  utils::Vector<std::vector<uint32_t>, FrameResourceIndex> m_dynamic_offsets;  // The offset of each region, repeated.
+#ifdef CWDEBUG
+  Ambifix m_ambifix;
+#endif
+
+  // Add a block. Must be called with m_blocks_mutex locked.
+  void add_block() const;
+
+ public:
+  UniformRingBuffer() = default;
+
+  // Allocate the first buffer with number_of_frame_resources regions of (at least) region_size bytes.
+  void create(LogicalDevice const* logical_device, FrameResourceIndex number_of_frame_resources, vk::DeviceSize region_size
+      COMMA_CWDEBUG_ONLY(Ambifix const& ambifix));
+
+  // Allocate a slot of size bytes in every region (thread-safe).
+  // Throws if size is larger than the region size.
+  Slot allocate(vk::DeviceSize size) const;
+
+  // Return a pointer to the mapped memory of slot in the region of frame_resource_index.
+  void* pointer(FrameResourceIndex frame_resource_index, Slot const& slot) const
+  {
+    return slot.m_pointer + frame_resource_index.get_value() * m_region_size;
+  }
+
+  // Return number_of_dynamic_offsets dynamic offsets that select the region of frame_resource_index.
+  // The number of dynamic offsets of a pipeline was checked against the device limits by ShaderInputData::number_of_dynamic_offsets.
+  vk::ArrayProxy<uint32_t const> dynamic_offsets(FrameResourceIndex frame_resource_index, uint32_t number_of_dynamic_offsets) const
+  {
+    ASSERT(number_of_dynamic_offsets <= m_dynamic_offsets[frame_resource_index].size());
+    return { number_of_dynamic_offsets, m_dynamic_offsets[frame_resource_index].data() };
+  }
+
+  // Accessors.
+  vk::DeviceSize region_size() const { return m_region_size; }
+};
+
+} // namespace vulkan::memory
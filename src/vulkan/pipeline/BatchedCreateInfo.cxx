@@ -0,0 +1,59 @@
+#include "sys.h"
+#include "BatchedCreateInfo.h"
+#include "FlatCreateInfo.h"
+#include "debug.h"
+
+namespace vulkan::pipeline {
+
+void BatchedCreateInfo::assign(FlatCreateInfo const& flat_create_info, vk::PipelineLayout vh_pipeline_layout, vk::RenderPass vh_render_pass)
+{
+  // Merge the results of all characteristics.
+  m_pipeline_shader_stage_create_infos = flat_create_info.get_pipeline_shader_stage_create_infos();
+  m_vertex_input_binding_descriptions = flat_create_info.get_vertex_input_binding_descriptions();
+  m_vertex_input_attribute_descriptions = flat_create_info.get_vertex_input_attribute_descriptions();
+  m_pipeline_color_blend_attachment_states = flat_create_info.get_pipeline_color_blend_attachment_states();
+  m_dynamic_states = flat_create_info.get_dynamic_states();
+
+  m_input_assembly_state_create_info = flat_create_info.m_pipeline_input_assembly_state_create_info;
+  m_viewport_state_create_info = flat_create_info.m_viewport_state_create_info;
+  m_rasterization_state_create_info = flat_create_info.m_rasterization_state_create_info;
+  m_multisample_state_create_info = flat_create_info.m_multisample_state_create_info;
+  m_depth_stencil_state_create_info = flat_create_info.m_depth_stencil_state_create_info;
+  m_color_blend_state_create_info = flat_create_info.m_color_blend_state_create_info;
+
+  m_graphics_pipeline_create_info = vk::GraphicsPipelineCreateInfo{
+    .pTessellationState = nullptr,
+    .layout = vh_pipeline_layout,
+    .renderPass = vh_render_pass,
+    .subpass = 0,
+    .basePipelineHandle = vk::Pipeline{},
+    .basePipelineIndex = -1
+  };
+}
+
+vk::GraphicsPipelineCreateInfo const& BatchedCreateInfo::create_info()
+{
+  m_vertex_input_state_create_info.vertexBindingDescriptionCount = static_cast<uint32_t>(m_vertex_input_binding_descriptions.size());
+  m_vertex_input_state_create_info.pVertexBindingDescriptions = m_vertex_input_binding_descriptions.data();
+  m_vertex_input_state_create_info.vertexAttributeDescriptionCount = static_cast<uint32_t>(m_vertex_input_attribute_descriptions.size());
+  m_vertex_input_state_create_info.pVertexAttributeDescriptions = m_vertex_input_attribute_descriptions.data();
+  m_color_blend_state_create_info.attachmentCount = static_cast<uint32_t>(m_pipeline_color_blend_attachment_states.size());
+  m_color_blend_state_create_info.pAttachments = m_pipeline_color_blend_attachment_states.data();
+  m_dynamic_state_create_info.dynamicStateCount = static_cast<uint32_t>(m_dynamic_states.size());
+  m_dynamic_state_create_info.pDynamicStates = m_dynamic_states.data();
+
+  m_graphics_pipeline_create_info.stageCount = static_cast<uint32_t>(m_pipeline_shader_stage_create_infos.size());
+  m_graphics_pipeline_create_info.pStages = m_pipeline_shader_stage_create_infos.data();
+  m_graphics_pipeline_create_info.pVertexInputState = &m_vertex_input_state_create_info;
+  m_graphics_pipeline_create_info.pInputAssemblyState = &m_input_assembly_state_create_info;
+  m_graphics_pipeline_create_info.pViewportState = &m_viewport_state_create_info;
+  m_graphics_pipeline_create_info.pRasterizationState = &m_rasterization_state_create_info;
+  m_graphics_pipeline_create_info.pMultisampleState = &m_multisample_state_create_info;
+  m_graphics_pipeline_create_info.pDepthStencilState = &m_depth_stencil_state_create_info;
+  m_graphics_pipeline_create_info.pColorBlendState = &m_color_blend_state_create_info;
+  m_graphics_pipeline_create_info.pDynamicState = &m_dynamic_state_create_info;
+
+  return m_graphics_pipeline_create_info;
+}
+
+} // namespace vulkan::pipeline
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+#include <span>
+#include "debug.h"
+
+namespace vulkan::pipeline {
+
+class FlatCreateInfo;
+
+// A copy of the flattened create info of a single pipeline variant.
+//
+// The PipelineFactory keeps one of these per slot of a batch, so that the
+// create info of a variant remains valid until the whole batch is passed
+// to a single vkCreateGraphicsPipelines call (see PipelineFactory::set_batch_size).
+//
+// The merged lists are not copied: they are stored in the arena of the FlatCreateInfo,
+// which is only reset (see FlatCreateInfo::reset_arena) after the batch was created.
+class BatchedCreateInfo
+{
+ private:
+  // These point into the arena of the FlatCreateInfo that was passed to assign.
+  std::span<vk::PipelineShaderStageCreateInfo const> m_pipeline_shader_stage_create_infos;
+  std::span<vk::VertexInputBindingDescription const> m_vertex_input_binding_descriptions;
+  std::span<vk::VertexInputAttributeDescription const> m_vertex_input_attribute_descriptions;
+  std::span<vk::PipelineColorBlendAttachmentState const> m_pipeline_color_blend_attachment_states;
+  std::span<vk::DynamicState const> m_dynamic_states;
+
+  vk::PipelineVertexInputStateCreateInfo m_vertex_input_state_create_info;
+  vk::PipelineInputAssemblyStateCreateInfo m_input_assembly_state_create_info;
+  vk::PipelineViewportStateCreateInfo m_viewport_state_create_info;
+  vk::PipelineRasterizationStateCreateInfo m_rasterization_state_create_info;
+  vk::PipelineMultisampleStateCreateInfo m_multisample_state_create_info;
+  vk::PipelineDepthStencilStateCreateInfo m_depth_stencil_state_create_info;
+  vk::PipelineColorBlendStateCreateInfo m_color_blend_state_create_info;
+  vk::PipelineDynamicStateCreateInfo m_dynamic_state_create_info;
+
+  vk::GraphicsPipelineCreateInfo m_graphics_pipeline_create_info;
+
+ public:
+  // Copy the current state of flat_create_info. The data remains valid until flat_create_info.reset_arena() is called.
+  void assign(FlatCreateInfo const& flat_create_info, vk::PipelineLayout vh_pipeline_layout, vk::RenderPass vh_render_pass);
+
+  // Return the create info that refers to the data of this object.
+  // The returned reference (and the pointers in it) are invalidated when this object is moved or assigned to.
+  vk::GraphicsPipelineCreateInfo const& create_info();
+};
+
+} // namespace vulkan::pipeline
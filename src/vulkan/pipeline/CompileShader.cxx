@@ -0,0 +1,71 @@
+#include "sys.h"
+#include "CompileShader.h"
+#include "shader_builder/ShaderCompiler.h"
+#include "shader_builder/SPIRVDiskCache.h"
+#include <Tracy.hpp>
+#include "debug.h"
+
+namespace task {
+
+CompileShader::~CompileShader()
+{
+  DoutEntering(dc::statefultask(mSMDebug), "CompileShader::~CompileShader() [" << this << "]");
+}
+
+char const* CompileShader::state_str_impl(state_type run_state) const
+{
+  switch (run_state)
+  {
+    AI_CASE_RETURN(CompileShader_compile);
+    AI_CASE_RETURN(CompileShader_done);
+  }
+  AI_NEVER_REACHED
+}
+
+char const* CompileShader::task_name_impl() const
+{
+  return "CompileShader";
+}
+
+void CompileShader::multiplex_impl(state_type run_state)
+{
+  switch (run_state)
+  {
+    case CompileShader_compile:
+    {
+      ZoneScopedN("CompileShader_compile");
+      vulkan::shader_builder::ShaderCompiler const& compiler = vulkan::shader_builder::ShaderCompiler::thread_local_instance();
+      try
+      {
+        if (m_shader_info.is_precompiled_template())
+        {
+          // The template doesn't depend on the SetBindingMap; it contains placeholders.
+          m_spirv_template.compile(m_glsl_source_code, compiler, m_shader_info, m_disk_cache, vulkan::descriptor::SetBindingMap{});
+          m_spirv_cache.patch_from_template(m_spirv_template, m_set_binding_map);
+        }
+        else
+          m_spirv_cache.compile(m_glsl_source_code, compiler, m_shader_info, m_disk_cache, m_set_binding_map);
+      }
+      catch (...)
+      {
+        // Pass the error on to the pipeline factory (see ShaderInputData::create_shader_modules).
+        m_error = std::current_exception();
+      }
+      // Free memory; the source code of a template is still needed to look it up (see ShaderInputData::create_shader_modules).
+      if (!m_shader_info.is_precompiled_template())
+      {
+        m_glsl_source_code.clear();
+        m_glsl_source_code.shrink_to_fit();
+      }
+      set_state(CompileShader_done);
+      [[fallthrough]];
+    }
+    case CompileShader_done:
+      // Decrement the counter before finish() signals the parent.
+      m_running_tasks->fetch_sub(1, std::memory_order_release);
+      finish();
+      break;
+  }
+}
+
+} // namespace task
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "descriptor/SetBindingMap.h"
+#include "shader_builder/SPIRVCache.h"
+#include "shader_builder/ShaderIndex.h"
+#include "statefultask/AIStatefulTask.h"
+#include <atomic>
+#include <exception>
+#include <string>
+#ifdef CWDEBUG
+#include "debug/DebugSetName.h"
+#endif
+#include "debug.h"
+
+namespace vulkan::shader_builder {
+class ShaderInfo;
+class SPIRVDiskCache;
+} // namespace vulkan::shader_builder
+
+namespace task {
+
+// Compile a single (preprocessed) shader into SPIR-V code.
+//
+// These tasks are created by ShaderInputData::build_shader_async, from the pipeline factory,
+// and run in the low priority queue of the thread pool, so that the shader stages of all
+// characteristics of a pipeline are compiled concurrently. The pipeline factory waits until
+// all of them finished before creating the shader modules and the graphics pipeline.
+//
+// Each thread of the thread pool uses its own shaderc_compiler_t (see ShaderCompiler::thread_local_instance).
+class CompileShader : public AIStatefulTask
+{
+ private:
+  // Constructor.
+  vulkan::shader_builder::ShaderIndex m_shader_index;           // The index of m_shader_info.
+  vulkan::shader_builder::ShaderInfo const& m_shader_info;      // The ShaderInfo, owned by Application, that glsl_source_code was generated from.
+  std::string m_glsl_source_code;                               // The result of ShaderInputData::preprocess2 (or preprocess2_template).
+  vulkan::descriptor::SetBindingMap m_set_binding_map;          // The set_binding_map that was passed to preprocess2.
+  vulkan::shader_builder::SPIRVDiskCache const* m_disk_cache;   // The on-disk SPIR-V cache to use, or nullptr.
+  std::atomic_int* m_running_tasks;                             // Counter that is decremented when this task finished.
+#ifdef CWDEBUG
+  vulkan::AmbifixOwner m_ambifix;                               // Debug name of the shader module.
+#endif
+
+  // State CompileShader_compile.
+  vulkan::shader_builder::SPIRVCache m_spirv_template;          // The compiled template, if m_shader_info is a precompiled template.
+  vulkan::shader_builder::SPIRVCache m_spirv_cache;             // The resulting SPIR-V code.
+  std::exception_ptr m_error;                                   // Set if compilation failed.
+
+ protected:
+  using direct_base_type = AIStatefulTask;
+
+  // The different states of the task.
+  enum CompileShader_state_type {
+    CompileShader_compile = direct_base_type::state_end,
+    CompileShader_done
+  };
+
+ public:
+  // One beyond the largest state of this task.
+  static constexpr state_type state_end = CompileShader_done + 1;
+
+ public:
+  // If shader_info is a precompiled template, then glsl_source_code must be generated with ShaderInputData::preprocess2_template.
+  CompileShader(vulkan::shader_builder::ShaderIndex shader_index, vulkan::shader_builder::ShaderInfo const& shader_info, std::string&& glsl_source_code,
+      vulkan::descriptor::SetBindingMap const& set_binding_map, vulkan::shader_builder::SPIRVDiskCache const* disk_cache, std::atomic_int* running_tasks
+      COMMA_CWDEBUG_ONLY(vulkan::AmbifixOwner const& ambifix, bool debug = false)) :
+    direct_base_type(CWDEBUG_ONLY(debug)), m_shader_index(shader_index), m_shader_info(shader_info), m_glsl_source_code(std::move(glsl_source_code)),
+    m_set_binding_map(set_binding_map), m_disk_cache(disk_cache), m_running_tasks(running_tasks) COMMA_CWDEBUG_ONLY(m_ambifix(ambifix))
+  {
+    DoutEntering(dc::statefultask(mSMDebug), "CompileShader::CompileShader(...) [" << this << "]");
+  }
+
+  // Accessors; only call these after the task finished.
+  vulkan::shader_builder::ShaderIndex shader_index() const { return m_shader_index; }
+  vulkan::shader_builder::ShaderInfo const& shader_info() const { return m_shader_info; }
+  vulkan::shader_builder::SPIRVCache& spirv_template() { return m_spirv_template; }
+  // Only kept for precompiled templates; the key of the compiled template (see ShaderInputData::m_spirv_templates).
+  std::string const& glsl_source_code() const { return m_glsl_source_code; }
+  vulkan::shader_builder::SPIRVCache const& spirv_cache() const { return m_spirv_cache; }
+#ifdef CWDEBUG
+  vulkan::AmbifixOwner const& ambifix() const { return m_ambifix; }
+#endif
+
+  // Rethrow the exception that was thrown by the compiler, if any.
+  void rethrow_if_failed() const
+  {
+    if (m_error)
+      std::rethrow_exception(m_error);
+  }
+
+ protected:
+  ~CompileShader() override;
+
+  // Implementation of virtual functions of AIStatefulTask.
+  char const* state_str_impl(state_type run_state) const override;
+  char const* task_name_impl() const override;
+  void multiplex_impl(state_type run_state) override;
+};
+
+} // namespace task
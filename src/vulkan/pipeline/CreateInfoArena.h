@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+#include <vector>
+#include <algorithm>
+#include "debug.h"
+
+namespace vulkan::pipeline {
+
+// A monotonic memory arena for the flattened create info of pipeline variants.
+//
+// Memory is handed out from a single block and is never freed individually;
+// reset() makes the whole block available again. If the block is too small,
+// extra memory is allocated from the heap until the next reset(), at which
+// point the block is replaced with one that is large enough to hold everything.
+// Hence, after the first few variants, the arena no longer allocates from the heap.
+// Note that this only covers the flattened create info: see PipelineFactory::m_pipeline_variants
+// for what is still allocated per variant.
+class CreateInfoArena
+{
+ private:
+  static constexpr size_t s_minimum_block_size = 4096;
+
+  std::unique_ptr<std::byte[]> m_block;                                 // The memory that we hand out.
+  size_t m_block_size = 0;                                              // The size of m_block in bytes.
+  size_t m_used = 0;                                                    // The number of bytes of m_block that are in use.
+  std::vector<std::unique_ptr<std::byte[]>> m_overflow_blocks;          // Memory that was allocated since the last reset() because m_block was full.
+  size_t m_overflow_size = 0;                                           // The total size of m_overflow_blocks in bytes.
+  int m_heap_allocations = 0;                                           // The number of times that memory was allocated from the heap.
+
+ public:
+  // Return memory for size bytes, aligned to alignment.
+  void* allocate(size_t size, size_t alignment)
+  {
+    // Memory returned by new[] is aligned to __STDCPP_DEFAULT_NEW_ALIGNMENT__.
+    ASSERT(alignment <= __STDCPP_DEFAULT_NEW_ALIGNMENT__ && (alignment & (alignment - 1)) == 0);
+    size_t const offset = (m_used + alignment - 1) & ~(alignment - 1);
+    if (offset + size <= m_block_size)
+    {
+      m_used = offset + size;
+      return m_block.get() + offset;
+    }
+    ++m_heap_allocations;
+    m_overflow_blocks.emplace_back(new std::byte[size]);
+    m_overflow_size += size;
+    return m_overflow_blocks.back().get();
+  }
+
+  // Return uninitialized memory for count objects of type T.
+  template<typename T>
+  requires std::is_trivially_copyable_v<T>
+  T* allocate_array(size_t count)
+  {
+    return static_cast<T*>(allocate(count * sizeof(T), alignof(T)));
+  }
+
+  // Invalidate all memory that was handed out.
+  void reset()
+  {
+    if (!m_overflow_blocks.empty())
+    {
+      // Grow, so that everything fits next time (with some slack for alignment padding).
+      m_block_size = std::max(s_minimum_block_size, 2 * (m_used + m_overflow_size));
+      ++m_heap_allocations;
+      m_block.reset(new std::byte[m_block_size]);
+      m_overflow_blocks.clear();
+      m_overflow_size = 0;
+    }
+    m_used = 0;
+  }
+
+  // Return the number of heap allocations that were done by this arena.
+  int heap_allocations() const { return m_heap_allocations; }
+};
+
+} // namespace vulkan::pipeline
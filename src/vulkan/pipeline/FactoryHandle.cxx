@@ -10,4 +10,10 @@ void FactoryHandle::generate(task::SynchronousWindow const* owning_window)
   owning_window->pipeline_factory(m_factory_index)->generate();
 }
 
+void FactoryHandle::set_batch_size(task::SynchronousWindow const* owning_window, size_t batch_size)
+{
+  DoutEntering(dc::vulkan, "pipeline::FactoryHandle::set_batch_size(" << owning_window << ", " << batch_size << ")");
+  owning_window->pipeline_factory(m_factory_index)->set_batch_size(batch_size);
+}
+
 } // namespace vulkan::pipeline
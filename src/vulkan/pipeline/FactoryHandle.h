@@ -29,6 +29,10 @@ class FactoryHandle
 
   void generate(task::SynchronousWindow const* owning_window);
 
+  // Set the maximum number of pipelines that the factory creates with a single vkCreateGraphicsPipelines call.
+  // Must be called before generate.
+  void set_batch_size(task::SynchronousWindow const* owning_window, size_t batch_size);
+
   friend bool operator==(FactoryHandle h1, FactoryHandle h2)
   {
     return h1.m_factory_index == h2.m_factory_index;
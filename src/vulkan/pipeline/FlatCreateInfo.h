@@ -2,9 +2,12 @@
 
 #include "descriptor/SetLayout.h"
 #include "descriptor/SetBindingMap.h"
+#include "CreateInfoArena.h"
 #include "utils/Vector.h"
 #include <vulkan/vulkan.hpp>
+#include <algorithm>
 #include <vector>
+#include <span>
 #include <functional>
 #include "debug.h"
 
@@ -26,10 +29,13 @@ class FlatCreateInfo
   std::vector<std::vector<vk::PushConstantRange> const*> m_push_constant_ranges_list;
   std::vector<std::function<void(descriptor::SetBindingMap const&)>> m_set_binding_map_callbacks;
 
+  // Memory used for the merged lists returned by the getters below; reset with reset_arena().
+  mutable CreateInfoArena m_arena;
+
+  // Return the concatenation of all vectors in input_list, stored in m_arena.
   template<typename T>
-  static std::vector<T> merge(std::vector<std::vector<T> const*> input_list)
+  std::span<T const> merge(std::vector<std::vector<T> const*> const& input_list) const
   {
-    std::vector<T> result;
     size_t s = 0;
     for (std::vector<T> const* v : input_list)
     {
@@ -37,10 +43,11 @@ class FlatCreateInfo
       ASSERT(v->size() != 0);
       s += v->size();
     }
-    result.reserve(s);
+    T* const result = m_arena.allocate_array<T>(s);
+    T* out = result;
     for (std::vector<T> const* v : input_list)
-      result.insert(result.end(), v->begin(), v->end());
-    return result;
+      out = std::copy(v->begin(), v->end(), out);
+    return { result, s };
   }
 
  public:
@@ -87,21 +94,24 @@ class FlatCreateInfo
     .maxDepthBounds        = {}                         // float
   };
 
-  // mutable because this object changes .attachmentCount and .pAttachments when unflattening.
-  mutable vk::PipelineColorBlendStateCreateInfo m_color_blend_state_create_info{
+  // The attachments are added with add(std::vector<vk::PipelineColorBlendAttachmentState> const*) and set when unflattening (see BatchedCreateInfo).
+  vk::PipelineColorBlendStateCreateInfo m_color_blend_state_create_info{
     .logicOpEnable = VK_FALSE,                          // vk::Bool32
     .logicOp = vk::LogicOp::eCopy,                      // vk::LogicOp
     .blendConstants = {}                                // vk::ArrayWrapper1D<float, 4>
   };
 
  public:
+  // The get_* functions below merge the vectors that were added by all characteristics.
+  // The returned spans point into an arena and remain valid until reset_arena() is called.
+
   int add(std::vector<vk::PipelineShaderStageCreateInfo> const* pipeline_shader_stage_create_infos)
   {
     m_pipeline_shader_stage_create_infos_list.push_back(pipeline_shader_stage_create_infos);
     return m_pipeline_shader_stage_create_infos_list.size() - 1;
   }
 
-  std::vector<vk::PipelineShaderStageCreateInfo> get_pipeline_shader_stage_create_infos() const
+  std::span<vk::PipelineShaderStageCreateInfo const> get_pipeline_shader_stage_create_infos() const
   {
     return merge(m_pipeline_shader_stage_create_infos_list);
   }
@@ -112,7 +122,7 @@ class FlatCreateInfo
     return m_vertex_input_binding_descriptions_list.size() - 1;
   }
 
-  std::vector<vk::VertexInputBindingDescription> get_vertex_input_binding_descriptions() const
+  std::span<vk::VertexInputBindingDescription const> get_vertex_input_binding_descriptions() const
   {
     return merge(m_vertex_input_binding_descriptions_list);
   }
@@ -123,7 +133,7 @@ class FlatCreateInfo
     return m_vertex_input_attribute_descriptions_list.size() - 1;
   }
 
-  std::vector<vk::VertexInputAttributeDescription> get_vertex_input_attribute_descriptions() const
+  std::span<vk::VertexInputAttributeDescription const> get_vertex_input_attribute_descriptions() const
   {
     return merge(m_vertex_input_attribute_descriptions_list);
   }
@@ -134,14 +144,12 @@ class FlatCreateInfo
     return m_pipeline_color_blend_attachment_states_list.size() - 1;
   }
 
-  std::vector<vk::PipelineColorBlendAttachmentState> get_pipeline_color_blend_attachment_states() const
+  std::span<vk::PipelineColorBlendAttachmentState const> get_pipeline_color_blend_attachment_states() const
   {
-    std::vector<vk::PipelineColorBlendAttachmentState> pipeline_color_blend_attachment_states = merge(m_pipeline_color_blend_attachment_states_list);
     // Use add(std::vector<vk::PipelineColorBlendAttachmentState> const& pipeline_color_blend_attachment_states)
     // instead of manipulating m_color_blend_state_create_info.attachmentCount and/or m_color_blend_state_create_info.pAttachments.
     ASSERT(m_color_blend_state_create_info.attachmentCount == 0 && m_color_blend_state_create_info.pAttachments == nullptr);
-    m_color_blend_state_create_info.setAttachments(pipeline_color_blend_attachment_states);
-    return pipeline_color_blend_attachment_states;
+    return merge(m_pipeline_color_blend_attachment_states_list);
   }
 
   int add(std::vector<vk::DynamicState> const* dynamic_states)
@@ -150,7 +158,7 @@ class FlatCreateInfo
     return m_dynamic_states_list.size() - 1;
   }
 
-  std::vector<vk::DynamicState> get_dynamic_states() const
+  std::span<vk::DynamicState const> get_dynamic_states() const
   {
     return merge(m_dynamic_states_list);
   }
@@ -182,15 +190,22 @@ class FlatCreateInfo
     return m_push_constant_ranges_list.size() - 1;
   }
 
-  std::vector<vk::PushConstantRange> get_sorted_push_constant_ranges() const
+  std::vector<vk::PushConstantRange> const& get_sorted_push_constant_ranges() const
   {
     // Merging push constant ranges doesn't seem to make sense; at least it is not supported right now.
     // Only add a std::vector<vk::PushConstantRange> once, from the initialize of a single PipelineCharacteristic.
     ASSERT(m_push_constant_ranges_list.size() <= 1);
     // This is only returning the vector that was added (if any), which was already sorted (see ShaderInputData::push_constant_ranges()).
-    return merge(m_push_constant_ranges_list);
+    static std::vector<vk::PushConstantRange> const no_push_constant_ranges;
+    return m_push_constant_ranges_list.empty() ? no_push_constant_ranges : *m_push_constant_ranges_list[0];
   }
 
+  // Invalidate all spans returned by the getters above, making their memory available again.
+  void reset_arena() { m_arena.reset(); }
+
+  // Return the number of heap allocations that were done for the spans returned by the getters above.
+  int arena_heap_allocations() const { return m_arena.heap_allocations(); }
+
   void add_set_binding_map_callback(std::function<void(descriptor::SetBindingMap const&)> callback)
   {
     m_set_binding_map_callbacks.emplace_back(std::move(callback));
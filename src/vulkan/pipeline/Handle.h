@@ -1,7 +1,9 @@
 #pragma once
 
 #include "utils/Vector.h"
+#include <vulkan/vulkan.hpp>
 #include <boost/intrusive_ptr.hpp>
+#include <boost/smart_ptr/intrusive_ref_counter.hpp>
 #include <iosfwd>
 #include "debug.h"
 
@@ -28,4 +30,23 @@ struct Handle
 #endif
 };
 
+// A reference counted vk::UniquePipeline.
+//
+// The pipeline factory creates a vk::Pipeline only once for pipeline variants (different Index)
+// whose flattened create info is identical; those Handle's then refer to the same SharedPipeline.
+// The vk::Pipeline is destroyed when the last reference is released.
+class SharedPipeline : public boost::intrusive_ref_counter<SharedPipeline, boost::thread_safe_counter>
+{
+ private:
+  vk::UniquePipeline m_pipeline;
+
+ public:
+  SharedPipeline(vk::UniquePipeline&& pipeline) : m_pipeline(std::move(pipeline)) { }
+
+  // Accessor.
+  vk::Pipeline vh_pipeline() const { return *m_pipeline; }
+};
+
+using SharedPipelinePtr = boost::intrusive_ptr<SharedPipeline>;
+
 } // namespace vulkan::pipeline
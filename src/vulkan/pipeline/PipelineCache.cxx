@@ -4,12 +4,18 @@
 #include "LogicalDevice.h"
 #include "Application.h"
 #include "SynchronousWindow.h"
-#include "utils/nearest_multiple_of_power_of_two.h"
 #include "utils/u8string_to_filename.h"
 #include "utils/AIAlert.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <system_error>
 #include "debug.h"
-#include <boost/serialization/binary_object.hpp>
-#include <fstream>
 
 #ifdef CWDEBUG
 #include <boost/uuid/uuid_io.hpp>
@@ -35,6 +41,53 @@ std::ostream& operator<<(std::ostream& os, vk::PipelineCacheHeaderVersionOne con
 
 namespace task {
 
+namespace {
+
+// The header of a pipeline cache file; it is followed by the data returned by vkGetPipelineCacheData.
+struct FileHeader
+{
+  static constexpr uint32_t s_magic = 0x4350564c;       // "LVPC" (little endian).
+  static constexpr uint32_t s_format_version = 1;
+
+  uint32_t m_magic;
+  uint32_t m_format_version;
+  uint32_t m_vendor_id;                                 // vk::PhysicalDeviceProperties::vendorID of the device that created the data.
+  uint32_t m_device_id;                                 // vk::PhysicalDeviceProperties::deviceID of the device that created the data.
+  uint8_t m_pipeline_cache_uuid[VK_UUID_SIZE];          // vk::PhysicalDeviceProperties::pipelineCacheUUID of the driver that created the data.
+  uint64_t m_data_size;                                 // The size of the data that follows the header, in bytes.
+  uint64_t m_checksum;                                  // FNV-1a checksum over the data.
+};
+
+// The file is read by casting the mapped memory, so there must not be any padding.
+static_assert(sizeof(FileHeader) == 16 + VK_UUID_SIZE + 16, "FileHeader has padding");
+
+// Fill in the fields of header that identify the device.
+void set_device_identity(FileHeader& header, vulkan::LogicalDevice const* logical_device)
+{
+  vk::PhysicalDeviceProperties const properties = logical_device->vh_physical_device().getProperties();
+  header.m_vendor_id = properties.vendorID;
+  header.m_device_id = properties.deviceID;
+  std::copy(properties.pipelineCacheUUID.begin(), properties.pipelineCacheUUID.end(), header.m_pipeline_cache_uuid);
+}
+
+// FNV-1a; used as checksum because, unlike boost::hash, it is guaranteed to be the same for every build.
+uint64_t fnv1a(void const* data, size_t size)
+{
+  uint64_t hash = 0xcbf29ce484222325;
+  unsigned char const* ptr = static_cast<unsigned char const*>(data);
+  for (size_t i = 0; i < size; ++i)
+  {
+    hash ^= ptr[i];
+    hash *= 0x100000001b3;
+  }
+  return hash;
+}
+
+} // namespace
+
+//static
+std::mutex PipelineCache::s_file_mutex;
+
 PipelineCache::PipelineCache(PipelineFactory* factory COMMA_CWDEBUG_ONLY(bool debug)) : direct_base_type(CWDEBUG_ONLY(debug)), m_owning_factory(factory)
 {
   Debug(m_create_ambifix = vulkan::Ambifix("PipelineCache", "[" + utils::ulong_to_base(reinterpret_cast<uint64_t>(this), "0123456789abcdef") + "]"));
@@ -70,6 +123,7 @@ char const* PipelineCache::state_str_impl(state_type run_state) const
     AI_CASE_RETURN(PipelineCache_initialize);
     AI_CASE_RETURN(PipelineCache_load_from_disk);
     AI_CASE_RETURN(PipelineCache_ready);
+    AI_CASE_RETURN(PipelineCache_checkpoint);
     AI_CASE_RETURN(PipelineCache_factory_finished);
     AI_CASE_RETURN(PipelineCache_factory_merge);
     AI_CASE_RETURN(PipelineCache_save_to_disk);
@@ -96,13 +150,7 @@ void PipelineCache::multiplex_impl(state_type run_state)
     {
       if (!std::filesystem::exists(get_filename()))
       {
-        vulkan::LogicalDevice const* logical_device(m_owning_factory->owning_window()->logical_device());
-        vk::PipelineCacheCreateInfo pipeline_cache_create_info = {
-          .flags = logical_device->supports_cache_control() ? vk::PipelineCacheCreateFlagBits::eExternallySynchronized : vk::PipelineCacheCreateFlagBits{0},
-          .initialDataSize = 0
-        };
-        m_pipeline_cache = logical_device->create_pipeline_cache(pipeline_cache_create_info
-            COMMA_CWDEBUG_ONLY(".m_pipeline_cache" + m_create_ambifix));
+        m_pipeline_cache = create_cache(0, nullptr COMMA_CWDEBUG_ONLY(".m_pipeline_cache" + m_create_ambifix));
         set_state(PipelineCache_ready);
         break;
       }
@@ -111,22 +159,13 @@ void PipelineCache::multiplex_impl(state_type run_state)
     }
     case PipelineCache_load_from_disk:
     {
-      std::ifstream file(get_filename());
-      ASSERT(file);
-      try
+      if (!load(get_filename()))
       {
-        boost::archive::binary_iarchive ia(file);
-        //Dout(dc::always|flush_cf, "CALLING ia & *this");
-        ia & *this;
-      }
-      catch (boost::archive::archive_exception const& error)
-      {
-        Dout(dc::warning, "Caught boost::archive::archive_exception \"" << error.what() << "\" while trying to load " << get_filename() << ". Removing.");
         std::error_code ec;
         int exists = std::filesystem::remove(get_filename(), ec);
         if (ec)
-          THROW_ALERTC(ec, "Failed to load (invalid?) pipeline cache file [FILENAME] ([ARERR]) and then failed to remove that file! Please remove it yourself",
-              AIArgs("[FILENAME]", get_filename())("[ARERR]", error.what()));
+          THROW_ALERTC(ec, "Failed to load (invalid?) pipeline cache file [FILENAME] and then failed to remove that file! Please remove it yourself",
+              AIArgs("[FILENAME]", get_filename()));
         // Paranoia check: we should never get in state PipelineCache_load_from_disk when it doesn't exist?!
         ASSERT(exists);
         yield();        // Must yield to avoid an assert because PipelineCache_initialize did fallthrough to this state.
@@ -140,9 +179,19 @@ void PipelineCache::multiplex_impl(state_type run_state)
       // Paranoia check: ready means we have a pipeline cache.
       ASSERT(m_pipeline_cache);
       m_owning_factory->signal(PipelineFactory::pipeline_cache_set_up);
-      set_state(PipelineCache_factory_finished);
-      wait(factory_finished);
+      set_state(PipelineCache_checkpoint);
+      wait(condition_flush_to_disk | factory_finished);
       break;
+    case PipelineCache_checkpoint:
+      if (m_checkpoint_requested.exchange(false, std::memory_order_acquire))
+        checkpoint();
+      if (!m_factory_finished.load(std::memory_order_acquire))
+      {
+        wait(condition_flush_to_disk | factory_finished);
+        break;
+      }
+      set_state(PipelineCache_factory_finished);
+      [[fallthrough]];
     case PipelineCache_factory_finished:
       if (!m_is_merger)
       {
@@ -175,11 +224,7 @@ void PipelineCache::multiplex_impl(state_type run_state)
     case PipelineCache_save_to_disk:
     {
       if (m_pipeline_cache)     // Should always be true - but see ASSERT in PipelineCache::save.
-      {
-        std::ofstream file(get_filename());
-        boost::archive::binary_oarchive oa(file);
-        oa & *this;
-      }
+        save(get_filename());
       else
         Dout(dc::warning, "Not saving pipeline cache because m_pipeline_cache is nul?!");
       set_state(PipelineCache_done);
@@ -198,52 +243,223 @@ void PipelineCache::clear_cache()
   m_pipeline_cache.reset();
 }
 
-void PipelineCache::load(boost::archive::binary_iarchive& archive, unsigned int const version)
+vk::UniquePipelineCache PipelineCache::create_cache(size_t data_size, void const* data COMMA_CWDEBUG_ONLY(vulkan::Ambifix const& ambifix)) const
 {
-  DoutEntering(dc::vulkan, "PipelineCache::load(archive, " << version << ") [" << this << "]");
-  size_t size;
-  archive & size;
-  void* tmp_storage = std::aligned_alloc(
-      alignof(vk::PipelineCacheHeaderVersionOne),
-      utils::nearest_multiple_of_power_of_two(size, alignof(vk::PipelineCacheHeaderVersionOne)));
-  archive & make_nvp("pipeline_cache", boost::serialization::make_binary_object(tmp_storage, size));
-  vk::PipelineCacheHeaderVersionOne const* header = static_cast<vk::PipelineCacheHeaderVersionOne const*>(tmp_storage);
-  Dout(dc::vulkan, "Read " << size << " bytes from pipeline cache, with header: " << *header);
   vulkan::LogicalDevice const* logical_device(m_owning_factory->owning_window()->logical_device());
   vk::PipelineCacheCreateInfo pipeline_cache_create_info = {
     .flags = logical_device->supports_cache_control() ? vk::PipelineCacheCreateFlagBits::eExternallySynchronized : vk::PipelineCacheCreateFlagBits{0},
-    .initialDataSize = size,
-    .pInitialData = tmp_storage
+    .initialDataSize = data_size,
+    .pInitialData = data
   };
-  m_pipeline_cache = logical_device->create_pipeline_cache(pipeline_cache_create_info
-      COMMA_CWDEBUG_ONLY(".m_pipeline_cache" + m_create_ambifix));
-  free(tmp_storage);
+  return logical_device->create_pipeline_cache(pipeline_cache_create_info COMMA_CWDEBUG_ONLY(ambifix));
+}
+
+bool PipelineCache::load(std::filesystem::path const& path)
+{
+  DoutEntering(dc::vulkan, "PipelineCache::load(" << path << ") [" << this << "]");
+  size_t data_size;
+  m_pipeline_cache = read_file(path, data_size COMMA_CWDEBUG_ONLY(".m_pipeline_cache" + m_create_ambifix));
+  if (!m_pipeline_cache)
+    return false;
+  m_saved_data_size = data_size;
+  return true;
+}
+
+vk::UniquePipelineCache PipelineCache::read_file(std::filesystem::path const& path, size_t& data_size COMMA_CWDEBUG_ONLY(vulkan::Ambifix const& ambifix)) const
+{
+  DoutEntering(dc::vulkan, "PipelineCache::read_file(" << path << ", ...) [" << this << "]");
+
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd == -1)
+  {
+    Dout(dc::warning, "Failed to open " << path << ": " << std::strerror(errno));
+    return {};
+  }
+  struct stat st;
+  if (::fstat(fd, &st) == -1 || static_cast<size_t>(st.st_size) < sizeof(FileHeader))
+  {
+    Dout(dc::warning, "Pipeline cache file " << path << " is truncated.");
+    ::close(fd);
+    return {};
+  }
+  size_t const file_size = st.st_size;
+
+  // Map the file into memory, so that the data can be passed to the driver without copying it first.
+  void* mapping = ::mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);          // The mapping remains valid after closing the file descriptor.
+  if (mapping == MAP_FAILED)
+  {
+    Dout(dc::warning, "Failed to mmap " << path << ": " << std::strerror(errno));
+    return {};
+  }
+  auto unmap = [file_size](void* ptr){ ::munmap(ptr, file_size); };
+  std::unique_ptr<void, decltype(unmap)> const mapping_guard(mapping, unmap);
+
+  FileHeader const* header = static_cast<FileHeader const*>(mapping);
+  void const* data = static_cast<char const*>(mapping) + sizeof(FileHeader);
+  data_size = file_size - sizeof(FileHeader);
+
+  // Reject stale or corrupt files before creating a pipeline cache.
+  vulkan::LogicalDevice const* logical_device(m_owning_factory->owning_window()->logical_device());
+  FileHeader expected_identity;
+  set_device_identity(expected_identity, logical_device);
+  if (header->m_magic != FileHeader::s_magic || header->m_format_version != FileHeader::s_format_version)
+  {
+    Dout(dc::warning, path << " is not a pipeline cache file (or has an unsupported format).");
+    return {};
+  }
+  if (header->m_vendor_id != expected_identity.m_vendor_id || header->m_device_id != expected_identity.m_device_id ||
+      std::memcmp(header->m_pipeline_cache_uuid, expected_identity.m_pipeline_cache_uuid, VK_UUID_SIZE) != 0)
+  {
+    Dout(dc::warning, "Pipeline cache file " << path << " was written for a different device or driver.");
+    return {};
+  }
+  if (header->m_data_size != data_size || header->m_checksum != fnv1a(data, data_size))
+  {
+    Dout(dc::warning, "Pipeline cache file " << path << " is corrupt.");
+    return {};
+  }
+
+#ifdef CWDEBUG
+  if (data_size >= sizeof(vk::PipelineCacheHeaderVersionOne))
+    Dout(dc::vulkan, "Read " << data_size << " bytes from pipeline cache, with header: " << *static_cast<vk::PipelineCacheHeaderVersionOne const*>(data));
+#endif
+  return create_cache(data_size, data COMMA_CWDEBUG_ONLY(ambifix));
+}
+
+void PipelineCache::save(std::filesystem::path const& path) const
+{
+  DoutEntering(dc::vulkan, "PipelineCache::save(" << path << ") [" << this << "]");
+  std::unique_ptr<char[]> buffer;
+  size_t file_size;
+  {
+    std::lock_guard<std::mutex> lock(m_pipeline_cache_mutex);
+    vk::PipelineCache vh_pipeline_cache = *m_pipeline_cache;
+    // Don't call save (state PipelineCache_save_to_disk) when we don't have a handle:
+    // that would truncate the cache file since we can't write to it and worse, make it unloadable.
+    // This assert is put before the throw because it is a program error and should be fixed before a Release.
+    ASSERT(vh_pipeline_cache);
+    // However - a release doesn't have asserts. In this case I want to do something better than just crash
+    // below; if this inadvertently would still happen.
+    if (!vh_pipeline_cache)
+      THROW_FALERT("The pipeline cache handle is nul.");
+    vulkan::LogicalDevice const* logical_device(m_owning_factory->owning_window()->logical_device());
+    file_size = get_file_data(vh_pipeline_cache, logical_device->get_pipeline_cache_size(vh_pipeline_cache), buffer);
+  }
+  // This is the merger: m_pipeline_cache contains the pipelines of all PipelineCache tasks (and of the file that they loaded).
+  std::lock_guard<std::mutex> file_lock(s_file_mutex);
+  write_file(path, buffer.get(), file_size);
 }
 
-void PipelineCache::save(boost::archive::binary_oarchive& archive, unsigned int const version) const
+void PipelineCache::pipelines_created(int number_of_pipelines)
 {
-  DoutEntering(dc::vulkan, "PipelineCache::save(archive, " << version << ") [" << this << "]");
+  m_pipelines_since_checkpoint += number_of_pipelines;
+  if (m_pipelines_since_checkpoint < s_checkpoint_interval)
+    return;
+  m_pipelines_since_checkpoint = 0;
+  m_checkpoint_requested.store(true, std::memory_order_release);
+  signal(condition_flush_to_disk);
+}
+
+void PipelineCache::checkpoint()
+{
+  DoutEntering(dc::vulkan, "PipelineCache::checkpoint() [" << this << "]");
+  vulkan::LogicalDevice const* logical_device(m_owning_factory->owning_window()->logical_device());
   size_t size;
-  vk::PipelineCache vh_pipeline_cache = *m_pipeline_cache;
-  // Don't call `oa & *this` (state PipelineCache_save_to_disk) when we don't have a handle:
-  // that would truncate the cache file since we can't write to it and worse, make it unloadable.
-  // This assert is put before the throw because it is a program error and should be fixed before a Release.
-  ASSERT(vh_pipeline_cache);
-  // However - a release doesn't have asserts. In this case I want to do something better than just crash
-  // below; if this inadvertently would still happen.
-  if (!vh_pipeline_cache)
-    THROW_FALERT("The pipeline cache handle is nul.");
+  {
+    std::lock_guard<std::mutex> lock(m_pipeline_cache_mutex);
+    // The cache might already have been detached for merging.
+    if (!m_pipeline_cache)
+      return;
+    size = logical_device->get_pipeline_cache_size(*m_pipeline_cache);
+  }
+  if (size <= m_saved_data_size)
+  {
+    Dout(dc::vulkan, "Not writing checkpoint: the pipeline cache didn't grow.");
+    return;
+  }
+
+  // Other PipelineCache tasks write their checkpoints to the same file. Merge our cache into what is on disk,
+  // instead of replacing it, so that a checkpoint never loses the pipelines of another factory.
+  std::lock_guard<std::mutex> file_lock(s_file_mutex);
+  std::filesystem::path const filename = get_filename();
+  size_t data_size;
+  vk::UniquePipelineCache merged_cache = read_file(filename, data_size COMMA_CWDEBUG_ONLY(".m_checkpoint_cache" + m_create_ambifix));
+  if (!merged_cache)
+    merged_cache = create_cache(0, nullptr COMMA_CWDEBUG_ONLY(".m_checkpoint_cache" + m_create_ambifix));
+  {
+    std::lock_guard<std::mutex> lock(m_pipeline_cache_mutex);
+    if (!m_pipeline_cache)
+      return;
+    logical_device->merge_pipeline_caches(*merged_cache, { *m_pipeline_cache });
+  }
+  std::unique_ptr<char[]> buffer;
+  size_t const file_size = get_file_data(*merged_cache, logical_device->get_pipeline_cache_size(*merged_cache), buffer);
+  // Write the file without holding m_pipeline_cache_mutex, so that the factory can continue creating pipelines.
+  try
+  {
+    write_file(filename, buffer.get(), file_size);
+    m_saved_data_size = size;
+  }
+  catch (AIAlert::Error const& error)
+  {
+    // Not fatal: the cache is written again later.
+    Dout(dc::warning, "Failed to write pipeline cache checkpoint: " << error);
+  }
+}
+
+size_t PipelineCache::get_file_data(vk::PipelineCache vh_pipeline_cache, size_t size, std::unique_ptr<char[]>& buffer) const
+{
   vulkan::LogicalDevice const* logical_device(m_owning_factory->owning_window()->logical_device());
-  size = logical_device->get_pipeline_cache_size(vh_pipeline_cache);
-  void* tmp_storage = std::aligned_alloc(
-      alignof(vk::PipelineCacheHeaderVersionOne),
-      utils::nearest_multiple_of_power_of_two(size, alignof(vk::PipelineCacheHeaderVersionOne)));
-  logical_device->get_pipeline_cache_data(vh_pipeline_cache, size, tmp_storage);
-  archive & size;
-  archive & make_nvp("pipeline_cache", boost::serialization::make_binary_object(tmp_storage, size));
-  vk::PipelineCacheHeaderVersionOne const* header = static_cast<vk::PipelineCacheHeaderVersionOne const*>(tmp_storage);
-  Dout(dc::vulkan, "Wrote " << size << " bytes to pipeline cache, with header: " << *header);
-  free(tmp_storage);
+  // Let the driver write its data directly behind our header, so that everything can be written with a single write.
+  buffer.reset(new char[sizeof(FileHeader) + size]);
+  FileHeader* header = reinterpret_cast<FileHeader*>(buffer.get());
+  char* data = buffer.get() + sizeof(FileHeader);
+  logical_device->get_pipeline_cache_data(vh_pipeline_cache, size, data);
+  header->m_magic = FileHeader::s_magic;
+  header->m_format_version = FileHeader::s_format_version;
+  set_device_identity(*header, logical_device);
+  header->m_data_size = size;
+  header->m_checksum = fnv1a(data, size);
+#ifdef CWDEBUG
+  if (size >= sizeof(vk::PipelineCacheHeaderVersionOne))
+    Dout(dc::vulkan, "Got " << size << " bytes from pipeline cache, with header: " << *reinterpret_cast<vk::PipelineCacheHeaderVersionOne const*>(data));
+#endif
+  return sizeof(FileHeader) + size;
+}
+
+void PipelineCache::write_file(std::filesystem::path const& path, char const* buffer, size_t file_size) const
+{
+  DoutEntering(dc::vulkan, "PipelineCache::write_file(" << path << ", buffer, " << file_size << ") [" << this << "]");
+  // Write to a temporary file first; then atomically rename it to its final name.
+  // Writes to the same path are serialized by s_file_mutex, but use a temporary file name that is unique per task anyway.
+  std::filesystem::path temporary_path = path;
+  temporary_path += "." + utils::ulong_to_base(reinterpret_cast<uint64_t>(this), "0123456789abcdef") + ".tmp";
+  int fd = ::open(temporary_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd == -1)
+    THROW_ALERTC(std::error_code(errno, std::generic_category()), "Failed to create [FILENAME]", AIArgs("[FILENAME]", temporary_path));
+  size_t written = 0;
+  while (written < file_size)
+  {
+    ssize_t const len = ::write(fd, buffer + written, file_size - written);
+    if (len == -1 && errno == EINTR)
+      continue;
+    if (len <= 0)
+      break;
+    written += len;
+  }
+  // Make sure the data is on disk before the rename replaces the previous file.
+  bool const success = written == file_size && ::fdatasync(fd) == 0;
+  std::error_code ec(success ? 0 : errno, std::generic_category());
+  ::close(fd);
+  if (success)
+    std::filesystem::rename(temporary_path, path, ec);
+  if (!success || ec)
+  {
+    std::error_code ignored;
+    std::filesystem::remove(temporary_path, ignored);
+    THROW_ALERTC(ec, "Failed to write pipeline cache file [FILENAME]", AIArgs("[FILENAME]", path));
+  }
 }
 
 } // namespace task
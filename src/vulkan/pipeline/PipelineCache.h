@@ -6,14 +6,12 @@
 #include "vk_utils/TaskToTaskDeque.h"
 #include "statefultask/AIStatefulTask.h"
 #include "threadsafe/aithreadsafe.h"
-#include "utils/nearest_multiple_of_power_of_two.h"
 #include "utils/ulong_to_base.h"
-#include <boost/serialization/serialization.hpp>
-#include <boost/archive/binary_iarchive.hpp>
-#include <boost/archive/binary_oarchive.hpp>
 #include <vulkan/vulkan.hpp>
 #include <filesystem>
-#include <cstdlib>
+#include <atomic>
+#include <memory>
+#include <mutex>
 #ifdef CWDEBUG
 #include "debug/DebugSetName.h"
 #endif
@@ -29,6 +27,9 @@ class PipelineCache : public vk_utils::TaskToTaskDeque<AIStatefulTask, vk::Uniqu
   static constexpr condition_type condition_flush_to_disk = 2;
   static constexpr condition_type factory_finished = 4;
 
+  // The number of new pipelines after which the pipeline cache is written to disk (see pipelines_created).
+  static constexpr int s_checkpoint_interval = 32;
+
  private:
   // Constructor.
   boost::intrusive_ptr<task::PipelineFactory> m_owning_factory; // We have one pipeline cache per factory - or each factory would still be
@@ -36,6 +37,18 @@ class PipelineCache : public vk_utils::TaskToTaskDeque<AIStatefulTask, vk::Uniqu
                                                                 // This is a intrusive_ptr because the PipelineFactory might finish before this task.
   // State PipelineCache_load_from_disk.
   vk::UniquePipelineCache m_pipeline_cache;
+  mutable std::mutex m_pipeline_cache_mutex;                    // Locked while m_pipeline_cache is used by the factory, a checkpoint or detach_pipeline_cache.
+  size_t m_saved_data_size = 0;                                 // The size of the data of m_pipeline_cache when it was last read from or written to disk.
+
+  // All PipelineCache tasks of windows with the same pipeline_cache_name use the same file.
+  // Locked while reading, merging and writing that file for a checkpoint, or writing it in save.
+  static std::mutex s_file_mutex;
+
+  // pipelines_created.
+  int m_pipelines_since_checkpoint = 0;                         // The number of pipelines created since the last checkpoint request.
+  std::atomic_bool m_checkpoint_requested = false;              // Set when condition_flush_to_disk is signaled.
+  // set_factory_finished.
+  std::atomic_bool m_factory_finished = false;                  // Set when factory_finished is signaled.
 
   bool m_is_merger = false;
 
@@ -49,6 +62,7 @@ class PipelineCache : public vk_utils::TaskToTaskDeque<AIStatefulTask, vk::Uniqu
     PipelineCache_initialize = direct_base_type::state_end,
     PipelineCache_load_from_disk,
     PipelineCache_ready,
+    PipelineCache_checkpoint,
     PipelineCache_factory_finished,
     PipelineCache_factory_merge,
     PipelineCache_save_to_disk,
@@ -61,10 +75,13 @@ class PipelineCache : public vk_utils::TaskToTaskDeque<AIStatefulTask, vk::Uniqu
 
   // Called by Application::pipeline_factory_done.
   void set_is_merger() { m_is_merger = true; }
+  void set_factory_finished()
+  {
+    m_factory_finished.store(true, std::memory_order_release);
+    signal(factory_finished);
+  }
 
  protected:
-  // boost::serialization::access has a destroy function that want to call operator delete on us. Of course, we will never call destroy.
-  friend class boost::serialization::access;
   ~PipelineCache() override;                    // Call finish(), not delete.
 
   // Implementation of virtual functions of AIStatefulTask.
@@ -88,16 +105,43 @@ class PipelineCache : public vk_utils::TaskToTaskDeque<AIStatefulTask, vk::Uniqu
 
   void clear_cache();
 
-  void load(boost::archive::binary_iarchive& archive, unsigned int const version);
-  void save(boost::archive::binary_oarchive& archive, unsigned int const version) const;
+  // Create m_pipeline_cache from the file at path. Returns false, without creating a pipeline cache,
+  // if the file is invalid or was written for a different device (or driver version).
+  bool load(std::filesystem::path const& path);
+  // Write the data of m_pipeline_cache to the file at path.
+  void save(std::filesystem::path const& path) const;
+
+  // Called by the PipelineFactory after it created number_of_pipelines pipelines using this cache.
+  // Signals condition_flush_to_disk once every s_checkpoint_interval pipelines.
+  void pipelines_created(int number_of_pipelines);
+
+  // The PipelineFactory must lock this while using vh_pipeline_cache(), because a checkpoint might read the cache concurrently.
+  std::mutex& pipeline_cache_mutex() const { return m_pipeline_cache_mutex; }
 
   // Accessor for the create pipeline cache.
   vk::PipelineCache vh_pipeline_cache() const { return *m_pipeline_cache; }
 
   // Rescue pipeline cache just before deleting this task. Called by Application::pipeline_factory_done.
-  vk::UniquePipelineCache detach_pipeline_cache() { return std::move(m_pipeline_cache); }
+  vk::UniquePipelineCache detach_pipeline_cache()
+  {
+    std::lock_guard<std::mutex> lock(m_pipeline_cache_mutex);
+    return std::move(m_pipeline_cache);
+  }
 
-  BOOST_SERIALIZATION_SPLIT_MEMBER()
+ private:
+  // Create a pipeline cache with the initial data [data, data + data_size).
+  vk::UniquePipelineCache create_cache(size_t data_size, void const* data COMMA_CWDEBUG_ONLY(vulkan::Ambifix const& ambifix)) const;
+  // Create a pipeline cache from the file at path. Returns a null handle if the file is invalid or was written for a different
+  // device (or driver version). Otherwise sets data_size to the size of the pipeline cache data in the file.
+  vk::UniquePipelineCache read_file(std::filesystem::path const& path, size_t& data_size COMMA_CWDEBUG_ONLY(vulkan::Ambifix const& ambifix)) const;
+  // Write the pipeline cache to disk if it grew since it was last loaded or saved, merged with what is already on disk
+  // (written by other PipelineCache tasks). Runs in the thread pool, from state PipelineCache_checkpoint.
+  void checkpoint();
+  // Fill buffer with the contents of a pipeline cache file for at most size bytes of the data of vh_pipeline_cache. Returns the size of the file.
+  // vh_pipeline_cache may not be used concurrently (for m_pipeline_cache, m_pipeline_cache_mutex must be locked).
+  size_t get_file_data(vk::PipelineCache vh_pipeline_cache, size_t size, std::unique_ptr<char[]>& buffer) const;
+  // Write file_size bytes from buffer to the file at path, atomically replacing the previous file.
+  void write_file(std::filesystem::path const& path, char const* buffer, size_t file_size) const;
 };
 
 } // namespace task
@@ -2,18 +2,21 @@
 #include "PipelineFactory.h"
 #include "PipelineCache.h"
 #include "Handle.h"
+#include "FlatCreateInfo.h"
 #include "SynchronousWindow.h"
 #include "SynchronousTask.h"
 #include "vk_utils/TaskToTaskDeque.h"
 #include "threadsafe/aithreadsafe.h"
 #include "utils/at_scope_end.h"
+#include <string_view>
+#include <type_traits>
 
 namespace task {
 
 namespace synchronous {
 
 // Task used to synchronously move newly created pipelines to the SynchronousWindow.
-class MoveNewPipelines final : public vk_utils::TaskToTaskDeque<SynchronousTask, std::pair<vulkan::Pipeline, vk::UniquePipeline>>
+class MoveNewPipelines final : public vk_utils::TaskToTaskDeque<SynchronousTask, std::pair<vulkan::Pipeline, vulkan::pipeline::SharedPipelinePtr>>
 {
  private:
   SynchronousWindow::PipelineFactoryIndex m_factory_index;      // Index of the owning factory. There is a one-on-one relationship between PipelineFactory's and MoveNewPipelines's.
@@ -99,12 +102,178 @@ void MoveNewPipelines::multiplex_impl(state_type run_state)
 void MoveNewPipelines::abort_impl()
 {
   DoutEntering(dc::notice, "MoveNewPipelines::abort_impl()");
-  flush_new_data([this](Datum&& datum){ Dout(dc::notice, "Still had {" << datum.first << ", " << *datum.second << "} in the deque."); });
+  flush_new_data([this](Datum&& datum){ Dout(dc::notice, "Still had {" << datum.first << ", " << datum.second->vh_pipeline() << "} in the deque."); });
   owning_window()->pipeline_factory_done({}, m_factory_index);
 }
 
 } // namespace synchronous
 
+namespace {
+
+// Serialize everything that vk::GraphicsPipelineCreateInfo (as generated by PipelineFactory) points to into a string of bytes.
+//
+// Two pipeline variants with the same key are identical, and can use the same vk::Pipeline.
+// Everything is keyed by content, not by address, because the addresses are reused by the next variant.
+// Shader modules are represented by the id of their SPIR-V code (see ShaderInputData::spirv_id), because
+// each variant creates its own modules.
+class PipelineVariantKey
+{
+ private:
+  std::string& m_bytes;
+
+ public:
+  // Reuse the capacity of bytes.
+  PipelineVariantKey(std::string& bytes) : m_bytes(bytes) { m_bytes.clear(); }
+
+  // T may not contain padding.
+  template<typename T>
+  requires std::is_trivially_copyable_v<T>
+  void add(T const& value)
+  {
+    m_bytes.append(reinterpret_cast<char const*>(&value), sizeof(T));
+  }
+
+  template<typename T>
+  void add(T const* array, size_t count)
+  {
+    add(count);
+    add(array != nullptr);
+    if (array)
+      m_bytes.append(reinterpret_cast<char const*>(array), count * sizeof(T));
+  }
+};
+
+// Tags of the first byte of a key.
+constexpr char content_key = 1;         // The key contains all of the create info.
+constexpr char unique_key = 0;          // The key contains the unique id of the variant.
+
+// Write the key of create_info to key_out.
+//
+// If create_info contains an extension structure (a non-null pNext) then its contents are unknown;
+// in that case a key is written that is unique for this variant (unique_id), so that the variant gets
+// its own vk::Pipeline.
+void pipeline_variant_key(std::string& key_out, vk::GraphicsPipelineCreateInfo const& create_info,
+    vulkan::pipeline::ShaderInputData const& shader_input_data, size_t unique_id)
+{
+  PipelineVariantKey key(key_out);
+
+  auto not_shareable = [&](){
+    PipelineVariantKey unique(key_out);
+    unique.add(unique_key);
+    unique.add(unique_id);
+  };
+
+  key.add(content_key);
+  if (create_info.pNext)
+    return not_shareable();
+  key.add(create_info.flags);
+
+  key.add(create_info.stageCount);
+  for (uint32_t i = 0; i < create_info.stageCount; ++i)
+  {
+    vk::PipelineShaderStageCreateInfo const& stage = create_info.pStages[i];
+    size_t const spirv_id = shader_input_data.spirv_id(stage.module);
+    if (stage.pNext || spirv_id == vulkan::pipeline::ShaderInputData::no_spirv_id)
+      return not_shareable();
+    key.add(stage.flags);
+    key.add(stage.stage);
+    key.add(spirv_id);
+    vk::SpecializationInfo const* specialization_info = stage.pSpecializationInfo;
+    key.add(specialization_info != nullptr);
+    if (specialization_info)
+    {
+      key.add(specialization_info->pMapEntries, specialization_info->mapEntryCount);
+      key.add(static_cast<char const*>(specialization_info->pData), specialization_info->dataSize);
+    }
+    std::string_view const name = stage.pName;
+    key.add(name.data(), name.size());
+  }
+
+  vk::PipelineVertexInputStateCreateInfo const& vertex_input = *create_info.pVertexInputState;
+  if (vertex_input.pNext)
+    return not_shareable();
+  key.add(vertex_input.pVertexBindingDescriptions, vertex_input.vertexBindingDescriptionCount);
+  key.add(vertex_input.pVertexAttributeDescriptions, vertex_input.vertexAttributeDescriptionCount);
+
+  vk::PipelineInputAssemblyStateCreateInfo const& input_assembly = *create_info.pInputAssemblyState;
+  if (input_assembly.pNext)
+    return not_shareable();
+  key.add(input_assembly.topology);
+  key.add(input_assembly.primitiveRestartEnable);
+
+  vk::PipelineTessellationStateCreateInfo const* tessellation = create_info.pTessellationState;
+  key.add(tessellation != nullptr);
+  if (tessellation)
+  {
+    if (tessellation->pNext)
+      return not_shareable();
+    key.add(tessellation->patchControlPoints);
+  }
+
+  vk::PipelineViewportStateCreateInfo const& viewport = *create_info.pViewportState;
+  if (viewport.pNext)
+    return not_shareable();
+  key.add(viewport.pViewports, viewport.viewportCount);
+  key.add(viewport.pScissors, viewport.scissorCount);
+
+  vk::PipelineRasterizationStateCreateInfo const& rasterization = *create_info.pRasterizationState;
+  if (rasterization.pNext)
+    return not_shareable();
+  key.add(rasterization.depthClampEnable);
+  key.add(rasterization.rasterizerDiscardEnable);
+  key.add(rasterization.polygonMode);
+  key.add(rasterization.cullMode);
+  key.add(rasterization.frontFace);
+  key.add(rasterization.depthBiasEnable);
+  key.add(rasterization.depthBiasConstantFactor);
+  key.add(rasterization.depthBiasClamp);
+  key.add(rasterization.depthBiasSlopeFactor);
+  key.add(rasterization.lineWidth);
+
+  vk::PipelineMultisampleStateCreateInfo const& multisample = *create_info.pMultisampleState;
+  if (multisample.pNext)
+    return not_shareable();
+  key.add(multisample.rasterizationSamples);
+  key.add(multisample.sampleShadingEnable);
+  key.add(multisample.minSampleShading);
+  // pSampleMask is an array of ceil(rasterizationSamples / 32) masks.
+  key.add(multisample.pSampleMask, (static_cast<size_t>(multisample.rasterizationSamples) + 31) / 32);
+  key.add(multisample.alphaToCoverageEnable);
+  key.add(multisample.alphaToOneEnable);
+
+  vk::PipelineDepthStencilStateCreateInfo const& depth_stencil = *create_info.pDepthStencilState;
+  if (depth_stencil.pNext)
+    return not_shareable();
+  key.add(depth_stencil.depthTestEnable);
+  key.add(depth_stencil.depthWriteEnable);
+  key.add(depth_stencil.depthCompareOp);
+  key.add(depth_stencil.depthBoundsTestEnable);
+  key.add(depth_stencil.stencilTestEnable);
+  key.add(depth_stencil.front);
+  key.add(depth_stencil.back);
+  key.add(depth_stencil.minDepthBounds);
+  key.add(depth_stencil.maxDepthBounds);
+
+  vk::PipelineColorBlendStateCreateInfo const& color_blend = *create_info.pColorBlendState;
+  if (color_blend.pNext)
+    return not_shareable();
+  key.add(color_blend.logicOpEnable);
+  key.add(color_blend.logicOp);
+  key.add(color_blend.pAttachments, color_blend.attachmentCount);
+  key.add(color_blend.blendConstants);
+
+  vk::PipelineDynamicStateCreateInfo const& dynamic_state = *create_info.pDynamicState;
+  if (dynamic_state.pNext)
+    return not_shareable();
+  key.add(dynamic_state.pDynamicStates, dynamic_state.dynamicStateCount);
+
+  key.add(create_info.layout);
+  key.add(create_info.renderPass);
+  key.add(create_info.subpass);
+}
+
+} // namespace
+
 PipelineFactory::PipelineFactory(SynchronousWindow* owning_window, vulkan::Pipeline& pipeline_out, vk::RenderPass vh_render_pass
     COMMA_CWDEBUG_ONLY(bool debug)) : AIStatefulTask(CWDEBUG_ONLY(debug)),
     m_owning_window(owning_window), m_pipeline_out(pipeline_out), m_vh_render_pass(vh_render_pass), m_index(vulkan::Application::instance().m_dependent_tasks.add(this))
@@ -125,6 +294,74 @@ void PipelineFactory::add(boost::intrusive_ptr<vulkan::pipeline::CharacteristicR
   m_characteristics.push_back(std::move(characteristic_range));
 }
 
+void PipelineFactory::set_batch_size(size_t batch_size)
+{
+  DoutEntering(dc::vulkan, "PipelineFactory::set_batch_size(" << batch_size << ") [" << this << "]");
+  // A batch must contain at least one pipeline.
+  ASSERT(batch_size > 0);
+  m_batch_size = batch_size;
+}
+
+void PipelineFactory::create_pipeline_batch()
+{
+  DoutEntering(dc::vulkan, "PipelineFactory::create_pipeline_batch() [" << this << "]");
+
+  if (m_pending_pipelines.empty())
+  {
+    m_flat_create_info.reset_arena();
+    return;
+  }
+
+  std::vector<vk::UniquePipeline> pipelines;
+  if (m_batched_create_infos_size > 0)
+  {
+    std::vector<vk::GraphicsPipelineCreateInfo>& create_infos = m_graphics_pipeline_create_infos;
+    create_infos.clear();
+    for (size_t slot = 0; slot < m_batched_create_infos_size; ++slot)
+      create_infos.push_back(m_batched_create_infos[slot].create_info());
+
+#if 0
+    // FIXME: We stop here because continueing causes "Lost Device".
+    static std::atomic_int cnt{0};
+    int prev_cnt = cnt.fetch_add(1);
+    ASSERT(prev_cnt < 2);
+    if (prev_cnt == 0)
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+      DoutFatal(dc::core, "Reached create_graphics_pipeline - after sleep!");
+    }
+    DoutFatal(dc::core, "Reached create_graphics_pipeline!");
+#endif
+
+    // Create all graphics pipelines of this batch with a single call.
+    {
+      // The pipeline cache task might be reading the cache concurrently, to write a checkpoint.
+      std::lock_guard<std::mutex> lock(m_pipeline_cache_task->pipeline_cache_mutex());
+      pipelines = m_owning_window->logical_device()->create_graphics_pipelines(m_pipeline_cache_task->vh_pipeline_cache(), create_infos
+          COMMA_CWDEBUG_ONLY(m_owning_window->debug_name_prefix("pipeline")));
+    }
+    m_pipeline_cache_task->pipelines_created(pipelines.size());
+  }
+
+  // Pass the pipelines one by one to MoveNewPipelines, in the order in which they were added.
+  // A pending pipeline that isn't created can only refer to one that was added before it.
+  auto next_pipeline = pipelines.begin();
+  for (PendingPipeline& pending_pipeline : m_pending_pipelines)
+  {
+    if (pending_pipeline.m_create)
+      *pending_pipeline.m_shared_pipeline = new vulkan::pipeline::SharedPipeline(std::move(*next_pipeline++));
+    // Inform the SynchronousWindow.
+    m_move_new_pipelines_synchronously->have_new_datum({std::move(pending_pipeline.m_pipeline), *pending_pipeline.m_shared_pipeline});
+  }
+  // Each created pipeline must have been used.
+  ASSERT(next_pipeline == pipelines.end());
+
+  m_pending_pipelines.clear();
+  m_batched_create_infos_size = 0;
+  // The memory of all BatchedCreateInfo objects can now be reused.
+  m_flat_create_info.reset_arena();
+}
+
 char const* PipelineFactory::condition_str_impl(condition_type condition) const
 {
   switch (condition)
@@ -133,6 +370,7 @@ char const* PipelineFactory::condition_str_impl(condition_type condition) const
     AI_CASE_RETURN(fully_initialized);
     AI_CASE_RETURN(obtained_create_lock);
     AI_CASE_RETURN(obtained_set_layout_binding_lock);
+    AI_CASE_RETURN(shaders_compiled);
   }
   return direct_base_type::condition_str_impl(condition);
 }
@@ -149,6 +387,7 @@ char const* PipelineFactory::state_str_impl(state_type run_state) const
     AI_CASE_RETURN(PipelineFactory_create_shader_resources);
     AI_CASE_RETURN(PipelineFactory_initialize_shader_resources_per_set_index);
     AI_CASE_RETURN(PipelineFactory_update_missing_descriptor_sets);
+    AI_CASE_RETURN(PipelineFactory_compile_shaders);
     AI_CASE_RETURN(PipelineFactory_bottom_multiloop_while_loop);
     AI_CASE_RETURN(PipelineFactory_bottom_multiloop_for_loop);
     AI_CASE_RETURN(PipelineFactory_done);
@@ -218,6 +457,10 @@ void PipelineFactory::multiplex_impl(state_type run_state)
           m_characteristics[i]->initialize(m_flat_create_info, m_owning_window);
           m_characteristics[i]->update(max_pipeline_index, m_characteristics[i]->iend() - 1);
         }
+        // Allocate the slots of a batch (see set_batch_size).
+        m_batched_create_infos.resize(m_batch_size);
+        m_graphics_pipeline_create_infos.reserve(m_batch_size);
+        m_pending_pipelines.reserve(m_batch_size);
         // max_pipeline_index is now equal to the maximum value that a m_pipeline_index can be.
   //FIXME: is max_pipeline_index still needed?      m_graphics_pipelines.resize(max_pipeline_index.get_value() + 1);
 
@@ -279,7 +522,7 @@ void PipelineFactory::multiplex_impl(state_type run_state)
         // Begin pipeline layout creation
 
         {
-          std::vector<vk::PushConstantRange> const sorted_push_constant_ranges = m_flat_create_info.get_sorted_push_constant_ranges();
+          std::vector<vk::PushConstantRange> const& sorted_push_constant_ranges = m_flat_create_info.get_sorted_push_constant_ranges();
 
           // Realize (create or get from cache) the pipeline layout and return a suitable SetBindingMap.
           m_vh_pipeline_layout = m_owning_window->logical_device()->realize_pipeline_layout(
@@ -288,6 +531,9 @@ void PipelineFactory::multiplex_impl(state_type run_state)
 
         // Now that we have initialized m_set_binding_map, do the callbacks that need it.
         m_flat_create_info.do_set_binding_map_callbacks(m_set_binding_map);
+        // Start compiling the shaders that were added with build_shader_async (if any) in the thread pool;
+        // they are compiled while we deal with the shader resources and descriptor sets below.
+        m_shader_input_data.start_compile_shader_tasks(this, shaders_compiled);
 
         if (m_shader_input_data.sort_required_shader_resources_list())
         {
@@ -323,47 +569,24 @@ void PipelineFactory::multiplex_impl(state_type run_state)
         // End pipeline layout creation
         //-----------------------------------------------------------------
 
+        set_state(PipelineFactory_compile_shaders);
+        [[fallthrough]];
+      case PipelineFactory_compile_shaders:
+        // Wait until all shaders of this pipeline are compiled.
+        if (!m_shader_input_data.compile_shader_tasks_finished())
         {
-          // Merge the results of all characteristics into local vectors.
-          std::vector<vk::VertexInputBindingDescription>     const vertex_input_binding_descriptions      = m_flat_create_info.get_vertex_input_binding_descriptions();
-          std::vector<vk::VertexInputAttributeDescription>   const vertex_input_attribute_descriptions    = m_flat_create_info.get_vertex_input_attribute_descriptions();
-          std::vector<vk::PipelineShaderStageCreateInfo>     const pipeline_shader_stage_create_infos     = m_flat_create_info.get_pipeline_shader_stage_create_infos();
-          std::vector<vk::PipelineColorBlendAttachmentState> const pipeline_color_blend_attachment_states = m_flat_create_info.get_pipeline_color_blend_attachment_states();
-          std::vector<vk::DynamicState>                      const dynamic_state                          = m_flat_create_info.get_dynamic_states();
-
-          vk::PipelineVertexInputStateCreateInfo pipeline_vertex_input_state_create_info{
-            .vertexBindingDescriptionCount = static_cast<uint32_t>(vertex_input_binding_descriptions.size()),
-            .pVertexBindingDescriptions = vertex_input_binding_descriptions.data(),
-            .vertexAttributeDescriptionCount = static_cast<uint32_t>(vertex_input_attribute_descriptions.size()),
-            .pVertexAttributeDescriptions = vertex_input_attribute_descriptions.data()
-          };
-
-          vk::PipelineDynamicStateCreateInfo pipeline_dynamic_state_create_info{
-            .dynamicStateCount = static_cast<uint32_t>(dynamic_state.size()),
-            .pDynamicStates = dynamic_state.data()
-          };
-
-          vk::GraphicsPipelineCreateInfo pipeline_create_info{
-            .stageCount = static_cast<uint32_t>(pipeline_shader_stage_create_infos.size()),
-            .pStages = pipeline_shader_stage_create_infos.data(),
-            .pVertexInputState = &pipeline_vertex_input_state_create_info,
-            .pInputAssemblyState = &m_flat_create_info.m_pipeline_input_assembly_state_create_info,
-            .pTessellationState = nullptr,
-            .pViewportState = &m_flat_create_info.m_viewport_state_create_info,
-            .pRasterizationState = &m_flat_create_info.m_rasterization_state_create_info,
-            .pMultisampleState = &m_flat_create_info.m_multisample_state_create_info,
-            .pDepthStencilState = &m_flat_create_info.m_depth_stencil_state_create_info,
-            .pColorBlendState = &m_flat_create_info.m_color_blend_state_create_info,
-            .pDynamicState = &pipeline_dynamic_state_create_info,
-            .layout = m_vh_pipeline_layout,
-            .renderPass = m_vh_render_pass,
-            .subpass = 0,
-            .basePipelineHandle = vk::Pipeline{},
-            .basePipelineIndex = -1
-          };
+          wait(shaders_compiled);
+          return;
+        }
+        m_shader_input_data.create_shader_modules(m_owning_window);
+
+        {
+          // Copy the flattened create info of this variant into the next free slot of the current batch.
+          vulkan::pipeline::BatchedCreateInfo& batched_create_info = m_batched_create_infos[m_batched_create_infos_size];
+          batched_create_info.assign(m_flat_create_info, m_vh_pipeline_layout, m_vh_render_pass);
 
 #ifdef CWDEBUG
-          Dout(dc::vulkan|continued_cf, "PipelineFactory [" << this << "] creating graphics pipeline with range values: ");
+          Dout(dc::vulkan|continued_cf, "PipelineFactory [" << this << "] adding graphics pipeline with range values: ");
           char const* prefix = "";
           for (int i = 0; i < m_characteristics.size(); ++i)
           {
@@ -373,25 +596,38 @@ void PipelineFactory::multiplex_impl(state_type run_state)
           Dout(dc::finish, " --> pipeline::Index " << m_pipeline_index);
 #endif
 
-#if 0
-          // FIXME: We stop here because continueing causes "Lost Device".
-          static std::atomic_int cnt{0};
-          int prev_cnt = cnt.fetch_add(1);
-          ASSERT(prev_cnt < 2);
-          if (prev_cnt == 0)
+          // Identical pipeline variants share the same vk::Pipeline.
+          pipeline_variant_key(m_pipeline_variant_key, batched_create_info.create_info(), m_shader_input_data, m_pipeline_index.get_value());
+          auto [variant, inserted] = m_pipeline_variants.try_emplace(m_pipeline_variant_key);
+          vulkan::Pipeline pipeline{m_vh_pipeline_layout, {m_pipeline_factory_index, m_pipeline_index}, m_shader_input_data.vhv_descriptor_sets(),
+            m_shader_input_data.number_of_dynamic_offsets(m_owning_window->logical_device()->set_limits())};
+          if (!inserted)
           {
-            std::this_thread::sleep_for(std::chrono::milliseconds(100));
-            DoutFatal(dc::core, "Reached create_graphics_pipeline - after sleep!");
+            m_deduplicated_pipelines.fetch_add(1, std::memory_order_relaxed);
+            if (variant->second && m_pending_pipelines.empty())
+            {
+              Dout(dc::vulkan, "Reusing identical pipeline " << variant->second->vh_pipeline() << ".");
+              // Inform the SynchronousWindow.
+              m_move_new_pipelines_synchronously->have_new_datum({std::move(pipeline), variant->second});
+            }
+            else
+            {
+              // Keep the order in which pipelines are passed to the SynchronousWindow;
+              // also, the identical variant might be part of the current batch.
+              Dout(dc::vulkan, "Reusing identical pipeline after creating the current batch.");
+              m_pending_pipelines.push_back({std::move(pipeline), &variant->second, false});
+            }
+          }
+          else
+          {
+            // Claim the slot.
+            ++m_batched_create_infos_size;
+            // Pointers to elements of an unordered_map are not invalidated by rehashing.
+            m_pending_pipelines.push_back({std::move(pipeline), &variant->second, true});
           }
-          DoutFatal(dc::core, "Reached create_graphics_pipeline!");
-#endif
-
-          // Create and then store the graphics pipeline.
-          vk::UniquePipeline pipeline = m_owning_window->logical_device()->create_graphics_pipeline(m_pipeline_cache_task->vh_pipeline_cache(), pipeline_create_info
-              COMMA_CWDEBUG_ONLY(m_owning_window->debug_name_prefix("pipeline")));
 
-          // Inform the SynchronousWindow.
-          m_move_new_pipelines_synchronously->have_new_datum({vulkan::Pipeline{m_vh_pipeline_layout, {m_pipeline_factory_index, m_pipeline_index}, m_shader_input_data.vhv_descriptor_sets()}, std::move(pipeline)});
+          if (m_batched_create_infos_size == m_batched_create_infos.size())
+            create_pipeline_batch();
         }
 
         //
@@ -425,6 +661,13 @@ multiloop_magic_footer:
         set_state(PipelineFactory_done);
         [[fallthrough]];
       case PipelineFactory_done:
+        // Create the pipelines of the last (partial) batch.
+        create_pipeline_batch();
+        Dout(dc::vulkan, "Flattening the create info of all variants did " << m_flat_create_info.arena_heap_allocations() << " heap allocations.");
+        // Release our references; the pipelines are now owned by the SynchronousWindow.
+        m_pipeline_variants.clear();
+        // Without new variants there is no need to keep the SPIR-V code of the shader modules.
+        m_shader_input_data.release_spirv_code();
         m_move_new_pipelines_synchronously->set_producer_finished();
         finish();
         return;
@@ -1,6 +1,7 @@
 #ifndef PIPELINE_PIPELINE_FACTORY_H
 #define PIPELINE_PIPELINE_FACTORY_H
 
+#include "BatchedCreateInfo.h"
 #include "CharacteristicRange.h"
 #include "Pipeline.h"
 #include "statefultask/AIStatefulTask.h"
@@ -9,6 +10,9 @@
 #include "utils/Vector.h"
 #include "utils/Badge.h"
 #include <vulkan/vulkan.hpp>
+#include <atomic>
+#include <string>
+#include <unordered_map>
 
 namespace vulkan {
 class LogicalDevice;
@@ -36,6 +40,7 @@ class PipelineFactory : public AIStatefulTask
   static constexpr condition_type fully_initialized = 2;
   static constexpr condition_type obtained_create_lock = 4;
   static constexpr condition_type obtained_set_layout_binding_lock = 8;
+  static constexpr condition_type shaders_compiled = 16;
 
  private:
   // Constructor.
@@ -68,6 +73,35 @@ class PipelineFactory : public AIStatefulTask
   vk::PipelineLayout m_vh_pipeline_layout;
   // Set to true when calling ShaderInputData::update_missing_descriptor_sets while already having the set_layout_binding lock for the current pipeline/set_index/first_shader_resource.
   bool m_have_lock;
+  // The pipelines created so far, by their flattened create info (see pipeline_variant_key), so that identical variants can share one vk::Pipeline.
+  //
+  // Unlike the flattened create info (see CreateInfoArena), the result of the factory is still allocated from the heap:
+  // every unique variant adds a node (and a key, if it doesn't fit in the small string buffer) to this map and a SharedPipeline,
+  // every variant copies the descriptor sets of ShaderInputData into its Pipeline, and every batch returns a std::vector
+  // of created pipelines from LogicalDevice::create_graphics_pipelines. These are kept for the lifetime of the pipelines.
+  std::unordered_map<std::string, vulkan::pipeline::SharedPipelinePtr> m_pipeline_variants;
+  // Buffer for the key of the current variant.
+  std::string m_pipeline_variant_key;
+  // The number of pipeline variants that reused a vk::Pipeline from m_pipeline_variants.
+  std::atomic_int m_deduplicated_pipelines{0};
+
+  // A pipeline variant that was added to the current batch.
+  struct PendingPipeline
+  {
+    vulkan::Pipeline m_pipeline;                                        // The Pipeline to pass to the SynchronousWindow.
+    vulkan::pipeline::SharedPipelinePtr* m_shared_pipeline;             // Points into m_pipeline_variants.
+    bool m_create;                                                      // True if this variant uses the next slot of the batch; false if it is a duplicate.
+  };
+
+  // The maximum number of pipelines that are created with a single vkCreateGraphicsPipelines call (see set_batch_size).
+  size_t m_batch_size = 1;
+  // One slot per pipeline of a batch; only the first m_batched_create_infos_size slots are in use.
+  std::vector<vulkan::pipeline::BatchedCreateInfo> m_batched_create_infos;
+  size_t m_batched_create_infos_size = 0;
+  // The create infos of the slots in use, as passed to vkCreateGraphicsPipelines.
+  std::vector<vk::GraphicsPipelineCreateInfo> m_graphics_pipeline_create_infos;
+  // The variants of the current batch, in the order in which they were added.
+  std::vector<PendingPipeline> m_pending_pipelines;
 
  protected:
   using direct_base_type = AIStatefulTask;      // The immediate base class of this task.
@@ -82,6 +116,7 @@ class PipelineFactory : public AIStatefulTask
     PipelineFactory_create_shader_resources,
     PipelineFactory_initialize_shader_resources_per_set_index,
     PipelineFactory_update_missing_descriptor_sets,
+    PipelineFactory_compile_shaders,
     PipelineFactory_bottom_multiloop_while_loop,
     PipelineFactory_bottom_multiloop_for_loop,
     PipelineFactory_done
@@ -99,6 +134,10 @@ class PipelineFactory : public AIStatefulTask
   char const* task_name_impl() const override;
   void multiplex_impl(state_type run_state) override;
 
+ private:
+  // Create the pipelines of the current batch and pass all pending pipelines to MoveNewPipelines.
+  void create_pipeline_batch();
+
  public:
   PipelineFactory(SynchronousWindow* owning_window, vulkan::Pipeline& pipeline_out, vk::RenderPass vh_render_pass
       COMMA_CWDEBUG_ONLY(bool debug = false));
@@ -108,9 +147,14 @@ class PipelineFactory : public AIStatefulTask
 
   void add(boost::intrusive_ptr<vulkan::pipeline::CharacteristicRange> characteristic_range);
   void generate() { signal(fully_initialized); }
+  // Create up to batch_size pipelines per vkCreateGraphicsPipelines call. Must be called before generate().
+  // The default is one: every pipeline is created (and passed to the SynchronousWindow) as soon as possible.
+  void set_batch_size(size_t batch_size);
   void set_index(PipelineFactoryIndex pipeline_factory_index) { m_pipeline_factory_index = pipeline_factory_index; }
   void set_pipeline(vulkan::Pipeline&& pipeline) { m_pipeline_out = std::move(pipeline); }
   characteristics_container_t const& characteristics() const { return m_characteristics; }
+  // Return the number of pipeline variants that didn't need their own vk::Pipeline because an identical one already existed.
+  int deduplicated_pipelines() const { return m_deduplicated_pipelines.load(std::memory_order_relaxed); }
 
   void added_creation_request(vulkan::pipeline::ShaderInputData const* shader_input_data);
   // Give pipeline::CharacteristicRange read/write access to m_shader_input_data.
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "descriptor/SetLayout.h"
+#include <vulkan/vulkan.hpp>
+#include <boost/container_hash/hash.hpp>
+#include <algorithm>
+#include <span>
+#include <utility>
+#include <vector>
+#include "debug.h"
+
+namespace vulkan::pipeline {
+
+// The same type as LogicalDevice::pipeline_layouts_container_key_t.
+using PipelineLayoutKeyStorage = std::pair<std::vector<descriptor::SetLayout>, std::vector<vk::PushConstantRange>>;
+
+// A key to look up a pipeline layout without copying the descriptor set layouts and push constant ranges.
+struct PipelineLayoutKey
+{
+  std::span<descriptor::SetLayout const> m_sorted_descriptor_set_layouts;
+  std::span<vk::PushConstantRange const> m_sorted_push_constant_ranges;
+};
+
+// Hash and equality functors for LogicalDevice::pipeline_layouts_container_t; both support lookup with a PipelineLayoutKey.
+//
+// Descriptor set layouts are compared like SetLayoutCompare does (using the hash that is stored in each SetLayout).
+// Push constant ranges must be exactly equal.
+struct PipelineLayoutHash
+{
+  using is_transparent = void;
+
+  static size_t hash(PipelineLayoutKey const& key)
+  {
+    size_t seed = key.m_sorted_descriptor_set_layouts.size();
+    for (descriptor::SetLayout const& set_layout : key.m_sorted_descriptor_set_layouts)
+      boost::hash_combine(seed, set_layout.hash());
+    for (vk::PushConstantRange const& push_constant_range : key.m_sorted_push_constant_ranges)
+    {
+      boost::hash_combine(seed, static_cast<vk::ShaderStageFlags::MaskType>(push_constant_range.stageFlags));
+      boost::hash_combine(seed, push_constant_range.offset);
+      boost::hash_combine(seed, push_constant_range.size);
+    }
+    return seed;
+  }
+
+  size_t operator()(PipelineLayoutKeyStorage const& key) const { return hash({ key.first, key.second }); }
+  size_t operator()(PipelineLayoutKey const& key) const { return hash(key); }
+};
+
+struct PipelineLayoutEqual
+{
+  using is_transparent = void;
+
+  static bool equal(PipelineLayoutKey const& lhs, PipelineLayoutKey const& rhs)
+  {
+    return std::equal(lhs.m_sorted_descriptor_set_layouts.begin(), lhs.m_sorted_descriptor_set_layouts.end(),
+                      rhs.m_sorted_descriptor_set_layouts.begin(), rhs.m_sorted_descriptor_set_layouts.end(), descriptor::SetLayoutEqual{}) &&
+           std::equal(lhs.m_sorted_push_constant_ranges.begin(), lhs.m_sorted_push_constant_ranges.end(),
+                      rhs.m_sorted_push_constant_ranges.begin(), rhs.m_sorted_push_constant_ranges.end());
+  }
+
+  bool operator()(PipelineLayoutKeyStorage const& lhs, PipelineLayoutKeyStorage const& rhs) const { return equal({ lhs.first, lhs.second }, { rhs.first, rhs.second }); }
+  bool operator()(PipelineLayoutKey const& lhs, PipelineLayoutKeyStorage const& rhs) const { return equal(lhs, { rhs.first, rhs.second }); }
+  bool operator()(PipelineLayoutKeyStorage const& lhs, PipelineLayoutKey const& rhs) const { return equal({ lhs.first, lhs.second }, rhs); }
+};
+
+} // namespace vulkan::pipeline
@@ -1,9 +1,11 @@
 #include "sys.h"
 #include "ShaderInputData.h"
 #include "SynchronousWindow.h"
+#include "PipelineFactory.h"
 #include "shader_builder/shader_resource/UniformBuffer.h"
 #include "shader_builder/ShaderResourceDeclarationContext.h"
 #include "utils/malloc_size.h"
+#include "utils/AIAlert.h"
 #include "debug.h"
 #include <cstring>
 
@@ -40,9 +42,9 @@ void ShaderInputData::preprocess1(shader_builder::ShaderInfo const& shader_info)
   }
 }
 
-std::string_view ShaderInputData::preprocess2(shader_builder::ShaderInfo const& shader_info, std::string& glsl_source_code_buffer, descriptor::SetBindingMap const& set_binding_map) const
+std::string_view ShaderInputData::preprocess2_impl(shader_builder::ShaderInfo const& shader_info, std::string& glsl_source_code_buffer, descriptor::SetBindingMap const* set_binding_map) const
 {
-  DoutEntering(dc::vulkan, "ShaderInputData::preprocess2(" << shader_info << ", glsl_source_code_buffer) [" << this << "]");
+  DoutEntering(dc::vulkan, "ShaderInputData::preprocess2_impl(" << shader_info << ", glsl_source_code_buffer, " << set_binding_map << ") [" << this << "]");
 
   declaration_contexts_container_t const& declaration_contexts = m_per_stage_declaration_contexts.at(shader_info.stage()); // All the declaration contexts that are involved.
   std::string_view const source = shader_info.glsl_template_code();
@@ -57,7 +59,8 @@ std::string_view ShaderInputData::preprocess2(shader_builder::ShaderInfo const&
       dynamic_cast<shader_builder::ShaderResourceDeclarationContext*>(declaration_context);
     if (!shader_resource_declaration_context)   // We're only interested in shader resources here (that have a set index and a binding).
       continue;
-    shader_resource_declaration_context->set_set_binding_map(&set_binding_map);
+    // If set_binding_map is nullptr then the set index hints and hint bindings are used as placeholders.
+    shader_resource_declaration_context->set_set_binding_map(set_binding_map);
   }
 
   // Generate the declarations.
@@ -66,44 +69,25 @@ std::string_view ShaderInputData::preprocess2(shader_builder::ShaderInfo const&
     declarations += declaration_context->generate(shader_info.stage());
   declarations += '\n';
 
-  // Store each position where a match string occurs, together with an std::pair
-  // containing the found substring that has to be replaced (first) and the
-  // string that it has to be replaced with (second).
-  std::map<size_t, std::pair<std::string, std::string>> positions;
-
   // m_shader_variables contains a number of strings that we need to find in the source. They may occur zero or more times.
-  int id_to_name_growth = 0;
-  for (shader_builder::ShaderVariable const* shader_variable : m_shader_variables)
+  // Build a trie from all of them, the first time we get here (or when variables were added since).
+  if (m_substitution_trie_size != m_shader_variables.size())
   {
-    std::string match_string = shader_variable->glsl_id_full();
-    for (size_t pos = 0; (pos = source.find(match_string, pos)) != std::string_view::npos; pos += match_string.length())
-    {
-      id_to_name_growth += shader_variable->name().length() - match_string.length();
-      positions[pos] = std::make_pair(match_string, shader_variable->substitution());
-    }
+    for (shader_builder::ShaderVariable const* shader_variable : m_shader_variables)
+      m_substitution_trie.add(shader_variable->glsl_id_full(), shader_variable->substitution());
+    m_substitution_trie.build();
+    m_substitution_trie_size = m_shader_variables.size();
   }
 
-  static constexpr char const* version_header = "#version 450\n\n";
-  size_t final_source_code_size = std::strlen(version_header) + declarations.size() + source.length() + id_to_name_growth;
+  static constexpr std::string_view version_header = "#version 450\n\n";
+  size_t final_source_code_size = version_header.size() + declarations.size() + m_substitution_trie.max_output_size(source);
 
   glsl_source_code_buffer.reserve(utils::malloc_size(final_source_code_size + 1) - 1);
   glsl_source_code_buffer = version_header;
   glsl_source_code_buffer += declarations;
 
-  // Next copy alternating, the characters in between the strings and the replacements of the substrings.
-  size_t start = 0;
-  for (auto&& p : positions)
-  {
-    // Copy the characters leading up to the string at position p.
-    glsl_source_code_buffer += source.substr(start, p.first - start);
-    // Advance start to just after the found string.
-    start = p.first + p.second.first.length();
-    // Append the replacement string.
-    glsl_source_code_buffer += p.second.second;
-  }
-  // Copy the remaining characters.
-  glsl_source_code_buffer += source.substr(start);
-  glsl_source_code_buffer.shrink_to_fit();
+  // Copy the source, replacing each glsl_id_full with the substitution of its ShaderVariable, in a single pass.
+  m_substitution_trie.substitute(source, glsl_source_code_buffer);
   return glsl_source_code_buffer;
 }
 
@@ -448,7 +432,7 @@ void ShaderInputData::add_uniform_buffer(shader_builder::shader_resource::Unifor
   descriptor::SetIndexHint set_index_hint = m_shader_resource_set_key_to_set_index_hint.try_emplace_set_index_hint(uniform_buffer_descriptor_set_key);
   Dout(dc::vulkan, "Using SetIndexHint " << set_index_hint);
 
-  shader_builder::ShaderResourceDeclaration shader_resource_tmp(uniform_buffer.glsl_id(), vk::DescriptorType::eUniformBuffer, set_index_hint, uniform_buffer);
+  shader_builder::ShaderResourceDeclaration shader_resource_tmp(uniform_buffer.glsl_id(), vk::DescriptorType::eUniformBufferDynamic, set_index_hint, uniform_buffer);
 
   auto res1 = m_glsl_id_to_shader_resource.insert(std::pair{uniform_buffer.glsl_id(), shader_resource_tmp});
   // The m_glsl_id_prefix of each UniformBuffer must be unique. And of course, don't register the same uniform buffer twice.
@@ -616,6 +600,7 @@ bool ShaderInputData::update_missing_descriptor_sets(task::PipelineFactory* pipe
   using namespace vulkan::descriptor;
   using namespace vulkan::shader_builder::shader_resource;
 
+  LogicalDevice const* logical_device = owning_window->logical_device();
   utils::Vector<vk::DescriptorSetLayout, SetIndex> vhv_descriptor_set_layouts = get_vhv_descriptor_set_layouts(set_binding_map);
   // Isn't this ALWAYS the case? Note that it might take a complex application that is skipping
   // shader resources that are in a given descriptor set but aren't used in this pipeline; hence
@@ -658,12 +643,9 @@ bool ShaderInputData::update_missing_descriptor_sets(task::PipelineFactory* pipe
   Dout(dc::shaderresource, "Locking and searching for existing descriptor sets: loop over set_index [" << m_set_index << " - " << m_set_index_end << ">");
   for (SetIndex set_index = m_set_index; set_index < m_set_index_end; ++set_index)    // #0, #1, #2, #3
   {
-    // We want to know if there is a vk::DescriptorSetLayout that appears in every shader resource corresponding to this set_index.
-    std::map<vk::DescriptorSet, int> number_of_shader_resources_bound_to;
-    int number_of_shader_resources_in_this_set_index = 0;
+    // The contents of the descriptor set that is needed for this set_index: which shader resource is bound to which binding.
+    DescriptorSetKey descriptor_set_key;
     descriptor::SetLayoutBinding locked_set_layout_binding{VK_NULL_HANDLE, 0};
-    bool have_match = false;
-    vk::DescriptorSet existing_descriptor_set;
     // Shader resources: T1, T2, T3, T4, U1, U2, U3, U4 (each with a unique key)
     // PL0:              PL1:                    PL1 after conversion:
     // #0 : { U2, U1 }   #0 : { U4, U3 } -> #0   #0 : { U4, U3 }
@@ -760,50 +742,17 @@ bool ShaderInputData::update_missing_descriptor_sets(task::PipelineFactory* pipe
         locked_set_layout_binding = set_layout_binding;
       }
 
-      ++number_of_shader_resources_in_this_set_index;
-      bool still_have_match = false;
-      {
-        auto set_layout_bindings_to_handles_crat = shader_resource->set_layout_bindings_to_handles();
-        auto set_layout_binding_handles_pair_iter = set_layout_bindings_to_handles_crat->find(set_layout_binding);
-        if (set_layout_binding_handles_pair_iter == set_layout_bindings_to_handles_crat->end())
-        {
-          Dout(dc::shaderresource, "Setting have_match to false because " << set_layout_binding << " doesn't exist.");
-          have_match = false;
-          // Note: we need to keep the lock on set_layout_binding in this case (if we have it).
-          break;
-        }
-        else
-          Dout(dc::shaderresource, "Found SetMutexAndSetHandles for " << set_layout_binding);
-
-        // Run over all vk::DescriptorSet that this shader resource is already bound to.
-        auto const& descriptor_sets = set_layout_binding_handles_pair_iter->second.descriptor_sets(CWDEBUG_ONLY(pipeline_factory));
-        Dout(dc::shaderresource, "Running over " << descriptor_sets.size() << " descriptor sets.");
-        for (vk::DescriptorSet descriptor_set : descriptor_sets)
-        {
-          Dout(dc::shaderresource, "Incrementing count for descriptor set " << descriptor_set);
-          if (++number_of_shader_resources_bound_to[descriptor_set] == number_of_shader_resources_in_this_set_index)
-          {
-            Dout(dc::shaderresource, "descriptor_set = " << descriptor_set << " and binding = " << binding << " leads to still_have_match = true.");
-            have_match = still_have_match = true;
-            existing_descriptor_set = descriptor_set;
-            Dout(dc::shaderresource, "Set existing_descriptor_set to " << existing_descriptor_set);
-          }
-          else
-          {
-            Dout(dc::shaderresource, "number_of_shader_resources_in_this_set_index = " << number_of_shader_resources_in_this_set_index <<
-                " but number_of_shader_resources_bound_to[descriptor_set] now is only " << number_of_shader_resources_bound_to[descriptor_set]);
-          }
-        }
-      } // Destruct set_layout_bindings_to_handles_crat.
-
-      if (!still_have_match)
-      {
-        Dout(dc::shaderresource, "Setting have_match to false because still_have_match is false.");
-        have_match = false;
-        break;
-      }
+      descriptor_set_key.add(binding, set_key);
     } // Next shader resource for this set_index.
 
+    // While we hold the lock on the set layout binding of the first shader resource, no other
+    // pipeline factory can be creating a descriptor set with the same contents.
+    descriptor_set_key.m_layout = locked_set_layout_binding.descriptor_set_layout();
+    descriptor_set_key.sort();
+    vk::DescriptorSet existing_descriptor_set = logical_device->descriptor_set_cache().find(descriptor_set_key);
+    bool const have_match = static_cast<bool>(existing_descriptor_set);
+    Dout(dc::shaderresource, "Descriptor set cache " << (have_match ? "hit" : "miss") << " for set_index " << set_index << ".");
+
     if (have_match)
     {
       m_vhv_descriptor_sets[set_index] = existing_descriptor_set;
@@ -836,16 +785,28 @@ void ShaderInputData::allocate_update_add_handles_and_unlocking(task::PipelineFa
   std::vector<vk::DescriptorSet> missing_descriptor_sets;
   if (!missing_descriptor_set_layouts.empty())
     missing_descriptor_sets = logical_device->allocate_descriptor_sets(
-        missing_descriptor_set_layouts COMMA_CWDEBUG_ONLY(set_indexes), logical_device->get_descriptor_pool()
+        missing_descriptor_set_layouts COMMA_CWDEBUG_ONLY(set_indexes)
         COMMA_CWDEBUG_ONLY(Ambifix{".m_vhv_descriptor_set"}));  // Add prefix and postfix later, when copying this
                                                                 // vector to the Pipeline it will be used with.
 
   for (int i = 0; i < missing_descriptor_set_layouts.size(); ++i)
     m_vhv_descriptor_sets[set_indexes[i]] = missing_descriptor_sets[i];
 
+  // Write the descriptors of all new descriptor sets with a single call, before any of them is made available to other pipeline factories.
+  DescriptorUpdateBatch update_batch;
+  for (SetIndex set_index : set_indexes)
+    for (Base const* shader_resource : m_shader_resources_per_set_index[set_index])
+    {
+      uint32_t binding = get_declaration(shader_resource->descriptor_set_key())->binding();
+      shader_resource->update_descriptor_set(update_batch, m_vhv_descriptor_sets[set_index], binding);
+    }
+  update_batch.flush(logical_device);
+
   Dout(dc::shaderresource, "Updating, adding handles and unlocking: loop over set_index [" << set_index_begin << " - " << set_index_end << ">");
   for (SetIndex set_index = set_index_begin; set_index < set_index_end; ++set_index)
   {
+    // The contents of the new descriptor set, if any, for the descriptor set cache.
+    DescriptorSetKey descriptor_set_key;
     // Run over all shader resources in reverse, so that the first one which is the one that is locked, is processed last!
     Dout(dc::shaderresource, "Loop over all shader resources - in reverse - with index " << set_index);
     for (int i = m_shader_resources_per_set_index[set_index].size() - 1; i >= 0; --i)
@@ -863,14 +824,28 @@ void ShaderInputData::allocate_update_add_handles_and_unlocking(task::PipelineFa
       if (new_descriptor_set)
       {
         Dout(dc::shaderresource, "The set_index was found in set_indexes.");
-        // Bind it to a descriptor set.
-        shader_resource->update_descriptor_set(owning_window, m_vhv_descriptor_sets[set_index], binding);
+        // The shader resource was already bound to the new descriptor set above.
 
         // Find the corresponding SetLayout.
         auto sorted_descriptor_set_layout =
           std::find_if(m_sorted_descriptor_set_layouts.begin(), m_sorted_descriptor_set_layouts.end(), CompareHint{set_index_hint});
         vk::DescriptorSetLayout descriptor_set_layout = sorted_descriptor_set_layout->handle();
         Dout(dc::shaderresource, "descriptor_set_layout = " << descriptor_set_layout);
+        descriptor_set_key.add(binding, set_key);
+        // Remove the new descriptor set from the cache again when this shader resource is destroyed.
+        shader_resource->cached_in(&logical_device->descriptor_set_cache());
+        if (first_shader_resource)
+        {
+          // The new descriptor set was updated: make it available to other pipeline factories
+          // before unlocking (which wakes up those that are waiting to look for it).
+          descriptor_set_key.m_layout = descriptor_set_layout;
+          descriptor_set_key.sort();
+          uint32_t number_of_descriptors = 0;
+          if (auto const* pool_sizes = logical_device->descriptor_set_layout_pool_sizes(descriptor_set_layout))
+            for (vk::DescriptorPoolSize const& pool_size : *pool_sizes)
+              number_of_descriptors += pool_size.descriptorCount;
+          logical_device->descriptor_set_cache().insert(std::move(descriptor_set_key), m_vhv_descriptor_sets[set_index], number_of_descriptors);
+        }
         // Store the descriptor set handle corresponding to the used vk::DescriptorSetLayout (SetLayout) and binding number.
         // This unlocks the '{ descriptor_set_layout, binding }' key when the last argument is non-NULL.
         shader_resource->add_set_layout_binding({ descriptor_set_layout, binding }, m_vhv_descriptor_sets[set_index],
@@ -891,6 +866,68 @@ void ShaderInputData::allocate_update_add_handles_and_unlocking(task::PipelineFa
   }
 }
 
+uint32_t ShaderInputData::number_of_dynamic_offsets(descriptor::SetLimits const& set_limits) const
+{
+  uint32_t number_of_uniform_buffers_dynamic = 0;
+  uint32_t number_of_storage_buffers_dynamic = 0;
+  for (descriptor::SetLayout const& set_layout : m_sorted_descriptor_set_layouts)
+    for (vk::DescriptorSetLayoutBinding const& binding : set_layout.sorted_bindings())
+      if (binding.descriptorType == vk::DescriptorType::eUniformBufferDynamic)
+        number_of_uniform_buffers_dynamic += binding.descriptorCount;
+      else if (binding.descriptorType == vk::DescriptorType::eStorageBufferDynamic)
+        number_of_storage_buffers_dynamic += binding.descriptorCount;
+  // Every uniform buffer shader resource is a dynamic uniform buffer (see memory::UniformRingBuffer).
+  if (AI_UNLIKELY(number_of_uniform_buffers_dynamic > set_limits.maxDescriptorSetUniformBuffersDynamic))
+    THROW_ALERT("The pipeline layout uses [NUMBER] uniform buffers, but this device supports at most [MAX] (maxDescriptorSetUniformBuffersDynamic).",
+        AIArgs("[NUMBER]", number_of_uniform_buffers_dynamic)("[MAX]", set_limits.maxDescriptorSetUniformBuffersDynamic));
+  // All dynamic offsets are those of the frame resource in the uniform ring buffer, which only make sense for uniform buffers.
+  if (AI_UNLIKELY(number_of_storage_buffers_dynamic > 0))
+    THROW_ALERT("The pipeline layout uses [NUMBER] dynamic storage buffers, which are not supported.",
+        AIArgs("[NUMBER]", number_of_storage_buffers_dynamic));
+  return number_of_uniform_buffers_dynamic;
+}
+
+void ShaderInputData::add_shader_module(task::SynchronousWindow const* owning_window,
+    shader_builder::ShaderInfo const& shader_info, shader_builder::SPIRVCache const& spirv_cache
+    COMMA_CWDEBUG_ONLY(AmbifixOwner const& ambifix))
+{
+  m_shader_modules.push_back(spirv_cache.create_module({}, owning_window->logical_device() COMMA_CWDEBUG_ONLY(ambifix)));
+  m_shader_module_spirv_ids.push_back(m_spirv_ids.try_emplace(spirv_cache.spirv_code(), m_spirv_ids.size()).first->second);
+  m_shader_stage_create_infos.push_back(
+    {
+      .flags = vk::PipelineShaderStageCreateFlags(0),
+      .stage = shader_info.stage(),
+      .module = *m_shader_modules.back(),
+      .pName = "main"
+    }
+  );
+}
+
+size_t ShaderInputData::spirv_id(vk::ShaderModule vh_shader_module) const
+{
+  for (size_t i = 0; i < m_shader_modules.size(); ++i)
+    if (*m_shader_modules[i] == vh_shader_module)
+      return m_shader_module_spirv_ids[i];
+  return no_spirv_id;
+}
+
+shader_builder::SPIRVCache& ShaderInputData::spirv_template(shader_builder::ShaderIndex const& shader_index, std::string_view template_source)
+{
+  auto& templates = m_spirv_templates[shader_index];
+  auto spirv_template = templates.find(template_source);
+  if (spirv_template == templates.end())
+    spirv_template = templates.try_emplace(std::string{template_source}).first;
+  return spirv_template->second;
+}
+
+void ShaderInputData::release_spirv_code()
+{
+  DoutEntering(dc::vulkan, "ShaderInputData::release_spirv_code() [" << this << "]");
+  // No new shader modules will be added, so no new ids are needed: m_shader_module_spirv_ids is all that spirv_id uses.
+  m_spirv_ids.clear();
+  m_spirv_templates.clear();
+}
+
 void ShaderInputData::build_shader(task::SynchronousWindow const* owning_window,
     shader_builder::ShaderIndex const& shader_index, shader_builder::ShaderCompiler const& compiler, shader_builder::SPIRVCache& spirv_cache, descriptor::SetBindingMap const& set_binding_map
     COMMA_CWDEBUG_ONLY(AmbifixOwner const& ambifix))
@@ -900,20 +937,96 @@ void ShaderInputData::build_shader(task::SynchronousWindow const* owning_window,
   std::string glsl_source_code_buffer;
   std::string_view glsl_source_code;
   shader_builder::ShaderInfo const& shader_info = owning_window->application().get_shader_info(shader_index);
-  glsl_source_code = preprocess2(shader_info, glsl_source_code_buffer, set_binding_map);
+  shader_builder::SPIRVDiskCache const& spirv_disk_cache = owning_window->application().spirv_disk_cache();
+  shader_builder::SPIRVDiskCache const* disk_cache = spirv_disk_cache.is_enabled() ? &spirv_disk_cache : nullptr;
+
+  if (shader_info.is_precompiled_template())
+  {
+    // Compile each template only once; after that only the decorations have to be patched.
+    glsl_source_code = preprocess2_template(shader_info, glsl_source_code_buffer);
+    shader_builder::SPIRVCache& spirv_template = this->spirv_template(shader_index, glsl_source_code);
+    if (spirv_template.empty())
+      spirv_template.compile(glsl_source_code, compiler, shader_info, disk_cache, descriptor::SetBindingMap{});
+    spirv_cache.patch_from_template(spirv_template, set_binding_map);
+  }
+  else
+  {
+    glsl_source_code = preprocess2(shader_info, glsl_source_code_buffer, set_binding_map);
+    spirv_cache.compile(glsl_source_code, compiler, shader_info, disk_cache, set_binding_map);
+  }
 
   // Add a shader module to this pipeline.
-  spirv_cache.compile(glsl_source_code, compiler, shader_info);
-  m_shader_modules.push_back(spirv_cache.create_module({}, owning_window->logical_device()
-      COMMA_CWDEBUG_ONLY(ambifix(".m_shader_modules[" + std::to_string(m_shader_modules.size()) + "]"))));
-  m_shader_stage_create_infos.push_back(
+  add_shader_module(owning_window, shader_info, spirv_cache
+      COMMA_CWDEBUG_ONLY(ambifix(".m_shader_modules[" + std::to_string(m_shader_modules.size()) + "]")));
+}
+
+void ShaderInputData::build_shader_async(task::SynchronousWindow const* owning_window,
+    shader_builder::ShaderIndex const& shader_index, descriptor::SetBindingMap const& set_binding_map
+    COMMA_CWDEBUG_ONLY(AmbifixOwner const& ambifix))
+{
+  DoutEntering(dc::vulkan, "ShaderInputData::build_shader_async(" << owning_window << ", " << shader_index << ", ...) [" << this << "]");
+
+  shader_builder::ShaderInfo const& shader_info = owning_window->application().get_shader_info(shader_index);
+  bool const precompiled_template = shader_info.is_precompiled_template();
+
+  std::string glsl_source_code_buffer;
+  // Preprocessing must be done by the pipeline factory; it needs access to the declaration contexts.
+  std::string_view glsl_source_code = precompiled_template ? preprocess2_template(shader_info, glsl_source_code_buffer)
+                                                           : preprocess2(shader_info, glsl_source_code_buffer, set_binding_map);
+
+  if (precompiled_template)
+  {
+    shader_builder::SPIRVCache const& spirv_template = this->spirv_template(shader_index, glsl_source_code);
+    if (!spirv_template.empty())
     {
-      .flags = vk::PipelineShaderStageCreateFlags(0),
-      .stage = shader_info.stage(),
-      .module = *m_shader_modules.back(),
-      .pName = "main"
+      // Patching the template is cheap; there is no need to involve the thread pool.
+      shader_builder::SPIRVCache spirv_cache;
+      spirv_cache.patch_from_template(spirv_template, set_binding_map);
+      add_shader_module(owning_window, shader_info, spirv_cache
+          COMMA_CWDEBUG_ONLY(ambifix(".m_shader_modules[" + std::to_string(m_shader_modules.size() + m_compile_shader_tasks.size()) + "]")));
+      return;
     }
-  );
+  }
+
+  shader_builder::SPIRVDiskCache const& spirv_disk_cache = owning_window->application().spirv_disk_cache();
+  m_compile_shader_tasks.emplace_back(statefultask::create<task::CompileShader>(shader_index, shader_info, std::string{glsl_source_code}, set_binding_map,
+      spirv_disk_cache.is_enabled() ? &spirv_disk_cache : nullptr, &m_running_compile_shader_tasks
+      COMMA_CWDEBUG_ONLY(ambifix(".m_shader_modules[" + std::to_string(m_shader_modules.size() + m_compile_shader_tasks.size()) + "]"))));
+}
+
+void ShaderInputData::start_compile_shader_tasks(task::PipelineFactory* pipeline_factory, AIStatefulTask::condition_type shaders_compiled)
+{
+  DoutEntering(dc::vulkan, "ShaderInputData::start_compile_shader_tasks(" << pipeline_factory << ", " << shaders_compiled << ") [" << this << "]");
+
+  // Don't call this function again before create_shader_modules was called.
+  ASSERT(m_running_compile_shader_tasks == 0);
+  m_running_compile_shader_tasks = m_compile_shader_tasks.size();
+  for (auto& compile_shader_task : m_compile_shader_tasks)
+    compile_shader_task->run(Application::instance().low_priority_queue(), pipeline_factory, shaders_compiled);
+}
+
+void ShaderInputData::create_shader_modules(task::SynchronousWindow const* owning_window)
+{
+  DoutEntering(dc::vulkan, "ShaderInputData::create_shader_modules(" << owning_window << ") [" << this << "]");
+
+  // Only call this function once all tasks finished.
+  ASSERT(compile_shader_tasks_finished());
+  // Move the tasks out of the way first, so that they are released even if rethrow_if_failed throws.
+  std::vector<boost::intrusive_ptr<task::CompileShader>> compile_shader_tasks;
+  compile_shader_tasks.swap(m_compile_shader_tasks);
+  for (auto const& compile_shader_task : compile_shader_tasks)
+  {
+    compile_shader_task->rethrow_if_failed();
+    // Remember compiled templates, so that the next pipeline only has to patch them.
+    if (compile_shader_task->shader_info().is_precompiled_template())
+    {
+      shader_builder::SPIRVCache& spirv_template = this->spirv_template(compile_shader_task->shader_index(), compile_shader_task->glsl_source_code());
+      if (spirv_template.empty())
+        spirv_template = std::move(compile_shader_task->spirv_template());
+    }
+    add_shader_module(owning_window, compile_shader_task->shader_info(), compile_shader_task->spirv_cache()
+        COMMA_CWDEBUG_ONLY(compile_shader_task->ambifix()));
+  }
 }
 
 } // namespace vulkan::pipeline
@@ -2,13 +2,16 @@
 #define VULKAN_PIPELINE_PIPELINE_H
 
 #include "PushConstantRangeCompare.h"
+#include "CompileShader.h"
 #include "descriptor/SetLayout.h"
+#include "descriptor/SetLimits.h"
 #include "descriptor/SetKeyToSetIndexHint.h"
 #include "descriptor/SetKeyToShaderResourceDeclaration.h"
 #include "descriptor/SetKeyPreference.h"
 #include "shader_builder/ShaderInfo.h"
 #include "shader_builder/ShaderIndex.h"
 #include "shader_builder/SPIRVCache.h"
+#include "shader_builder/SubstitutionTrie.h"
 #include "shader_builder/VertexAttribute.h"
 #include "shader_builder/VertexAttributeDeclarationContext.h"
 #include "shader_builder/PushConstant.h"
@@ -22,10 +25,13 @@
 #include "utils/TemplateStringLiteral.h"
 #include "utils/Badge.h"
 #include <vector>
+#include <map>
+#include <unordered_map>
 #include <set>
 #include <tuple>
 #include <memory>
 #include <cxxabi.h>
+#include <boost/functional/hash.hpp>
 #ifdef CWDEBUG
 #include "debug/DebugSetName.h"
 #endif
@@ -120,8 +126,38 @@ class ShaderInputData
 
   std::vector<shader_builder::ShaderVariable const*> m_shader_variables;                        // A list of all ShaderVariable's (elements of m_glsl_id_full_to_vertex_attribute,
                                                                                                 // m_glsl_id_full_to_push_constant, m_glsl_id_to_shader_resource, ...).
+  mutable shader_builder::SubstitutionTrie m_substitution_trie;                                 // Maps the glsl_id_full of each element of m_shader_variables to its substitution.
+  mutable size_t m_substitution_trie_size = 0;                                                  // The size of m_shader_variables when m_substitution_trie was built.
   std::vector<vk::PipelineShaderStageCreateInfo> m_shader_stage_create_infos;
   std::vector<vk::UniqueShaderModule> m_shader_modules;
+  // Each distinct SPIR-V code of the modules in m_shader_modules, mapped to a unique id (see spirv_id). Cleared by release_spirv_code.
+  struct SPIRVCodeHash
+  {
+    size_t operator()(std::vector<uint32_t> const& spirv_code) const { return boost::hash_range(spirv_code.begin(), spirv_code.end()); }
+  };
+  std::unordered_map<std::vector<uint32_t>, size_t, SPIRVCodeHash> m_spirv_ids;
+  std::vector<size_t> m_shader_module_spirv_ids;                                                // The spirv id of the corresponding element of m_shader_modules.
+
+  // Shaders that are being compiled in the thread pool (see build_shader_async).
+  std::vector<boost::intrusive_ptr<task::CompileShader>> m_compile_shader_tasks;
+  std::atomic_int m_running_compile_shader_tasks{0};                                            // The number of elements of m_compile_shader_tasks that didn't finish yet.
+
+  // Compiled SPIR-V templates of shaders that are precompiled templates (see ShaderInfo::set_precompiled_template),
+  // per shader and per preprocessed template source (the result of preprocess2_template depends on the declarations
+  // that the characteristics of the pipeline added, not only on the shader).
+  std::map<shader_builder::ShaderIndex, std::map<std::string, shader_builder::SPIRVCache, std::less<>>> m_spirv_templates;
+
+ private:
+  // Create glsl code from template source code; if set_binding_map is nullptr, use the hints as placeholders.
+  std::string_view preprocess2_impl(shader_builder::ShaderInfo const& shader_info, std::string& glsl_source_code_buffer, descriptor::SetBindingMap const* set_binding_map) const;
+
+  // Return the (possibly still empty) compiled template of shader_index with preprocessed source template_source.
+  shader_builder::SPIRVCache& spirv_template(shader_builder::ShaderIndex const& shader_index, std::string_view template_source);
+
+  // Create a shader module from spirv_cache and add it, and a corresponding vk::PipelineShaderStageCreateInfo, to this pipeline.
+  void add_shader_module(task::SynchronousWindow const* owning_window,
+      shader_builder::ShaderInfo const& shader_info, shader_builder::SPIRVCache const& spirv_cache
+      COMMA_CWDEBUG_ONLY(AmbifixOwner const& ambifix));
 
  private:
   //---------------------------------------------------------------------------
@@ -219,6 +255,19 @@ class ShaderInputData
     build_shader(owning_window, shader_index, compiler, tmp_spirv_cache, set_binding_map COMMA_CWDEBUG_ONLY(ambifix));
   }
 
+  // Same as build_shader, but only preprocess the shader and create a task::CompileShader for it.
+  // The actual compilation is done in the thread pool, after the pipeline factory called start_compile_shader_tasks.
+  void build_shader_async(task::SynchronousWindow const* owning_window,
+      shader_builder::ShaderIndex const& shader_index, descriptor::SetBindingMap const& set_binding_map
+      COMMA_CWDEBUG_ONLY(AmbifixOwner const& ambifix));
+
+  // Called by PipelineFactory_top_multiloop_while_loop, after the set binding map callbacks (which call build_shader_async).
+  void start_compile_shader_tasks(task::PipelineFactory* pipeline_factory, AIStatefulTask::condition_type shaders_compiled);
+  // Returns true when all tasks started by start_compile_shader_tasks finished.
+  bool compile_shader_tasks_finished() const { return m_running_compile_shader_tasks.load(std::memory_order_acquire) == 0; }
+  // Called by PipelineFactory_compile_shaders once compile_shader_tasks_finished() returns true.
+  void create_shader_modules(task::SynchronousWindow const* owning_window);
+
   // Create glsl code from template source code.
   //
   // glsl_source_code_buffer is only used when the code from shader_info needs preprocessing,
@@ -226,7 +275,16 @@ class ShaderInputData
   //
   // Hence, both shader_info and the string passed as glsl_source_code_buffer need to have a life time beyond the call to compile.
   void preprocess1(shader_builder::ShaderInfo const& shader_info);
-  std::string_view preprocess2(shader_builder::ShaderInfo const& shader_info, std::string& glsl_source_code_buffer, descriptor::SetBindingMap const& set_binding_map) const;
+  std::string_view preprocess2(shader_builder::ShaderInfo const& shader_info, std::string& glsl_source_code_buffer, descriptor::SetBindingMap const& set_binding_map) const
+  {
+    return preprocess2_impl(shader_info, glsl_source_code_buffer, &set_binding_map);
+  }
+  // Same as preprocess2, but use the set index hints and hint bindings as set indexes and bindings.
+  // The result, after compilation, must be patched with SPIRVCache::patch_from_template.
+  std::string_view preprocess2_template(shader_builder::ShaderInfo const& shader_info, std::string& glsl_source_code_buffer) const
+  {
+    return preprocess2_impl(shader_info, glsl_source_code_buffer, nullptr);
+  }
 
   void push_back_descriptor_set_layout_binding(descriptor::SetIndexHint set_index_hint, vk::DescriptorSetLayoutBinding const& descriptor_set_layout_binding)
   {
@@ -314,6 +372,13 @@ class ShaderInputData
 
   // Returns information on what was added with build_shader.
   std::vector<vk::PipelineShaderStageCreateInfo> const& shader_stage_create_infos() const { return m_shader_stage_create_infos; }
+  // Return an id of the SPIR-V code of vh_shader_module if that was created by this object, or no_spirv_id otherwise.
+  // Two modules have the same id if and only if their SPIR-V code is the same.
+  static constexpr size_t no_spirv_id = static_cast<size_t>(-1);
+  size_t spirv_id(vk::ShaderModule vh_shader_module) const;
+  // Free the copies of SPIR-V code that are only needed while new shader modules are created (the keys of m_spirv_ids and the
+  // compiled templates). Called by the pipeline factory when it finished; spirv_id keeps working for the existing modules.
+  void release_spirv_code();
   sorted_descriptor_set_layouts_container_t const& sorted_descriptor_set_layouts() const { return m_sorted_descriptor_set_layouts; }
   sorted_descriptor_set_layouts_container_t& sorted_descriptor_set_layouts() { return m_sorted_descriptor_set_layouts; }
 
@@ -331,6 +396,9 @@ class ShaderInputData
   per_stage_declaration_contexts_container_t const& per_stage_declaration_contexts() const { return m_per_stage_declaration_contexts; }
 
   utils::Vector<vk::DescriptorSet, descriptor::SetIndex> const& vhv_descriptor_sets() const { return m_vhv_descriptor_sets; }
+  // The number of dynamic offsets that must be passed to bindDescriptorSets when binding all of vhv_descriptor_sets().
+  // Throws if the number of dynamic uniform buffers exceeds the limits of the device, or if there are dynamic storage buffers.
+  uint32_t number_of_dynamic_offsets(descriptor::SetLimits const& set_limits) const;
 };
 
 } // namespace pipeline
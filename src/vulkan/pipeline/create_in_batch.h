@@ -0,0 +1,46 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+#include <cstdint>
+#include <vector>
+#include "debug.h"
+
+namespace vulkan::pipeline {
+
+// Create one object per create info with a single call to `create_batch`, and return them in the same order.
+//
+// `create_batch` has the signature of vkCreateGraphicsPipelines (without the device, cache and allocator):
+//
+//   vk::Result create_batch(uint32_t count, CreateInfo const* create_infos, Handle* handles_out);
+//
+// and, like vkCreateGraphicsPipelines, it can fail for a part of the create infos only: the handles
+// of the failed entries are then set to null while all other handles are valid.
+//
+// All returned handles are first passed to `wrap` (which turns a Handle into a UniqueHandle), so that
+// none of them can leak. Then every null entry is created again, on its own, with `create_single`:
+// that either succeeds (the batch failed for a transient reason, like running out of memory) or throws
+// the error of the create info that actually failed.
+template<typename UniqueHandle, typename Handle, typename CreateInfo, typename CreateBatch, typename Wrap, typename CreateSingle>
+std::vector<UniqueHandle> create_in_batch(vk::ArrayProxy<CreateInfo const> const& create_infos, CreateBatch create_batch, Wrap wrap, CreateSingle create_single)
+{
+  uint32_t const count = create_infos.size();
+  std::vector<Handle> handles(count);
+  vk::Result result = create_batch(count, create_infos.data(), handles.data());
+
+  std::vector<UniqueHandle> objects;
+  objects.reserve(count);
+  for (Handle handle : handles)
+    objects.push_back(wrap(handle));
+
+  if (AI_UNLIKELY(result != vk::Result::eSuccess))
+  {
+    Dout(dc::warning, "Batched creation of " << count << " objects returned " << to_string(result) << "; creating the failed ones one by one.");
+    for (uint32_t i = 0; i < count; ++i)
+      if (!objects[i])
+        objects[i] = create_single(create_infos.data()[i]);
+  }
+
+  return objects;
+}
+
+} // namespace vulkan::pipeline
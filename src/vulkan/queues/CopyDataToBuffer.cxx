@@ -1,43 +1,60 @@
 #include "sys.h"
 #include "CopyDataToBuffer.h"
+#include "SynchronousWindow.h"
 
 namespace task {
 
-void CopyDataToBuffer::record_command_buffer(vulkan::handle::CommandBuffer command_buffer)
+void CopyDataToBuffer::add_upload(vulkan::UploadBatch& upload_batch)
 {
-  DoutEntering(dc::vulkan, "CopyDataToBuffer::record_command_buffer(" << command_buffer << ") [" << this << "]");
+  DoutEntering(dc::vulkan, "CopyDataToBuffer::add_upload(...) [" << this << "]");
 
-  command_buffer->begin({ .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit });
+  prepare_queue_family_ownership_transfer(upload_batch);
 
-  vk::BufferMemoryBarrier pre_transfer_buffer_memory_barrier{
-    .srcAccessMask = m_current_buffer_access,
-    .dstAccessMask = vk::AccessFlagBits::eTransferWrite,
-    .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-    .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-    .buffer = m_vh_target_buffer,
-    .offset = m_buffer_offset,
-    .size = m_data_size
-  };
-  command_buffer->pipelineBarrier(m_generating_stages, vk::PipelineStageFlagBits::eTransfer, vk::DependencyFlags(0), {}, { pre_transfer_buffer_memory_barrier }, {});
+  // A buffer that was never accessed has no content.
+  add_pre_transfer_barrier(upload_batch, m_generating_stages, static_cast<bool>(m_current_buffer_access),
+    vk::BufferMemoryBarrier{
+      .srcAccessMask = m_current_buffer_access,
+      .dstAccessMask = vk::AccessFlagBits::eTransferWrite,
+      .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+      .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+      .buffer = m_vh_target_buffer,
+      .offset = m_buffer_offset,
+      .size = m_data_size
+    });
 
-  vk::BufferCopy buffer_copy_region{
-    .srcOffset = 0,
+  upload_batch.add_copy(m_vh_staging_buffer, m_vh_target_buffer, vk::BufferCopy{
+    .srcOffset = m_staging_offset,
     .dstOffset = m_buffer_offset,
     .size = m_data_size
-  };
-  command_buffer->copyBuffer(m_staging_buffer.m_vh_buffer, m_vh_target_buffer, { buffer_copy_region });
+  });
+
+  // Either a normal barrier, or the release half of a queue family ownership transfer (see add_queue_family_ownership_acquire).
+  upload_batch.add_post_transfer_barrier(m_queue_family_ownership_transfer ? vk::PipelineStageFlagBits::eBottomOfPipe : m_consuming_stages,
+    vk::BufferMemoryBarrier{
+      .srcAccessMask = vk::AccessFlagBits::eTransferWrite,
+      .dstAccessMask = m_queue_family_ownership_transfer ? vk::AccessFlags(0) : m_new_buffer_access,
+      .srcQueueFamilyIndex = m_release_queue_family_index,
+      .dstQueueFamilyIndex = m_acquire_queue_family_index,
+      .buffer = m_vh_target_buffer,
+      .offset = m_buffer_offset,
+      .size = m_data_size
+    });
+}
+
+void CopyDataToBuffer::add_queue_family_ownership_acquire(vk::Semaphore vh_semaphore, uint64_t signal_value)
+{
+  DoutEntering(dc::vulkan, "CopyDataToBuffer::add_queue_family_ownership_acquire(" << vh_semaphore << ", " << signal_value << ") [" << this << "]");
 
-  vk::BufferMemoryBarrier post_transfer_buffer_memory_barrier{
-    .srcAccessMask = vk::AccessFlagBits::eTransferWrite,
+  // The acquire half of the queue family ownership transfer; must match the release barrier above.
+  m_resource_owner->add_queue_family_ownership_acquire(vh_semaphore, signal_value, m_consuming_stages, vk::BufferMemoryBarrier{
+    .srcAccessMask = vk::AccessFlags(0),
     .dstAccessMask = m_new_buffer_access,
-    .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-    .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+    .srcQueueFamilyIndex = m_release_queue_family_index,
+    .dstQueueFamilyIndex = m_acquire_queue_family_index,
     .buffer = m_vh_target_buffer,
     .offset = m_buffer_offset,
     .size = m_data_size
-  };
-  command_buffer->pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, m_consuming_stages, vk::DependencyFlags(0), {}, { post_transfer_buffer_memory_barrier }, {});
-  command_buffer->end();
+  });
 }
 
 } // namespace task
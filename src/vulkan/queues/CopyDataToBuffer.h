@@ -30,6 +30,7 @@ class CopyDataToBuffer final : public CopyDataToGPU
     DoutEntering(dc::vulkan, "CopyDataToBuffer(" << logical_device << ", " << data_size << ", " << vh_target_buffer <<
         ", " << buffer_offset << ", " << current_buffer_access << ", " << generating_stages <<
         ", " << new_buffer_access << ", " << consuming_stages << ") [" << this << "]");
+    set_destination(vh_target_buffer);
   }
 
   ~CopyDataToBuffer()
@@ -38,7 +39,8 @@ class CopyDataToBuffer final : public CopyDataToGPU
   }
 
  private:
-  void record_command_buffer(vulkan::handle::CommandBuffer command_buffer) override;
+  void add_upload(vulkan::UploadBatch& upload_batch) override;
+  void add_queue_family_ownership_acquire(vk::Semaphore vh_semaphore, uint64_t signal_value) override;
 };
 
 } // namespace task
@@ -1,7 +1,10 @@
 #include "sys.h"
 #include "CopyDataToGPU.h"
 #include "SynchronousWindow.h"
+#include "Application.h"
 #include "memory/StagingBuffer.h"
+#include "utils/AIAlert.h"
+#include <algorithm>
 
 namespace task {
 
@@ -10,12 +13,22 @@ CopyDataToGPU::~CopyDataToGPU()
   DoutEntering(dc::vulkan, "CopyDataToGPU::~CopyDataToGPU() [" << this << "]");
 }
 
+char const* CopyDataToGPU::condition_str_impl(condition_type condition) const
+{
+  switch (condition)
+  {
+    AI_CASE_RETURN(fill_ranges_finished);
+  }
+  return direct_base_type::condition_str_impl(condition);
+}
+
 char const* CopyDataToGPU::state_str_impl(state_type run_state) const
 {
   switch(run_state)
   {
     AI_CASE_RETURN(CopyDataToGPU_start);
     AI_CASE_RETURN(CopyDataToGPU_write);
+    AI_CASE_RETURN(CopyDataToGPU_fill_ranges);
     AI_CASE_RETURN(CopyDataToGPU_flush);
     AI_CASE_RETURN(CopyDataToGPU_done);
   }
@@ -41,13 +54,80 @@ void CopyDataToGPU::initialize_impl()
   }
 }
 
+void CopyDataToGPU::abort_impl()
+{
+  DoutEntering(dc::vulkan, "CopyDataToGPU::abort_impl() [" << this << "]");
+  // FillRange tasks that didn't start yet won't touch the staging memory anymore once we claimed them.
+  for (boost::intrusive_ptr<FillRange> const& fill_range_task : m_fill_range_tasks)
+    if (fill_range_task->claim())
+      m_running_fill_range_tasks.fetch_sub(1, std::memory_order_relaxed);
+  // The others are writing to the staging memory that finish_impl releases; wait for them.
+  // Each of them only fills its own range (and is running in another thread), so this doesn't take long;
+  // they notify m_running_fill_range_tasks after decrementing it (see FillRange::done_filling).
+  for (int running; (running = m_running_fill_range_tasks.load(std::memory_order_acquire)) != 0;)
+    m_running_fill_range_tasks.wait(running, std::memory_order_acquire);
+  m_fill_range_tasks.clear();
+}
+
 void CopyDataToGPU::finish_impl()
 {
+  // If we get here with a staging ring region then it was never passed to m_submit_request (we were aborted),
+  // so the GPU never read from it.
+  if (m_staging_region)
+    m_submit_request.logical_device()->staging_ring().release(m_staging_region);
   if (m_resource_owner)
     // See above.
     const_cast<SynchronousWindow*>(m_resource_owner)->m_task_counter_gate.decrement();
 }
 
+void CopyDataToGPU::prepare_queue_family_ownership_transfer(vulkan::UploadBatch const& upload_batch)
+{
+  m_queue_family_ownership_transfer = false;
+  m_release_queue_family_index = VK_QUEUE_FAMILY_IGNORED;
+  m_acquire_queue_family_index = VK_QUEUE_FAMILY_IGNORED;
+  // Without a resource owner we don't know which queue will consume the data.
+  if (!m_resource_owner)
+    return;
+  vulkan::QueueFamilyPropertiesIndex const consuming_queue_family = m_resource_owner->presentation_surface().graphics_queue().queue_family();
+  if (consuming_queue_family == upload_batch.queue_family())
+    return;
+  // The copy is done by, for example, a dedicated transfer queue family.
+  m_queue_family_ownership_transfer = true;
+  m_release_queue_family_index = upload_batch.queue_family().get_value();
+  m_acquire_queue_family_index = consuming_queue_family.get_value();
+}
+
+template<typename MemoryBarrier>
+void CopyDataToGPU::add_pre_transfer_barrier(vulkan::UploadBatch& upload_batch, vk::PipelineStageFlags generating_stages, bool has_content, MemoryBarrier barrier)
+{
+  if (m_queue_family_ownership_transfer)
+  {
+    if (has_content)
+    {
+      // Transfer the ownership from the consuming queue family to the uploading one. The release half is executed by the graphics queue
+      // of m_resource_owner, after its last use of the resource (in generating_stages), which then signals the semaphore that we wait for.
+      // The access masks and layouts of both halves are the same (the srcAccessMask is ignored by the acquire, the dstAccessMask by the release).
+      barrier.srcQueueFamilyIndex = m_acquire_queue_family_index;
+      barrier.dstQueueFamilyIndex = m_release_queue_family_index;
+      auto [vh_semaphore, signal_value] = m_resource_owner->add_queue_family_ownership_release(generating_stages, barrier);
+      upload_batch.add_wait(vh_semaphore, signal_value);
+      // The semaphore wait is at eTransfer: start the acquire there to form a dependency chain.
+      generating_stages = vk::PipelineStageFlagBits::eTransfer;
+    }
+    else
+    {
+      // There is nothing to preserve or to wait for; and the generating stages (of the consuming queue) are not necessarily supported by the transfer queue.
+      barrier.srcAccessMask = vk::AccessFlags(0);
+      generating_stages = vk::PipelineStageFlagBits::eTopOfPipe;
+    }
+  }
+  upload_batch.add_pre_transfer_barrier(generating_stages, barrier);
+}
+
+// Explicit instantiations, for CopyDataToBuffer and CopyDataToImage.
+template void CopyDataToGPU::add_pre_transfer_barrier(vulkan::UploadBatch&, vk::PipelineStageFlags, bool, vk::BufferMemoryBarrier);
+template void CopyDataToGPU::add_pre_transfer_barrier(vulkan::UploadBatch&, vk::PipelineStageFlags, bool, vk::ImageMemoryBarrier);
+
 void CopyDataToGPU::multiplex_impl(state_type run_state)
 {
   switch (run_state)
@@ -56,9 +136,22 @@ void CopyDataToGPU::multiplex_impl(state_type run_state)
     {
       ZoneScopedN("CopyDataToGPU_start");
       vulkan::LogicalDevice const* logical_device = m_submit_request.logical_device();
-      // Create staging buffer and map its memory to copy data from the CPU.
-      m_staging_buffer = vulkan::memory::StagingBuffer(logical_device, m_data_size
-          COMMA_CWDEBUG_ONLY(debug_name_prefix("m_staging_buffer")));
+      // Reserve a region of the staging ring to copy data from the CPU, or create a dedicated
+      // staging buffer if the data doesn't fit (either because it is too large, or because the ring is full).
+      vulkan::memory::StagingRing const& staging_ring = logical_device->staging_ring();
+      m_staging_region = staging_ring.reserve(m_data_size, staging_offset_alignment());
+      if (m_staging_region)
+      {
+        m_vh_staging_buffer = staging_ring.vh_buffer();
+        m_staging_offset = m_staging_region.m_offset;
+      }
+      else
+      {
+        m_staging_buffer = vulkan::memory::StagingBuffer(logical_device, m_data_size
+            COMMA_CWDEBUG_ONLY(debug_name_prefix("m_staging_buffer")));
+        m_vh_staging_buffer = m_staging_buffer.m_vh_buffer;
+        m_staging_offset = 0;
+      }
       set_state(CopyDataToGPU_write);
     }
     [[fallthrough]];
@@ -66,15 +159,48 @@ void CopyDataToGPU::multiplex_impl(state_type run_state)
     {
       ZoneScopedN("CopyDataToGPU_write");
       // Copy data to the staging buffer.
-      unsigned char* dst = static_cast<unsigned char*>(m_staging_buffer.m_pointer);
+      unsigned char* dst = static_cast<unsigned char*>(m_staging_region ? m_staging_region.m_pointer : m_staging_buffer.m_pointer);
       uint32_t const chunk_size = m_data_feeder->chunk_size();
       int const chunk_count = m_data_feeder->chunk_count();
-      int chunks;
-      for (int total_chunks = 0; total_chunks < chunk_count; total_chunks += chunks)
+      size_t const total_size = static_cast<size_t>(chunk_count) * chunk_size;
+      if (m_data_feeder->supports_fill_range() && total_size >= 2 * s_min_fill_range_size)
+      {
+        // Split the chunks over a number of FillRange tasks that run in the thread pool,
+        // each writing to its own, disjoint, part of the staging memory.
+        int const number_of_ranges = std::min(static_cast<size_t>(s_max_fill_range_tasks), total_size / s_min_fill_range_size);
+        ASSERT(m_running_fill_range_tasks == 0);
+        m_running_fill_range_tasks = number_of_ranges;
+        m_fill_range_tasks.reserve(number_of_ranges);
+        int begin = 0;
+        for (int range = 1; range <= number_of_ranges; ++range)
+        {
+          int const end = static_cast<int>(static_cast<int64_t>(chunk_count) * range / number_of_ranges);
+          m_fill_range_tasks.emplace_back(statefultask::create<FillRange>(m_data_feeder.get(), begin, end, dst + static_cast<size_t>(begin) * chunk_size,
+              &m_running_fill_range_tasks));
+          // If a FillRange task fails, it aborts us.
+          m_fill_range_tasks.back()->run(vulkan::Application::instance().low_priority_queue(), this, fill_ranges_finished, abort_parent);
+          begin = end;
+        }
+        set_state(CopyDataToGPU_fill_ranges);
+        break;
+      }
+      // Fall back to getting the chunks sequentially.
+      try
       {
-        chunks = m_data_feeder->next_batch();
-        m_data_feeder->get_chunks(dst);
-        dst += chunks * chunk_size;
+        int chunks;
+        for (int total_chunks = 0; total_chunks < chunk_count; total_chunks += chunks)
+        {
+          chunks = m_data_feeder->next_batch();
+          m_data_feeder->get_chunks(dst);
+          dst += chunks * chunk_size;
+        }
+      }
+      catch (AIAlert::Error const& error)
+      {
+        // For example, a data feeder that decodes an image file can only detect corrupt data here.
+        Dout(dc::warning, "Failed to get the data to upload: " << error);
+        abort();
+        break;
       }
       set_state(CopyDataToGPU_flush);
     }
@@ -84,19 +210,44 @@ void CopyDataToGPU::multiplex_impl(state_type run_state)
       ZoneScopedN("CopyDataToGPU_flush");
       vulkan::LogicalDevice const* logical_device = m_submit_request.logical_device();
       // Once everything is written to the staging buffer and flush.
-      logical_device->flush_mapped_allocation(m_staging_buffer.m_vh_allocation, 0, VK_WHOLE_SIZE);
-      // Set callback to record command buffer to virtual function `record_command_buffer`,
+      if (m_staging_region)
+        logical_device->flush_mapped_allocation(logical_device->staging_ring().vh_allocation(), m_staging_offset, m_data_size);
+      else
+        logical_device->flush_mapped_allocation(m_staging_buffer.m_vh_allocation, 0, VK_WHOLE_SIZE);
+      // Set callback to add the barriers and copy regions of this upload to a batch of uploads to virtual function `add_upload`,
       // the derived class is responsible for appropriate commands to copy the staging buffer to the right destination.
-      m_submit_request.set_record_function([this](vulkan::handle::CommandBuffer command_buffer){
-        record_command_buffer(command_buffer);
-      });
+      // The ImmediateSubmitQueue records the batch into a single command buffer.
+      m_submit_request.set_upload_function([this](vulkan::UploadBatch& upload_batch){
+        add_upload(upload_batch);
+      }, m_data_size);
+      // From now on the request releases the staging ring region, when the GPU is done reading it.
+      if (m_staging_region)
+      {
+        m_submit_request.set_staging_region(m_staging_region);
+        m_staging_region = {};
+      }
       // Finish the rest of this "immediate submit" by passing control to the base class.
       set_state(ImmediateSubmit_start);
       break;
     }
+    case CopyDataToGPU_fill_ranges:
+      // Wait until all FillRange tasks finished.
+      if (m_running_fill_range_tasks.load(std::memory_order_acquire) != 0)
+      {
+        wait(fill_ranges_finished);
+        break;
+      }
+      m_fill_range_tasks.clear();
+      set_state(CopyDataToGPU_flush);
+      break;
     case CopyDataToGPU_done:
     {
       ZoneScopedN("CopyDataToGPU_done");
+      // We get here after the timeline semaphore of the ImmediateSubmitQueue passed the signal value
+      // of our submit: the GPU is done reading the staging memory (which ImmediateSubmitRequest::finished released).
+      // The release barrier was executed by the transfer queue; let the graphics queue acquire the ownership.
+      if (m_queue_family_ownership_transfer)
+        add_queue_family_ownership_acquire(m_vh_finished_semaphore, m_finished_signal_value);
       finish();
       break;
     }
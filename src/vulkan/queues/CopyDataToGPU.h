@@ -1,21 +1,42 @@
 #pragma once
 
 #include "ImmediateSubmit.h"
+#include "FillRange.h"
 #include "memory/StagingBuffer.h"
+#include "memory/StagingRing.h"
 #include "memory/DataFeeder.h"
 #include "statefultask/RunningTasksTracker.h"
+#include <atomic>
 #include <vector>
 
 namespace task {
 
 class CopyDataToGPU : public ImmediateSubmit
 {
+ public:
+  static constexpr condition_type fill_ranges_finished = 2;
+
+  // If the data feeder supports fill_range, then the data is split over at most
+  // s_max_fill_range_tasks FillRange tasks of at least s_min_fill_range_size bytes each.
+  static constexpr uint32_t s_min_fill_range_size = 256 * 1024;
+  static constexpr int s_max_fill_range_tasks = 8;
+
  protected:
   std::unique_ptr<vulkan::DataFeeder> m_data_feeder;
-  vulkan::memory::StagingBuffer m_staging_buffer;
+  vulkan::memory::StagingRingRegion m_staging_region;           // The region of the staging ring of the logical device that is used, if any.
+  vulkan::memory::StagingBuffer m_staging_buffer;               // A dedicated staging buffer, only used when the data doesn't fit in the staging ring.
+  vk::Buffer m_vh_staging_buffer;                               // The buffer that the derived class must copy from (at m_staging_offset).
+  vk::DeviceSize m_staging_offset;                              // The offset of the data in m_vh_staging_buffer.
   uint32_t m_data_size;
   SynchronousWindow const* m_resource_owner;                    // If any resources that this task uses are part of a window, then this should be set.
   statefultask::RunningTasksTracker::index_type m_index;        // Our index, if added to m_resource_owner.
+  // Set by prepare_queue_family_ownership_transfer.
+  bool m_queue_family_ownership_transfer{};                     // Set if the data is copied by a queue of another queue family than the graphics queue of m_resource_owner.
+  uint32_t m_release_queue_family_index;                        // The queue family that copies the data, or VK_QUEUE_FAMILY_IGNORED.
+  uint32_t m_acquire_queue_family_index;                        // The queue family that consumes the data, or VK_QUEUE_FAMILY_IGNORED.
+  // CopyDataToGPU_write.
+  std::vector<boost::intrusive_ptr<FillRange>> m_fill_range_tasks;
+  std::atomic_int m_running_fill_range_tasks{0};                // The number of elements of m_fill_range_tasks that didn't finish yet.
 
  protected:
   using direct_base_type = ImmediateSubmit;
@@ -24,6 +45,7 @@ class CopyDataToGPU : public ImmediateSubmit
   enum CopyDataToGPU_state_type {
     CopyDataToGPU_start = direct_base_type::state_end,
     CopyDataToGPU_write,
+    CopyDataToGPU_fill_ranges,
     CopyDataToGPU_flush,
     CopyDataToGPU_done
   };
@@ -50,14 +72,38 @@ class CopyDataToGPU : public ImmediateSubmit
     m_data_feeder = std::move(data_feeder);
   }
 
+ protected:
+  // Called by the constructor of the derived class: keep the uploads to the same destination resource ordered,
+  // by passing them to the same queue. Uploads to different resources go to the least loaded queue.
+  template<typename Handle>
+  void set_destination(Handle vh_destination)
+  {
+    m_submit_request.set_affinity(reinterpret_cast<uint64_t>(static_cast<typename Handle::CType>(vh_destination)));
+  }
+
+  // Called by add_upload of the derived class: determine if a queue family ownership transfer is needed and set the queue family indices.
+  void prepare_queue_family_ownership_transfer(vulkan::UploadBatch const& upload_batch);
+
+  // Called by add_upload of the derived class, after prepare_queue_family_ownership_transfer: add barrier, which makes the destination
+  // available to the transfer, to upload_batch. If the destination has content (it might still be in use) and the copy is done by a queue
+  // of another queue family, then the graphics queue of m_resource_owner first releases it, and the copy waits for and acquires that.
+  template<typename MemoryBarrier>
+  void add_pre_transfer_barrier(vulkan::UploadBatch& upload_batch, vk::PipelineStageFlags generating_stages, bool has_content, MemoryBarrier barrier);
+
  private:
-  virtual void record_command_buffer(vulkan::handle::CommandBuffer command_buffer) = 0;
+  virtual void add_upload(vulkan::UploadBatch& upload_batch) = 0;
+  // Called after the copy finished, if m_queue_family_ownership_transfer is set: pass the acquire barrier to m_resource_owner.
+  virtual void add_queue_family_ownership_acquire(vk::Semaphore vh_semaphore, uint64_t signal_value) = 0;
+  // Return the value that m_staging_offset must be a multiple of, as required by the copy command of the derived class.
+  virtual vk::DeviceSize staging_offset_alignment() const { return 1; }
 
  protected:
   ~CopyDataToGPU() override;
 
   void initialize_impl() override;
+  void abort_impl() override;
   void finish_impl() override;
+  char const* condition_str_impl(condition_type condition) const override;
   char const* state_str_impl(state_type run_state) const override;
   void multiplex_impl(state_type run_state) override;
 };
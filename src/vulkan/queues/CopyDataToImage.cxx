@@ -1,32 +1,34 @@
 #include "sys.h"
 #include "CopyDataToImage.h"
+#include "SynchronousWindow.h"
 
 namespace task {
 
-void CopyDataToImage::record_command_buffer(vulkan::handle::CommandBuffer command_buffer)
+void CopyDataToImage::add_upload(vulkan::UploadBatch& upload_batch)
 {
-  DoutEntering(dc::vulkan, "CopyDataToImage::record_command_buffer(" << command_buffer << ")");
+  DoutEntering(dc::vulkan, "CopyDataToImage::add_upload(...) [" << this << "]");
 
-  command_buffer->begin({ .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit });
+  prepare_queue_family_ownership_transfer(upload_batch);
 
-  vk::ImageMemoryBarrier pre_transfer_image_memory_barrier{
-    .srcAccessMask = m_current_image_access,
-    .dstAccessMask = vk::AccessFlagBits::eTransferWrite,
-    .oldLayout = m_current_image_layout,
-    .newLayout = vk::ImageLayout::eTransferDstOptimal,
-    .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-    .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-    .image = m_vh_target_image,
-    .subresourceRange = m_image_subresource_range
-  };
-  command_buffer->pipelineBarrier(m_generating_stages, vk::PipelineStageFlagBits::eTransfer, vk::DependencyFlags(0), {}, {}, { pre_transfer_image_memory_barrier });
+  // An image in the eUndefined layout has no content that must be preserved.
+  add_pre_transfer_barrier(upload_batch, m_generating_stages, m_current_image_layout != vk::ImageLayout::eUndefined,
+    vk::ImageMemoryBarrier{
+      .srcAccessMask = m_current_image_access,
+      .dstAccessMask = vk::AccessFlagBits::eTransferWrite,
+      .oldLayout = m_current_image_layout,
+      .newLayout = vk::ImageLayout::eTransferDstOptimal,
+      .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+      .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+      .image = m_vh_target_image,
+      .subresourceRange = m_image_subresource_range
+    });
 
-  std::vector<vk::BufferImageCopy> buffer_image_copy;
-  buffer_image_copy.reserve(m_image_subresource_range.levelCount);
+  // Append the regions directly to those of the batch; their memory is reused by later batches.
+  std::vector<vk::BufferImageCopy>& buffer_image_copy = upload_batch.image_copy_regions(m_vh_staging_buffer, m_vh_target_image);
   for (uint32_t i = m_image_subresource_range.baseMipLevel; i < m_image_subresource_range.baseMipLevel + m_image_subresource_range.levelCount; ++i)
   {
     buffer_image_copy.emplace_back(vk::BufferImageCopy{
-      .bufferOffset = 0,
+      .bufferOffset = m_staging_offset,
       .bufferRowLength = 0,
       .bufferImageHeight = 0,
       .imageSubresource = vk::ImageSubresourceLayers{
@@ -43,20 +45,46 @@ void CopyDataToImage::record_command_buffer(vulkan::handle::CommandBuffer comman
       }
     });
   }
-  command_buffer->copyBufferToImage(m_staging_buffer.m_vh_buffer, m_vh_target_image, vk::ImageLayout::eTransferDstOptimal, buffer_image_copy);
 
-  vk::ImageMemoryBarrier post_transfer_image_memory_barrier{
-    .srcAccessMask = vk::AccessFlagBits::eTransferWrite,
+  // Either a normal barrier, or the release half of a queue family ownership transfer (see add_queue_family_ownership_acquire).
+  upload_batch.add_post_transfer_barrier(m_queue_family_ownership_transfer ? vk::PipelineStageFlagBits::eBottomOfPipe : m_consuming_stages,
+    vk::ImageMemoryBarrier{
+      .srcAccessMask = vk::AccessFlagBits::eTransferWrite,
+      .dstAccessMask = m_queue_family_ownership_transfer ? vk::AccessFlags(0) : m_new_image_access,
+      .oldLayout = vk::ImageLayout::eTransferDstOptimal,
+      .newLayout = m_new_image_layout,
+      .srcQueueFamilyIndex = m_release_queue_family_index,
+      .dstQueueFamilyIndex = m_acquire_queue_family_index,
+      .image = m_vh_target_image,
+      .subresourceRange = m_image_subresource_range
+    });
+}
+
+vk::DeviceSize CopyDataToImage::staging_offset_alignment() const
+{
+  // The bufferOffset of vkCmdCopyBufferToImage must be a multiple of the texel block size of the format of the image.
+  // The data is m_extent.width * m_extent.height texels per layer (see add_upload), so that gives the texel size of
+  // uncompressed formats. The blocks of compressed formats are 8 or 16 bytes, which the staging ring always aligns to.
+  uint64_t const number_of_texels = uint64_t{m_extent.width} * m_extent.height * m_image_subresource_range.layerCount;
+  vk::DeviceSize const texel_size = number_of_texels > 0 ? m_data_size / number_of_texels : 0;
+  return texel_size > 0 ? texel_size : 1;
+}
+
+void CopyDataToImage::add_queue_family_ownership_acquire(vk::Semaphore vh_semaphore, uint64_t signal_value)
+{
+  DoutEntering(dc::vulkan, "CopyDataToImage::add_queue_family_ownership_acquire(" << vh_semaphore << ", " << signal_value << ") [" << this << "]");
+
+  // The acquire half of the queue family ownership transfer; the layout transition must be the same as that of the release barrier above.
+  m_resource_owner->add_queue_family_ownership_acquire(vh_semaphore, signal_value, m_consuming_stages, vk::ImageMemoryBarrier{
+    .srcAccessMask = vk::AccessFlags(0),
     .dstAccessMask = m_new_image_access,
     .oldLayout = vk::ImageLayout::eTransferDstOptimal,
     .newLayout = m_new_image_layout,
-    .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-    .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+    .srcQueueFamilyIndex = m_release_queue_family_index,
+    .dstQueueFamilyIndex = m_acquire_queue_family_index,
     .image = m_vh_target_image,
     .subresourceRange = m_image_subresource_range
-  };
-  command_buffer->pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, m_consuming_stages, vk::DependencyFlags(0), {}, {}, { post_transfer_image_memory_barrier });
-  command_buffer->end();
+  });
 }
 
 } // namespace task
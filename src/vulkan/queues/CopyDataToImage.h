@@ -33,10 +33,13 @@ class CopyDataToImage final : public CopyDataToGPU
     DoutEntering(dc::vulkan, "CopyDataToImage(" << logical_device << ", " << data_size << ", " << vh_target_image << ", " <<
         extent << ", " << image_subresource_range << ", " << current_image_layout << ", " << current_image_access << ", " <<
         generating_stages << ", " << new_image_layout << ", " << new_image_access << ", " << consuming_stages << ")");
+    set_destination(vh_target_image);
   }
 
  private:
-  void record_command_buffer(vulkan::handle::CommandBuffer command_buffer) override;
+  void add_upload(vulkan::UploadBatch& upload_batch) override;
+  void add_queue_family_ownership_acquire(vk::Semaphore vh_semaphore, uint64_t signal_value) override;
+  vk::DeviceSize staging_offset_alignment() const override;
 };
 
 } // namespace task
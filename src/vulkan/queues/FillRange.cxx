@@ -0,0 +1,73 @@
+#include "sys.h"
+#include "FillRange.h"
+#include "utils/AIAlert.h"
+#include <Tracy.hpp>
+#include "debug.h"
+
+namespace task {
+
+FillRange::~FillRange()
+{
+  DoutEntering(dc::statefultask(mSMDebug), "FillRange::~FillRange() [" << this << "]");
+}
+
+char const* FillRange::state_str_impl(state_type run_state) const
+{
+  switch (run_state)
+  {
+    AI_CASE_RETURN(FillRange_fill);
+    AI_CASE_RETURN(FillRange_done);
+  }
+  AI_NEVER_REACHED
+}
+
+void FillRange::done_filling()
+{
+  // The parent can't be destroyed before we finished, so it is safe to notify after the decrement.
+  m_running_tasks->fetch_sub(1, std::memory_order_release);
+  m_running_tasks->notify_all();        // Wake up CopyDataToGPU::abort_impl, if it is waiting for us.
+}
+
+char const* FillRange::task_name_impl() const
+{
+  return "FillRange";
+}
+
+void FillRange::multiplex_impl(state_type run_state)
+{
+  switch (run_state)
+  {
+    case FillRange_fill:
+    {
+      ZoneScopedN("FillRange_fill");
+      if (!claim())
+      {
+        // The parent was aborted before we started; it already accounted for us in *m_running_tasks.
+        finish();
+        break;
+      }
+      try
+      {
+        m_data_feeder->fill_range(m_begin, m_end, m_chunk_ptr);
+      }
+      catch (AIAlert::Error const& error)
+      {
+        // For example, a data feeder that decodes an image file can only detect corrupt data here.
+        // We were run with abort_parent: aborting also aborts the CopyDataToGPU task that uses this range.
+        Dout(dc::warning, "Failed to fill chunks [" << m_begin << ", " << m_end << "): " << error);
+        done_filling();
+        abort();
+        break;
+      }
+      set_state(FillRange_done);
+      [[fallthrough]];
+    }
+    case FillRange_done:
+      // Decrement the counter before finish() signals the parent.
+      done_filling();
+      finish();
+      break;
+  }
+}
+
+} // namespace task
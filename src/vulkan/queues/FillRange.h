@@ -0,0 +1,65 @@
+#pragma once
+
+#include "memory/DataFeeder.h"
+#include "statefultask/AIStatefulTask.h"
+#include <atomic>
+#include "debug.h"
+
+namespace task {
+
+// Fill a range of chunks of a DataFeeder into (mapped) staging memory.
+//
+// These tasks are created by CopyDataToGPU, when its data feeder supports fill_range,
+// and run in the low priority queue of the thread pool, so that disjoint ranges of the
+// staging memory are filled concurrently. CopyDataToGPU waits until all of them finished
+// before flushing the staging memory. If fill_range throws, the task aborts, which aborts
+// the CopyDataToGPU task too.
+class FillRange : public AIStatefulTask
+{
+ private:
+  vulkan::DataFeeder const* m_data_feeder;                      // The data feeder to call fill_range on.
+  int m_begin;                                                  // The first chunk to fill.
+  int m_end;                                                    // One beyond the last chunk to fill.
+  unsigned char* m_chunk_ptr;                                   // Where chunk m_begin must be written.
+  std::atomic_int* m_running_tasks;                             // Counter that is decremented, and notified, when this task finished filling its range.
+  std::atomic_bool m_claimed{false};                            // Set by whoever calls claim() first: this task when it starts filling, or the parent when it is aborted.
+
+ protected:
+  using direct_base_type = AIStatefulTask;
+
+  // The different states of the task.
+  enum FillRange_state_type {
+    FillRange_fill = direct_base_type::state_end,
+    FillRange_done
+  };
+
+ public:
+  // One beyond the largest state of this task.
+  static constexpr state_type state_end = FillRange_done + 1;
+
+ public:
+  FillRange(vulkan::DataFeeder const* data_feeder, int begin, int end, unsigned char* chunk_ptr, std::atomic_int* running_tasks
+      COMMA_CWDEBUG_ONLY(bool debug = false)) :
+    direct_base_type(CWDEBUG_ONLY(debug)), m_data_feeder(data_feeder), m_begin(begin), m_end(end), m_chunk_ptr(chunk_ptr), m_running_tasks(running_tasks)
+  {
+    DoutEntering(dc::statefultask(mSMDebug), "FillRange::FillRange(" << data_feeder << ", " << begin << ", " << end << ", " << (void*)chunk_ptr << ") [" << this << "]");
+  }
+
+  // Return true if the caller is the first to claim this task.
+  // When the parent task is aborted it claims all FillRange tasks: those that weren't claimed by themselves yet then
+  // no longer touch the staging memory, and the parent decrements *m_running_tasks on their behalf.
+  bool claim() { return !m_claimed.exchange(true, std::memory_order_acq_rel); }
+
+ private:
+  void done_filling();
+
+ protected:
+  ~FillRange() override;
+
+  // Implementation of virtual functions of AIStatefulTask.
+  char const* state_str_impl(state_type run_state) const override;
+  char const* task_name_impl() const override;
+  void multiplex_impl(state_type run_state) override;
+};
+
+} // namespace task
@@ -20,6 +20,9 @@ class ImmediateSubmit : public vulkan::AsyncTask
   state_type m_continue_state{ImmediateSubmit_done};
   // ImmediateSubmit_start.
   ImmediateSubmitQueue* m_immediate_submit_queue_task{};
+  // Set by ImmediateSubmitRequest::finished: the timeline semaphore, and its value, that signalled the end of the submit.
+  vk::Semaphore m_vh_finished_semaphore;
+  uint64_t m_finished_signal_value{};
 
   // The different states of the task.
   enum ImmediateSubmit_state_type {
@@ -36,6 +39,13 @@ class ImmediateSubmit : public vulkan::AsyncTask
   void set_queue_request_key(vulkan::QueueRequestKey queue_request_key) { m_submit_request.set_queue_request_key(queue_request_key); }
   void set_record_function(vulkan::ImmediateSubmitRequest::record_function_type&& record_function) { m_submit_request.set_record_function(std::move(record_function)); }
 
+  // Called by ImmediateSubmitRequest::finished, right before signalling submit_finished.
+  void set_finished_semaphore_value(vk::Semaphore vh_semaphore, uint64_t signal_value)
+  {
+    m_vh_finished_semaphore = vh_semaphore;
+    m_finished_signal_value = signal_value;
+  }
+
  protected:
   ~ImmediateSubmit() override;
 
@@ -2,19 +2,23 @@
 #include "ImmediateSubmitQueue.h"
 #include "CommandBufferFactory.h"
 #include "utils/AIAlert.h"
+#include <algorithm>
 
 namespace task {
 
 ImmediateSubmitQueue::ImmediateSubmitQueue(
     vulkan::LogicalDevice const* logical_device,
-    vulkan::Queue const& queue
+    vulkan::Queue const& queue,
+    vulkan::QueueSelector* selector
     COMMA_CWDEBUG_ONLY(bool debug)) :
   direct_base_type(CWDEBUG_ONLY(debug)),
   m_command_buffer_pool(8, m_deque_allocator, logical_device, queue.queue_family()
       COMMA_CWDEBUG_ONLY(debug_name_prefix("m_command_buffer_pool.m_factory"))),
   m_queue(queue),
   m_semaphore(logical_device, 0
-      COMMA_CWDEBUG_ONLY(debug_name_prefix("m_timeline_semaphore")))
+      COMMA_CWDEBUG_ONLY(debug_name_prefix("m_timeline_semaphore"))),
+  m_upload_batch(queue.queue_family(), logical_device->queue_flags(queue.queue_family())),
+  m_selector(selector)
 {
   DoutEntering(dc::statefultask(mSMDebug), "ImmediateSubmitQueue::ImmediateSubmitQueue(" << logical_device << ", " << queue << ") [" << this << "]");
 }
@@ -59,21 +63,23 @@ void ImmediateSubmitQueue::multiplex_impl(state_type run_state)
       //                  std::deque<ImmediateSubmitRequest>
       //                             .----------.
       //                             |          | ⎞ <-- begin() iff m_submitted > 0.
-      //                             |          | ⎟- m_pending_requests = number of submitted, but not finished, command buffers.
+      //                             |          | ⎟- m_pending_requests = number of submitted, but not finished, requests.
       //                             |          | ⎟
       //  m_last_submitted       --> |          | ⎠
       //   (only valid if            +----------+
       //    m_pending_requests > 0)  |          | ⎞⎞  <-- first_submit_request (= begin() iff m_submitted == 0) (only valid if n > 0).
-      //                             |          | ⎟⎟- n = number of existing new submit requests at the time of the call to front_n(n) (with a max. of 64).
-      //                             |          | ⎟-- acquired = number of command buffers acquired (might be less than n).
+      //                             |          | ⎟⎟- n = number of existing new submit requests at the time of the call to front_n(n) (with a max. of s_max_requests_per_submit).
+      //                             |          | ⎟-- handled = number of requests that were recorded into the acquired command buffers (might be less than n).
       //                             |          | ⎠⎟
       //                             |          |  ⎠
       //                             .          .
       //                             .          . <-- possibly already appended new submit requests (there is no `end()`).
       //
+      // The command buffers and the number of requests of each submit are stored in m_in_flight_submissions,
+      // indexed by the signal value of that submit. The pending requests are in the same order as the submits.
       //
-      // Reserve up to 64 elements for reading.
-      int n = m_pending_requests + 64;
+      // Reserve up to s_max_requests_per_submit new elements for reading.
+      int n = m_pending_requests + s_max_requests_per_submit;
       // front_n sets n to the size of the deque (if that is less than the n that is passed).
       container_type::const_iterator const first_pending_request = front_n(n);  // Returns begin(); points to ImmediateSubmitRequest's.
       // We know there are this many elements in the deque; so it should be impossible for n to be less.
@@ -82,45 +88,70 @@ void ImmediateSubmitQueue::multiplex_impl(state_type run_state)
       n -= m_pending_requests;
       // If there are pending requests then the first newly submitted request is at m_last_submitted + 1, otherwise it is at begin().
       container_type::const_iterator const first_submit_request = (m_pending_requests > 0) ? m_last_submitted + 1 : first_pending_request;
-      if (m_pending_requests > 0)
+      if (!m_in_flight_submissions.empty())
       {
-        Dout(dc::vulkan, "Considering " << m_pending_requests << " pending requests.");
-        std::vector<vulkan::handle::CommandBuffer> command_buffers(m_pending_requests);
-        container_type::const_iterator pending_request = first_pending_request;
-        uint64_t counter_value = m_semaphore.get_counter_value();
-        int processed = 0;
-        for (;;)
+        // Remove the submits whose signal value was reached, releasing all command buffers of each submit at once.
+        int const processed = m_in_flight_submissions.pop_completed(m_semaphore.get_counter_value(),
+            [this](CommandBuffer const* command_buffers, int count){ m_command_buffer_pool.release(command_buffers, count); });
+        Dout(dc::vulkan, "Processed " << processed << " of " << m_pending_requests << " pending requests.");
+        if (processed > 0)
         {
-          if (counter_value < pending_request->signal_value())
+          // The processed requests are the first `processed` pending requests.
+          container_type::const_iterator pending_request = first_pending_request;
+          vk::DeviceSize finished_load = 0;
+          for (int i = 1;; ++i, ++pending_request)
           {
-            // This one should not be processed anymore. Hence, the previous one -if any- was the last one that was processed.
-            if (processed > 0)
-              --pending_request;        // Must be equal to the last processed request for the call to pop_front_n below.
-            break;
+            finished_load += request_load(*pending_request);
+            if (pending_request->affinity())
+              m_selector->release_affinity(pending_request->affinity());
+            pending_request->finished();
+            // Do not increment pending_request past the last one processed.
+            if (i == processed)
+              break;
           }
-          command_buffers[processed++] = pending_request->command_buffer();
-          pending_request->finished();
-          // Do not increment pending_request past the last one processed.
-          if (processed == m_pending_requests)
-            break;
-          ++pending_request;
-        }
-        Dout(dc::vulkan, "Processed " << processed << " pending requests.");
-        if (processed > 0)
-        {
-          // Release the command buffers of the pending requests that were signaled.
-          m_command_buffer_pool.release(command_buffers.data(), processed);
+          m_load.fetch_sub(finished_load, std::memory_order_relaxed);
           // Erase the pending requests that were just processed.
           pop_front_n(pending_request);         // If this invalidates m_last_submitted
           m_pending_requests -= processed;      // then this will become zero.
         }
       }
-      if (n > 0)
+      // If s_max_in_flight_submissions submits are still in flight then we'll be woken up by the semaphore poll when (the last of) those finished.
+      if (n > 0 && !m_in_flight_submissions.full())
       {
-        // Acquire n command buffers from the command buffer pool.
-        std::vector<vulkan::handle::CommandBuffer> command_buffers(n);
-        // Attempt to acquire n buffers - this might fail.
-        size_t const acquired = m_command_buffer_pool.acquire(command_buffers);
+        // Requests that are uploads (see ImmediateSubmitRequest::set_upload_function) are not recorded into
+        // a command buffer of their own: consecutive uploads are recorded together into one command buffer,
+        // up to s_max_upload_batch_size bytes per batch. Count the number of command buffers that are needed.
+        int needed = 0;
+        {
+          vk::DeviceSize batch_size = s_max_upload_batch_size;        // The size of the current batch, if any.
+          bool in_batch = false;
+          container_type::const_iterator submit_request = first_submit_request;
+          for (int i = 0; i < n; ++i, ++submit_request)
+          {
+            if (!submit_request->is_upload())
+            {
+              ++needed;
+              in_batch = false;
+            }
+            else
+            {
+              if (starts_new_batch(*submit_request, in_batch, batch_size))
+              {
+                ++needed;
+                in_batch = true;
+                batch_size = 0;
+              }
+              batch_size += submit_request->upload_size();
+            }
+          }
+        }
+        // Because this is the only thread/task that uses m_semaphore; it is safe to add 1 to the value
+        // returned by signal_value() and assume that will be the value used by the submit below.
+        uint64_t const signal_value = m_semaphore.signal_value() + 1;
+        // Acquire the needed command buffers from the command buffer pool, directly into the slot of this submit.
+        CommandBuffer* const command_buffers = m_in_flight_submissions.next_command_buffers(signal_value);
+        // Attempt to acquire `needed` buffers - this might fail.
+        size_t const acquired = m_command_buffer_pool.acquire(command_buffers, needed);
         if (AI_LIKELY(acquired > 0))
         {
           // As this task owns the deque and is essentially single threaded, we can
@@ -128,26 +159,75 @@ void ImmediateSubmitQueue::multiplex_impl(state_type run_state)
           // without having the deque locked: producer threads can add new elements
           // in the meantime without invalidating submit_request.
           container_type::const_iterator submit_request = first_submit_request;
-          int count = 0;
+          size_t used = 0;                              // The number of command buffers used so far.
+          int count = 0;                                // The number of requests handled so far.
+          vk::DeviceSize batch_size = 0;
+          bool in_batch = false;
           for (;;)
           {
             Dout(dc::vulkan, "ImmediateSubmitQueue_need_action: received submit_request: " << *submit_request << " [" << this << "]");
 
-            // Record the command buffer.
-            submit_request->record_commands(command_buffers[count]);
-            // Store pending request data. Because this is the only thread/task that uses m_semaphore; it is safe to
-            // add 1 to the value returned by signal_value() and assume that will be the value used by the submit below.
-            submit_request->set_command_buffer_and_signal_value(command_buffers[count], m_semaphore.signal_value() + 1);
-            // Prevent submit_request from being moved past the last recorded command buffer.
-            if (++count == acquired)
+            bool const is_upload = submit_request->is_upload();
+            bool const start_new_batch = is_upload && starts_new_batch(*submit_request, in_batch, batch_size);
+            if (in_batch && (!is_upload || start_new_batch))
+            {
+              // Record the command buffer of the previous batch.
+              m_upload_batch.record(command_buffers[used - 1]);
+              m_upload_batch.clear();
+              in_batch = false;
+            }
+            if (!is_upload || start_new_batch)
+            {
+              // This request needs a command buffer of its own; stop if there are none left.
+              if (used == acquired)
+                break;
+              ++used;
+            }
+            if (is_upload)
+            {
+              // Add the upload to the current batch. Only the first request of a batch is associated with the command buffer.
+              submit_request->add_upload(m_upload_batch);
+              submit_request->set_command_buffer_and_signal_value(start_new_batch ? command_buffers[used - 1] : vulkan::handle::CommandBuffer{},
+                  *m_semaphore.vh_semaphore_ptr(), signal_value);
+              if (start_new_batch)
+              {
+                in_batch = true;
+                batch_size = 0;
+              }
+              batch_size += submit_request->upload_size();
+            }
+            else
+            {
+              // Record the command buffer.
+              submit_request->record_commands(command_buffers[used - 1]);
+              // Store pending request data.
+              submit_request->set_command_buffer_and_signal_value(command_buffers[used - 1], *m_semaphore.vh_semaphore_ptr(), signal_value);
+            }
+            // Prevent submit_request from being moved past the last handled request.
+            if (++count == n)
               break;
             ++submit_request;
           }
+          if (in_batch)
+          {
+            m_upload_batch.record(command_buffers[used - 1]);
+            m_upload_batch.clear();
+          }
+          // If we stopped because we ran out of command buffers then submit_request points to the first request that was not handled.
+          if (count < n)
+            --submit_request;
+          // Every acquired command buffer was used: we only stop early when we run out of them.
+          ASSERT(used == acquired);
+          Dout(dc::vulkan, "Recorded " << count << " requests into " << used << " command buffers.");
           m_last_submitted = submit_request;
-          m_pending_requests += acquired;
+          m_pending_requests += count;
+          m_in_flight_submissions.push(signal_value, count, used);
 
           // Submit recorded commands.
-          m_queue.submit(command_buffers.data()->get_array(), acquired, m_semaphore);
+          // Uploads to resources that are released by another queue (family) first wait for that release.
+          m_queue.submit(command_buffers->get_array(), acquired, m_semaphore,
+              m_upload_batch.wait_semaphores(), m_upload_batch.wait_values(), m_upload_batch.wait_dst_stage_masks());
+          m_upload_batch.clear_waits();
 
           // Wake me up when you're done.
           m_semaphore.add_poll(this, need_action);
@@ -157,8 +237,8 @@ void ImmediateSubmitQueue::multiplex_impl(state_type run_state)
         // "do something" (action needs to be taken) it will work: this just assures this task will run again once more CAN be done.
         // It will also still run again when more submit requests are added; that then can result in multiple calls to the below 'subscribe'
         // function - so that must be able to deal with that.
-        if (acquired < n)
-          m_command_buffer_pool.subscribe(n - acquired, this, need_action);
+        if (acquired < static_cast<size_t>(needed))
+          m_command_buffer_pool.subscribe(needed - acquired, this, need_action);
       }
       if (producer_not_finished())
         break;
@@ -171,12 +251,47 @@ void ImmediateSubmitQueue::multiplex_impl(state_type run_state)
   }
 }
 
+bool ImmediateSubmitQueue::starts_new_batch(vulkan::ImmediateSubmitRequest const& upload_request, bool in_batch, vk::DeviceSize batch_size)
+{
+  // The copies of a batch are executed between a single pre-transfer barrier and a single post-transfer barrier,
+  // and those to the same destination are merged into one copy command. Therefore two uploads to the same
+  // destination, which have the same affinity (see CopyDataToGPU::set_destination), are never put in the same
+  // batch: their regions might overlap, and the later upload must also be executed after the earlier one.
+  uint64_t const destination = upload_request.affinity();
+  bool const new_batch = !in_batch || batch_size + upload_request.upload_size() > s_max_upload_batch_size ||
+    (destination && std::find(m_batch_destinations.begin(), m_batch_destinations.end(), destination) != m_batch_destinations.end());
+  if (new_batch)
+    m_batch_destinations.clear();
+  if (destination)
+    m_batch_destinations.push_back(destination);
+  return new_batch;
+}
+
 void ImmediateSubmitQueue::abort_impl()
 {
   m_semaphore.remove_poll();
-  flush_new_data([](vulkan::ImmediateSubmitRequest&& submit_request){
-    submit_request.abort();
+  // The first m_pending_requests requests in the deque were already submitted. The GPU might still be
+  // reading their staging memory, so wait for the last submit before those regions are released.
+  bool gpu_finished = true;
+  if (m_pending_requests > 0 && !m_semaphore.wait_for(m_semaphore.signal_value(), s_abort_timeout_ns))
+    gpu_finished = false;
+  int submitted = m_pending_requests;
+  vk::DeviceSize aborted_load = 0;
+  flush_new_data([this, &submitted, &aborted_load, gpu_finished](vulkan::ImmediateSubmitRequest&& submit_request){
+    // Like finished requests, aborted requests no longer keep their affinity to this task.
+    aborted_load += request_load(submit_request);
+    if (submit_request.affinity())
+      m_selector->release_affinity(submit_request.affinity());
+    if (submitted > 0)
+    {
+      --submitted;
+      submit_request.abort_submitted(gpu_finished);
+    }
+    else
+      submit_request.abort();
   });
+  m_load.fetch_sub(aborted_load, std::memory_order_relaxed);
+  m_pending_requests = 0;
 }
 
 void ImmediateSubmitQueue::terminate()
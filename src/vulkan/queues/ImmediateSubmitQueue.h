@@ -3,24 +3,46 @@
 #include "Application.h"
 #include "CommandBufferFactory.h"
 #include "ImmediateSubmitRequest.h"
+#include "InFlightSubmissions.h"
+#include "UploadBatch.h"
+#include "QueueSelector.h"
 #include "PersistentAsyncTask.h"
 #include "TimelineSemaphore.h"
 #include "vk_utils/TaskToTaskDeque.h"
 #include "statefultask/DefaultMemoryPagePool.h"
+#include <atomic>
+#include <vector>
 
 namespace task {
 
 class ImmediateSubmitQueue final : public vk_utils::TaskToTaskDeque<vulkan::PersistentAsyncTask, vulkan::ImmediateSubmitRequest>
 {
+ public:
+  // The maximum number of bytes that consecutive uploads copy before a new command buffer is used.
+  static constexpr vk::DeviceSize s_max_upload_batch_size = 16 * 1024 * 1024;
+  // The maximum number of new requests that are handled per submit.
+  static constexpr int s_max_requests_per_submit = 64;
+  // The maximum number of submits that can be in flight at the same time (must be a power of two).
+  static constexpr int s_max_in_flight_submissions = 8;
+  // The load of a request, on top of the number of bytes that it uploads: the equivalent of the cost of recording and submitting it.
+  static constexpr vk::DeviceSize s_request_load = 64 * 1024;
+  // The maximum time that abort_impl waits for submits that are still in flight.
+  static constexpr uint64_t s_abort_timeout_ns = 1000000000;
+
  private:
   using CommandBuffer = vulkan::CommandBufferFactory::resource_type;    // vulkan::handle::CommandBuffer
   utils::DequeAllocator<CommandBuffer> m_deque_allocator{vulkan::Application::instance().deque512_nmr()};
   statefultask::ResourcePool<vulkan::CommandBufferFactory> m_command_buffer_pool;
   vulkan::Queue m_queue;                                                // Queue that is owned by this task.
   vulkan::TimelineSemaphore m_semaphore;                                // Timeline semaphore used for submitting to m_queue.
-  int m_pending_requests{};                                             // The number of command buffers that were submitted but were not signaled yet.
+  int m_pending_requests{};                                             // The number of requests that were submitted but were not signaled yet.
   container_type::const_iterator m_last_submitted;                      // Pointer to the last ImmediateSubmitRequest associated with the pending requests.
                                                                         // Only valid if m_pending_requests > 0.
+  vulkan::InFlightSubmissions<CommandBuffer, s_max_requests_per_submit, s_max_in_flight_submissions> m_in_flight_submissions;
+  vulkan::UploadBatch m_upload_batch;                                   // Reused for every batch of uploads.
+  std::vector<uint64_t> m_batch_destinations;                           // The affinities (destinations) of the uploads in the current batch (see starts_new_batch).
+  std::atomic<vk::DeviceSize> m_load{0};                                // The sum of request_load() of all requests that were passed to this task but did not finish yet.
+  vulkan::QueueSelector* m_selector;                                    // The selector of the QueuePool that owns this task; released the affinity of finished requests.
 
   // The different states of the task.
   enum ImmediateSubmitQueue_state_type {
@@ -39,15 +61,30 @@ class ImmediateSubmitQueue final : public vk_utils::TaskToTaskDeque<vulkan::Pers
   void multiplex_impl(state_type run_state) override;
   void abort_impl() override;
 
+ private:
+  // Return true if upload_request can not be added to the current batch, if any, of batch_size bytes.
+  // Also updates m_batch_destinations to include upload_request.
+  bool starts_new_batch(vulkan::ImmediateSubmitRequest const& upload_request, bool in_batch, vk::DeviceSize batch_size);
+
  public:
   ImmediateSubmitQueue(
     // Arguments for m_command_buffer_pool.
     vulkan::LogicalDevice const* logical_device,
-    vulkan::Queue const& queue
+    vulkan::Queue const& queue,
+    vulkan::QueueSelector* selector
     COMMA_CWDEBUG_ONLY(bool debug = false));
 
   void wait_for(uint64_t signal_value) { m_semaphore.wait_for(signal_value); }
 
+  // The load that submit_request adds to the queue until it finished.
+  static vk::DeviceSize request_load(vulkan::ImmediateSubmitRequest const& submit_request) { return s_request_load + submit_request.upload_size(); }
+
+  // Called (by ImmediateSubmit_start) right before passing submit_request to have_new_datum.
+  void add_load(vulkan::ImmediateSubmitRequest const& submit_request) { m_load.fetch_add(request_load(submit_request), std::memory_order_relaxed); }
+
+  // Return the amount of outstanding work (see QueuePool::get_immediate_submit_queue_task).
+  vk::DeviceSize load() const { return m_load.load(std::memory_order_relaxed); }
+
   void terminate();
 };
 
@@ -6,11 +6,35 @@ namespace vulkan {
 
 void ImmediateSubmitRequest::finished() const
 {
+  // The timeline semaphore passed m_signal_value: the GPU is done reading the staging memory.
+  if (m_staging_region)
+    m_logical_device->staging_ring().release(m_staging_region);
+  m_immediate_submit->set_finished_semaphore_value(m_vh_semaphore, m_signal_value);
   m_immediate_submit->signal(task::ImmediateSubmit::submit_finished);
 }
 
 void ImmediateSubmitRequest::abort()
 {
+  // This request was never submitted.
+  if (m_staging_region)
+  {
+    m_logical_device->staging_ring().release(m_staging_region);
+    m_staging_region = {};
+  }
+  m_immediate_submit->abort();
+}
+
+void ImmediateSubmitRequest::abort_submitted(bool gpu_finished)
+{
+  if (m_staging_region)
+  {
+    // Don't hand the region back to the ring (where another queue could reuse it straight away) while the GPU might still be reading it.
+    if (gpu_finished)
+      m_logical_device->staging_ring().release(m_staging_region);
+    else
+      Dout(dc::warning, "Leaking staging ring region " << m_staging_region << " of an aborted upload that didn't finish.");
+    m_staging_region = {};
+  }
   m_immediate_submit->abort();
 }
 
@@ -19,7 +43,11 @@ void ImmediateSubmitRequest::print_on(std::ostream& os) const
 {
   os << "{m_logical_device:" << m_logical_device <<
     ", m_queue_request_key:" << m_queue_request_key <<
-    ", m_record_function:" << (m_record_function ? "<set>" : "nullptr") << '}';
+    ", m_record_function:" << (m_record_function ? "<set>" : "nullptr") <<
+    ", m_upload_function:" << (m_upload_function ? "<set>" : "nullptr") <<
+    ", m_upload_size:" << m_upload_size <<
+    ", m_affinity:" << m_affinity <<
+    ", m_staging_region:" << m_staging_region << '}';
 }
 #endif
 
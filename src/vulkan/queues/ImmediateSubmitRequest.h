@@ -3,6 +3,8 @@
 #include "LogicalDevice.h"
 #include "CommandBuffer.h"
 #include "QueueRequestKey.h"
+#include "UploadBatch.h"
+#include "memory/StagingRing.h"
 #include <functional>
 
 namespace task {
@@ -17,6 +19,7 @@ class ImmediateSubmitRequest
  public:
   static constexpr vk::CommandPoolCreateFlags::MaskType pool_type = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
   using record_function_type = std::function<void(handle::CommandBuffer)>;
+  using upload_function_type = std::function<void(UploadBatch&)>;
 
  private:
   // Filled by set_* functions before running the task.
@@ -24,9 +27,14 @@ class ImmediateSubmitRequest
   task::ImmediateSubmit* m_immediate_submit;            // The ImmediateSubmit task that issued this request.
   QueueRequestKey m_queue_request_key;                  // Key that uniquely maps to a queue (request/reply) to use.
   record_function_type m_record_function;               // Callback function that will record the command buffer.
+  upload_function_type m_upload_function;               // Alternatively, callback function that adds an upload to a batch of uploads.
+  vk::DeviceSize m_upload_size{};                       // The number of bytes copied by m_upload_function.
+  uint64_t m_affinity{};                                // Requests with the same (non-zero) affinity are passed to the same ImmediateSubmitQueue.
+  memory::StagingRingRegion m_staging_region;           // The region of the staging ring that m_upload_function copies from, if any. Released by finished(), abort() or abort_submitted().
   // Filled in after submitting.
   mutable handle::CommandBuffer m_command_buffer{};     // Acquired command buffer that was recorded into (if any).
   mutable uint64_t m_signal_value;                      // Signal value used with the timeline semaphore when this command buffer was submitted.
+  mutable vk::Semaphore m_vh_semaphore;                 // That timeline semaphore.
 
  public:
   ImmediateSubmitRequest() = default;
@@ -40,6 +48,11 @@ class ImmediateSubmitRequest
     m_logical_device = orig.m_logical_device;
     m_queue_request_key = orig.m_queue_request_key;
     m_record_function = std::move(orig.m_record_function);
+    m_upload_function = std::move(orig.m_upload_function);
+    m_upload_size = orig.m_upload_size;
+    m_affinity = orig.m_affinity;
+    m_staging_region = orig.m_staging_region;
+    orig.m_staging_region = {};
     return *this;
   }
 
@@ -47,8 +60,26 @@ class ImmediateSubmitRequest
   void set_logical_device(vulkan::LogicalDevice const* logical_device) { m_logical_device = logical_device; }
   void set_queue_request_key(vulkan::QueueRequestKey queue_request_key) { m_queue_request_key = queue_request_key; }
   void set_record_function(record_function_type&& record_function) { m_record_function = std::move(record_function); }
+  // Use instead of set_record_function for requests that only copy upload_size bytes from a staging buffer.
+  // The ImmediateSubmitQueue records those together with other uploads into a single command buffer.
+  void set_upload_function(upload_function_type&& upload_function, vk::DeviceSize upload_size)
+  {
+    m_upload_function = std::move(upload_function);
+    m_upload_size = upload_size;
+  }
+  // Pass ownership of the staging ring region that the upload function copies from to this request.
+  // It is released as soon as the GPU can no longer read from it: when the submit finished, or when the request is aborted before it was submitted.
+  void set_staging_region(memory::StagingRingRegion const& staging_region) { m_staging_region = staging_region; }
+  // Keep this request ordered with respect to other requests with the same affinity (for example, uploads to the same resource),
+  // by submitting all of them to the same queue. By default (zero) a request is submitted to the least loaded queue.
+  void set_affinity(uint64_t affinity) { m_affinity = affinity; }
   // Called by ImmediateSubmitQueue_need_action.
-  void set_command_buffer_and_signal_value(handle::CommandBuffer command_buffer, uint64_t signal_value) const { m_command_buffer = command_buffer; m_signal_value = signal_value; }
+  void set_command_buffer_and_signal_value(handle::CommandBuffer command_buffer, vk::Semaphore vh_semaphore, uint64_t signal_value) const
+  {
+    m_command_buffer = command_buffer;
+    m_vh_semaphore = vh_semaphore;
+    m_signal_value = signal_value;
+  }
 
   vulkan::LogicalDevice const* logical_device() const
   {
@@ -65,6 +96,29 @@ class ImmediateSubmitRequest
     m_record_function(command_buffer);
   }
 
+  bool is_upload() const
+  {
+    return static_cast<bool>(m_upload_function);
+  }
+
+  vk::DeviceSize upload_size() const
+  {
+    return m_upload_size;
+  }
+
+  uint64_t affinity() const
+  {
+    return m_affinity;
+  }
+
+  void add_upload(UploadBatch& upload_batch) const
+  {
+    m_upload_function(upload_batch);
+    upload_batch.upload_added();
+  }
+
+  // Returns the command buffer that was recorded into, or a null handle if this upload was
+  // added to the command buffer of an earlier request of the same batch.
   handle::CommandBuffer command_buffer() const
   {
     return m_command_buffer;
@@ -75,8 +129,17 @@ class ImmediateSubmitRequest
     return m_signal_value;
   }
 
+  vk::Semaphore vh_semaphore() const
+  {
+    return m_vh_semaphore;
+  }
+
   void finished() const;
+  // Abort a request that was never submitted.
   void abort();
+  // Abort a request that was already submitted. Pass true for gpu_finished if the timeline semaphore reached signal_value(),
+  // otherwise the GPU might still read from the staging region and it is leaked.
+  void abort_submitted(bool gpu_finished);
 
 #ifdef CWDEBUG
   void print_on(std::ostream& os) const;
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include "debug.h"
+
+namespace vulkan {
+
+// A ring of submissions that were submitted to a queue, but whose timeline semaphore value was not reached yet.
+//
+// Used by ImmediateSubmitQueue. Each submit signals the next value of the timeline semaphore of that task,
+// so the signal values of consecutive submissions are consecutive integers: the slot of a submission is
+// its signal value modulo capacity. Each slot stores the (at most max_command_buffers) command buffers of
+// that submission and the number of requests that were recorded into them.
+//
+// The command buffers are acquired directly into the slot of the next submission (see next_command_buffers),
+// and a completed submission releases all its command buffers at once, so that no heap allocations
+// are necessary, and completion is O(completed submissions) (not O(pending requests)).
+//
+// This class is not thread-safe (it is only accessed by the ImmediateSubmitQueue task).
+template<typename CommandBuffer, int max_command_buffers, int capacity>
+class InFlightSubmissions
+{
+  static_assert((capacity & (capacity - 1)) == 0, "capacity must be a power of two.");
+
+ private:
+  struct Submission
+  {
+    int m_number_of_requests;                                           // The number of requests that were recorded into m_command_buffers.
+    int m_number_of_command_buffers;                                    // The number of command buffers used.
+    std::array<CommandBuffer, max_command_buffers> m_command_buffers;   // The command buffers that were submitted.
+  };
+
+  std::array<Submission, capacity> m_ring;
+  uint64_t m_first_signal_value{};                                      // The signal value of the oldest submission in m_ring (only valid if m_size > 0).
+  int m_size{};                                                         // The number of submissions in m_ring.
+
+  Submission& slot(uint64_t signal_value) { return m_ring[signal_value & (capacity - 1)]; }
+
+ public:
+  bool empty() const { return m_size == 0; }
+  bool full() const { return m_size == capacity; }
+
+  // Return a pointer to max_command_buffers command buffers that may be used by the submission with signal value signal_value,
+  // which must be the signal value of the next call to push. Only call this when not full().
+  CommandBuffer* next_command_buffers(uint64_t signal_value)
+  {
+    // There is no room for another submission.
+    ASSERT(!full());
+    // Signal values of consecutive submissions must be consecutive.
+    ASSERT(m_size == 0 || signal_value == m_first_signal_value + m_size);
+    return slot(signal_value).m_command_buffers.data();
+  }
+
+  // Add a submission that uses the first number_of_command_buffers command buffers returned by next_command_buffers(signal_value).
+  void push(uint64_t signal_value, int number_of_requests, int number_of_command_buffers)
+  {
+    ASSERT(!full() && (m_size == 0 || signal_value == m_first_signal_value + m_size));
+    ASSERT(0 < number_of_command_buffers && number_of_command_buffers <= max_command_buffers);
+    Submission& submission = slot(signal_value);
+    submission.m_number_of_requests = number_of_requests;
+    submission.m_number_of_command_buffers = number_of_command_buffers;
+    if (m_size++ == 0)
+      m_first_signal_value = signal_value;
+  }
+
+  // Remove all submissions whose signal value is less than or equal to counter_value, the current value of the timeline semaphore.
+  // Calls release(CommandBuffer const* command_buffers, int count) once per removed submission.
+  // Returns the total number of requests of the removed submissions; those are the oldest pending requests.
+  template<typename RELEASE>
+  int pop_completed(uint64_t counter_value, RELEASE&& release)
+  {
+    int number_of_requests = 0;
+    while (m_size > 0 && m_first_signal_value <= counter_value)
+    {
+      Submission& submission = slot(m_first_signal_value);
+      release(submission.m_command_buffers.data(), submission.m_number_of_command_buffers);
+      number_of_requests += submission.m_number_of_requests;
+      ++m_first_signal_value;
+      --m_size;
+    }
+    return number_of_requests;
+  }
+};
+
+} // namespace vulkan
@@ -19,9 +19,14 @@ void Queue::print_on(std::ostream& os) const
 }
 #endif
 
-void Queue::submit(vk::CommandBuffer const* vh_command_buffer_ptrs, uint32_t count, TimelineSemaphore& timeline_semaphore)
+void Queue::submit(vk::CommandBuffer const* vh_command_buffer_ptrs, uint32_t count, TimelineSemaphore& timeline_semaphore,
+    std::vector<vk::Semaphore> const& vh_wait_semaphores, std::vector<uint64_t> const& wait_values,
+    std::vector<vk::PipelineStageFlags> const& wait_dst_stage_masks)
 {
+  ASSERT(wait_values.size() == vh_wait_semaphores.size() && wait_dst_stage_masks.size() == vh_wait_semaphores.size());
   vk::TimelineSemaphoreSubmitInfo timeline_semaphore_info{
+    .waitSemaphoreValueCount = static_cast<uint32_t>(wait_values.size()),
+    .pWaitSemaphoreValues = wait_values.data(),
     .signalSemaphoreValueCount = 1,
     .pSignalSemaphoreValues = timeline_semaphore.get_next_value_ptr()   // Returns a reference; is not thread-safe.
                                                                         // No other thread may call get_next_value() until after submit() below returned.
@@ -29,9 +34,9 @@ void Queue::submit(vk::CommandBuffer const* vh_command_buffer_ptrs, uint32_t cou
 
   vk::SubmitInfo submit_info{
     .pNext = &timeline_semaphore_info,
-    .waitSemaphoreCount = 0,
-    .pWaitSemaphores = nullptr,
-    .pWaitDstStageMask = nullptr,
+    .waitSemaphoreCount = static_cast<uint32_t>(vh_wait_semaphores.size()),
+    .pWaitSemaphores = vh_wait_semaphores.data(),
+    .pWaitDstStageMask = wait_dst_stage_masks.data(),
     .commandBufferCount = count,
     .pCommandBuffers = vh_command_buffer_ptrs,
     .signalSemaphoreCount = 1,
@@ -2,6 +2,7 @@
 
 #include "QueueFamilyProperties.h"
 #include <vulkan/vulkan.hpp>
+#include <vector>
 
 namespace vulkan {
 
@@ -25,7 +26,11 @@ class Queue
   QueueFamilyPropertiesIndex queue_family() const { return m_queue_family; }
   operator bool() const { return !m_queue_family.undefined(); }
 
-  void submit(vk::CommandBuffer const* vh_command_buffer_ptrs, uint32_t count, TimelineSemaphore& timeline_semaphore);
+  // Submit count command buffers that signal the next value of timeline_semaphore when they finished,
+  // after waiting for each of the (timeline) vh_wait_semaphores to reach the corresponding wait_values.
+  void submit(vk::CommandBuffer const* vh_command_buffer_ptrs, uint32_t count, TimelineSemaphore& timeline_semaphore,
+      std::vector<vk::Semaphore> const& vh_wait_semaphores = {}, std::vector<uint64_t> const& wait_values = {},
+      std::vector<vk::PipelineStageFlags> const& wait_dst_stage_masks = {});
 
 #ifdef CWDEBUG
   void print_on(std::ostream& os) const;
@@ -0,0 +1,57 @@
+#include "sys.h"
+#include "QueueFamilyOwnershipAcquires.h"
+#include <algorithm>
+#include "debug.h"
+
+namespace vulkan {
+
+void QueueFamilyOwnershipAcquires::add_wait(vk::Semaphore vh_semaphore, uint64_t signal_value)
+{
+  // Normally all uploads are done by the same few queues; wait only once per semaphore, for the largest value.
+  auto iter = std::find(m_vh_wait_semaphores.begin(), m_vh_wait_semaphores.end(), vh_semaphore);
+  if (iter == m_vh_wait_semaphores.end())
+  {
+    m_vh_wait_semaphores.push_back(vh_semaphore);
+    m_wait_values.push_back(signal_value);
+  }
+  else
+  {
+    uint64_t& wait_value = m_wait_values[iter - m_vh_wait_semaphores.begin()];
+    wait_value = std::max(wait_value, signal_value);
+  }
+}
+
+void QueueFamilyOwnershipAcquires::add(vk::Semaphore vh_semaphore, uint64_t signal_value, vk::PipelineStageFlags consuming_stages, vk::BufferMemoryBarrier const& barrier)
+{
+  add_wait(vh_semaphore, signal_value);
+  m_consuming_stages |= consuming_stages;
+  m_buffer_barriers.push_back(barrier);
+}
+
+void QueueFamilyOwnershipAcquires::add(vk::Semaphore vh_semaphore, uint64_t signal_value, vk::PipelineStageFlags consuming_stages, vk::ImageMemoryBarrier const& barrier)
+{
+  add_wait(vh_semaphore, signal_value);
+  m_consuming_stages |= consuming_stages;
+  m_image_barriers.push_back(barrier);
+}
+
+void QueueFamilyOwnershipAcquires::record(handle::CommandBuffer command_buffer) const
+{
+  DoutEntering(dc::vulkan, "QueueFamilyOwnershipAcquires::record(" << command_buffer << ")");
+
+  command_buffer->begin({ .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit });
+  // The semaphore waits use m_consuming_stages as pWaitDstStageMask; start the barrier at the same stages to form a dependency chain.
+  command_buffer->pipelineBarrier(m_consuming_stages, m_consuming_stages, vk::DependencyFlags(0), {}, m_buffer_barriers, m_image_barriers);
+  command_buffer->end();
+}
+
+void QueueFamilyOwnershipAcquires::clear()
+{
+  m_consuming_stages = {};
+  m_buffer_barriers.clear();
+  m_image_barriers.clear();
+  m_vh_wait_semaphores.clear();
+  m_wait_values.clear();
+}
+
+} // namespace vulkan
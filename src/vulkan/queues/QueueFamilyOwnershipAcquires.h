@@ -0,0 +1,47 @@
+#pragma once
+
+#include "CommandBuffer.h"
+#include <vulkan/vulkan.hpp>
+#include <utility>
+#include <vector>
+#include "debug.h"
+
+namespace vulkan {
+
+// The acquire halves of queue family ownership transfers of resources that were uploaded by
+// a queue of another queue family (see task::CopyDataToGPU), for a queue that consumes them.
+//
+// The release halves are recorded by the uploading queue, which signals a timeline semaphore
+// when it is done. The consuming queue must wait for that semaphore value (wait_semaphores)
+// before executing the acquire barriers (record).
+class QueueFamilyOwnershipAcquires
+{
+ private:
+  vk::PipelineStageFlags m_consuming_stages;                            // The union of the stages of all acquire barriers.
+  std::vector<vk::BufferMemoryBarrier> m_buffer_barriers;
+  std::vector<vk::ImageMemoryBarrier> m_image_barriers;
+  std::vector<vk::Semaphore> m_vh_wait_semaphores;                      // The timeline semaphores of the queues that released the resources.
+  std::vector<uint64_t> m_wait_values;                                  // The signal value to wait for, per semaphore in m_vh_wait_semaphores.
+
+  void add_wait(vk::Semaphore vh_semaphore, uint64_t signal_value);
+
+ public:
+  // Add an acquire barrier that must be executed after vh_semaphore reached signal_value.
+  void add(vk::Semaphore vh_semaphore, uint64_t signal_value, vk::PipelineStageFlags consuming_stages, vk::BufferMemoryBarrier const& barrier);
+  void add(vk::Semaphore vh_semaphore, uint64_t signal_value, vk::PipelineStageFlags consuming_stages, vk::ImageMemoryBarrier const& barrier);
+
+  // Record all acquire barriers into command_buffer (including begin and end).
+  void record(handle::CommandBuffer command_buffer) const;
+
+  // Remove everything.
+  void clear();
+
+  bool empty() const { return m_vh_wait_semaphores.empty(); }
+
+  // Accessors.
+  vk::PipelineStageFlags consuming_stages() const { return m_consuming_stages; }
+  std::vector<vk::Semaphore> const& wait_semaphores() const { return m_vh_wait_semaphores; }
+  std::vector<uint64_t> const& wait_values() const { return m_wait_values; }
+};
+
+} // namespace vulkan
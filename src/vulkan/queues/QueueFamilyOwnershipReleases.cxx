@@ -0,0 +1,40 @@
+#include "sys.h"
+#include "QueueFamilyOwnershipReleases.h"
+#include "debug.h"
+
+namespace vulkan {
+
+uint64_t QueueFamilyOwnershipReleases::add(vk::PipelineStageFlags generating_stages, vk::BufferMemoryBarrier const& barrier)
+{
+  m_generating_stages |= generating_stages;
+  m_buffer_barriers.push_back(barrier);
+  return m_signal_value;
+}
+
+uint64_t QueueFamilyOwnershipReleases::add(vk::PipelineStageFlags generating_stages, vk::ImageMemoryBarrier const& barrier)
+{
+  m_generating_stages |= generating_stages;
+  m_image_barriers.push_back(barrier);
+  return m_signal_value;
+}
+
+void QueueFamilyOwnershipReleases::record(handle::CommandBuffer command_buffer) const
+{
+  DoutEntering(dc::vulkan, "QueueFamilyOwnershipReleases::record(" << command_buffer << ")");
+
+  command_buffer->begin({ .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit });
+  // The semaphore signal operation of the submit waits for all stages, so nothing has to be made available to later stages here.
+  command_buffer->pipelineBarrier(m_generating_stages, vk::PipelineStageFlagBits::eBottomOfPipe, vk::DependencyFlags(0), {}, m_buffer_barriers, m_image_barriers);
+  command_buffer->end();
+}
+
+void QueueFamilyOwnershipReleases::clear()
+{
+  m_generating_stages = {};
+  m_buffer_barriers.clear();
+  m_image_barriers.clear();
+  // The next barriers are executed by a later submit.
+  ++m_signal_value;
+}
+
+} // namespace vulkan
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "CommandBuffer.h"
+#include <vulkan/vulkan.hpp>
+#include <vector>
+#include "debug.h"
+
+namespace vulkan {
+
+// The release halves of queue family ownership transfers of resources that are in use by a queue,
+// and that are about to be overwritten by a queue of another queue family (see task::CopyDataToGPU).
+//
+// The release barriers are recorded (record) after the last command buffer of the next submit of the
+// releasing queue, which then also signals a timeline semaphore with signal_value(). The uploading
+// queue must wait for that value before executing the acquire halves and the copies.
+class QueueFamilyOwnershipReleases
+{
+ private:
+  vk::PipelineStageFlags m_generating_stages;                           // The union of the stages of all release barriers.
+  std::vector<vk::BufferMemoryBarrier> m_buffer_barriers;
+  std::vector<vk::ImageMemoryBarrier> m_image_barriers;
+  uint64_t m_signal_value{1};                                           // The value that the submit that executes the current barriers signals.
+
+ public:
+  // Add a release barrier that must be executed after all previous use (in generating_stages) of the resource.
+  // Returns the value that the timeline semaphore of the releasing queue is signaled with once the barrier was executed.
+  uint64_t add(vk::PipelineStageFlags generating_stages, vk::BufferMemoryBarrier const& barrier);
+  uint64_t add(vk::PipelineStageFlags generating_stages, vk::ImageMemoryBarrier const& barrier);
+
+  // Record all release barriers into command_buffer (including begin and end).
+  void record(handle::CommandBuffer command_buffer) const;
+
+  // Remove everything; call after submitting the barriers (or abandoning them) with a signal of signal_value().
+  void clear();
+
+  bool empty() const { return m_buffer_barriers.empty() && m_image_barriers.empty(); }
+
+  // Accessor.
+  uint64_t signal_value() const { return m_signal_value; }
+};
+
+} // namespace vulkan
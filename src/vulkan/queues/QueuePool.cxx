@@ -67,15 +67,29 @@ void QueuePool::clean_up()
 #endif
 }
 
-task::ImmediateSubmitQueue* QueuePool::get_immediate_submit_queue_task(CWDEBUG_ONLY(bool debug))
+task::ImmediateSubmitQueue* QueuePool::get_immediate_submit_queue_task(uint64_t affinity COMMA_CWDEBUG_ONLY(bool debug))
+{
+  // Use the same task as the requests with this affinity that didn't finish yet, if any.
+  // The ImmediateSubmitQueue task calls m_selector.release_affinity when the request finished.
+  int const index = affinity ?
+      m_selector.acquire_affinity_task(affinity, [&](){ return select_task(CWDEBUG_ONLY(debug)); }) :
+      select_task(CWDEBUG_ONLY(debug));
+
+  // Obtain read lock on m_tasks.
+  tasks_type::rat tasks_r(m_tasks);
+  return tasks_r->tasks[index].get();
+}
+
+int QueuePool::select_task(CWDEBUG_ONLY(bool debug))
 {
   // The fast-path assumes we already acquired all queues - of course.
   if (AI_LIKELY(m_no_more_queues.load(std::memory_order::relaxed)))
   {
     // Obtain read lock on m_tasks.
     tasks_type::rat tasks_r(m_tasks);
-    // For now just rotate over all tasks.
-    return tasks_r->tasks[++m_next_task % tasks_r->tasks.size()].get();
+    auto const& tasks = tasks_r->tasks;
+    // Find the task with the least outstanding work.
+    return m_selector.least_loaded(tasks.size(), [&](int index){ return tasks[index]->load(); });
   }
 
   // For now just get a new queue, regardless of whether or not already running tasks are busy or not.
@@ -98,23 +112,19 @@ task::ImmediateSubmitQueue* QueuePool::get_immediate_submit_queue_task(CWDEBUG_O
   catch (vulkan::OutOfQueues_Exception const& error)
   {
     m_no_more_queues.store(true, std::memory_order::relaxed);
-    return get_immediate_submit_queue_task(CWDEBUG_ONLY(debug));
+    return select_task(CWDEBUG_ONLY(debug));
   }
-  auto immediate_submit_queue_task = statefultask::create<task::ImmediateSubmitQueue>(m_logical_device, queue COMMA_CWDEBUG_ONLY(debug));
+  auto immediate_submit_queue_task = statefultask::create<task::ImmediateSubmitQueue>(m_logical_device, queue, &m_selector COMMA_CWDEBUG_ONLY(debug));
   immediate_submit_queue_task->run(vulkan::Application::instance().medium_priority_queue());
 
-  // Keep a copy of the task pointer.
-  task::ImmediateSubmitQueue* new_task = immediate_submit_queue_task.get();
-
   // Add the new task to the vector with tasks.
   {
     // Obtain write lock on m_tasks.
     tasks_type::wat tasks_w(m_tasks);
     // Append the new task.
     tasks_w->tasks.emplace_back(std::move(immediate_submit_queue_task));
+    return tasks_w->tasks.size() - 1;
   }
-
-  return new_task;
 }
 
 QueuePool::~QueuePool()
@@ -1,11 +1,14 @@
 #pragma once
 
 #include "QueueRequestKey.h"
+#include "QueueSelector.h"
 #include "ImmediateSubmitQueue.h"
 #include "utils/UltraHash.h"
 #include "threadsafe/aithreadsafe.h"
 #include "threadsafe/AIReadWriteSpinLock.h"
 #include <boost/intrusive_ptr.hpp>
+#include <array>
+#include <atomic>
 #include <vector>
 #include "debug.h"
 
@@ -36,6 +39,7 @@ struct QueuePoolTasks
 
 class QueuePool
 {
+ private:
   // The type of the global s_map that maps keys to instances.
   using map_type = aithreadsafe::Wrapper<QueuePoolMap, aithreadsafe::policy::ReadWrite<AIReadWriteSpinLock>>;
   // The type of m_tasks.
@@ -52,14 +56,17 @@ class QueuePool
   LogicalDevice const* m_logical_device;        // The corresponding logical device.
   uint64_t const m_key_as_uint64;               // The key that uniquely identifies this pool.
   std::atomic<bool> m_no_more_queues;           // Set when all available queues have been acquired. Once set we'll return the least busy task from m_tasks.
-  std::atomic<int> m_next_task;                 // Rotates over the existing tasks. FIXME: we should use the task with an empty queue first and/or the smallest queue.
   tasks_type m_tasks;                           // A list with running task::ImmediateSubmitQueue pointers.
   std::mutex m_acquiring_queue;                 // Used in get_immediate_submit_queue_task.
+  QueueSelector m_selector;                     // Selects one of m_tasks, by index, once all queues are acquired.
 
  private:
   // Add key by reinitializing the UltraHash and lookup_table.
   static QueuePool& insert_key(map_type::rat& map_r, ImmediateSubmitRequest const& submit_request);
 
+  // Return the index into m_tasks of the least loaded task, or of a newly created task if there are still queues available.
+  int select_task(CWDEBUG_ONLY(bool debug));
+
   [[gnu::always_inline]] static QueuePool* instance(map_type::rat const& map_r, uint64_t key_as_uint64)
   {
     // Convert the key into a lookup table index and grab the QueuePool* from it.
@@ -72,7 +79,7 @@ class QueuePool
   }
 
  public:
-  QueuePool(LogicalDevice const* logical_device, uint64_t key_as_uint64) : m_logical_device(logical_device), m_key_as_uint64(key_as_uint64), m_no_more_queues(false), m_next_task(0)
+  QueuePool(LogicalDevice const* logical_device, uint64_t key_as_uint64) : m_logical_device(logical_device), m_key_as_uint64(key_as_uint64), m_no_more_queues(false)
   {
     DoutEntering(dc::vulkan, "QueuePool::QueuePool(" << logical_device << ", 0x" << std::hex << key_as_uint64 << ") [" << this << "]");
   }
@@ -110,7 +117,9 @@ class QueuePool
   static void clean_up();
 
   // Returns a pointer to a running ImmediateSubmitQueue from this pool.
-  task::ImmediateSubmitQueue* get_immediate_submit_queue_task(CWDEBUG_ONLY(bool debug));
+  // If affinity is not zero, then the same task is returned as for earlier calls with the same affinity, as long as any of those requests didn't finish.
+  // Otherwise the task with the least outstanding work (see ImmediateSubmitQueue::load) is returned.
+  task::ImmediateSubmitQueue* get_immediate_submit_queue_task(uint64_t affinity COMMA_CWDEBUG_ONLY(bool debug));
 };
 
 } // namespace vulkan
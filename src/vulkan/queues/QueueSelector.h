@@ -0,0 +1,90 @@
+#pragma once
+
+#include "utils/log2.h"
+#include "utils/macros.h"
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace vulkan {
+
+// The policy that QueuePool uses to select one of its tasks (queues) for a request.
+//
+// Without affinity the task with the least outstanding work is selected (least_loaded).
+// Requests with the same (non-zero) affinity are passed to the same task as long as any of them
+// did not finish yet (acquire_affinity_task and release_affinity); after that they are free to
+// go to another task again.
+//
+// The tasks themselves are only known through their index, so that this can be used
+// without a logical device (for example by tests/queue_selector_test.cxx).
+class QueueSelector
+{
+ public:
+  // The number of entries in m_affinity_table (must be a power of two). Unrelated requests that share an entry are kept on the same
+  // task too; with many requests in flight (a backed up queue) a small table therefore pins most of them to that queue.
+  static constexpr int s_affinity_table_size = 1024;
+
+ private:
+  std::atomic<int> m_next_task{0};              // Rotates over the existing tasks; the task at which the search for the least loaded task starts.
+  // Maps (the hash of) the affinity of a request to the index of the task that requests with that affinity are passed to (the high 32 bits)
+  // and the number of those requests that did not finish yet (the low 32 bits). Different affinities can share an entry (and therefore a task).
+  std::array<std::atomic<uint64_t>, s_affinity_table_size> m_affinity_table{};
+
+  static int affinity_index(uint64_t affinity)
+  {
+    // Fibonacci hashing: the low bits of a handle are not random.
+    return (affinity * 0x9e3779b97f4a7c15UL) >> (64 - utils::log2(s_affinity_table_size));
+  }
+
+ public:
+  // Return the index of the task with the least load, where load(index) returns the load of task index (0 <= index < number_of_tasks).
+  template<typename LOAD>
+  int least_loaded(int number_of_tasks, LOAD const& load)
+  {
+    // Start at a rotating index so that tasks with an equal load (for example, when they are all idle) are still used in turn.
+    int const start = static_cast<unsigned int>(m_next_task.fetch_add(1, std::memory_order::relaxed)) % number_of_tasks;
+    int best = start;
+    auto best_load = load(start);
+    for (int i = 1; i < number_of_tasks && best_load > 0; ++i)
+    {
+      int const index = (start + i) % number_of_tasks;
+      auto const task_load = load(index);
+      if (task_load < best_load)
+      {
+        best = index;
+        best_load = task_load;
+      }
+    }
+    return best;
+  }
+
+  // Return the index of the task that a request with this (non-zero) affinity must be passed to.
+  // This is the task of the requests with this affinity that didn't finish yet, if any; otherwise select() is
+  // called to choose a task. Every call must be followed by a call to release_affinity once the request finished.
+  template<typename SELECT>
+  int acquire_affinity_task(uint64_t affinity, SELECT const& select)
+  {
+    std::atomic<uint64_t>& entry = m_affinity_table[affinity_index(affinity)];
+    uint64_t expected = entry.load(std::memory_order::acquire);
+    // select() might create a new task, so call it at most once: not again when the compare-exchange below fails.
+    int selected = static_cast<uint32_t>(expected) == 0 ? select() : -1;
+    for (;;)
+    {
+      uint32_t const pending = expected;
+      if (pending == 0 && selected == -1)
+        selected = select();    // The requests with this affinity finished in the meantime.
+      int const index = pending > 0 ? static_cast<int>(expected >> 32) : selected;
+      if (entry.compare_exchange_weak(expected, (static_cast<uint64_t>(index) << 32) | (pending + 1), std::memory_order::acq_rel))
+        return index;
+      // Another thread passed or finished a request with this affinity in the meantime; try again.
+    }
+  }
+
+  // Called when a request, for which acquire_affinity_task was called, finished or was aborted.
+  void release_affinity(uint64_t affinity)
+  {
+    m_affinity_table[affinity_index(affinity)].fetch_sub(1, std::memory_order::release);
+  }
+};
+
+} // namespace vulkan
@@ -0,0 +1,176 @@
+#include "sys.h"
+#include "UploadBatch.h"
+#include <algorithm>
+#include "debug.h"
+
+namespace vulkan {
+
+void UploadBatch::clear()
+{
+  m_generating_stages = {};
+  m_pre_transfer_buffer_barriers.clear();
+  m_pre_transfer_image_barriers.clear();
+  // Keep the elements and the memory of their regions.
+  for (size_t i = 0; i < m_used_buffer_copies; ++i)
+    m_buffer_copies[i].m_regions.clear();
+  m_used_buffer_copies = 0;
+  for (size_t i = 0; i < m_used_buffer_image_copies; ++i)
+    m_buffer_image_copies[i].m_regions.clear();
+  m_used_buffer_image_copies = 0;
+  m_consuming_stages = {};
+  m_post_transfer_buffer_barriers.clear();
+  m_post_transfer_image_barriers.clear();
+  m_number_of_uploads = 0;
+}
+
+void UploadBatch::clear_waits()
+{
+  m_vh_wait_semaphores.clear();
+  m_wait_values.clear();
+  m_wait_dst_stage_masks.clear();
+}
+
+void UploadBatch::add_wait(vk::Semaphore vh_semaphore, uint64_t wait_value)
+{
+  // Wait only once per semaphore, for the largest value.
+  auto iter = std::find(m_vh_wait_semaphores.begin(), m_vh_wait_semaphores.end(), vh_semaphore);
+  if (iter == m_vh_wait_semaphores.end())
+  {
+    m_vh_wait_semaphores.push_back(vh_semaphore);
+    m_wait_values.push_back(wait_value);
+    m_wait_dst_stage_masks.push_back(vk::PipelineStageFlagBits::eTransfer);
+  }
+  else
+  {
+    uint64_t& value = m_wait_values[iter - m_vh_wait_semaphores.begin()];
+    value = std::max(value, wait_value);
+  }
+}
+
+namespace {
+
+// The stages and accesses that are supported by a queue family without graphics and compute capability.
+constexpr vk::PipelineStageFlags transfer_only_stages =
+  vk::PipelineStageFlagBits::eTopOfPipe | vk::PipelineStageFlagBits::eTransfer | vk::PipelineStageFlagBits::eHost | vk::PipelineStageFlagBits::eBottomOfPipe;
+constexpr vk::AccessFlags transfer_only_accesses =
+  vk::AccessFlagBits::eTransferRead | vk::AccessFlagBits::eTransferWrite | vk::AccessFlagBits::eHostRead | vk::AccessFlagBits::eHostWrite |
+  vk::AccessFlagBits::eMemoryRead | vk::AccessFlagBits::eMemoryWrite;
+
+// Clamp stages to those supported by a transfer-only queue, replacing an empty result by fallback.
+//
+// An upload that runs on such a queue without a queue family ownership transfer has no dependency on
+// graphics or compute work of its own queue (there is none); the dependency on the work of other queues
+// comes from the semaphore waits of the submits involved, which make all memory accesses available and visible.
+vk::PipelineStageFlags clamp_stages(vk::PipelineStageFlags stages, vk::PipelineStageFlagBits fallback)
+{
+  stages &= transfer_only_stages;
+  return stages ? stages : vk::PipelineStageFlags{fallback};
+}
+
+} // namespace
+
+void UploadBatch::add_pre_transfer_barrier(vk::PipelineStageFlags generating_stages, vk::BufferMemoryBarrier const& barrier)
+{
+  if (m_transfer_only)
+  {
+    m_generating_stages |= clamp_stages(generating_stages, vk::PipelineStageFlagBits::eTopOfPipe);
+    vk::BufferMemoryBarrier& clamped_barrier = m_pre_transfer_buffer_barriers.emplace_back(barrier);
+    clamped_barrier.srcAccessMask &= transfer_only_accesses;
+    return;
+  }
+  m_generating_stages |= generating_stages;
+  m_pre_transfer_buffer_barriers.push_back(barrier);
+}
+
+void UploadBatch::add_pre_transfer_barrier(vk::PipelineStageFlags generating_stages, vk::ImageMemoryBarrier const& barrier)
+{
+  if (m_transfer_only)
+  {
+    m_generating_stages |= clamp_stages(generating_stages, vk::PipelineStageFlagBits::eTopOfPipe);
+    vk::ImageMemoryBarrier& clamped_barrier = m_pre_transfer_image_barriers.emplace_back(barrier);
+    clamped_barrier.srcAccessMask &= transfer_only_accesses;
+    return;
+  }
+  m_generating_stages |= generating_stages;
+  m_pre_transfer_image_barriers.push_back(barrier);
+}
+
+void UploadBatch::add_post_transfer_barrier(vk::PipelineStageFlags consuming_stages, vk::BufferMemoryBarrier const& barrier)
+{
+  if (m_transfer_only)
+  {
+    m_consuming_stages |= clamp_stages(consuming_stages, vk::PipelineStageFlagBits::eBottomOfPipe);
+    vk::BufferMemoryBarrier& clamped_barrier = m_post_transfer_buffer_barriers.emplace_back(barrier);
+    clamped_barrier.dstAccessMask &= transfer_only_accesses;
+    return;
+  }
+  m_consuming_stages |= consuming_stages;
+  m_post_transfer_buffer_barriers.push_back(barrier);
+}
+
+void UploadBatch::add_post_transfer_barrier(vk::PipelineStageFlags consuming_stages, vk::ImageMemoryBarrier const& barrier)
+{
+  if (m_transfer_only)
+  {
+    m_consuming_stages |= clamp_stages(consuming_stages, vk::PipelineStageFlagBits::eBottomOfPipe);
+    vk::ImageMemoryBarrier& clamped_barrier = m_post_transfer_image_barriers.emplace_back(barrier);
+    clamped_barrier.dstAccessMask &= transfer_only_accesses;
+    return;
+  }
+  m_consuming_stages |= consuming_stages;
+  m_post_transfer_image_barriers.push_back(barrier);
+}
+
+namespace {
+
+// Return the element of copies (of which the first `used` are used) with vh_source and vh_destination,
+// using the next unused element (or appending a new one) if there is no such element yet.
+template<typename COPIES, typename DESTINATION>
+COPIES& find_or_add(std::vector<COPIES>& copies, size_t& used, vk::Buffer vh_source, DESTINATION vh_destination)
+{
+  // Normally all uploads use the same source (the staging ring of the logical device).
+  auto const end = copies.begin() + used;
+  auto iter = std::find_if(copies.begin(), end,
+      [=](COPIES const& element){ return element.m_vh_source == vh_source && element.m_vh_destination == vh_destination; });
+  if (iter != end)
+    return *iter;
+  if (used == copies.size())
+    copies.emplace_back();
+  COPIES& element = copies[used++];
+  element.m_vh_source = vh_source;
+  element.m_vh_destination = vh_destination;
+  // The m_regions of an unused element were cleared by clear().
+  ASSERT(element.m_regions.empty());
+  return element;
+}
+
+} // namespace
+
+void UploadBatch::add_copy(vk::Buffer vh_source, vk::Buffer vh_destination, vk::BufferCopy const& region)
+{
+  find_or_add(m_buffer_copies, m_used_buffer_copies, vh_source, vh_destination).m_regions.push_back(region);
+}
+
+std::vector<vk::BufferImageCopy>& UploadBatch::image_copy_regions(vk::Buffer vh_source, vk::Image vh_destination)
+{
+  return find_or_add(m_buffer_image_copies, m_used_buffer_image_copies, vh_source, vh_destination).m_regions;
+}
+
+void UploadBatch::record(handle::CommandBuffer command_buffer) const
+{
+  DoutEntering(dc::vulkan, "UploadBatch::record(" << command_buffer << ") [" << m_number_of_uploads << " uploads]");
+
+  command_buffer->begin({ .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit });
+  command_buffer->pipelineBarrier(m_generating_stages, vk::PipelineStageFlagBits::eTransfer, vk::DependencyFlags(0),
+      {}, m_pre_transfer_buffer_barriers, m_pre_transfer_image_barriers);
+  for (size_t i = 0; i < m_used_buffer_copies; ++i)
+    command_buffer->copyBuffer(m_buffer_copies[i].m_vh_source, m_buffer_copies[i].m_vh_destination, m_buffer_copies[i].m_regions);
+  for (size_t i = 0; i < m_used_buffer_image_copies; ++i)
+    command_buffer->copyBufferToImage(m_buffer_image_copies[i].m_vh_source, m_buffer_image_copies[i].m_vh_destination,
+        vk::ImageLayout::eTransferDstOptimal, m_buffer_image_copies[i].m_regions);
+  command_buffer->pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, m_consuming_stages, vk::DependencyFlags(0),
+      {}, m_post_transfer_buffer_barriers, m_post_transfer_image_barriers);
+  command_buffer->end();
+}
+
+} // namespace vulkan
@@ -0,0 +1,109 @@
+#pragma once
+
+#include "CommandBuffer.h"
+#include "QueueFamilyProperties.h"
+#include <vulkan/vulkan.hpp>
+#include <vector>
+#include "debug.h"
+
+namespace vulkan {
+
+// The commands of a number of uploads (see task::CopyDataToGPU) that are recorded into a single command buffer.
+//
+// Every upload adds a barrier that makes its destination available to the transfer (add_pre_transfer_barrier),
+// one or more copy regions (add_copy or image_copy_regions) and a barrier that makes the result available to its consumers
+// (add_post_transfer_barrier). record() then records one pipelineBarrier with all pre-transfer barriers,
+// one copyBuffer / copyBufferToImage per (source, destination) pair with all regions of that pair, and
+// finally one pipelineBarrier with all post-transfer barriers.
+//
+// The stage masks of the combined barriers are the union of those of the individual uploads.
+// Because nothing orders the copies of one batch with respect to each other, the caller must not add two
+// uploads to the same destination to one batch (see ImmediateSubmitQueue::starts_new_batch).
+//
+// A queue family without graphics and compute capability only supports the transfer, host and top/bottom of pipe
+// stages; on such a queue the stage and access masks of the barriers are clamped to those (see clamp_stages).
+//
+// An upload that first has to wait for the release of its destination by another queue (family) adds
+// a semaphore wait (add_wait). Those are waits of the whole submit and therefore survive clear().
+class UploadBatch
+{
+ private:
+  struct BufferCopies
+  {
+    vk::Buffer m_vh_source;
+    vk::Buffer m_vh_destination;
+    std::vector<vk::BufferCopy> m_regions;
+  };
+
+  struct BufferImageCopies
+  {
+    vk::Buffer m_vh_source;
+    vk::Image m_vh_destination;
+    std::vector<vk::BufferImageCopy> m_regions;
+  };
+
+  vk::PipelineStageFlags m_generating_stages;                           // The union of the srcStageMask of all pre-transfer barriers.
+  std::vector<vk::BufferMemoryBarrier> m_pre_transfer_buffer_barriers;
+  std::vector<vk::ImageMemoryBarrier> m_pre_transfer_image_barriers;
+  // The elements beyond the used ones are kept by clear(), together with the memory of their m_regions, for reuse by later batches.
+  std::vector<BufferCopies> m_buffer_copies;
+  size_t m_used_buffer_copies = 0;                                      // The number of elements of m_buffer_copies that are used by this batch.
+  std::vector<BufferImageCopies> m_buffer_image_copies;
+  size_t m_used_buffer_image_copies = 0;                                // The number of elements of m_buffer_image_copies that are used by this batch.
+  vk::PipelineStageFlags m_consuming_stages;                            // The union of the dstStageMask of all post-transfer barriers.
+  std::vector<vk::BufferMemoryBarrier> m_post_transfer_buffer_barriers;
+  std::vector<vk::ImageMemoryBarrier> m_post_transfer_image_barriers;
+  int m_number_of_uploads = 0;
+  std::vector<vk::Semaphore> m_vh_wait_semaphores;                      // The timeline semaphores that the submit must wait for.
+  std::vector<uint64_t> m_wait_values;                                  // The value to wait for, per semaphore in m_vh_wait_semaphores.
+  std::vector<vk::PipelineStageFlags> m_wait_dst_stage_masks;           // Always eTransfer; one per semaphore in m_vh_wait_semaphores.
+  QueueFamilyPropertiesIndex m_queue_family;                            // The queue family of the queue that the batch is submitted to.
+  bool m_transfer_only;                                                 // Set if m_queue_family has neither graphics nor compute capability.
+
+ public:
+  UploadBatch(QueueFamilyPropertiesIndex queue_family, QueueFlags queue_flags) :
+    m_queue_family(queue_family), m_transfer_only(!(queue_flags & (QueueFlagBits::eGraphics|QueueFlagBits::eCompute))) { }
+
+  // Add the barriers of one upload.
+  void add_pre_transfer_barrier(vk::PipelineStageFlags generating_stages, vk::BufferMemoryBarrier const& barrier);
+  void add_pre_transfer_barrier(vk::PipelineStageFlags generating_stages, vk::ImageMemoryBarrier const& barrier);
+  void add_post_transfer_barrier(vk::PipelineStageFlags consuming_stages, vk::BufferMemoryBarrier const& barrier);
+  void add_post_transfer_barrier(vk::PipelineStageFlags consuming_stages, vk::ImageMemoryBarrier const& barrier);
+
+  // Add copy regions of one upload.
+  void add_copy(vk::Buffer vh_source, vk::Buffer vh_destination, vk::BufferCopy const& region);
+  // Return the regions of the copy from vh_source to vh_destination, to which the caller appends the regions of one upload.
+  // The destination image must be in the eTransferDstOptimal layout.
+  std::vector<vk::BufferImageCopy>& image_copy_regions(vk::Buffer vh_source, vk::Image vh_destination);
+
+  // Make the submit wait until vh_semaphore reached wait_value before executing the transfers (of any batch).
+  void add_wait(vk::Semaphore vh_semaphore, uint64_t wait_value);
+
+  // Remove everything that was added, except the semaphore waits, but keep the allocated memory for reuse by the next batch.
+  void clear();
+
+  // Remove the semaphore waits; call after submitting.
+  void clear_waits();
+
+  // Call once per upload, after adding everything of that upload.
+  void upload_added() { ++m_number_of_uploads; }
+
+  // Record all commands into command_buffer (including begin and end).
+  void record(handle::CommandBuffer command_buffer) const;
+
+  // Return the number of uploads that were added.
+  int number_of_uploads() const { return m_number_of_uploads; }
+
+  // Accessors for the semaphore waits.
+  std::vector<vk::Semaphore> const& wait_semaphores() const { return m_vh_wait_semaphores; }
+  std::vector<uint64_t> const& wait_values() const { return m_wait_values; }
+  std::vector<vk::PipelineStageFlags> const& wait_dst_stage_masks() const { return m_wait_dst_stage_masks; }
+
+  // Return true if the queue that will execute the copies has neither graphics nor compute capability.
+  bool transfer_only() const { return m_transfer_only; }
+
+  // Return the queue family of the queue that will execute the copies.
+  QueueFamilyPropertiesIndex queue_family() const { return m_queue_family; }
+};
+
+} // namespace vulkan
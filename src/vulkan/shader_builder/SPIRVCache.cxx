@@ -1,5 +1,7 @@
 #include "sys.h"
 #include "SPIRVCache.h"
+#include "SPIRVDiskCache.h"
+#include "descriptor/SetBindingMap.h"
 #include "LogicalDevice.h"
 #include "SynchronousWindow.h"
 #include "pipeline/ShaderInputData.h"
@@ -7,8 +9,10 @@
 #include "utils/at_scope_end.h"
 #include <shaderc/shaderc.hpp>
 #include <magic_enum.hpp>
+#include <boost/functional/hash.hpp>
 #include <fstream>
 #include <functional>
+#include <map>
 #include "debug.h"
 #ifdef CWDEBUG
 #include <sstream>
@@ -66,6 +70,11 @@ void SPIRVCache::reset()
   m_spirv_code.clear();
 }
 
+size_t SPIRVCache::hash() const
+{
+  return boost::hash_range(m_spirv_code.begin(), m_spirv_code.end());
+}
+
 void SPIRVCache::compile(std::string_view glsl_source_code, ShaderCompiler const& compiler, ShaderInfo const& shader_info)
 {
   DoutEntering(dc::vulkan, "SPIRVCache::compile(...)");
@@ -75,6 +84,93 @@ void SPIRVCache::compile(std::string_view glsl_source_code, ShaderCompiler const
   m_spirv_code = compiler.compile({}, shader_info, glsl_source_code);
 }
 
+void SPIRVCache::compile(std::string_view glsl_source_code, ShaderCompiler const& compiler, ShaderInfo const& shader_info,
+    SPIRVDiskCache const* disk_cache, descriptor::SetBindingMap const& set_binding_map)
+{
+  DoutEntering(dc::vulkan, "SPIRVCache::compile(..., " << disk_cache << ", " << set_binding_map << ")");
+
+  if (!disk_cache)
+  {
+    compile(glsl_source_code, compiler, shader_info);
+    return;
+  }
+
+  // Call reset() before reusing a SPIRVCache.
+  ASSERT(m_spirv_code.empty());
+  SPIRVDiskCache::Key const key = SPIRVDiskCache::make_key(shader_info, glsl_source_code, set_binding_map);
+  if (disk_cache->load(key, m_spirv_code))
+    return;
+  m_spirv_code = compiler.compile({}, shader_info, glsl_source_code);
+  disk_cache->store(key, m_spirv_code);
+}
+
+namespace {
+
+// See https://registry.khronos.org/SPIR-V/specs/unified1/SPIRV.html
+constexpr uint32_t spirv_magic_number = 0x07230203;
+constexpr size_t spirv_header_size = 5;                 // The number of words in the header.
+constexpr uint32_t spirv_op_decorate = 71;
+constexpr uint32_t spirv_decoration_binding = 33;
+constexpr uint32_t spirv_decoration_descriptor_set = 34;
+
+} // namespace
+
+void SPIRVCache::patch_from_template(SPIRVCache const& spirv_template, descriptor::SetBindingMap const& set_binding_map)
+{
+  DoutEntering(dc::vulkan, "SPIRVCache::patch_from_template(" << &spirv_template << ", " << set_binding_map << ") [" << this << "]");
+
+  // Call reset() before reusing a SPIRVCache.
+  ASSERT(m_spirv_code.empty());
+  // Call compile() on spirv_template first.
+  ASSERT(!spirv_template.m_spirv_code.empty());
+
+  m_spirv_code = spirv_template.m_spirv_code;
+  size_t const size = m_spirv_code.size();
+  if (size < spirv_header_size || m_spirv_code[0] != spirv_magic_number)
+    THROW_ALERT("Invalid SPIR-V header");
+
+  // The DescriptorSet and Binding decorations of each variable, by result id.
+  struct Decorations
+  {
+    uint32_t* m_descriptor_set = nullptr;
+    uint32_t* m_binding = nullptr;
+  };
+  std::map<uint32_t, Decorations> decorations;
+
+  // Find all OpDecorate instructions with a DescriptorSet or Binding decoration.
+  for (size_t pos = spirv_header_size; pos < size;)
+  {
+    uint32_t const word_count = m_spirv_code[pos] >> 16;
+    uint32_t const opcode = m_spirv_code[pos] & 0xffff;
+    if (word_count == 0 || pos + word_count > size)
+      THROW_ALERT("Corrupt SPIR-V code at word [POS]", AIArgs("[POS]", pos));
+    // OpDecorate <target id> <decoration> <literal>
+    if (opcode == spirv_op_decorate && word_count == 4)
+    {
+      uint32_t const decoration = m_spirv_code[pos + 2];
+      if (decoration == spirv_decoration_descriptor_set)
+        decorations[m_spirv_code[pos + 1]].m_descriptor_set = &m_spirv_code[pos + 3];
+      else if (decoration == spirv_decoration_binding)
+        decorations[m_spirv_code[pos + 1]].m_binding = &m_spirv_code[pos + 3];
+    }
+    pos += word_count;
+  }
+
+  // Replace the placeholders.
+  for (auto& id_decorations : decorations)
+  {
+    Decorations const& d = id_decorations.second;
+    // Shader resources generated by ShaderResourceDeclarationContext always have both.
+    ASSERT(d.m_descriptor_set && d.m_binding);
+    descriptor::SetIndexHint const set_index_hint{*d.m_descriptor_set};
+    uint32_t const binding_hint = *d.m_binding;
+    *d.m_descriptor_set = set_binding_map.convert(set_index_hint).get_value();
+    *d.m_binding = set_binding_map.convert(set_index_hint, binding_hint);
+    Dout(dc::vulkan, "Patched %" << id_decorations.first << ": (set, binding) = (" << set_index_hint.get_value() << ", " << binding_hint << ") --> (" <<
+        *d.m_descriptor_set << ", " << *d.m_binding << ")");
+  }
+}
+
 vk::UniqueShaderModule SPIRVCache::create_module(utils::Badge<vulkan::pipeline::ShaderInputData>, vulkan::LogicalDevice const* logical_device
     COMMA_CWDEBUG_ONLY(vulkan::AmbifixOwner const& debug_name)) const
 {
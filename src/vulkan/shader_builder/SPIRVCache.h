@@ -20,9 +20,14 @@ namespace pipeline {
 class ShaderInputData;
 } // namespace pipeline
 
+namespace descriptor {
+class SetBindingMap;
+} // namespace descriptor
+
 namespace shader_builder {
 
 class ShaderCompiler;
+class SPIRVDiskCache;
 
 // Objects of this type should be used to keep a cache of compiled SPIR-V code
 // when for whatever reason you need to recreate a ShaderModule but don't want
@@ -36,6 +41,18 @@ class SPIRVCache
   // Compile the code in glsl_source_code (as returned from preprocess) and cache it in m_spirv_code.
   void compile(std::string_view glsl_source_code, ShaderCompiler const& compiler, ShaderInfo const& shader_info);
 
+  // Same as above, but first try to load the SPIR-V code from disk_cache; and store it there after compiling it.
+  // If disk_cache is nullptr then this is the same as the above function.
+  void compile(std::string_view glsl_source_code, ShaderCompiler const& compiler, ShaderInfo const& shader_info,
+      SPIRVDiskCache const* disk_cache, descriptor::SetBindingMap const& set_binding_map);
+
+  // Precompiled-template mode.
+  //
+  // Copy the SPIR-V code of spirv_template, which must be compiled from the source code returned
+  // by ShaderInputData::preprocess2_template, and patch its DescriptorSet and Binding decorations,
+  // which contain the set index hints and binding hints, to the values given by set_binding_map.
+  void patch_from_template(SPIRVCache const& spirv_template, descriptor::SetBindingMap const& set_binding_map);
+
   // Create handle from cached SPIR-V code.
   vk::UniqueShaderModule create_module(
       utils::Badge<vulkan::pipeline::ShaderInputData>, // Use vulkan::pipeline::ShaderInputData::build_shader(shader_info, compiler) instead of this function.
@@ -44,6 +61,15 @@ class SPIRVCache
 
   // Free resources.
   void reset();
+
+  // Return true if nothing was compiled yet (or reset() was called).
+  bool empty() const { return m_spirv_code.empty(); }
+
+  // Return a hash of the cached SPIR-V code.
+  size_t hash() const;
+
+  // Accessor for the cached SPIR-V code.
+  std::vector<uint32_t> const& spirv_code() const { return m_spirv_code; }
 };
 
 } // namespace shader_builder
@@ -0,0 +1,278 @@
+#include "sys.h"
+#include "SPIRVDiskCache.h"
+#include "ShaderInfo.h"
+#include "descriptor/SetBindingMap.h"
+#include "vk_utils/fnv1a.h"
+#include <shaderc/shaderc.h>
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <iomanip>
+#include "debug.h"
+
+namespace vulkan::shader_builder {
+
+namespace {
+
+// The header of each entry file.
+struct EntryHeader
+{
+  static constexpr uint32_t s_magic = 0x43565053;       // "SPVC" (little endian).
+  static constexpr uint32_t s_format_version = 2;        // Version 2: the key hash is FNV-1a (it was boost::hash).
+
+  uint32_t m_magic;
+  uint32_t m_format_version;
+  uint32_t m_spv_version;                               // The SPIR-V version that shaderc produces.
+  uint32_t m_spv_revision;                              // The SPIR-V revision that shaderc produces.
+  uint64_t m_hash;                                      // The key hash.
+  uint64_t m_source_size;                               // The size of the GLSL source code that follows the header, in bytes.
+  uint64_t m_spirv_word_count;                          // The number of SPIR-V words that follow the GLSL source code.
+  uint64_t m_checksum;                                  // FNV-1a checksum over the GLSL source code and the SPIR-V code.
+};
+
+uint64_t checksum(std::string_view glsl_source_code, uint32_t const* spirv_code, size_t spirv_word_count)
+{
+  return vk_utils::fnv1a(spirv_code, spirv_word_count * sizeof(uint32_t), vk_utils::fnv1a(glsl_source_code.data(), glsl_source_code.size()));
+}
+
+void get_spv_version(uint32_t& version, uint32_t& revision)
+{
+  unsigned int v, r;
+  shaderc_get_spv_version(&v, &r);
+  version = v;
+  revision = r;
+}
+
+constexpr char const* entry_extension = ".spv";
+constexpr char const* temporary_extension = ".tmp";
+
+} // namespace
+
+void SPIRVDiskCache::initialize(std::filesystem::path const& directory, size_t max_size)
+{
+  DoutEntering(dc::vulkan, "SPIRVDiskCache::initialize(" << directory << ", " << max_size << ")");
+
+  std::error_code ec;
+  std::filesystem::create_directories(directory, ec);
+  if (ec)
+  {
+    Dout(dc::warning, "Could not create SPIR-V cache directory " << directory << " (" << ec.message() << "). Not using a disk cache for SPIR-V code.");
+    return;
+  }
+
+  m_directory = directory;
+  m_max_size = max_size;
+
+  // Calculate the current size of the cache and clean up left-overs of interrupted writes.
+  bookkeeping_t::wat bookkeeping_w(m_bookkeeping);
+  bookkeeping_w->m_total_size = 0;
+  for (std::filesystem::directory_entry const& entry : std::filesystem::directory_iterator(m_directory, ec))
+  {
+    if (!entry.is_regular_file(ec))
+      continue;
+    if (entry.path().extension() == temporary_extension)
+    {
+      Dout(dc::vulkan, "Removing stale temporary file " << entry.path());
+      std::filesystem::remove(entry.path(), ec);
+      continue;
+    }
+    if (entry.path().extension() == entry_extension)
+      bookkeeping_w->m_total_size += entry.file_size(ec);
+  }
+  Dout(dc::vulkan, "SPIR-V disk cache currently uses " << bookkeeping_w->m_total_size << " bytes.");
+  if (bookkeeping_w->m_total_size > m_max_size)
+    evict(*bookkeeping_w);
+}
+
+//static
+SPIRVDiskCache::Key SPIRVDiskCache::make_key(ShaderInfo const& shader_info, std::string_view glsl_source_code, descriptor::SetBindingMap const& set_binding_map)
+{
+  // The key is stored on disk (as file name), so it may only be calculated from hashes that are the same for every build.
+  uint64_t const inputs[] = {
+    shader_info.get_stable_hash(),                      // The stage, the template code, the macro definitions and the precompiled-template flag.
+    vk_utils::fnv1a(glsl_source_code.data(), glsl_source_code.size()),
+    set_binding_map.stable_hash()
+  };
+  uint32_t compiler_version[2];
+  get_spv_version(compiler_version[0], compiler_version[1]);
+  uint64_t const hash = vk_utils::fnv1a(compiler_version, sizeof(compiler_version), vk_utils::fnv1a(inputs, sizeof(inputs)));
+  return { hash, glsl_source_code };
+}
+
+std::filesystem::path SPIRVDiskCache::entry_path(uint64_t hash) const
+{
+  std::ostringstream filename;
+  filename << std::hex << std::setfill('0') << std::setw(16) << hash << entry_extension;
+  return m_directory / filename.str();
+}
+
+bool SPIRVDiskCache::load(Key const& key, std::vector<uint32_t>& spirv_code_out) const
+{
+  DoutEntering(dc::vulkan, "SPIRVDiskCache::load({" << std::hex << key.m_hash << std::dec << ", ...})");
+
+  if (!is_enabled())
+    return false;
+
+  std::filesystem::path const path = entry_path(key.m_hash);
+  std::ifstream file(path, std::ios::binary | std::ios::ate);
+  if (!file)
+    return false;       // Cache miss.
+
+  bool corrupt = true;
+  bool collision = false;
+  do
+  {
+    std::streamoff const file_size = file.tellg();
+    EntryHeader header;
+    if (file_size < static_cast<std::streamoff>(sizeof(header)))
+      break;
+    file.seekg(0, std::ios::beg);
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)))
+      break;
+    uint32_t spv_version, spv_revision;
+    get_spv_version(spv_version, spv_revision);
+    if (header.m_magic != EntryHeader::s_magic || header.m_format_version != EntryHeader::s_format_version ||
+        header.m_spv_version != spv_version || header.m_spv_revision != spv_revision || header.m_hash != key.m_hash)
+      break;
+    if (static_cast<uint64_t>(file_size) != sizeof(header) + header.m_source_size + header.m_spirv_word_count * sizeof(uint32_t) ||
+        header.m_spirv_word_count == 0)
+      break;
+    std::string glsl_source_code(header.m_source_size, '\0');
+    if (!file.read(glsl_source_code.data(), glsl_source_code.size()))
+      break;
+    spirv_code_out.resize(header.m_spirv_word_count);
+    if (!file.read(reinterpret_cast<char*>(spirv_code_out.data()), spirv_code_out.size() * sizeof(uint32_t)))
+      break;
+    if (checksum(glsl_source_code, spirv_code_out.data(), spirv_code_out.size()) != header.m_checksum)
+      break;
+    corrupt = false;
+    // The file is valid, but if the source code is different then this was a hash collision.
+    collision = glsl_source_code != key.m_glsl_source_code;
+  }
+  while (false);
+  file.close();
+
+  if (corrupt || collision)
+  {
+    spirv_code_out.clear();
+    if (corrupt)
+    {
+      Dout(dc::warning, "Removing corrupt or stale SPIR-V cache entry " << path);
+      std::error_code ec;
+      uintmax_t const size = std::filesystem::file_size(path, ec);
+      if (!ec && std::filesystem::remove(path, ec))
+      {
+        bookkeeping_t::wat bookkeeping_w(m_bookkeeping);
+        bookkeeping_w->m_total_size -= std::min(static_cast<size_t>(size), bookkeeping_w->m_total_size);
+      }
+    }
+    else
+      Dout(dc::vulkan, "Hash collision for SPIR-V cache entry " << path);
+    return false;
+  }
+
+  // Mark this entry as most recently used.
+  std::error_code ec;
+  std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), ec);
+
+  Dout(dc::vulkan, "Loaded " << spirv_code_out.size() << " SPIR-V words from " << path);
+  return true;
+}
+
+void SPIRVDiskCache::store(Key const& key, std::vector<uint32_t> const& spirv_code) const
+{
+  DoutEntering(dc::vulkan, "SPIRVDiskCache::store({" << std::hex << key.m_hash << std::dec << ", ...}, <" << spirv_code.size() << " words>)");
+
+  if (!is_enabled() || spirv_code.empty())
+    return;
+
+  EntryHeader header;
+  header.m_magic = EntryHeader::s_magic;
+  header.m_format_version = EntryHeader::s_format_version;
+  get_spv_version(header.m_spv_version, header.m_spv_revision);
+  header.m_hash = key.m_hash;
+  header.m_source_size = key.m_glsl_source_code.size();
+  header.m_spirv_word_count = spirv_code.size();
+  header.m_checksum = checksum(key.m_glsl_source_code, spirv_code.data(), spirv_code.size());
+
+  // Write to a uniquely named temporary file first; then atomically rename it to its final name.
+  static std::atomic<unsigned int> s_sequence_number;
+  std::filesystem::path const path = entry_path(key.m_hash);
+  std::filesystem::path temporary_path = path;
+  temporary_path.replace_extension(
+      std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id())) + "_" +
+      std::to_string(s_sequence_number.fetch_add(1, std::memory_order_relaxed)) + temporary_extension);
+
+  std::error_code ec;
+  {
+    std::ofstream file(temporary_path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<char const*>(&header), sizeof(header));
+    file.write(key.m_glsl_source_code.data(), key.m_glsl_source_code.size());
+    file.write(reinterpret_cast<char const*>(spirv_code.data()), spirv_code.size() * sizeof(uint32_t));
+    file.close();
+    if (!file)
+    {
+      Dout(dc::warning, "Failed to write SPIR-V cache entry " << temporary_path);
+      std::filesystem::remove(temporary_path, ec);
+      return;
+    }
+  }
+  std::filesystem::rename(temporary_path, path, ec);
+  if (ec)
+  {
+    Dout(dc::warning, "Failed to rename " << temporary_path << " to " << path << " (" << ec.message() << ")");
+    std::filesystem::remove(temporary_path, ec);
+    return;
+  }
+
+  bookkeeping_t::wat bookkeeping_w(m_bookkeeping);
+  bookkeeping_w->m_total_size += sizeof(header) + header.m_source_size + header.m_spirv_word_count * sizeof(uint32_t);
+  if (bookkeeping_w->m_total_size > m_max_size)
+    evict(*bookkeeping_w);
+}
+
+// Remove the least recently used entries until the total size is less than three quarters of m_max_size.
+// Must be called while m_bookkeeping is locked.
+void SPIRVDiskCache::evict(Bookkeeping& bookkeeping) const
+{
+  DoutEntering(dc::vulkan, "SPIRVDiskCache::evict() [total size: " << bookkeeping.m_total_size << "]");
+
+  struct Entry
+  {
+    std::filesystem::file_time_type m_last_used;
+    uintmax_t m_size;
+    std::filesystem::path m_path;
+  };
+  std::vector<Entry> entries;
+
+  // Resynchronize m_total_size with what is really on disk (other processes might be using the same cache).
+  std::error_code ec;
+  bookkeeping.m_total_size = 0;
+  for (std::filesystem::directory_entry const& entry : std::filesystem::directory_iterator(m_directory, ec))
+  {
+    if (entry.path().extension() != entry_extension || !entry.is_regular_file(ec))
+      continue;
+    Entry e{ entry.last_write_time(ec), entry.file_size(ec), entry.path() };
+    if (ec)
+      continue;
+    bookkeeping.m_total_size += e.m_size;
+    entries.push_back(std::move(e));
+  }
+
+  // Oldest first.
+  std::sort(entries.begin(), entries.end(), [](Entry const& e1, Entry const& e2){ return e1.m_last_used < e2.m_last_used; });
+
+  size_t const low_water_mark = m_max_size / 4 * 3;
+  for (Entry const& e : entries)
+  {
+    if (bookkeeping.m_total_size <= low_water_mark)
+      break;
+    if (std::filesystem::remove(e.m_path, ec))
+      bookkeeping.m_total_size -= e.m_size;
+  }
+  Dout(dc::vulkan, "SPIR-V disk cache now uses " << bookkeeping.m_total_size << " bytes.");
+}
+
+} // namespace vulkan::shader_builder
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "threadsafe/aithreadsafe.h"
+#include <filesystem>
+#include <string_view>
+#include <cstdint>
+#include <vector>
+#include <mutex>
+#include "debug.h"
+
+namespace vulkan::descriptor {
+class SetBindingMap;
+} // namespace vulkan::descriptor
+
+namespace vulkan::shader_builder {
+
+class ShaderInfo;
+
+// A persistent, content-addressed store of compiled SPIR-V code.
+//
+// Each entry is a single file in the cache directory (Directory::cache / "spirv"), whose
+// name is the hexadecimal representation of a key that is calculated from the ShaderInfo
+// (the stage, the template code and the macro definitions), the final GLSL source code
+// (as returned by ShaderInputData::preprocess2), the SetBindingMap that was used and the
+// SPIR-V version of the compiler. Because the key outlives the process, it is an FNV-1a
+// hash (see vk_utils/fnv1a.h): std::hash and boost::hash can change between builds.
+//
+// The file contains a small header, a copy of the GLSL source code that it was compiled
+// from (so that hash collisions can be detected) and the SPIR-V code itself. Files are
+// written to a temporary file first and then renamed, so that a reader never sees a
+// partially written entry. Entries that can not be read or fail validation are removed.
+//
+// The last write time of the files is used to keep track of which entries were most recently
+// used: a cache hit "touches" the file. If the total size of all entries exceeds the size cap,
+// the least recently used entries are removed until the total size drops below the low water mark.
+class SPIRVDiskCache
+{
+ public:
+  static constexpr size_t default_max_size = 32 * 1024 * 1024;  // The default size cap of the cache directory, in bytes.
+
+  struct Key
+  {
+    uint64_t m_hash;                                    // Stable hash of the ShaderInfo, the final GLSL source code, the SetBindingMap and the compiler version.
+    std::string_view m_glsl_source_code;                // The final GLSL source code (used to detect hash collisions).
+  };
+
+ private:
+  struct Bookkeeping
+  {
+    size_t m_total_size = 0;                            // The (approximate) sum of the sizes of all entries.
+  };
+  using bookkeeping_t = aithreadsafe::Wrapper<Bookkeeping, aithreadsafe::policy::Primitive<std::mutex>>;
+  mutable bookkeeping_t m_bookkeeping;
+
+  std::filesystem::path m_directory;                    // The directory that contains the cache entries. Empty when disabled.
+  size_t m_max_size = default_max_size;                 // Evict entries when the total size exceeds this value.
+
+ public:
+  // Create a disabled cache. Call initialize to enable it.
+  SPIRVDiskCache() = default;
+
+  // Enable the cache, using the directory `directory` (which is created when it doesn't exist yet).
+  void initialize(std::filesystem::path const& directory, size_t max_size = default_max_size);
+
+  // Return true if initialize was called successfully.
+  bool is_enabled() const { return !m_directory.empty(); }
+
+  // Calculate the key for a shader with final source code glsl_source_code, generated from shader_info using set_binding_map.
+  static Key make_key(ShaderInfo const& shader_info, std::string_view glsl_source_code, descriptor::SetBindingMap const& set_binding_map);
+
+  // Try to load the SPIR-V code that belongs to key into spirv_code_out. Returns true upon success.
+  // Calls to load are thread-safe.
+  bool load(Key const& key, std::vector<uint32_t>& spirv_code_out) const;
+
+  // Store spirv_code under key. Calls to store are thread-safe.
+  void store(Key const& key, std::vector<uint32_t> const& spirv_code) const;
+
+ private:
+  std::filesystem::path entry_path(uint64_t hash) const;
+  void evict(Bookkeeping& bookkeeping) const;
+};
+
+} // namespace vulkan::shader_builder
@@ -41,6 +41,14 @@ Compiler::Compiler(ShaderInfo const& shader_info, std::string_view glsl_source_c
 
 } // namespace
 
+//static
+ShaderCompiler const& ShaderCompiler::thread_local_instance()
+{
+  // Each thread (of the thread pool) initializes its own compiler the first time it needs one.
+  static thread_local ShaderCompiler s_compiler;
+  return s_compiler;
+}
+
 std::vector<uint32_t> ShaderCompiler::compile(utils::Badge<SPIRVCache>, ShaderInfo const& shader_info, std::string_view glsl_source_code) const
 {
   Compiler compiler(shader_info, glsl_source_code, m_compiler);
@@ -2,6 +2,7 @@
 
 #include "utils/AIAlert.h"
 #include "utils/Badge.h"
+#include "vk_utils/fnv1a.h"
 #include <shaderc/shaderc.h>
 #include <vulkan/vulkan.hpp>
 #include <boost/container_hash/hash.hpp>
@@ -31,6 +32,7 @@ class ShaderCompilerOptions
   shaderc_compile_options_t m_options;
   std::map<std::string, std::string> m_macro_definitions;       // Macro definitions that are set. Used to calculate a hash for the ShaderCompilerOptions.
   size_t m_hash{};                                              // The final hash (zero when no macro definitions were added).
+  uint64_t m_stable_hash{};                                     // FNV-1a hash of the macro definitions; the same for every build (see stable_hash()).
 
  public:
   // Default constructor.
@@ -43,7 +45,8 @@ class ShaderCompilerOptions
 
   // Copy constructor.
   ShaderCompilerOptions(ShaderCompilerOptions const& compiler_options) :
-    m_options(shaderc_compile_options_clone(compiler_options.m_options)), m_macro_definitions(compiler_options.m_macro_definitions), m_hash(compiler_options.m_hash)
+    m_options(shaderc_compile_options_clone(compiler_options.m_options)), m_macro_definitions(compiler_options.m_macro_definitions), m_hash(compiler_options.m_hash),
+    m_stable_hash(compiler_options.m_stable_hash)
   {
   }
 
@@ -53,6 +56,7 @@ class ShaderCompilerOptions
     std::swap(m_options, compiler_options.m_options);
     std::swap(m_macro_definitions, compiler_options.m_macro_definitions);
     std::swap(m_hash, compiler_options.m_hash);
+    std::swap(m_stable_hash, compiler_options.m_stable_hash);
   }
 
   ShaderCompilerOptions& operator=(ShaderCompilerOptions const& compiler_options)
@@ -61,6 +65,7 @@ class ShaderCompilerOptions
     m_options = shaderc_compile_options_clone(compiler_options.m_options);
     m_macro_definitions = compiler_options.m_macro_definitions;
     m_hash = compiler_options.m_hash;
+    m_stable_hash = compiler_options.m_stable_hash;
     return *this;
   }
 
@@ -71,7 +76,9 @@ class ShaderCompilerOptions
     compiler_options.m_options = nullptr;
     m_macro_definitions = std::move(compiler_options.m_macro_definitions);
     m_hash = compiler_options.m_hash;
+    m_stable_hash = compiler_options.m_stable_hash;
     compiler_options.m_hash = 0;
+    compiler_options.m_stable_hash = 0;
     return *this;
   }
 
@@ -108,6 +115,13 @@ class ShaderCompilerOptions
     boost::hash<std::string> string_hash;
     for (std::map<std::string, std::string>::value_type const& definition : m_macro_definitions)
       boost::hash_combine(m_hash, string_hash(definition.first + "=" + definition.second));
+    // The same, but with a hash that can be stored on disk. Include the terminating zeroes, so that the boundaries are part of the hash.
+    m_stable_hash = vk_utils::fnv1a_offset_basis;
+    for (std::map<std::string, std::string>::value_type const& definition : m_macro_definitions)
+    {
+      m_stable_hash = vk_utils::fnv1a(definition.first.c_str(), definition.first.size() + 1, m_stable_hash);
+      m_stable_hash = vk_utils::fnv1a(definition.second.c_str(), definition.second.size() + 1, m_stable_hash);
+    }
     // Free memory.
     m_macro_definitions.clear();
   }
@@ -119,6 +133,14 @@ class ShaderCompilerOptions
     return m_hash;
   }
 
+  // Like hash(), but the same for every build (used for the key of SPIRVDiskCache).
+  uint64_t stable_hash() const
+  {
+    // First call calculate_hash().
+    ASSERT(m_hash != 0);
+    return m_stable_hash;
+  }
+
   // Sets the compiler mode to generate debug information in the output.
   ShaderCompilerOptions& set_generate_debug_info()
   {
@@ -282,6 +304,10 @@ class ShaderCompiler
     shaderc_compiler_release(m_compiler);
   }
 
+  // Return a ShaderCompiler that is private to the calling thread.
+  // Used by task::CompileShader, so that concurrently running compile jobs never share a shaderc_compiler_t.
+  static ShaderCompiler const& thread_local_instance();
+
   // Calls to compile are thread-safe.
   std::vector<uint32_t> compile(utils::Badge<SPIRVCache>, ShaderInfo const& shader_info, std::string_view glsl_source_code) const;
 
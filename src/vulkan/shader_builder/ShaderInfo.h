@@ -1,6 +1,7 @@
 #pragma once
 
 #include "ShaderCompiler.h"
+#include "vk_utils/fnv1a.h"
 #include <vulkan/vulkan.hpp>
 #include <shaderc/shaderc.h>    // shaderc_shader_kind, shaderc_glsl_infer_from_source
 #include <string>
@@ -27,6 +28,9 @@ class ShaderInfo
   std::string m_name;                                   // Shader name, used for diagnostics.
   std::string m_glsl_template_code;                     // GLSL template source code; loaded with load().
   ShaderCompilerOptions m_compiler_options;             // Compile options to use.
+  size_t m_hash{};                                      // The value returned by hash(), or zero if that wasn't called yet.
+  uint64_t m_stable_hash{};                             // The value returned by get_stable_hash(); also calculated by hash().
+  bool m_precompiled_template = false;                  // Set if this shader should be compiled only once per ShaderInputData (see set_precompiled_template).
 
  public:
   // Construct an empty ShaderInfo object to be used for the specified stage.
@@ -66,6 +70,18 @@ class ShaderInfo
     return *this;
   }
 
+  // Use precompiled-template mode for this shader.
+  //
+  // In this mode the shader is compiled only once per pipeline factory, with the set index hints and
+  // binding hints as DescriptorSet and Binding decorations. Each pipeline variant then only patches
+  // those decorations in the SPIR-V code, according to its SetBindingMap, instead of generating the
+  // GLSL code and compiling it again.
+  ShaderInfo& set_precompiled_template(bool precompiled_template = true)
+  {
+    m_precompiled_template = precompiled_template;
+    return *this;
+  }
+
   // Calculate a hash. Only call this function once after full initialization.
   size_t hash()
   {
@@ -73,14 +89,41 @@ class ShaderInfo
     size_t hash = static_cast<size_t>(m_stage);
     boost::hash_combine(hash, boost::hash<std::string>{}(m_glsl_template_code));
     boost::hash_combine(hash, m_compiler_options.hash());
+    // A precompiled template is compiled from different GLSL code (see ShaderInputData::preprocess2_template).
+    boost::hash_combine(hash, m_precompiled_template);
+    m_hash = hash;
+    // The same, but with a hash that can be stored on disk.
+    uint32_t const stage = static_cast<uint32_t>(m_stage);
+    m_stable_hash = vk_utils::fnv1a(&stage, sizeof(stage));
+    m_stable_hash = vk_utils::fnv1a(m_glsl_template_code.data(), m_glsl_template_code.size(), m_stable_hash);
+    uint64_t const compiler_options_hash = m_compiler_options.stable_hash();
+    m_stable_hash = vk_utils::fnv1a(&compiler_options_hash, sizeof(compiler_options_hash), m_stable_hash);
+    m_stable_hash = vk_utils::fnv1a(&m_precompiled_template, sizeof(m_precompiled_template), m_stable_hash);
     return hash;
   }
 
+  // Return the hash as calculated by hash().
+  size_t get_hash() const
+  {
+    // Call hash() first (this is done by Application::register_shaders).
+    ASSERT(m_hash != 0);
+    return m_hash;
+  }
+
+  // Return a hash of the same data as get_hash(), but one that is the same for every build (used for the key of SPIRVDiskCache).
+  uint64_t get_stable_hash() const
+  {
+    // Call hash() first (this is done by Application::register_shaders).
+    ASSERT(m_hash != 0);
+    return m_stable_hash;
+  }
+
   // Accessors.
   vk::ShaderStageFlagBits stage() const { return m_stage; }
   std::string const& name() const { return m_name; }
   std::string_view glsl_template_code() const { return m_glsl_template_code; }
   ShaderCompilerOptions const& compiler_options() const { return m_compiler_options; }
+  bool is_precompiled_template() const { return m_precompiled_template; }
 
   // Called by ShaderCompiler.
   shaderc_shader_kind get_shader_kind() const;
@@ -49,6 +49,7 @@ void ShaderResourceDeclarationContext::glsl_id_prefix_is_used_in(std::string gls
   {
     case vk::DescriptorType::eCombinedImageSampler:
     case vk::DescriptorType::eUniformBuffer:
+    case vk::DescriptorType::eUniformBufferDynamic:
       //FIXME: Is this correct? Can't I use this for every type?
       update_binding(shader_resource_declaration);
       break;
@@ -90,8 +91,14 @@ std::string ShaderResourceDeclarationContext::generate(vk::ShaderStageFlagBits s
     ShaderResourceDeclaration const* shader_resource_declaration = shader_resource_binding_pair.first;
     if (!(shader_resource_declaration->stage_flags() & shader_stage))
       continue;
-    descriptor::SetIndex set_index = m_set_binding_map->convert(shader_resource_declaration->set_index_hint());
-    uint32_t binding = m_set_binding_map->convert(shader_resource_declaration->set_index_hint(), shader_resource_binding_pair.second);
+    // In precompiled-template mode, use the hints as placeholders; they are patched in the SPIR-V code (see SPIRVCache::patch_from_template).
+    descriptor::SetIndex set_index{shader_resource_declaration->set_index_hint().get_value()};
+    uint32_t binding = shader_resource_binding_pair.second;
+    if (m_set_binding_map)
+    {
+      set_index = m_set_binding_map->convert(shader_resource_declaration->set_index_hint());
+      binding = m_set_binding_map->convert(shader_resource_declaration->set_index_hint(), binding);
+    }
 
     switch (shader_resource_declaration->descriptor_type())
     {
@@ -111,6 +118,7 @@ std::string ShaderResourceDeclarationContext::generate(vk::ShaderStageFlagBits s
         break;
       }
       case vk::DescriptorType::eUniformBuffer:
+      case vk::DescriptorType::eUniformBufferDynamic:   // The GLSL declaration doesn't depend on the offset being dynamic.
       {
         // struct TopPosition {
         //   mat2 unused1;
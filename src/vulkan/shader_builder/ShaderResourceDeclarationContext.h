@@ -18,7 +18,7 @@ struct ShaderResourceDeclarationContext final : DeclarationContext
   std::map<ShaderResourceDeclaration const*, uint32_t> m_bindings;
 
   pipeline::ShaderInputData* const m_owning_shader_input_data;
-  descriptor::SetBindingMap const* m_set_binding_map;
+  descriptor::SetBindingMap const* m_set_binding_map = nullptr;         // If nullptr, generate uses the set index hints and binding hints (precompiled-template mode).
 
  public:
   ShaderResourceDeclarationContext(pipeline::ShaderInputData* owning_shader_input_data) :
@@ -49,6 +49,7 @@ std::string ShaderResourceVariable::substitution() const
   switch (m_shader_resource_declaration_ptr->descriptor_type())
   {
     case vk::DescriptorType::eUniformBuffer:
+    case vk::DescriptorType::eUniformBufferDynamic:
     {
       std::string prefix = this->prefix();
       std::size_t const prefix_hash = std::hash<std::string>{}(prefix);
@@ -0,0 +1,132 @@
+#include "sys.h"
+#include "SubstitutionTrie.h"
+#include <algorithm>
+#include <limits>
+#include "debug.h"
+
+namespace vulkan::shader_builder {
+
+void SubstitutionTrie::clear()
+{
+  m_added.clear();
+  m_char_to_column.fill(0);
+  m_columns = 1;
+  m_transitions.clear();
+  m_replacement_index.clear();
+  m_replacements.clear();
+  m_max_growth = 0;
+  m_min_pattern_length = 0;
+}
+
+void SubstitutionTrie::build()
+{
+  std::vector<std::pair<std::string, std::string>> added = std::move(m_added);
+  clear();
+
+  // Assign a column to every character that occurs in any of the patterns.
+  for (auto const& pattern_replacement : added)
+  {
+    // Patterns may not be empty.
+    ASSERT(!pattern_replacement.first.empty());
+    for (char c : pattern_replacement.first)
+    {
+      uint8_t& column = m_char_to_column[static_cast<unsigned char>(c)];
+      if (column == 0)
+      {
+        // Column zero is reserved, so only 255 distinct characters are supported.
+        ASSERT(m_columns < 256);
+        column = m_columns++;
+      }
+    }
+  }
+
+  // Create the root node.
+  m_transitions.resize(m_columns, root);
+  m_replacement_index.push_back(-1);
+  m_min_pattern_length = std::numeric_limits<size_t>::max();
+
+  for (auto& pattern_replacement : added)
+  {
+    std::string const& pattern = pattern_replacement.first;
+    node_type node = root;
+    for (char c : pattern)
+    {
+      size_t const transition = node * m_columns + m_char_to_column[static_cast<unsigned char>(c)];
+      if (m_transitions[transition] == root)
+      {
+        node_type const new_node = m_replacement_index.size();
+        m_transitions[transition] = new_node;       // Do this before the resize, because that invalidates transition.
+        m_transitions.resize(m_transitions.size() + m_columns, root);
+        m_replacement_index.push_back(-1);
+      }
+      node = m_transitions[transition];
+    }
+    if (m_replacement_index[node] == -1)
+    {
+      m_replacement_index[node] = m_replacements.size();
+      m_replacements.emplace_back();
+    }
+    std::string& replacement = m_replacements[m_replacement_index[node]];
+    replacement = std::move(pattern_replacement.second);
+    if (replacement.size() > pattern.size())
+      m_max_growth = std::max(m_max_growth, replacement.size() - pattern.size());
+    m_min_pattern_length = std::min(m_min_pattern_length, pattern.size());
+  }
+
+  if (m_replacements.empty())
+    m_min_pattern_length = 0;
+}
+
+void SubstitutionTrie::substitute(std::string_view source, std::string& output) const
+{
+  char const* const data = source.data();
+  size_t const size = source.size();
+
+  if (m_replacements.empty())
+  {
+    output.append(data, size);
+    return;
+  }
+
+  size_t copied = 0;    // Everything before this position was already appended to output.
+  size_t pos = 0;
+  while (pos < size)
+  {
+    // The row of the root node in m_transitions is the first m_columns entries,
+    // and column zero is used for characters that don't occur in any pattern,
+    // hence this is non-zero if and only if a pattern starts with this character.
+    node_type node = m_transitions[m_char_to_column[static_cast<unsigned char>(data[pos])]];
+    if (node == root)
+    {
+      ++pos;
+      continue;
+    }
+    // Find the longest pattern that starts at pos.
+    int32_t replacement_index = m_replacement_index[node];
+    size_t match_end = replacement_index == -1 ? 0 : pos + 1;
+    for (size_t end = pos + 1; end < size; ++end)
+    {
+      node = m_transitions[node * m_columns + m_char_to_column[static_cast<unsigned char>(data[end])]];
+      if (node == root)
+        break;
+      if (m_replacement_index[node] != -1)
+      {
+        replacement_index = m_replacement_index[node];
+        match_end = end + 1;
+      }
+    }
+    if (match_end == 0)
+    {
+      ++pos;
+      continue;
+    }
+    // Copy the characters leading up to the match, followed by the replacement.
+    output.append(data + copied, pos - copied);
+    output += m_replacements[replacement_index];
+    pos = copied = match_end;
+  }
+  // Copy the remaining characters.
+  output.append(data + copied, size - copied);
+}
+
+} // namespace vulkan::shader_builder
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace vulkan::shader_builder {
+
+// A trie over a set of patterns, each with a replacement string.
+//
+// Used by ShaderInputData::preprocess2 to replace every occurrence of the
+// glsl_id_full of all ShaderVariable's in the template source code with
+// their substitution, in a single left to right scan over the source.
+//
+// At each position in the source the longest matching pattern is replaced,
+// after which scanning continues immediately after that match. Runs of
+// characters that do not start any pattern are copied in one go.
+//
+// Usage:
+//
+//   SubstitutionTrie trie;
+//   trie.add("MyPushConstant::m_x", "m_x");
+//   ...
+//   trie.build();
+//   std::string output;
+//   trie.substitute(source, output);   // Appends to output.
+//
+class SubstitutionTrie
+{
+ private:
+  using node_type = uint32_t;
+  static constexpr node_type root = 0;                          // The root node; since it is nobody's child, zero is also used to mean 'no transition'.
+
+  std::vector<std::pair<std::string, std::string>> m_added;     // Patterns and replacements that were added, but not built yet.
+
+  std::array<uint8_t, 256> m_char_to_column{};                  // Maps characters to a column in m_transitions. Zero if the character doesn't occur in any pattern.
+  size_t m_columns = 1;                                         // The number of distinct characters in all patterns plus one (for column zero).
+  std::vector<node_type> m_transitions;                         // m_transitions[node * m_columns + column] is the child of node, or root if there is none.
+  std::vector<int32_t> m_replacement_index;                     // Per node: an index into m_replacements if a pattern ends in that node, otherwise -1.
+  std::vector<std::string> m_replacements;                      // The replacement strings.
+  size_t m_max_growth = 0;                                      // The largest difference in length between a replacement and its pattern, or zero.
+  size_t m_min_pattern_length = 0;                              // The length of the shortest pattern.
+
+ public:
+  // Add a pattern with its replacement. Patterns may not be empty.
+  // If the same pattern is added more than once then the last replacement is used.
+  void add(std::string pattern, std::string replacement)
+  {
+    m_added.emplace_back(std::move(pattern), std::move(replacement));
+  }
+
+  // Build the trie from all patterns that were added (and forget them).
+  void build();
+
+  // Remove everything.
+  void clear();
+
+  // Return true if no patterns were built.
+  bool empty() const { return m_replacements.empty(); }
+
+  // Return an upper bound of the number of characters that substitute appends for source.
+  size_t max_output_size(std::string_view source) const
+  {
+    return source.size() + (m_min_pattern_length == 0 ? 0 : source.size() / m_min_pattern_length * m_max_growth);
+  }
+
+  // Append source to output, with every pattern replaced with its replacement.
+  void substitute(std::string_view source, std::string& output) const;
+};
+
+} // namespace vulkan::shader_builder
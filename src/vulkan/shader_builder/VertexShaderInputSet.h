@@ -41,6 +41,8 @@ class VertexShaderInputSetFeeder final : public DataFeeder
   int chunk_count() const override { return m_input_set->chunk_count(); }
   int next_batch() override { return m_input_set->next_batch(); }
   void get_chunks(unsigned char* chunk_ptr) override { m_input_set->get_chunks(chunk_ptr); }
+  bool supports_fill_range() const override { return m_input_set->supports_fill_range(); }
+  void fill_range(int begin, int end, unsigned char* chunk_ptr) const override { m_input_set->fill_range(begin, end, chunk_ptr); }
 };
 
 // ENTRY should be a struct existing solely of types specified in math/glsl.h,
@@ -93,11 +95,25 @@ class VertexShaderInputSet : public VertexShaderInputSetBase
 
   virtual void create_entry(ENTRY* input_entry_ptr) = 0;
 
+  // Override this, together with supports_fill_range (returning true), if the entries can be generated in any order.
+  // This allows CopyDataToGPU to generate them in parallel, using the thread pool.
+  virtual void create_entries(int /*begin*/, int /*end*/, ENTRY* /*input_entry_ptr*/) const
+  {
+    // Only call fill_range when supports_fill_range() returns true.
+    THROW_ALERT("VertexShaderInputSet::create_entries called on an input set that doesn't support it");
+  }
+
   void get_chunks(unsigned char* chunk_ptr) override final
   {
     ASSERT(reinterpret_cast<size_t>(chunk_ptr) % alignof(ENTRY) == 0);
     create_entry(reinterpret_cast<ENTRY*>(chunk_ptr));
   }
+
+  void fill_range(int begin, int end, unsigned char* chunk_ptr) const override final
+  {
+    ASSERT(reinterpret_cast<size_t>(chunk_ptr) % alignof(ENTRY) == 0);
+    create_entries(begin, end, reinterpret_cast<ENTRY*>(chunk_ptr));
+  }
 };
 
 } // namespace vulkan::shader_builder
@@ -1,5 +1,6 @@
 #include "sys.h"
 #include "Base.h"
+#include "descriptor/DescriptorSetCache.h"
 #ifdef CWDEBUG
 #include <iomanip>
 #endif
@@ -7,6 +8,13 @@
 
 namespace vulkan::shader_builder::shader_resource {
 
+Base::~Base()
+{
+  // The descriptor sets that this shader resource is bound to can no longer be used by new pipelines.
+  if (descriptor::DescriptorSetCache* descriptor_set_cache = m_descriptor_set_cache.load(std::memory_order_relaxed))
+    descriptor_set_cache->remove(m_descriptor_set_key);
+}
+
 #ifdef CWDEBUG
 bool SetMutexAndSetHandles::lock_descriptor_sets(AIStatefulTask* task, AIStatefulTask::condition_type condition)
 {
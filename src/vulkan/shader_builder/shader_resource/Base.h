@@ -2,8 +2,10 @@
 
 #include "descriptor/SetLayout.h"
 #include "descriptor/SetLayoutBinding.h"
+#include "descriptor/DescriptorUpdateBatch.h"
 #include "threadsafe/aithreadsafe.h"
 #include <vulkan/vulkan.hpp>
+#include <atomic>
 #ifdef CWDEBUG
 #include "debug/DebugSetName.h"
 #endif
@@ -13,6 +15,10 @@ namespace task {
 class SynchronousWindow;
 } // namespace task
 
+namespace vulkan::descriptor {
+class DescriptorSetCache;
+} // namespace vulkan::descriptor
+
 namespace vulkan::shader_builder {
 class ShaderResourceDeclaration;
 
@@ -96,6 +102,8 @@ class Base
   descriptor::SetKey m_descriptor_set_key;
   using set_layout_bindings_to_handles_t = aithreadsafe::Wrapper<set_layout_bindings_to_handles_container_t, aithreadsafe::policy::ReadWrite<AIReadWriteMutex>>;
   mutable set_layout_bindings_to_handles_t m_set_layout_bindings_to_handles;
+  // The descriptor set cache that contains descriptor sets that this shader resource is bound to, if any (see cached_in).
+  mutable std::atomic<descriptor::DescriptorSetCache*> m_descriptor_set_cache{nullptr};
 
 #ifdef CWDEBUG
  private:
@@ -127,6 +135,9 @@ class Base
   // Disallow copy and move constructing.
   Base(Base const& rhs) = delete;
 
+  // Removes the descriptor sets that this shader resource is bound to from the descriptor set cache.
+  ~Base();
+
   //---------------------------------------------------------------------------
   // The call to create and update_descriptor_set must happen after acquire_lock returned true,
   // followed by a call to set_created and before the accompanied call to release_lock.
@@ -190,6 +201,14 @@ class Base
     iter->second.unlock_descriptor_sets(CWDEBUG_ONLY(task));
   }
 
+  // Called when a descriptor set that this shader resource is bound to was added to descriptor_set_cache.
+  // All descriptor sets of a shader resource belong to the same logical device, and thus to the same cache.
+  void cached_in(descriptor::DescriptorSetCache* descriptor_set_cache) /*thread-safe*/ const
+  {
+    [[maybe_unused]] descriptor::DescriptorSetCache* previous = m_descriptor_set_cache.exchange(descriptor_set_cache, std::memory_order_relaxed);
+    ASSERT(!previous || previous == descriptor_set_cache);
+  }
+
   void set_created()
   {
     m_created.store(true, std::memory_order::release);
@@ -207,7 +226,8 @@ class Base
   }
 
   virtual void create(task::SynchronousWindow const* owning_window) = 0;
-  virtual void update_descriptor_set(task::SynchronousWindow const* owning_window, vk::DescriptorSet vh_descriptor_set, uint32_t binding) const = 0;
+  // Add the write that binds this shader resource to binding `binding` of vh_descriptor_set to update_batch.
+  virtual void update_descriptor_set(descriptor::DescriptorUpdateBatch& update_batch, vk::DescriptorSet vh_descriptor_set, uint32_t binding) const = 0;
   virtual void ready() = 0;
   //---------------------------------------------------------------------------
 
@@ -15,7 +15,7 @@ void Texture::create(task::SynchronousWindow const* owning_window)
 #endif
 }
 
-void Texture::update_descriptor_set(task::SynchronousWindow const* owning_window, vk::DescriptorSet vh_descriptor_set, uint32_t binding) const
+void Texture::update_descriptor_set(descriptor::DescriptorUpdateBatch& update_batch, vk::DescriptorSet vh_descriptor_set, uint32_t binding) const
 {
   // Update vh_descriptor_set binding `binding` with this texture.
   std::vector<vk::DescriptorImageInfo> image_infos = {
@@ -25,7 +25,7 @@ void Texture::update_descriptor_set(task::SynchronousWindow const* owning_window
       .imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal
     }
   };
-  owning_window->logical_device()->update_descriptor_set(vh_descriptor_set, vk::DescriptorType::eCombinedImageSampler, binding, 0 /*array_element*/, image_infos);
+  update_batch.add(vh_descriptor_set, vk::DescriptorType::eCombinedImageSampler, binding, 0 /*array_element*/, image_infos);
 }
 
 #ifdef CWDEBUG
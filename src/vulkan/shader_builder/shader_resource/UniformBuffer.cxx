@@ -10,27 +10,26 @@ void UniformBufferBase::create(task::SynchronousWindow const* owning_window)
 #ifdef CWDEBUG
   add_ambifix(owning_window->debug_name_prefix("PipelineFactory::"));
 #endif
+  memory::UniformRingBuffer const& uniform_ring_buffer = owning_window->uniform_ring_buffer();
+  memory::UniformRingBuffer::Slot const slot = uniform_ring_buffer.allocate(size());
+  m_vh_buffer = slot.m_vh_buffer;
+  m_offset = slot.m_offset;
   for (vulkan::FrameResourceIndex i{0}; i != owning_window->max_number_of_frame_resources(); ++i)
-  {
-    m_uniform_buffers.emplace_back(owning_window->logical_device(), size()
-      COMMA_CWDEBUG_ONLY(ambifix() + "[" + to_string(i) + "]"));
-  }
+    m_uniform_buffers.push_back({ .m_pointer = uniform_ring_buffer.pointer(i, slot) });
 }
 
-void UniformBufferBase::update_descriptor_set(task::SynchronousWindow const* owning_window, vk::DescriptorSet vh_descriptor_set, uint32_t binding) const
+void UniformBufferBase::update_descriptor_set(descriptor::DescriptorUpdateBatch& update_batch, vk::DescriptorSet vh_descriptor_set, uint32_t binding) const
 {
-  // FIXME: not implemented: currently we're only using the first frame resource!
-  vulkan::FrameResourceIndex const hack0{0};
-
-  // Information about the buffer we want to point at in the descriptor.
+  // Information about the buffer we want to point at in the descriptor: the slice in the first region.
+  // The region of the current frame is selected with a dynamic offset (see SynchronousWindow::dynamic_offsets).
   std::vector<vk::DescriptorBufferInfo> buffer_infos = {
     {
-      .buffer = m_uniform_buffers[hack0].m_vh_buffer,
-      .offset = 0,
+      .buffer = m_vh_buffer,
+      .offset = m_offset,
       .range = size()
     }
   };
-  owning_window->logical_device()->update_descriptor_set(vh_descriptor_set, vk::DescriptorType::eUniformBuffer, binding, 0 /*array_element*/, {}, buffer_infos);
+  update_batch.add(vh_descriptor_set, vk::DescriptorType::eUniformBufferDynamic, binding, 0 /*array_element*/, buffer_infos);
   //create_uniform_buffers
 }
 
@@ -49,7 +48,9 @@ void UniformBufferBase::print_on(std::ostream& os) const
   os << "(Base)";
   Base::print_on(os);
   os << ", m_members:" << m_members <<
-        ", m_uniform_buffers:" << m_uniform_buffers;
+        ", m_uniform_buffers:" << m_uniform_buffers <<
+        ", m_vh_buffer:" << m_vh_buffer <<
+        ", m_offset:" << m_offset;
   os << '}';
 }
 #endif
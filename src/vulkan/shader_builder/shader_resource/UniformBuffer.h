@@ -7,7 +7,7 @@
 #include "shader_builder/ShaderVariableLayouts.h"
 #include "shader_builder/ShaderResourceMember.h"
 #include "shader_resource/UniformBuffer.h"
-#include "memory/UniformBuffer.h"
+#include "memory/UniformRingBuffer.h"
 #include "utils/Vector.h"
 #ifdef CWDEBUG
 #include "debug/vulkan_print_on.h"
@@ -25,7 +25,9 @@ class UniformBufferBase : public Base
  protected:
   using members_container_t = ShaderResourceMember::container_t;
   members_container_t m_members;                                                // The members of ENTRY (of the derived class).
-  utils::Vector<memory::UniformBuffer, FrameResourceIndex> m_uniform_buffers;   // The actual uniform buffer(s), one for each frame resource.
+  utils::Vector<memory::UniformBufferSlice, FrameResourceIndex> m_uniform_buffers;     // The memory of this uniform buffer, one slice for each frame resource.
+  vk::Buffer m_vh_buffer;                                                             // The block of the uniform ring buffer of the owning window that the slices are part of.
+  vk::DeviceSize m_offset{};                                                          // The offset of the slices relative to the start of each region of that buffer.
 
   template<typename ContainingClass, glsl::Standard Standard, glsl::ScalarIndex ScalarIndex, int Rows, int Cols, size_t Alignment, size_t Size, size_t ArrayStride,
       int MemberIndex, size_t MaxAlignment, size_t Offset, utils::TemplateStringLiteral GlslIdStr>
@@ -40,9 +42,9 @@ class UniformBufferBase : public Base
   UniformBufferBase(int number_of_members COMMA_CWDEBUG_ONLY(char const* debug_name)) :
     Base(descriptor::SetKeyContext::instance() COMMA_CWDEBUG_ONLY(debug_name)) { }
 
-  // Create the memory::UniformBuffer's of m_uniform_buffers.
+  // Allocate the slices of m_uniform_buffers from the uniform ring buffer of owning_window.
   void create(task::SynchronousWindow const* owning_window) override;
-  void update_descriptor_set(task::SynchronousWindow const* owning_window, vk::DescriptorSet vh_descriptor_set, uint32_t binding) const override;
+  void update_descriptor_set(descriptor::DescriptorUpdateBatch& update_batch, vk::DescriptorSet vh_descriptor_set, uint32_t binding) const override;
 
   // Accessors.
   members_container_t const& members() const { return m_members; }
@@ -54,7 +56,7 @@ class UniformBufferBase : public Base
 };
 
 template<typename ENTRY>
-struct UniformBufferInstance : public memory::UniformBuffer
+struct UniformBufferInstance : public memory::UniformBufferSlice
 {
   // This class may not define any members!
 };
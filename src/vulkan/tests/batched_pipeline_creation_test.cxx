@@ -0,0 +1,148 @@
+// Test the handling of (partial) failures of batched pipeline creation by pipeline::create_in_batch,
+// as used by LogicalDevice::create_graphics_pipelines when PipelineFactory::set_batch_size was called
+// with a value larger than one.
+//
+// A driver can not be made to fail for a specific create info, therefore vkCreateGraphicsPipelines
+// is replaced by a stand-in that does what the specification says: create every pipeline that it
+// can and set the handles of the ones that failed to null.
+
+#include "sys.h"
+#include "pipeline/create_in_batch.h"
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+#include "debug.h"
+
+namespace {
+
+int s_live_objects = 0;
+
+struct StandInPipeline
+{
+  int m_id;
+
+  StandInPipeline(int id) : m_id(id) { ++s_live_objects; }
+  ~StandInPipeline() { --s_live_objects; }
+};
+
+using UniqueStandInPipeline = std::unique_ptr<StandInPipeline>;
+
+struct StandInCreateInfo
+{
+  int m_id;
+  bool m_fails_in_batch;        // Creation fails when done as part of a batch.
+  bool m_fails_singly;          // Creation also fails when done on its own.
+};
+
+struct Calls
+{
+  int m_batch = 0;
+  int m_single = 0;
+};
+
+std::vector<UniqueStandInPipeline> create(std::vector<StandInCreateInfo> const& create_infos, Calls& calls)
+{
+  return vulkan::pipeline::create_in_batch<UniqueStandInPipeline, StandInPipeline*>(vk::ArrayProxy<StandInCreateInfo const>(create_infos),
+      [&](uint32_t count, StandInCreateInfo const* infos, StandInPipeline** pipelines_out){
+        ++calls.m_batch;
+        vk::Result result = vk::Result::eSuccess;
+        for (uint32_t i = 0; i < count; ++i)
+        {
+          if (infos[i].m_fails_in_batch)
+          {
+            pipelines_out[i] = nullptr;
+            result = vk::Result::eErrorOutOfDeviceMemory;
+          }
+          else
+            pipelines_out[i] = new StandInPipeline(infos[i].m_id);
+        }
+        return result;
+      },
+      [](StandInPipeline* pipeline){
+        return UniqueStandInPipeline(pipeline);
+      },
+      [&](StandInCreateInfo const& info){
+        ++calls.m_single;
+        if (info.m_fails_singly)
+          throw std::runtime_error("vkCreateGraphicsPipelines: VK_ERROR_OUT_OF_DEVICE_MEMORY");
+        return UniqueStandInPipeline(new StandInPipeline(info.m_id));
+      });
+}
+
+bool in_order(std::vector<UniqueStandInPipeline> const& pipelines, std::vector<StandInCreateInfo> const& create_infos)
+{
+  if (pipelines.size() != create_infos.size())
+    return false;
+  for (size_t i = 0; i < pipelines.size(); ++i)
+    if (!pipelines[i] || pipelines[i]->m_id != create_infos[i].m_id)
+      return false;
+  return true;
+}
+
+} // namespace
+
+int main()
+{
+  Debug(NAMESPACE_DEBUG::init());
+
+  bool success = true;
+
+  // A batch of four pipelines that are all created.
+  {
+    std::vector<StandInCreateInfo> const create_infos{ { 0, false, false }, { 1, false, false }, { 2, false, false }, { 3, false, false } };
+    Calls calls;
+    {
+      std::vector<UniqueStandInPipeline> pipelines = create(create_infos, calls);
+      if (!in_order(pipelines, create_infos) || calls.m_batch != 1 || calls.m_single != 0)
+      {
+        std::cerr << "FAILURE: a successful batch was not returned as-is." << std::endl;
+        success = false;
+      }
+    }
+  }
+
+  // A batch of four pipelines of which two fail, but succeed when created on their own.
+  {
+    std::vector<StandInCreateInfo> const create_infos{ { 0, false, false }, { 1, true, false }, { 2, false, false }, { 3, true, false } };
+    Calls calls;
+    {
+      std::vector<UniqueStandInPipeline> pipelines = create(create_infos, calls);
+      if (!in_order(pipelines, create_infos) || calls.m_batch != 1 || calls.m_single != 2)
+      {
+        std::cerr << "FAILURE: the failed pipelines of a batch were not recreated singly, in order." << std::endl;
+        success = false;
+      }
+    }
+  }
+
+  // A batch of four pipelines of which one really fails: the error must be thrown and nothing may leak.
+  {
+    std::vector<StandInCreateInfo> const create_infos{ { 0, false, false }, { 1, false, false }, { 2, true, true }, { 3, false, false } };
+    Calls calls;
+    bool threw = false;
+    try
+    {
+      std::vector<UniqueStandInPipeline> pipelines = create(create_infos, calls);
+    }
+    catch (std::runtime_error const&)
+    {
+      threw = true;
+    }
+    if (!threw || calls.m_single != 1)
+    {
+      std::cerr << "FAILURE: the error of a failing pipeline was not thrown." << std::endl;
+      success = false;
+    }
+  }
+
+  if (s_live_objects != 0)
+  {
+    std::cerr << "FAILURE: " << s_live_objects << " pipelines were leaked." << std::endl;
+    success = false;
+  }
+
+  if (!success)
+    return 1;
+  std::cout << "Success." << std::endl;
+}
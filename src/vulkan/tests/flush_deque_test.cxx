@@ -0,0 +1,146 @@
+// Test of vk_utils::flush_deque, the batch drain done by TaskToTaskDeque::flush_new_data.
+//
+// All data must be passed to the lambda exactly once and, per producer, in the order it was added;
+// also when producers keep adding data while the consumer is draining, and when the lambda throws
+// (the remaining data of the batch is then passed on the next call).
+//
+// TaskToTaskDeque itself needs a running Application (for its allocator) and an engine,
+// therefore only the shared drain code is driven directly, with the same container type.
+
+#include "sys.h"
+#include "statefultask/DefaultMemoryPagePool.h"
+#include "threadsafe/aithreadsafe.h"
+#include "utils/DequeAllocator.h"
+#include "vk_utils/flush_deque.h"
+#include <atomic>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include "debug.h"
+
+namespace {
+
+bool success = true;
+
+void check(bool condition, char const* what)
+{
+  if (!condition)
+  {
+    std::cerr << "FAILURE: " << what << std::endl;
+    success = false;
+  }
+}
+
+struct Datum
+{
+  int m_producer;
+  int m_sequence_number;
+};
+
+using deque_allocator_type = utils::DequeAllocator<Datum>;
+using container_type = std::deque<Datum, deque_allocator_type>;
+using new_data_type = aithreadsafe::Wrapper<container_type, aithreadsafe::policy::Primitive<std::mutex>>;
+
+struct Consumer
+{
+  new_data_type m_new_data;
+  container_type m_consumer_data;
+  std::vector<int> m_next_sequence_number;      // Per producer: the sequence number of the next datum that must be processed.
+  bool m_in_order = true;
+
+  Consumer(deque_allocator_type& allocator, int number_of_producers) :
+    m_new_data(allocator), m_consumer_data(allocator), m_next_sequence_number(number_of_producers, 0) { }
+
+  void process(Datum&& datum)
+  {
+    m_in_order &= datum.m_sequence_number == m_next_sequence_number[datum.m_producer]++;
+  }
+
+  void flush()
+  {
+    vk_utils::flush_deque(m_new_data, m_consumer_data, [this](Datum&& datum){ process(std::move(datum)); });
+  }
+};
+
+} // namespace
+
+int main()
+{
+  Debug(NAMESPACE_DEBUG::init());
+
+  AIMemoryPagePool mpp;
+  utils::DequeMemoryResource::Initialization dmri(mpp.instance());      // For the internal tables of all std::deque<T, utils::DequeAllocator<T>>'s.
+  utils::NodeMemoryResource deque512_nmr(mpp.instance(), 512);          // Like Application::m_deque512_nmr.
+  deque_allocator_type allocator(deque512_nmr);
+
+  // Nothing to flush.
+  {
+    Consumer consumer(allocator, 1);
+    int calls = 0;
+    vk_utils::flush_deque(consumer.m_new_data, consumer.m_consumer_data, [&](Datum&&){ ++calls; });
+    check(calls == 0, "flushing an empty deque doesn't call the lambda.");
+  }
+
+  // The lambda throws halfway a batch.
+  {
+    Consumer consumer(allocator, 1);
+    for (int i = 0; i < 10; ++i)
+      new_data_type::wat(consumer.m_new_data)->push_back({0, i});
+    bool thrown = false;
+    try
+    {
+      vk_utils::flush_deque(consumer.m_new_data, consumer.m_consumer_data, [&](Datum&& datum){
+        if (datum.m_sequence_number == 4)
+          throw std::runtime_error("lambda failed");
+        consumer.process(std::move(datum));
+      });
+    }
+    catch (std::runtime_error const&)
+    {
+      thrown = true;
+    }
+    check(thrown && consumer.m_next_sequence_number[0] == 4, "data before the one that threw was processed.");
+    // The datum that threw is lost, the rest of the batch is not.
+    consumer.m_next_sequence_number[0] = 5;
+    new_data_type::wat(consumer.m_new_data)->push_back({0, 10});
+    consumer.flush();
+    check(consumer.m_in_order && consumer.m_next_sequence_number[0] == 11, "the rest of a batch is processed by the next flush, before new data.");
+  }
+
+  // Producers keep adding data while the consumer drains.
+  {
+    constexpr int number_of_producers = 4;
+    constexpr int data_per_producer = 100000;
+    Consumer consumer(allocator, number_of_producers);
+    std::atomic_int producers_running = number_of_producers;
+    std::vector<std::thread> producers;
+    for (int p = 0; p < number_of_producers; ++p)
+      producers.emplace_back([&, p](){
+        for (int i = 0; i < data_per_producer; ++i)
+          new_data_type::wat(consumer.m_new_data)->push_back({p, i});
+        producers_running.fetch_sub(1, std::memory_order_release);
+      });
+    // The consumer; like a task that is woken up by need_action.
+    for (;;)
+    {
+      bool const producers_finished = producers_running.load(std::memory_order_acquire) == 0;
+      consumer.flush();
+      if (producers_finished)
+        break;
+    }
+    for (std::thread& producer : producers)
+      producer.join();
+    bool all_processed = true;
+    for (int p = 0; p < number_of_producers; ++p)
+      all_processed &= consumer.m_next_sequence_number[p] == data_per_producer;
+    check(consumer.m_in_order, "the data of each producer is processed in order.");
+    check(all_processed, "all data is processed exactly once.");
+  }
+
+  if (!success)
+    return 1;
+  std::cout << "Success." << std::endl;
+}
@@ -0,0 +1,172 @@
+// Test of decoding images into staging memory with vk_utils::stbi::ImageData.
+//
+// PNG images are decoded with libpng (see ImageData::decode_png_into), other formats with stb_image.
+// Both must produce exactly the pixels that stbi_load produces, for every requested number of components.
+//
+// Tested are PNG images of all color types, bit depths, with and without tRNS chunk and interlaced,
+// written with libpng into a temporary directory, and the textures of the tests (src/tests/*/resources/textures).
+// A std::vector stands in for the mapped staging memory.
+//
+// Usage: image_data_test [<tests directory>]
+
+#include "sys.h"
+#include "vk_utils/ImageData.h"
+#include <png.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <vector>
+#include "debug.h"
+
+#ifndef TESTS_DIR
+#define TESTS_DIR "src/tests"
+#endif
+
+namespace {
+
+struct PngFormat
+{
+  char const* m_name;
+  int m_bit_depth;
+  int m_color_type;
+  bool m_interlaced;
+  bool m_trns;
+};
+
+// Write a PNG image of 33x17 pixels (odd sizes, so that rows are not aligned and all interlace passes are partial).
+void write_png(std::filesystem::path const& filename, PngFormat const& format)
+{
+  constexpr int width = 33;
+  constexpr int height = 17;
+  FILE* fp = std::fopen(filename.c_str(), "wb");
+  png_structp png = png_create_write_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
+  png_infop info = png_create_info_struct(png);
+  png_init_io(png, fp);
+  png_set_IHDR(png, info, width, height, format.m_bit_depth, format.m_color_type,
+      format.m_interlaced ? PNG_INTERLACE_ADAM7 : PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+  int const palette_size = 1 << std::min(format.m_bit_depth, 4);
+  if (format.m_color_type == PNG_COLOR_TYPE_PALETTE)
+  {
+    std::vector<png_color> palette(palette_size);
+    for (int i = 0; i < palette_size; ++i)
+      palette[i] = { static_cast<png_byte>(i * 16), static_cast<png_byte>(255 - i * 16), static_cast<png_byte>(i * 7) };
+    png_set_PLTE(png, info, palette.data(), palette_size);
+    if (format.m_trns)
+    {
+      png_byte alpha[] = { 0, 64, 128, 200 };
+      png_set_tRNS(png, info, alpha, 4, nullptr);
+    }
+  }
+  else if (format.m_trns)
+  {
+    png_color_16 transparent_color = { 0, 3, 3, 3, 3 };
+    png_set_tRNS(png, info, nullptr, 0, &transparent_color);
+  }
+  png_write_info(png, info);
+  int const channels = png_get_channels(png, info);
+  std::vector<png_byte> row((width * channels * format.m_bit_depth + 7) / 8);
+  int const passes = png_set_interlace_handling(png);
+  for (int pass = 0; pass < passes; ++pass)
+    for (int y = 0; y < height; ++y)
+    {
+      for (int x = 0; x < row.size(); ++x)
+      {
+        row[x] = x * 37 + y * 11 + x * y;
+        // Only use palette entries that exist.
+        if (format.m_color_type == PNG_COLOR_TYPE_PALETTE && format.m_bit_depth == 8)
+          row[x] %= palette_size;
+      }
+      png_write_row(png, row.data());
+    }
+  png_write_end(png, info);
+  png_destroy_write_struct(&png, &info);
+  std::fclose(fp);
+}
+
+// Return true if ImageData decodes filename into the same pixels as stbi_load does.
+bool decodes_like_stbi_load(std::filesystem::path const& filename, int requested_components)
+{
+  vk_utils::stbi::ImageData image_data(filename, requested_components);
+  // Add some guard bytes, to detect writing past the end.
+  constexpr size_t guard_size = 16;
+  std::vector<std::byte> staging_memory(image_data.size() + guard_size, std::byte{0xcd});
+  uint32_t const size = image_data.size();
+  vk_utils::stbi::ImageDataFeeder feeder(std::move(image_data));
+  feeder.next_batch();
+  feeder.get_chunks(reinterpret_cast<unsigned char*>(staging_memory.data()));
+
+  int width, height, components;
+  stbi_uc* expected = stbi_load(filename.c_str(), &width, &height, &components, requested_components);
+  bool const equal = expected && size == width * height * requested_components && std::memcmp(expected, staging_memory.data(), size) == 0;
+  stbi_image_free(expected);
+  for (size_t i = 0; i < guard_size; ++i)
+    if (staging_memory[size + i] != std::byte{0xcd})
+      return false;
+  return equal;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+  Debug(NAMESPACE_DEBUG::init());
+
+  std::filesystem::path const tests_dir = argc > 1 ? argv[1] : TESTS_DIR;
+
+  std::vector<std::filesystem::path> images;
+
+  PngFormat const formats[] = {
+    { "gray1",         1, PNG_COLOR_TYPE_GRAY,       false, false },
+    { "gray2",         2, PNG_COLOR_TYPE_GRAY,       false, false },
+    { "gray8",         8, PNG_COLOR_TYPE_GRAY,       false, false },
+    { "gray8_trns",    8, PNG_COLOR_TYPE_GRAY,       false, true },
+    { "gray16",       16, PNG_COLOR_TYPE_GRAY,       false, false },
+    { "gray_alpha8",   8, PNG_COLOR_TYPE_GRAY_ALPHA, false, false },
+    { "rgb8",          8, PNG_COLOR_TYPE_RGB,        false, false },
+    { "rgb8_trns",     8, PNG_COLOR_TYPE_RGB,        false, true },
+    { "rgb16",        16, PNG_COLOR_TYPE_RGB,        false, false },
+    { "rgba8",         8, PNG_COLOR_TYPE_RGBA,       false, false },
+    { "rgba16",       16, PNG_COLOR_TYPE_RGBA,       false, false },
+    { "palette4",      4, PNG_COLOR_TYPE_PALETTE,    false, false },
+    { "palette8_trns", 8, PNG_COLOR_TYPE_PALETTE,    false, true },
+    { "gray4_adam7",   4, PNG_COLOR_TYPE_GRAY,       true,  false },
+    { "rgb8_adam7",    8, PNG_COLOR_TYPE_RGB,        true,  false },
+    { "rgba8_adam7",   8, PNG_COLOR_TYPE_RGBA,       true,  false }
+    // Interlaced 16 bit images are not tested: stb_image v2.12 decodes those wrong (libpng doesn't).
+  };
+  std::filesystem::path const png_dir = std::filesystem::temp_directory_path() / "image_data_test";
+  std::filesystem::create_directories(png_dir);
+  for (PngFormat const& format : formats)
+  {
+    images.push_back(png_dir / (std::string{format.m_name} + ".png"));
+    write_png(images.back(), format);
+  }
+
+  // Add the textures of all tests.
+  for (auto const& test : std::filesystem::directory_iterator(tests_dir))
+  {
+    std::filesystem::path const textures_dir = test.path() / "resources" / "textures";
+    if (!std::filesystem::is_directory(textures_dir))
+      continue;
+    for (auto const& texture : std::filesystem::directory_iterator(textures_dir))
+      images.push_back(texture.path());
+  }
+
+  bool success = true;
+  for (std::filesystem::path const& image : images)
+    // Requesting zero components (as many as are in the file) is not tested: stb_image ignores the tRNS chunk then, libpng doesn't.
+    for (int requested_components = 1; requested_components <= 4; ++requested_components)
+      if (!decodes_like_stbi_load(image, requested_components))
+      {
+        std::cerr << "FAILURE: decoding " << image << " with " << requested_components << " components differs from stbi_load." << std::endl;
+        success = false;
+      }
+
+  std::filesystem::remove_all(png_dir);
+
+  if (!success)
+    return 1;
+  std::cout << "Success." << std::endl;
+}
@@ -0,0 +1,308 @@
+// Stress benchmark of ImmediateSubmitQueue.
+//
+// 10,000 tiny uploads (task::CopyDataToImage of 8x8 RGBA pixels) are started in small bursts,
+// round robin over 64 images, and go through the real upload path: the staging ring of the logical
+// device, QueuePool, ImmediateSubmitQueue (which batches the uploads into command buffers, tracks
+// the submits in InFlightSubmissions and retires them when their timeline semaphore value is reached)
+// and back to the CopyDataToImage task.
+//
+// Prints the wall clock time per upload, from starting the first upload until the last one finished,
+// and the CPU time used by the process (which includes that of the window, drawn at 11 frames per second).
+//
+// Because uploads to the same image are never put in the same batch (see ImmediateSubmitQueue::starts_new_batch),
+// the number of images bounds the number of uploads per command buffer.
+//
+// A logical device can only be created for a window, therefore this opens a (small) window.
+// Requires a Vulkan 1.2 capable device.
+
+#include "sys.h"
+#include "Application.inl.h"
+#include "ImageKind.h"
+#include "LogicalDevice.h"
+#include "infos/DeviceCreateInfo.h"
+#include "memory/DataFeeder.h"
+#include "memory/Image.h"
+#include "queues/CopyDataToImage.h"
+#include "tests/SingleButtonWindow.h"
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <vector>
+#include <sys/resource.h>
+#include "debug.h"
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+constexpr int number_of_uploads = 10000;
+constexpr int number_of_images = 64;
+constexpr vk::Extent2D image_extent{8, 8};
+constexpr uint32_t upload_size = image_extent.width * image_extent.height * 4;
+
+// The number of uploads that are started before the benchmark task yields: 1, 2, ..., 8, 1, 2, ...
+int burst_size(int burst) { return 1 + burst % 8; }
+
+double process_cpu_ms()
+{
+  rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1e3 + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1e-3;
+}
+
+class LogicalDevice : public vulkan::LogicalDevice
+{
+ public:
+  static constexpr int root_window_request_cookie = 1;
+  static constexpr int transfer_request_cookie = 2;
+
+  void prepare_logical_device(vulkan::DeviceCreateInfo& device_create_info) const override
+  {
+    using vulkan::QueueFlagBits;
+
+    device_create_info
+    .addQueueRequest({
+        .queue_flags = QueueFlagBits::eGraphics|QueueFlagBits::ePresentation,
+        .max_number_of_queues = 1,
+        .priority = 1.0,
+        .cookies = root_window_request_cookie})
+    .addQueueRequest({
+        .queue_flags = QueueFlagBits::eTransfer,
+        .max_number_of_queues = 2,
+        .cookies = transfer_request_cookie})
+#ifdef CWDEBUG
+    .setDebugName("LogicalDevice");
+#endif
+    ;
+  }
+};
+
+class ImmediateSubmitStressBenchmark : public vulkan::Application
+{
+  using vulkan::Application::Application;
+
+ private:
+  int thread_pool_number_of_worker_threads() const override
+  {
+    return 4;
+  }
+
+ public:
+  std::u8string application_name() const override
+  {
+    return u8"ImmediateSubmitStressBenchmark";
+  }
+};
+
+// Feeds upload_size bytes of a single color.
+class PixelFeeder final : public vulkan::DataFeeder
+{
+ private:
+  unsigned char m_value;
+
+ public:
+  PixelFeeder(unsigned char value) : m_value(value) { }
+
+  uint32_t chunk_size() const override { return upload_size; }
+  int chunk_count() const override { return 1; }
+  int next_batch() override { return 1; }
+  void get_chunks(unsigned char* chunk_ptr) override { std::memset(chunk_ptr, m_value, upload_size); }
+};
+
+// The task that starts all uploads.
+class Benchmark final : public AIStatefulTask
+{
+ private:
+  vulkan::Application* m_application;
+  boost::intrusive_ptr<task::LogicalDevice const> m_logical_device_task;
+  vulkan::LogicalDevice const* m_logical_device{};
+  std::vector<vulkan::memory::Image> m_images;
+  int m_started{};                                      // The number of uploads that were started.
+  int m_burst{};                                        // The number of bursts so far.
+  std::atomic_int m_finished{0};                        // The number of uploads that finished.
+  std::atomic_int m_failed{0};                          // The number of uploads that were aborted.
+  clock_type::time_point m_start_time;
+  double m_start_cpu_ms;
+
+ protected:
+  using direct_base_type = AIStatefulTask;
+
+  enum benchmark_state_type {
+    Benchmark_wait_for_logical_device = direct_base_type::state_end,
+    Benchmark_create_images,
+    Benchmark_start_uploads,
+    Benchmark_wait_for_uploads,
+    Benchmark_done
+  };
+
+ public:
+  static constexpr state_type state_end = Benchmark_done + 1;
+  static constexpr condition_type logical_device_index_available = 1;
+  static constexpr condition_type upload_finished = 2;
+
+  Benchmark(vulkan::Application* application, boost::intrusive_ptr<task::LogicalDevice const> logical_device_task COMMA_CWDEBUG_ONLY(bool debug = false)) :
+    AIStatefulTask(CWDEBUG_ONLY(debug)), m_application(application), m_logical_device_task(std::move(logical_device_task)) { }
+
+  // Return true if every upload finished successfully.
+  bool success() const { return m_failed == 0 && m_finished == number_of_uploads; }
+
+ private:
+  void start_upload();
+  void print_results();
+
+ protected:
+  ~Benchmark() override = default;
+
+  char const* condition_str_impl(condition_type condition) const override;
+  char const* state_str_impl(state_type run_state) const override;
+  char const* task_name_impl() const override;
+  void multiplex_impl(state_type run_state) override;
+};
+
+void Benchmark::start_upload()
+{
+  vulkan::memory::Image const& image = m_images[m_started % number_of_images];
+  // Every upload replaces the whole image: the previous content, and thus the order of the uploads to one image, doesn't matter.
+  auto copy_data_to_image = statefultask::create<task::CopyDataToImage>(m_logical_device, upload_size,
+      image.m_vh_image, image_extent, vk_defaults::ImageSubresourceRange{},
+      vk::ImageLayout::eUndefined, vk::AccessFlags(0), vk::PipelineStageFlagBits::eTopOfPipe,
+      vk::ImageLayout::eShaderReadOnlyOptimal, vk::AccessFlagBits::eShaderRead, vk::PipelineStageFlagBits::eFragmentShader
+      COMMA_CWDEBUG_ONLY(false));
+  copy_data_to_image->set_data_feeder(std::make_unique<PixelFeeder>(static_cast<unsigned char>(m_started)));
+  copy_data_to_image->run(m_application->low_priority_queue(), [this](bool success){
+    if (!success)
+      m_failed.fetch_add(1, std::memory_order_relaxed);
+    m_finished.fetch_add(1, std::memory_order_release);
+    signal(upload_finished);
+  });
+  ++m_started;
+}
+
+void Benchmark::print_results()
+{
+  double const cpu_ms = process_cpu_ms() - m_start_cpu_ms;
+  double const wall_ns = std::chrono::duration<double, std::nano>(clock_type::now() - m_start_time).count();
+  std::cout << number_of_uploads << " uploads of " << upload_size << " bytes to " << number_of_images << " images:\n";
+  std::cout << std::fixed << std::setprecision(1) <<
+    "  " << (wall_ns / number_of_uploads) << " ns per upload, CPU time: " << cpu_ms << " ms (" <<
+    (cpu_ms * 1e6 / number_of_uploads) << " ns per upload)" << std::endl;
+}
+
+char const* Benchmark::condition_str_impl(condition_type condition) const
+{
+  switch (condition)
+  {
+    AI_CASE_RETURN(logical_device_index_available);
+    AI_CASE_RETURN(upload_finished);
+  }
+  return direct_base_type::condition_str_impl(condition);
+}
+
+char const* Benchmark::state_str_impl(state_type run_state) const
+{
+  switch (run_state)
+  {
+    AI_CASE_RETURN(Benchmark_wait_for_logical_device);
+    AI_CASE_RETURN(Benchmark_create_images);
+    AI_CASE_RETURN(Benchmark_start_uploads);
+    AI_CASE_RETURN(Benchmark_wait_for_uploads);
+    AI_CASE_RETURN(Benchmark_done);
+  }
+  AI_NEVER_REACHED;
+}
+
+char const* Benchmark::task_name_impl() const
+{
+  return "Benchmark";
+}
+
+void Benchmark::multiplex_impl(state_type run_state)
+{
+  switch (run_state)
+  {
+    case Benchmark_wait_for_logical_device:
+      m_logical_device_task->m_logical_device_index_available_event.register_task(this, logical_device_index_available);
+      set_state(Benchmark_create_images);
+      wait(logical_device_index_available);
+      break;
+    case Benchmark_create_images:
+    {
+      m_logical_device = m_application->get_logical_device(m_logical_device_task->get_index());
+      static vulkan::ImageKind const image_kind({
+        .format = vk::Format::eR8G8B8A8Unorm,
+        .usage = vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled
+      });
+      static vulkan::ImageViewKind const image_view_kind(image_kind, {});
+      for (int i = 0; i < number_of_images; ++i)
+        m_images.emplace_back(m_logical_device, image_extent, image_view_kind,
+            vulkan::memory::Image::MemoryCreateInfo{ .properties = vk::MemoryPropertyFlagBits::eDeviceLocal }
+            COMMA_CWDEBUG_ONLY(vulkan::Ambifix{"Benchmark::m_images[" + std::to_string(i) + "]"}));
+      m_start_cpu_ms = process_cpu_ms();
+      m_start_time = clock_type::now();
+      set_state(Benchmark_start_uploads);
+      [[fallthrough]];
+    }
+    case Benchmark_start_uploads:
+      for (int i = burst_size(m_burst++); i > 0 && m_started < number_of_uploads; --i)
+        start_upload();
+      if (m_started < number_of_uploads)
+      {
+        // Give the other tasks a chance to run before the next burst.
+        yield();
+        break;
+      }
+      set_state(Benchmark_wait_for_uploads);
+      [[fallthrough]];
+    case Benchmark_wait_for_uploads:
+      if (m_finished.load(std::memory_order_acquire) < number_of_uploads)
+      {
+        wait(upload_finished);
+        break;
+      }
+      print_results();
+      set_state(Benchmark_done);
+      [[fallthrough]];
+    case Benchmark_done:
+      // All uploads finished; the images are no longer used.
+      m_images.clear();
+      m_application->quit();
+      finish();
+      break;
+  }
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+  Debug(NAMESPACE_DEBUG::init());
+
+  try
+  {
+    ImmediateSubmitStressBenchmark application;
+    application.initialize(argc, argv);
+
+    auto root_window = application.create_root_window<vulkan::WindowEvents, SingleButtonWindow>(
+        std::make_tuple([](SingleButtonWindow&){ }), {150, 50}, LogicalDevice::root_window_request_cookie, u8"immediate_submit_stress_benchmark");
+    auto logical_device_task = application.create_logical_device(std::make_unique<LogicalDevice>(), std::move(root_window));
+
+    auto benchmark = statefultask::create<Benchmark>(&application, logical_device_task);
+    benchmark->run(application.high_priority_queue());
+
+    application.run();
+
+    if (!benchmark->success())
+    {
+      std::cerr << "FAILURE: not every upload finished successfully." << std::endl;
+      return 1;
+    }
+  }
+  catch (AIAlert::Error const& error)
+  {
+    std::cerr << error << std::endl;
+    return 1;
+  }
+}
@@ -0,0 +1,93 @@
+// Test of InFlightSubmissions, the ring of submits that ImmediateSubmitQueue waits for.
+//
+// Submissions are pushed with consecutive signal values (starting at an arbitrary value, so that
+// the ring wraps around) and removed by pop_completed once the timeline semaphore counter reaches
+// their signal value: oldest first, releasing exactly the command buffers that each one used,
+// and returning the total number of requests of the removed submissions.
+
+#include "sys.h"
+#include "queues/InFlightSubmissions.h"
+#include <iostream>
+#include <vector>
+#include "debug.h"
+
+namespace {
+
+bool success = true;
+
+void check(bool condition, char const* what)
+{
+  if (!condition)
+  {
+    std::cerr << "FAILURE: " << what << std::endl;
+    success = false;
+  }
+}
+
+constexpr int max_command_buffers = 4;
+constexpr int capacity = 8;
+
+using in_flight_submissions_type = vulkan::InFlightSubmissions<int, max_command_buffers, capacity>;
+
+// Acquire number_of_command_buffers "command buffers" for the submission with signal value signal_value and push it.
+void submit(in_flight_submissions_type& submissions, uint64_t signal_value, int number_of_requests, int number_of_command_buffers)
+{
+  int* command_buffers = submissions.next_command_buffers(signal_value);
+  for (int i = 0; i < number_of_command_buffers; ++i)
+    command_buffers[i] = signal_value * max_command_buffers + i;
+  submissions.push(signal_value, number_of_requests, number_of_command_buffers);
+}
+
+} // namespace
+
+int main()
+{
+  Debug(NAMESPACE_DEBUG::init());
+
+  in_flight_submissions_type submissions;
+  check(submissions.empty() && !submissions.full(), "a new ring is empty.");
+
+  std::vector<int> released;
+  auto release = [&](int const* command_buffers, int count){
+    released.insert(released.end(), command_buffers, command_buffers + count);
+  };
+
+  // Start at a signal value that is not a multiple of the capacity.
+  uint64_t next_signal_value = 13;
+  uint64_t counter_value = 12;
+
+  for (int i = 0; i < capacity; ++i, ++next_signal_value)
+    submit(submissions, next_signal_value, i + 1, 1 + i % max_command_buffers);
+  check(submissions.full(), "the ring is full after capacity submissions.");
+
+  check(submissions.pop_completed(counter_value, release) == 0 && released.empty(), "nothing is removed before the counter reaches the first signal value.");
+
+  // Complete the first three submissions (signal values 13, 14 and 15).
+  counter_value = 15;
+  check(submissions.pop_completed(counter_value, release) == 1 + 2 + 3, "the requests of all completed submissions are returned.");
+  check(released == std::vector<int>{ 13 * 4, 14 * 4, 14 * 4 + 1, 15 * 4, 15 * 4 + 1, 15 * 4 + 2 }, "exactly the used command buffers of the completed submissions are released, oldest first.");
+  check(!submissions.full() && !submissions.empty(), "completed submissions make room.");
+
+  // Reuse the freed slots (this wraps around the end of the ring).
+  for (int i = 0; i < 3; ++i, ++next_signal_value)
+    submit(submissions, next_signal_value, 10, max_command_buffers);
+  check(submissions.full(), "freed slots are reused.");
+
+  // A counter that jumped past several signal values completes all of them.
+  released.clear();
+  counter_value = next_signal_value - 1;
+  int const requests = submissions.pop_completed(counter_value, release);
+  check(requests == 4 + 5 + 6 + 7 + 8 + 3 * 10, "a counter past the last signal value completes every submission.");
+  check(released.size() == 4 + 1 + 2 + 3 + 4 + 3 * max_command_buffers, "every used command buffer is released once.");
+  check(released.back() == static_cast<int>(counter_value * max_command_buffers + max_command_buffers - 1), "the newest submission is released last.");
+  check(submissions.empty(), "the ring is empty after all submissions completed.");
+
+  // After becoming empty, the next signal value starts a new sequence.
+  released.clear();
+  submit(submissions, next_signal_value, 1, 1);
+  check(submissions.pop_completed(next_signal_value, release) == 1 && released == std::vector<int>{ static_cast<int>(next_signal_value * max_command_buffers) }, "an emptied ring can be used again.");
+
+  if (!success)
+    return 1;
+  std::cout << "Success." << std::endl;
+}
@@ -0,0 +1,166 @@
+// Test of vk_utils::InsertOnlyHashMap, used for the layout caches of LogicalDevice.
+//
+// A number of threads realize the same descriptor set layouts at the same time, the way
+// LogicalDevice::realize_descriptor_set_layout does: a lock-free find, and on a miss create
+// the value without holding a lock and race to insert it. Every thread must end up with the
+// same element for a given key, and the values of the threads that lost the race must be destroyed.
+//
+// The key, hash and equality types are those of LogicalDevice::descriptor_set_layouts_container_t;
+// the value is a stand-in for vk::UniqueDescriptorSetLayout (that can't be created without a device)
+// that counts the number of live objects.
+
+#include "sys.h"
+#include "descriptor/SortedBindingsHash.h"
+#include "vk_utils/InsertOnlyHashMap.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+#include "debug.h"
+
+namespace {
+
+bool success = true;
+
+void check(bool condition, char const* what)
+{
+  if (!condition)
+  {
+    std::cerr << "FAILURE: " << what << std::endl;
+    success = false;
+  }
+}
+
+std::atomic_int s_live_layouts = 0;
+
+struct StandInLayout
+{
+  StandInLayout() { s_live_layouts.fetch_add(1, std::memory_order_relaxed); }
+  ~StandInLayout() { s_live_layouts.fetch_sub(1, std::memory_order_relaxed); }
+};
+
+using bindings_type = std::vector<vk::DescriptorSetLayoutBinding>;
+
+template<size_t number_of_buckets>
+using layouts_container_t = vk_utils::InsertOnlyHashMap<bindings_type, std::unique_ptr<StandInLayout>,
+      vulkan::descriptor::SortedBindingsHash, vulkan::descriptor::SortedBindingsEqual, number_of_buckets>;
+
+// Return a set of distinct sorted binding vectors.
+std::vector<bindings_type> make_keys(int number_of_keys)
+{
+  std::array<vk::DescriptorType, 3> const types = { vk::DescriptorType::eCombinedImageSampler, vk::DescriptorType::eUniformBuffer, vk::DescriptorType::eStorageBuffer };
+  std::vector<bindings_type> keys;
+  for (int k = 0; k < number_of_keys; ++k)
+  {
+    bindings_type bindings;
+    for (int b = 0; b <= k % 4; ++b)
+      bindings.push_back(vk::DescriptorSetLayoutBinding{}
+          .setBinding(b)
+          .setDescriptorType(types[(k + b) % types.size()])
+          .setDescriptorCount(1 + k / 12)
+          .setStageFlags(vk::ShaderStageFlagBits::eFragment));
+    keys.push_back(std::move(bindings));
+  }
+  return keys;
+}
+
+// Look up or insert key, like LogicalDevice::realize_descriptor_set_layout. Returns the element and increments inserted if this call inserted it.
+template<size_t number_of_buckets>
+typename layouts_container_t<number_of_buckets>::value_type const* realize(layouts_container_t<number_of_buckets>& layouts, bindings_type const& key, std::atomic_int& inserted)
+{
+  size_t const hash = vulkan::descriptor::hash_sorted_bindings(key);
+  auto const* entry = layouts.find(vulkan::descriptor::SortedBindingsKey{key, hash});
+  if (!entry)
+  {
+    auto layout = std::make_unique<StandInLayout>();
+    bool created;
+    std::tie(entry, created) = layouts.insert(key, std::move(layout));
+    if (created)
+      inserted.fetch_add(1, std::memory_order_relaxed);
+  }
+  return entry;
+}
+
+template<size_t number_of_buckets>
+void test_concurrent_realize(char const* description)
+{
+  constexpr int number_of_threads = 8;
+  constexpr int number_of_keys = 200;
+  constexpr int rounds = 20;
+
+  std::vector<bindings_type> const keys = make_keys(number_of_keys);
+  bool all_equal = true;
+  bool all_found = true;
+  for (int round = 0; round < rounds; ++round)
+  {
+    std::atomic_int inserted = 0;
+    {
+      layouts_container_t<number_of_buckets> layouts;
+      std::vector<std::vector<void const*>> results(number_of_threads, std::vector<void const*>(number_of_keys));
+      std::atomic_int ready = 0;
+      std::vector<std::thread> threads;
+      for (int t = 0; t < number_of_threads; ++t)
+        threads.emplace_back([&, t](){
+          // Every thread realizes all keys, in a different order.
+          std::vector<int> order(number_of_keys);
+          for (int k = 0; k < number_of_keys; ++k)
+            order[k] = k;
+          std::shuffle(order.begin(), order.end(), std::mt19937(round * number_of_threads + t));
+          ready.fetch_add(1);
+          while (ready.load() < number_of_threads)
+            ;
+          for (int k : order)
+            results[t][k] = realize<number_of_buckets>(layouts, keys[k], inserted);
+        });
+      for (std::thread& thread : threads)
+        thread.join();
+
+      for (int k = 0; k < number_of_keys; ++k)
+      {
+        for (int t = 1; t < number_of_threads; ++t)
+          all_equal &= results[t][k] == results[0][k];
+        all_found &= layouts.find(keys[k]) == results[0][k];
+      }
+      check(inserted == number_of_keys, description);
+      check(s_live_layouts == number_of_keys, "the values of the threads that lost the race to insert are destroyed.");
+    }
+    check(s_live_layouts == 0, "all values are destroyed with the map.");
+  }
+  check(all_equal, "all threads get the same element for the same key.");
+  check(all_found, "every inserted key is found afterwards.");
+}
+
+} // namespace
+
+int main()
+{
+  Debug(NAMESPACE_DEBUG::init());
+
+  {
+    layouts_container_t<256> layouts;
+    std::atomic_int inserted = 0;
+    bindings_type key = make_keys(8).back();
+    check(!layouts.find(key), "an empty map finds nothing.");
+    auto const* entry = realize<256>(layouts, key, inserted);
+    check(inserted == 1 && entry && vulkan::descriptor::SortedBindingsEqual{}(entry->first, key), "a missing key is inserted.");
+    // Bindings that only differ in their binding number are the same layout (see LayoutBindingEqual).
+    for (vk::DescriptorSetLayoutBinding& binding : key)
+      binding.binding += 10;
+    check(realize<256>(layouts, key, inserted) == entry && inserted == 1, "the binding number is not part of the key.");
+    check(layouts.find(vulkan::descriptor::SortedBindingsKey{key, vulkan::descriptor::hash_sorted_bindings(key)}) == entry, "lookup with a SortedBindingsKey finds the element.");
+    key.back().descriptorCount += 1;
+    check(!layouts.find(key), "a different descriptor count is a different key.");
+  }
+
+  // The bucket count of LogicalDevice, and a tiny one so that all threads insert into the same few chains.
+  test_concurrent_realize<256>("every key is inserted exactly once.");
+  test_concurrent_realize<2>("every key is inserted exactly once, also when all keys share two buckets.");
+
+  if (!success)
+    return 1;
+  std::cout << "Success." << std::endl;
+}
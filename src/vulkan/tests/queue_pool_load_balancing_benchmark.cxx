@@ -0,0 +1,179 @@
+// Simulated-load benchmark of the queue selection done by QueuePool::get_immediate_submit_queue_task.
+//
+// A stream of uploads, mostly small (64 kB) with now and then a large one (32 MB), arrives at
+// a number of transfer queues. Each queue executes its uploads one after another; an upload takes
+// a fixed amount of time (recording, submitting, waking up the ImmediateSubmitQueue task) plus
+// a time proportional to its size. Every upload is to one of a number of destination resources.
+//
+// The selection is done by vulkan::QueueSelector, exactly as QueuePool does it, where the load of
+// a request is ImmediateSubmitQueue::s_request_load plus its size (see ImmediateSubmitQueue::request_load).
+// Compares the old selection (rotate over the queues), selecting the queue with the least outstanding
+// work without affinity, with the affinity of all uploads set to the window that owns the resources
+// (what CopyDataToGPU::set_resource_owner used to do), and with the affinity set to the destination
+// resource (what CopyDataToImage and CopyDataToBuffer do now). Prints the latency percentiles (from
+// the arrival of an upload until it finished) of the small uploads, which suffer most when they end
+// up behind a large upload.
+
+#include "sys.h"
+#include "queues/QueueSelector.h"
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+#include "debug.h"
+
+namespace {
+
+constexpr int number_of_queues = 4;
+constexpr int number_of_uploads = 200000;
+constexpr uint64_t small_upload_size = 64 * 1024;
+constexpr uint64_t large_upload_size = 32 * 1024 * 1024;
+constexpr double large_upload_fraction = 0.005;
+constexpr double fixed_cost_us = 20.0;                  // Per upload.
+constexpr double bytes_per_us = 8.0 * 1024;             // About 8 GB/s.
+constexpr double mean_interarrival_us = 15.0;           // Keeps the queues at roughly 80% utilization.
+constexpr uint64_t request_load = 64 * 1024;            // ImmediateSubmitQueue::s_request_load.
+constexpr int number_of_destinations = 1000;            // The number of different resources that are uploaded to.
+constexpr uint64_t window = 0x7f3a12c45600;             // Stand-in for the address of the window that owns all resources.
+
+struct Upload
+{
+  double m_arrival_us;
+  uint64_t m_size;
+  uint64_t m_destination;                               // Stand-in for the (non-dispatchable) handle of the destination resource.
+};
+
+struct Queue
+{
+  double m_busy_until_us = 0;                           // The time at which the last upload passed to this queue finishes.
+  struct Pending
+  {
+    double m_completion_us;
+    uint64_t m_load;
+    uint64_t m_affinity;
+  };
+  std::deque<Pending> m_pending;                        // The uploads that didn't finish yet.
+  uint64_t m_load = 0;                                  // The sum of the loads in m_pending.
+
+  // Retire the uploads that finished before now (like ImmediateSubmitQueue_need_action does).
+  void update(double now_us, vulkan::QueueSelector& selector)
+  {
+    while (!m_pending.empty() && m_pending.front().m_completion_us <= now_us)
+    {
+      m_load -= m_pending.front().m_load;
+      if (m_pending.front().m_affinity)
+        selector.release_affinity(m_pending.front().m_affinity);
+      m_pending.pop_front();
+    }
+  }
+
+  // Returns the latency of the upload.
+  double submit(Upload const& upload, uint64_t affinity)
+  {
+    double const start_us = std::max(upload.m_arrival_us, m_busy_until_us);
+    m_busy_until_us = start_us + fixed_cost_us + upload.m_size / bytes_per_us;
+    uint64_t const load = request_load + upload.m_size;
+    m_pending.push_back({m_busy_until_us, load, affinity});
+    m_load += load;
+    return m_busy_until_us - upload.m_arrival_us;
+  }
+};
+
+std::vector<Upload> generate_uploads()
+{
+  std::mt19937 generator(42);
+  std::exponential_distribution<double> interarrival(1.0 / mean_interarrival_us);
+  std::bernoulli_distribution is_large(large_upload_fraction);
+  std::uniform_int_distribution<uint64_t> destination(1, number_of_destinations);
+  std::vector<Upload> uploads;
+  double now_us = 0;
+  for (int i = 0; i < number_of_uploads; ++i)
+  {
+    now_us += interarrival(generator);
+    // Handles are typically addresses of driver objects, 256 bytes apart or so.
+    uploads.push_back({now_us, is_large(generator) ? large_upload_size : small_upload_size, 0x5600a0000000 + destination(generator) * 256});
+  }
+  return uploads;
+}
+
+// Return the latencies of the small uploads, sorted.
+// affinity(upload) returns the affinity of the request of upload, or zero for none.
+template<typename AFFINITY>
+std::vector<double> simulate(std::vector<Upload> const& uploads, AFFINITY affinity)
+{
+  std::vector<Queue> queues(number_of_queues);
+  vulkan::QueueSelector selector;
+  std::vector<double> latencies;
+  for (Upload const& upload : uploads)
+  {
+    for (Queue& queue : queues)
+      queue.update(upload.m_arrival_us, selector);
+    // This is what QueuePool::get_immediate_submit_queue_task does once all queues are acquired.
+    uint64_t const request_affinity = affinity(upload);
+    auto const select = [&](){ return selector.least_loaded(queues.size(), [&](int i){ return queues[i].m_load; }); };
+    int const index = request_affinity ? selector.acquire_affinity_task(request_affinity, select) : select();
+    double const latency = queues[index].submit(upload, request_affinity);
+    if (upload.m_size == small_upload_size)
+      latencies.push_back(latency);
+  }
+  std::sort(latencies.begin(), latencies.end());
+  return latencies;
+}
+
+// This is what QueuePool::get_immediate_submit_queue_task did before it looked at the load.
+std::vector<double> simulate_round_robin(std::vector<Upload> const& uploads)
+{
+  std::vector<Queue> queues(number_of_queues);
+  std::vector<double> latencies;
+  vulkan::QueueSelector unused;
+  int next_task = 0;
+  for (Upload const& upload : uploads)
+  {
+    for (Queue& queue : queues)
+      queue.update(upload.m_arrival_us, unused);
+    double const latency = queues[++next_task % queues.size()].submit(upload, 0);
+    if (upload.m_size == small_upload_size)
+      latencies.push_back(latency);
+  }
+  std::sort(latencies.begin(), latencies.end());
+  return latencies;
+}
+
+double percentile(std::vector<double> const& sorted, double p)
+{
+  return sorted[std::min(sorted.size() - 1, static_cast<size_t>(p * sorted.size()))];
+}
+
+void print(char const* name, std::vector<double> const& latencies)
+{
+  std::cout << "  " << name << std::fixed << std::setprecision(0) <<
+    " p50: " << std::setw(6) << percentile(latencies, 0.5) << " us," <<
+    " p99: " << std::setw(6) << percentile(latencies, 0.99) << " us," <<
+    " p99.9: " << std::setw(6) << percentile(latencies, 0.999) << " us," <<
+    " max: " << std::setw(6) << latencies.back() << " us\n";
+}
+
+} // namespace
+
+int main()
+{
+  Debug(NAMESPACE_DEBUG::init());
+
+  std::vector<Upload> const uploads = generate_uploads();
+  std::vector<double> const round_robin = simulate_round_robin(uploads);
+  std::vector<double> const least_loaded = simulate(uploads, [](Upload const&) -> uint64_t { return 0; });
+  std::vector<double> const window_affinity = simulate(uploads, [](Upload const&) { return window; });
+  std::vector<double> const destination_affinity = simulate(uploads, [](Upload const& upload) { return upload.m_destination; });
+
+  std::cout << number_of_uploads << " uploads (" << (large_upload_fraction * 100) << "% of 32 MB, the rest of 64 kB) to " <<
+    number_of_destinations << " resources over " << number_of_queues << " queues; latency of the small uploads:\n";
+  print("round robin:          ", round_robin);
+  print("least loaded:         ", least_loaded);
+  print("window affinity:      ", window_affinity);
+  print("destination affinity: ", destination_affinity);
+  std::cout << "  p99 speed up of destination over window affinity: " << std::setprecision(2) <<
+    (percentile(window_affinity, 0.99) / percentile(destination_affinity, 0.99)) << std::endl;
+}
@@ -0,0 +1,101 @@
+// Test of QueueSelector, the policy that QueuePool uses to select a queue for an immediate submit request.
+//
+// Without affinity the task with the least load must be selected, and tasks with an equal load in turn.
+// Requests with the same affinity must go to the same task as long as any of them didn't finish,
+// also when other threads pass and finish requests with that affinity at the same time.
+
+#include "sys.h"
+#include "queues/QueueSelector.h"
+#include <array>
+#include <atomic>
+#include <iostream>
+#include <set>
+#include <thread>
+#include <vector>
+#include "debug.h"
+
+namespace {
+
+bool success = true;
+
+void check(bool condition, char const* what)
+{
+  if (!condition)
+  {
+    std::cerr << "FAILURE: " << what << std::endl;
+    success = false;
+  }
+}
+
+} // namespace
+
+int main()
+{
+  Debug(NAMESPACE_DEBUG::init());
+
+  constexpr int number_of_tasks = 4;
+
+  // Least loaded.
+  {
+    vulkan::QueueSelector selector;
+    std::array<int, number_of_tasks> loads = { 7, 3, 9, 5 };
+    bool always_least = true;
+    for (int i = 0; i < 2 * number_of_tasks; ++i)
+      always_least &= selector.least_loaded(number_of_tasks, [&](int index){ return loads[index]; }) == 1;
+    check(always_least, "the task with the least load is selected, wherever the search starts.");
+
+    loads = {};
+    std::set<int> selected;
+    for (int i = 0; i < number_of_tasks; ++i)
+      selected.insert(selector.least_loaded(number_of_tasks, [&](int index){ return loads[index]; }));
+    check(selected.size() == number_of_tasks, "idle tasks are selected in turn.");
+  }
+
+  // Affinity.
+  {
+    vulkan::QueueSelector selector;
+    int select_calls = 0;
+    auto select = [&](int index){ return [&select_calls, index](){ ++select_calls; return index; }; };
+    constexpr uint64_t affinity = 0x5600a0001200;
+
+    check(selector.acquire_affinity_task(affinity, select(2)) == 2 && select_calls == 1, "the first request with an affinity is passed to the selected task.");
+    check(selector.acquire_affinity_task(affinity, select(3)) == 2 && select_calls == 1, "a request with the affinity of a pending request goes to the same task.");
+    selector.release_affinity(affinity);
+    check(selector.acquire_affinity_task(affinity, select(0)) == 2 && select_calls == 1, "the affinity is kept while any of its requests is pending.");
+    selector.release_affinity(affinity);
+    selector.release_affinity(affinity);
+    check(selector.acquire_affinity_task(affinity, select(1)) == 1 && select_calls == 2, "once all requests with an affinity finished, the next one is free to go to another task.");
+    selector.release_affinity(affinity);
+  }
+
+  // Concurrent requests with the same affinity, while one request with that affinity stays pending.
+  {
+    constexpr int number_of_threads = 8;
+    constexpr int requests_per_thread = 100000;
+    constexpr uint64_t affinity = 0x5600a0004500;
+    vulkan::QueueSelector selector;
+    int const pinned = selector.acquire_affinity_task(affinity, [](){ return 3; });
+    std::atomic_int wrong_task = 0;
+    std::atomic_int select_calls = 0;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < number_of_threads; ++t)
+      threads.emplace_back([&, t](){
+        for (int i = 0; i < requests_per_thread; ++i)
+        {
+          int const index = selector.acquire_affinity_task(affinity, [&](){ select_calls.fetch_add(1); return t % number_of_tasks; });
+          if (index != pinned)
+            wrong_task.fetch_add(1);
+          selector.release_affinity(affinity);
+        }
+      });
+    for (std::thread& thread : threads)
+      thread.join();
+    check(wrong_task == 0 && select_calls == 0, "concurrent requests with the affinity of a pending request all go to its task.");
+    selector.release_affinity(affinity);
+    check(selector.acquire_affinity_task(affinity, [](){ return 0; }) == 0, "the pending count returns to zero after all requests finished.");
+  }
+
+  if (!success)
+    return 1;
+  std::cout << "Success." << std::endl;
+}
@@ -0,0 +1,372 @@
+// Benchmark of the completion latency of task::AsyncSemaphoreWatcher.
+//
+// A "GPU" thread signals a number of timeline semaphores (from the host, with vkSignalSemaphore) at
+// random moments. A task is woken up by its own AsyncSemaphoreWatcher when that happens. Prints the
+// time between signaling a semaphore and the task running, and the CPU time used by the process
+// (which includes that of the window, drawn at 11 frames per second), for:
+//
+//   polling   - start_waiter_thread is not called; the watcher polls all semaphores every 4 ms.
+//   wake up   - the waiter thread; the next value of a semaphore is only added after the previous value
+//               was reached, so that every add() adds a new semaphore and wakes up the waiter thread.
+//   appended  - the waiter thread; all values are added up front, so that add() appends to a semaphore
+//               that is already watched and does not wake up the waiter thread.
+//   fallback  - like wake up, but stop_waiter_thread is called halfway; the rest is detected by polling.
+//
+// The waiter thread is also blocked on a semaphore that is never signaled. At the end of each scenario
+// that semaphore is removed with remove(), which has to wake up the waiter thread before it can be
+// destroyed; the time that took is printed too.
+//
+// A logical device can only be created for a window, therefore this opens a (small) window.
+// Requires a Vulkan 1.2 capable device.
+
+#include "sys.h"
+#include "Application.inl.h"
+#include "LogicalDevice.h"
+#include "SemaphoreWatcher.h"
+#include "TimelineSemaphore.h"
+#include "infos/DeviceCreateInfo.h"
+#include "tests/SingleButtonWindow.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+#include <sys/resource.h>
+#include "debug.h"
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+constexpr int number_of_semaphores = 8;
+constexpr int number_of_signals = 1000;
+constexpr uint64_t last_value = number_of_signals / number_of_semaphores;
+
+enum Scenario
+{
+  polling,
+  wake_up,
+  appended,
+  fallback,
+  number_of_scenarios
+};
+
+char const* scenario_str(int scenario)
+{
+  switch (scenario)
+  {
+    AI_CASE_RETURN(polling);
+    AI_CASE_RETURN(wake_up);
+    AI_CASE_RETURN(appended);
+    AI_CASE_RETURN(fallback);
+  }
+  AI_NEVER_REACHED;
+}
+
+double process_cpu_ms()
+{
+  rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1e3 + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1e-3;
+}
+
+class LogicalDevice : public vulkan::LogicalDevice
+{
+ public:
+  static constexpr int root_window_request_cookie = 1;
+
+  void prepare_logical_device(vulkan::DeviceCreateInfo& device_create_info) const override
+  {
+    using vulkan::QueueFlagBits;
+
+    device_create_info
+    .addQueueRequest({
+        .queue_flags = QueueFlagBits::eGraphics|QueueFlagBits::ePresentation,
+        .max_number_of_queues = 1,
+        .priority = 1.0,
+        .cookies = root_window_request_cookie})
+#ifdef CWDEBUG
+    .setDebugName("LogicalDevice");
+#endif
+    ;
+  }
+};
+
+class SemaphoreWatcherLatencyBenchmark : public vulkan::Application
+{
+  using vulkan::Application::Application;
+
+ private:
+  int thread_pool_number_of_worker_threads() const override
+  {
+    return 4;
+  }
+
+ public:
+  std::u8string application_name() const override
+  {
+    return u8"SemaphoreWatcherLatencyBenchmark";
+  }
+};
+
+// The task that is woken up by the semaphore watcher.
+class Benchmark final : public AIStatefulTask
+{
+ private:
+  vulkan::Application* m_application;
+  boost::intrusive_ptr<task::LogicalDevice const> m_logical_device_task;
+  vulkan::LogicalDevice const* m_logical_device{};
+  int m_scenario{polling};
+  std::vector<boost::intrusive_ptr<task::AsyncSemaphoreWatcher>> m_semaphore_watchers;  // The semaphore watchers of all scenarios; the last one is used.
+
+  // The objects of the current scenario.
+  std::vector<std::unique_ptr<vulkan::TimelineSemaphore>> m_timeline_semaphores;
+  std::unique_ptr<vulkan::TimelineSemaphore> m_unsignaled_timeline_semaphore;
+  std::array<uint64_t, number_of_semaphores> m_seen;                    // The last counter value that we saw, per semaphore.
+  std::vector<clock_type::time_point> m_signal_times;                   // Indexed by signal: signal i sets semaphore i % number_of_semaphores to i / number_of_semaphores + 1.
+  std::vector<clock_type::time_point> m_detect_times;
+  std::thread m_gpu_thread;
+  double m_start_cpu_ms;
+  bool m_waiter_thread_failed{false};                                   // Set when start_waiter_thread failed in a scenario that uses the waiter thread.
+
+ protected:
+  using direct_base_type = AIStatefulTask;
+
+  enum benchmark_state_type {
+    Benchmark_wait_for_logical_device = direct_base_type::state_end,
+    Benchmark_start_scenario,
+    Benchmark_detect,
+    Benchmark_done
+  };
+
+ public:
+  static constexpr state_type state_end = Benchmark_done + 1;
+  static constexpr condition_type logical_device_index_available = 1;
+  static constexpr condition_type semaphore_signaled = 2;
+  static constexpr condition_type never_signaled = 4;
+
+  Benchmark(vulkan::Application* application, boost::intrusive_ptr<task::LogicalDevice const> logical_device_task COMMA_CWDEBUG_ONLY(bool debug = false)) :
+    AIStatefulTask(CWDEBUG_ONLY(debug)), m_application(application), m_logical_device_task(std::move(logical_device_task)),
+    m_signal_times(number_of_signals), m_detect_times(number_of_signals) { }
+
+  // Return true if every scenario that should use the waiter thread could start it.
+  bool success() const { return !m_waiter_thread_failed; }
+
+ private:
+  task::AsyncSemaphoreWatcher* semaphore_watcher() const { return m_semaphore_watchers.back().get(); }
+  void start_scenario();
+  bool detect();
+  void finish_scenario();
+
+  // Signal the semaphores one by one, with random pauses in between.
+  void gpu();
+
+ protected:
+  ~Benchmark() override = default;
+
+  char const* condition_str_impl(condition_type condition) const override;
+  char const* state_str_impl(state_type run_state) const override;
+  char const* task_name_impl() const override;
+  void multiplex_impl(state_type run_state) override;
+};
+
+void Benchmark::gpu()
+{
+  std::mt19937 generator(42);
+  std::uniform_int_distribution<int> pause_us(0, 8000);
+  for (int i = 0; i < number_of_signals; ++i)
+  {
+    std::this_thread::sleep_for(std::chrono::microseconds(pause_us(generator)));
+    m_signal_times[i] = clock_type::now();
+    m_timeline_semaphores[i % number_of_semaphores]->signal(i / number_of_semaphores + 1);
+  }
+}
+
+void Benchmark::start_scenario()
+{
+  m_semaphore_watchers.push_back(statefultask::create<task::AsyncSemaphoreWatcher>(CWDEBUG_ONLY(false)));
+  semaphore_watcher()->run(m_application->high_priority_queue());
+  if (m_scenario != polling && !semaphore_watcher()->start_waiter_thread(m_logical_device))
+  {
+    std::cerr << "Could not start the waiter thread; " << scenario_str(m_scenario) << " falls back to polling." << std::endl;
+    m_waiter_thread_failed = true;
+  }
+
+  m_timeline_semaphores.clear();
+  for (int s = 0; s < number_of_semaphores; ++s)
+    m_timeline_semaphores.push_back(std::make_unique<vulkan::TimelineSemaphore>(m_logical_device, 0
+        COMMA_CWDEBUG_ONLY(vulkan::Ambifix{"Benchmark::m_timeline_semaphores[" + std::to_string(s) + "]"})));
+  m_unsignaled_timeline_semaphore = std::make_unique<vulkan::TimelineSemaphore>(m_logical_device, 0
+      COMMA_CWDEBUG_ONLY(vulkan::Ambifix{"Benchmark::m_unsignaled_timeline_semaphore"}));
+  m_seen.fill(0);
+
+  semaphore_watcher()->add(m_unsignaled_timeline_semaphore.get(), 1, this, never_signaled);
+  uint64_t const last_added_value = m_scenario == appended ? last_value : 1;
+  for (uint64_t value = 1; value <= last_added_value; ++value)
+    for (int s = 0; s < number_of_semaphores; ++s)
+      semaphore_watcher()->add(m_timeline_semaphores[s].get(), value, this, semaphore_signaled);
+
+  m_start_cpu_ms = process_cpu_ms();
+  m_gpu_thread = std::thread([this](){ gpu(); });
+}
+
+// Read all counters and record the detection time of the signals that weren't seen before. Returns true when all signals were seen.
+bool Benchmark::detect()
+{
+  clock_type::time_point const now = clock_type::now();
+  bool done = true;
+  int number_seen = 0;
+  for (int s = 0; s < number_of_semaphores; ++s)
+  {
+    uint64_t const counter_value = m_timeline_semaphores[s]->get_counter_value();
+    if (counter_value > m_seen[s])
+    {
+      for (uint64_t value = m_seen[s] + 1; value <= counter_value; ++value)
+        m_detect_times[(value - 1) * number_of_semaphores + s] = now;
+      m_seen[s] = counter_value;
+      // The watcher stopped watching this semaphore when it reached the last added value; add the next value.
+      if (m_scenario != appended && counter_value < last_value)
+        semaphore_watcher()->add(m_timeline_semaphores[s].get(), counter_value + 1, this, semaphore_signaled);
+    }
+    if (m_seen[s] < last_value)
+      done = false;
+    number_seen += m_seen[s];
+  }
+  if (m_scenario == fallback && number_seen >= number_of_signals / 2)
+    semaphore_watcher()->stop_waiter_thread();          // Does nothing when it was already stopped.
+  return done;
+}
+
+void Benchmark::finish_scenario()
+{
+  double const cpu_ms = process_cpu_ms() - m_start_cpu_ms;
+  m_gpu_thread.join();
+
+  // The waiter thread (if still running) is blocked in vkWaitSemaphores on m_unsignaled_timeline_semaphore.
+  clock_type::time_point const remove_start = clock_type::now();
+  semaphore_watcher()->remove(m_unsignaled_timeline_semaphore.get());
+  double const remove_us = std::chrono::duration<double, std::micro>(clock_type::now() - remove_start).count();
+  m_unsignaled_timeline_semaphore.reset();
+  // The watcher might still be removing the semaphores that reached their last value; wait for that before they are destroyed.
+  for (auto const& timeline_semaphore : m_timeline_semaphores)
+    semaphore_watcher()->remove(timeline_semaphore.get());
+  semaphore_watcher()->stop_waiter_thread();
+
+  std::vector<double> latencies_us;
+  for (int i = 0; i < number_of_signals; ++i)
+    latencies_us.push_back(std::chrono::duration<double, std::micro>(m_detect_times[i] - m_signal_times[i]).count());
+  std::sort(latencies_us.begin(), latencies_us.end());
+  double mean_us = 0;
+  for (double latency_us : latencies_us)
+    mean_us += latency_us / number_of_signals;
+  std::cout << "  " << std::left << std::setw(8) << scenario_str(m_scenario) << std::right << std::fixed << std::setprecision(1) <<
+    " mean: " << std::setw(7) << mean_us << " us, p50: " << std::setw(7) << latencies_us[number_of_signals / 2] <<
+    " us, p99: " << std::setw(7) << latencies_us[number_of_signals * 99 / 100] << " us, CPU time: " << std::setw(6) << cpu_ms <<
+    " ms, remove(): " << std::setw(6) << remove_us << " us\n";
+}
+
+char const* Benchmark::condition_str_impl(condition_type condition) const
+{
+  switch (condition)
+  {
+    AI_CASE_RETURN(logical_device_index_available);
+    AI_CASE_RETURN(semaphore_signaled);
+    AI_CASE_RETURN(never_signaled);
+  }
+  return direct_base_type::condition_str_impl(condition);
+}
+
+char const* Benchmark::state_str_impl(state_type run_state) const
+{
+  switch (run_state)
+  {
+    AI_CASE_RETURN(Benchmark_wait_for_logical_device);
+    AI_CASE_RETURN(Benchmark_start_scenario);
+    AI_CASE_RETURN(Benchmark_detect);
+    AI_CASE_RETURN(Benchmark_done);
+  }
+  AI_NEVER_REACHED;
+}
+
+char const* Benchmark::task_name_impl() const
+{
+  return "Benchmark";
+}
+
+void Benchmark::multiplex_impl(state_type run_state)
+{
+  switch (run_state)
+  {
+    case Benchmark_wait_for_logical_device:
+      m_logical_device_task->m_logical_device_index_available_event.register_task(this, logical_device_index_available);
+      set_state(Benchmark_start_scenario);
+      wait(logical_device_index_available);
+      break;
+    case Benchmark_start_scenario:
+      if (!m_logical_device)
+      {
+        m_logical_device = m_application->get_logical_device(m_logical_device_task->get_index());
+        std::cout << number_of_signals << " timeline semaphore signals, spread over " << number_of_semaphores << " semaphores; time until a task is woken up:\n";
+      }
+      start_scenario();
+      set_state(Benchmark_detect);
+      wait(semaphore_signaled);
+      break;
+    case Benchmark_detect:
+      if (!detect())
+      {
+        wait(semaphore_signaled);
+        break;
+      }
+      finish_scenario();
+      if (++m_scenario < number_of_scenarios)
+      {
+        set_state(Benchmark_start_scenario);
+        break;
+      }
+      set_state(Benchmark_done);
+      [[fallthrough]];
+    case Benchmark_done:
+      m_timeline_semaphores.clear();
+      m_application->quit();
+      finish();
+      break;
+  }
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+  Debug(NAMESPACE_DEBUG::init());
+
+  try
+  {
+    SemaphoreWatcherLatencyBenchmark application;
+    application.initialize(argc, argv);
+
+    auto root_window = application.create_root_window<vulkan::WindowEvents, SingleButtonWindow>(
+        std::make_tuple([](SingleButtonWindow&){ }), {150, 50}, LogicalDevice::root_window_request_cookie, u8"semaphore_watcher_latency_benchmark");
+    auto logical_device_task = application.create_logical_device(std::make_unique<LogicalDevice>(), std::move(root_window));
+
+    auto benchmark = statefultask::create<Benchmark>(&application, logical_device_task);
+    benchmark->run(application.high_priority_queue());
+
+    application.run();
+
+    if (!benchmark->success())
+    {
+      std::cerr << "FAILURE: the waiter thread could not be started." << std::endl;
+      return 1;
+    }
+  }
+  catch (AIAlert::Error const& error)
+  {
+    std::cerr << error << std::endl;
+    return 1;
+  }
+}
@@ -0,0 +1,105 @@
+// Test of SPIRVCache::patch_from_template (precompiled-template mode, see ShaderInfo::set_precompiled_template).
+//
+// A fragment shader is compiled once with the set index hints and binding hints as DescriptorSet and
+// Binding decorations (the template), and then patched according to a SetBindingMap. The result must
+// be identical to the SPIR-V code obtained by compiling the same shader with the final set indexes
+// and bindings.
+//
+// Also tests that two ShaderInfo objects that only differ in being a precompiled template have a
+// different hash (otherwise Application::register_shaders would deduplicate them).
+
+#include "sys.h"
+#include "shader_builder/SPIRVCache.h"
+#include "shader_builder/ShaderInfo.h"
+#include "shader_builder/ShaderCompiler.h"
+#include "descriptor/SetBindingMap.h"
+#include <iostream>
+#include <string>
+#include "debug.h"
+
+namespace {
+
+struct SetAndBinding
+{
+  int m_set;
+  int m_binding;
+};
+
+// Return the source code of the test shader, using the given (set, binding) for its three shader resources.
+std::string make_glsl(SetAndBinding top, SetAndBinding bottom, SetAndBinding block)
+{
+  auto layout = [](SetAndBinding sb){
+    return "layout(set = " + std::to_string(sb.m_set) + ", binding = " + std::to_string(sb.m_binding) + ") ";
+  };
+  return "#version 450\n" +
+    layout(top) + "uniform sampler2D top;\n" +
+    layout(bottom) + "uniform sampler2D bottom;\n" +
+    layout(block) + "uniform Block { float x; } block;\n"
+    "layout(location = 0) out vec4 outColor;\n"
+    "void main()\n"
+    "{\n"
+    "  outColor = texture(top, vec2(block.x)) + texture(bottom, vec2(0.5));\n"
+    "}\n";
+}
+
+} // namespace
+
+int main()
+{
+  Debug(NAMESPACE_DEBUG::init());
+
+  using namespace vulkan;
+  using descriptor::SetIndexHint;
+  using descriptor::SetBinding;
+
+  shader_builder::ShaderCompiler const compiler;
+  shader_builder::ShaderInfo shader_info(vk::ShaderStageFlagBits::eFragment, "spirv_template_patch_test.frag.glsl");
+  shader_info.set_precompiled_template();
+
+  // The template: the hints are used as set indexes and bindings.
+  std::string const template_glsl = make_glsl({0, 0}, {0, 1}, {1, 0});
+  shader_builder::SPIRVCache spirv_template;
+  spirv_template.compile(template_glsl, compiler, shader_info);
+
+  // Swap the two descriptor sets and reorder the bindings.
+  descriptor::SetBindingMap set_binding_map;
+  set_binding_map.add_from_to(SetIndexHint{0}, SetIndexHint{1});
+  set_binding_map.add_from_to(SetIndexHint{1}, SetIndexHint{0});
+  set_binding_map.add_from_to(SetBinding{SetIndexHint{0}, 0}, 2);
+  set_binding_map.add_from_to(SetBinding{SetIndexHint{0}, 1}, 0);
+  set_binding_map.add_from_to(SetBinding{SetIndexHint{1}, 0}, 1);
+
+  shader_builder::SPIRVCache patched;
+  patched.patch_from_template(spirv_template, set_binding_map);
+
+  // What preprocess2 would have generated for this set_binding_map.
+  std::string const expected_glsl = make_glsl({1, 2}, {1, 0}, {0, 1});
+  shader_builder::SPIRVCache expected;
+  expected.compile(expected_glsl, compiler, shader_info);
+
+  bool success = true;
+  if (patched.hash() != expected.hash())
+  {
+    std::cerr << "FAILURE: the patched template differs from the SPIR-V code compiled with the final set indexes and bindings." << std::endl;
+    success = false;
+  }
+  if (patched.hash() == spirv_template.hash())
+  {
+    std::cerr << "FAILURE: patch_from_template didn't change anything." << std::endl;
+    success = false;
+  }
+
+  shader_builder::ShaderInfo template_info(vk::ShaderStageFlagBits::eFragment, "template");
+  shader_builder::ShaderInfo normal_info(vk::ShaderStageFlagBits::eFragment, "normal");
+  template_info.load(template_glsl).set_precompiled_template();
+  normal_info.load(template_glsl);
+  if (template_info.hash() == normal_info.hash())
+  {
+    std::cerr << "FAILURE: ShaderInfo::hash() doesn't depend on set_precompiled_template." << std::endl;
+    success = false;
+  }
+
+  if (!success)
+    return 1;
+  std::cout << "Success." << std::endl;
+}
@@ -0,0 +1,146 @@
+// Test of the bookkeeping of StagingRing (see RingReservations).
+//
+// Ranges are reserved at the head of the ring and only recycled at the tail, once they and
+// all ranges that were reserved before them were released. A reservation that doesn't fit
+// at the end of the ring wraps around to offset zero, provided that the tail already passed it.
+
+#include "sys.h"
+#include "memory/StagingRing.h"
+#include <iostream>
+#include <vector>
+#include "debug.h"
+
+namespace {
+
+bool success = true;
+
+void check(bool condition, char const* what)
+{
+  if (!condition)
+  {
+    std::cerr << "FAILURE: " << what << std::endl;
+    success = false;
+  }
+}
+
+struct Range
+{
+  vk::DeviceSize m_begin;
+  uint64_t m_sequence_number;
+};
+
+} // namespace
+
+int main()
+{
+  Debug(NAMESPACE_DEBUG::init());
+
+  using vulkan::memory::RingReservations;
+  constexpr vk::DeviceSize ring_size = 100;
+
+  {
+    RingReservations ring;
+    Range a, b, c, d;
+    check(ring.reserve(40, ring_size, a.m_begin, a.m_sequence_number) && a.m_begin == 0, "first reservation starts at zero.");
+    check(ring.reserve(40, ring_size, b.m_begin, b.m_sequence_number) && b.m_begin == 40, "second reservation follows the first.");
+    // [80, 100) is free, but 30 bytes don't fit there and [0, 40) is still in use.
+    check(!ring.reserve(30, ring_size, c.m_begin, c.m_sequence_number), "a reservation that doesn't fit anywhere fails.");
+    check(ring.reserve(20, ring_size, c.m_begin, c.m_sequence_number) && c.m_begin == 80, "a reservation that fits at the end doesn't wrap.");
+
+    // Out of order release: releasing b doesn't recycle anything because a is still in use.
+    ring.release(b.m_sequence_number, b.m_begin);
+    check(ring.tail() == 0, "releasing a range that is not at the tail doesn't move the tail.");
+    check(!ring.reserve(30, ring_size, d.m_begin, d.m_sequence_number), "space of a range released out of order is not reused before the tail passes it.");
+
+    // Releasing a recycles both a and b.
+    ring.release(a.m_sequence_number, a.m_begin);
+    check(ring.tail() == 80, "releasing the tail also recycles the ranges released before.");
+
+    // Wrap around: the ring is full at the end, but [0, 80) is free.
+    check(ring.reserve(70, ring_size, d.m_begin, d.m_sequence_number) && d.m_begin == 0, "a reservation that doesn't fit at the end wraps around.");
+    Range e;
+    check(!ring.reserve(20, ring_size, e.m_begin, e.m_sequence_number), "the head can't pass the tail after wrapping around.");
+    check(ring.reserve(10, ring_size, e.m_begin, e.m_sequence_number) && e.m_begin == 70, "the space between head and tail is used after wrapping around.");
+
+    ring.release(c.m_sequence_number, c.m_begin);
+    check(ring.tail() == 0, "the tail wraps around too.");
+    ring.release(e.m_sequence_number, e.m_begin);
+    check(ring.tail() == 0, "releasing the last range doesn't recycle the range before it.");
+    ring.release(d.m_sequence_number, d.m_begin);
+    check(ring.empty(), "everything is recycled after all ranges were released.");
+
+    Range f;
+    check(ring.reserve(ring_size, ring_size, f.m_begin, f.m_sequence_number) && f.m_begin == 0, "an empty ring starts again at zero.");
+    Range g;
+    check(!ring.reserve(1, ring_size, g.m_begin, g.m_sequence_number), "a full ring can't reserve anything.");
+    ring.release(f.m_sequence_number, f.m_begin);
+    check(!ring.reserve(ring_size + 1, ring_size, g.m_begin, g.m_sequence_number), "a range larger than the ring is never reserved.");
+  }
+
+  // Aligned reservations, as done by StagingRing::reserve for an image with a texel size of 3 bytes (the lcm of 16 and 3 is 48).
+  {
+    RingReservations ring;
+    constexpr vk::DeviceSize alignment = 48;
+    Range a, b, c, d;
+    check(ring.reserve(16, ring_size, a.m_begin, a.m_sequence_number, alignment) && a.m_begin == 0, "an aligned reservation in an empty ring starts at zero.");
+    check(ring.reserve(16, ring_size, b.m_begin, b.m_sequence_number, alignment) && b.m_begin == 48, "an aligned reservation skips to the next multiple of the alignment.");
+    // The head is at 64; the next multiple of 48 is 96, where 48 bytes don't fit, and the tail is at zero.
+    check(!ring.reserve(48, ring_size, c.m_begin, c.m_sequence_number, alignment), "an aligned reservation that doesn't fit after padding fails.");
+    ring.release(a.m_sequence_number, a.m_begin);
+    check(ring.tail() == 48, "the padding in front of a range is recycled with the range before it.");
+    check(ring.reserve(48, ring_size, c.m_begin, c.m_sequence_number, alignment) && c.m_begin == 0, "an aligned reservation wraps around to zero.");
+    ring.release(b.m_sequence_number, b.m_begin);
+    check(ring.reserve(16, ring_size, d.m_begin, d.m_sequence_number, alignment) && d.m_begin == 48, "the head is padded after wrapping around too.");
+    ring.release(c.m_sequence_number, c.m_begin);
+    ring.release(d.m_sequence_number, d.m_begin);
+    check(ring.empty(), "aligned ranges are recycled once released.");
+  }
+
+  // A stream of reservations of varying sizes, each released out of order: at most three ranges are
+  // in use at any time and the second oldest is always released before the oldest one.
+  // Ranges that are in use at the same time may never overlap.
+  {
+    RingReservations ring;
+    struct Live
+    {
+      Range m_range;
+      vk::DeviceSize m_size;
+    };
+    std::vector<Live> live;
+    bool overlap = false;
+    int wrap_arounds = 0;
+    vk::DeviceSize last_begin = 0;
+    for (int round = 0; round < 1000; ++round)
+    {
+      if (live.size() == 3)
+      {
+        ring.release(live[1].m_range.m_sequence_number, live[1].m_range.m_begin);
+        ring.release(live[0].m_range.m_sequence_number, live[0].m_range.m_begin);
+        live.erase(live.begin(), live.begin() + 2);
+      }
+      Live next;
+      next.m_size = 1 + round % 13;
+      if (!ring.reserve(next.m_size, ring_size, next.m_range.m_begin, next.m_range.m_sequence_number))
+      {
+        std::cerr << "FAILURE: reservation of round " << round << " failed." << std::endl;
+        return 1;
+      }
+      if (next.m_range.m_begin < last_begin)
+        ++wrap_arounds;
+      last_begin = next.m_range.m_begin;
+      overlap |= next.m_range.m_begin + next.m_size > ring_size;
+      for (Live const& other : live)
+        overlap |= next.m_range.m_begin < other.m_range.m_begin + other.m_size && other.m_range.m_begin < next.m_range.m_begin + next.m_size;
+      live.push_back(next);
+    }
+    check(!overlap, "ranges that are in use at the same time never overlap.");
+    check(wrap_arounds > 0, "the stream of reservations wraps around.");
+    for (Live const& l : live)
+      ring.release(l.m_range.m_sequence_number, l.m_range.m_begin);
+    check(ring.empty(), "all ranges are recycled once released.");
+  }
+
+  if (!success)
+    return 1;
+  std::cout << "Success." << std::endl;
+}
@@ -0,0 +1,127 @@
+// Microbenchmark for the glsl_id_full substitution done by ShaderInputData::preprocess2.
+//
+// Compares the old approach (one std::string_view::find pass over the source per shader
+// variable, collecting the hits in a std::map, followed by rebuilding the string) with
+// shader_builder::SubstitutionTrie (a single scan over the source) on a large generated shader.
+
+#include "sys.h"
+#include "shader_builder/SubstitutionTrie.h"
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+#include "debug.h"
+
+namespace {
+
+struct Variable
+{
+  std::string m_glsl_id_full;
+  std::string m_substitution;
+};
+
+// This is what ShaderInputData::preprocess2 used to do.
+void substitute_using_find(std::vector<Variable> const& variables, std::string_view source, std::string& output)
+{
+  std::map<size_t, std::pair<std::string, std::string>> positions;
+  int id_to_name_growth = 0;
+  for (Variable const& variable : variables)
+  {
+    std::string match_string = variable.m_glsl_id_full;
+    for (size_t pos = 0; (pos = source.find(match_string, pos)) != std::string_view::npos; pos += match_string.length())
+    {
+      id_to_name_growth += variable.m_substitution.length() - match_string.length();
+      positions[pos] = std::make_pair(match_string, variable.m_substitution);
+    }
+  }
+  output.reserve(source.length() + id_to_name_growth);
+  size_t start = 0;
+  for (auto&& p : positions)
+  {
+    output += source.substr(start, p.first - start);
+    start = p.first + p.second.first.length();
+    output += p.second.second;
+  }
+  output += source.substr(start);
+}
+
+void substitute_using_trie(vulkan::shader_builder::SubstitutionTrie const& trie, std::string_view source, std::string& output)
+{
+  output.reserve(trie.max_output_size(source));
+  trie.substitute(source, output);
+}
+
+template<typename FUNCTION>
+double measure(int iterations, FUNCTION const& function)
+{
+  auto const start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; ++i)
+    function();
+  auto const stop = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::micro>(stop - start).count() / iterations;
+}
+
+} // namespace
+
+int main()
+{
+  Debug(NAMESPACE_DEBUG::init());
+
+  constexpr int number_of_structs = 8;
+  constexpr int members_per_struct = 12;
+  constexpr int number_of_lines = 20000;
+  constexpr int iterations = 20;
+
+  // Generate the shader variables, named like "VertexData4::m_member7".
+  std::vector<Variable> variables;
+  for (int s = 0; s < number_of_structs; ++s)
+    for (int m = 0; m < members_per_struct; ++m)
+    {
+      std::string prefix = "VertexData" + std::to_string(s);
+      std::string member = "m_member" + std::to_string(m);
+      variables.push_back({prefix + "::" + member, "v" + std::to_string(s) + "_" + member});
+    }
+
+  // Generate a large shader in which about half of the lines use a shader variable.
+  std::mt19937 rng(12345);
+  std::uniform_int_distribution<size_t> variable_distribution(0, variables.size() - 1);
+  std::string source;
+  for (int line = 0; line < number_of_lines; ++line)
+  {
+    source += "  vec4 tmp" + std::to_string(line) + " = ";
+    if (line % 2 == 0)
+      source += variables[variable_distribution(rng)].m_glsl_id_full + " * " + variables[variable_distribution(rng)].m_glsl_id_full;
+    else
+      source += "vec4(0.0, 1.0, 2.0, 3.0) * float(" + std::to_string(line) + ")";
+    source += ";\n";
+  }
+
+  // Build the trie once, like ShaderInputData does.
+  vulkan::shader_builder::SubstitutionTrie trie;
+  auto const build_start = std::chrono::steady_clock::now();
+  for (Variable const& variable : variables)
+    trie.add(variable.m_glsl_id_full, variable.m_substitution);
+  trie.build();
+  double const build_time = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - build_start).count();
+
+  // Check that both give the same result.
+  std::string output_find;
+  std::string output_trie;
+  substitute_using_find(variables, source, output_find);
+  substitute_using_trie(trie, source, output_trie);
+  if (output_find != output_trie)
+  {
+    std::cerr << "Results differ!" << std::endl;
+    return 1;
+  }
+
+  double const find_time = measure(iterations, [&]{ std::string output; substitute_using_find(variables, source, output); });
+  double const trie_time = measure(iterations, [&]{ std::string output; substitute_using_trie(trie, source, output); });
+
+  std::cout << "Source size: " << source.size() << " bytes, " << variables.size() << " shader variables." << std::endl;
+  std::cout << "find + std::map: " << find_time << " us per shader." << std::endl;
+  std::cout << "SubstitutionTrie: " << trie_time << " us per shader (building the trie took " << build_time << " us)." << std::endl;
+}
@@ -0,0 +1,85 @@
+// Test of shader_builder::SubstitutionTrie (the substitution done by ShaderInputData::preprocess2).
+//
+// At each position the longest matching pattern must be replaced, after which scanning continues
+// immediately after the match; and max_output_size must be an upper bound of what substitute appends.
+
+#include "sys.h"
+#include "shader_builder/SubstitutionTrie.h"
+#include <iostream>
+#include <string>
+#include "debug.h"
+
+namespace {
+
+bool success = true;
+
+void check(vulkan::shader_builder::SubstitutionTrie const& trie, std::string_view source, std::string_view expected, char const* what)
+{
+  std::string output = "prefix:";
+  trie.substitute(source, output);
+  if (output != "prefix:" + std::string{expected})
+  {
+    std::cerr << "FAILURE: " << what << " Got \"" << output.substr(7) << "\", expected \"" << expected << "\"." << std::endl;
+    success = false;
+  }
+  else if (output.size() - 7 > trie.max_output_size(source))
+  {
+    std::cerr << "FAILURE: " << what << " The output is larger than max_output_size." << std::endl;
+    success = false;
+  }
+}
+
+} // namespace
+
+int main()
+{
+  Debug(NAMESPACE_DEBUG::init());
+
+  using vulkan::shader_builder::SubstitutionTrie;
+
+  {
+    SubstitutionTrie trie;
+    trie.build();
+    check(trie, "VertexData::m_x", "VertexData::m_x", "without patterns the source is copied.");
+  }
+
+  {
+    SubstitutionTrie trie;
+    trie.add("VertexData::m_x", "v_m_x");
+    trie.add("VertexData::m_xy", "v_m_xy");
+    trie.add("Push::m_y", "m_y");
+    trie.add("Push::m_y", "push_m_y");
+    trie.build();
+    check(trie, "", "", "an empty source gives an empty output.");
+    check(trie, "vec4 a = vec4(0.0);", "vec4 a = vec4(0.0);", "a source without patterns is copied.");
+    check(trie, "VertexData::m_x", "v_m_x", "a pattern that is the whole source is replaced.");
+    check(trie, "a = VertexData::m_xy * VertexData::m_x;", "a = v_m_xy * v_m_x;", "the longest matching pattern is replaced.");
+    check(trie, "VertexData::m_xz", "v_m_xz", "a shorter pattern matches when the longer one doesn't.");
+    check(trie, "VertexData::m_ + VertexData::", "VertexData::m_ + VertexData::", "a partial match at the end is copied.");
+    check(trie, "Push::m_y", "push_m_y", "the last replacement of a pattern that was added twice is used.");
+    check(trie, "VertexData::m_xPush::m_y", "v_m_xpush_m_y", "scanning continues immediately after a match.");
+  }
+
+  {
+    SubstitutionTrie trie;
+    trie.add("aa", "b");
+    trie.add("ab", "c");
+    trie.build();
+    check(trie, "aaa", "ba", "matches don't overlap.");
+    check(trie, "aab", "bb", "a match at a position hides a match that starts inside it.");
+    trie.clear();
+    trie.build();
+    check(trie, "aab", "aab", "clear removes all patterns.");
+  }
+
+  {
+    SubstitutionTrie trie;
+    trie.add("x", "xxxxxxxx");
+    trie.build();
+    check(trie, "xxxx", "xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx", "max_output_size accounts for replacements that are longer than their pattern.");
+  }
+
+  if (!success)
+    return 1;
+  std::cout << "Success." << std::endl;
+}
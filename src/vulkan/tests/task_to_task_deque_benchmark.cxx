@@ -0,0 +1,136 @@
+// Producer/consumer throughput benchmark of the way TaskToTaskDeque::flush_new_data drains its deque.
+//
+// A number of producer threads push data onto a mutex protected std::deque that uses a
+// utils::DequeAllocator (as TaskToTaskDeque::have_new_datum does), while a single consumer
+// thread drains it. Compares the old approach (lock the mutex and call a std::function for
+// every datum) with the batch drain of vk_utils::flush_deque, which is what flush_new_data
+// calls (swap the whole deque out under a single lock into a consumer-side deque that uses
+// the same allocator, and process that without locking).
+//
+// TaskToTaskDeque itself needs a running Application (for its allocator) and an engine,
+// therefore only the shared drain code is driven directly. That no data is lost or
+// reordered is tested by flush_deque_test.
+
+#include "sys.h"
+#include "statefultask/DefaultMemoryPagePool.h"
+#include "threadsafe/aithreadsafe.h"
+#include "utils/DequeAllocator.h"
+#include "vk_utils/flush_deque.h"
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "debug.h"
+
+namespace {
+
+// A stand-in for the pair<Pipeline, SharedPipelinePtr> that MoveNewPipelines receives.
+struct Datum
+{
+  int m_producer;
+  int m_sequence_number;
+  void* m_payload;
+};
+
+using deque_allocator_type = utils::DequeAllocator<Datum>;
+using container_type = std::deque<Datum, deque_allocator_type>;
+using new_data_type = aithreadsafe::Wrapper<container_type, aithreadsafe::policy::Primitive<std::mutex>>;
+
+struct Consumer
+{
+  new_data_type m_new_data;
+  container_type m_consumer_data;
+  std::atomic_int m_producers_running;
+  long m_processed = 0;
+
+  Consumer(deque_allocator_type& allocator, int number_of_producers) :
+    m_new_data(allocator), m_consumer_data(allocator), m_producers_running(number_of_producers) { }
+
+  void process(Datum&& datum)
+  {
+    ++m_processed;
+  }
+
+  // This is what TaskToTaskDeque::flush_new_data used to do.
+  void flush_per_element(std::function<void(Datum&&)> lambda)
+  {
+    for (;;)
+    {
+      Datum datum;
+      {
+        new_data_type::wat new_data_w(m_new_data);
+        if (new_data_w->empty())
+          break;
+        datum = std::move(new_data_w->front());
+        new_data_w->pop_front();
+      }
+      lambda(std::move(datum));
+    }
+  }
+
+  // This is what TaskToTaskDeque::flush_new_data does now.
+  template<typename LAMBDA>
+  void flush_batch(LAMBDA&& lambda)
+  {
+    vk_utils::flush_deque(m_new_data, m_consumer_data, std::forward<LAMBDA>(lambda));
+  }
+};
+
+template<typename FLUSH>
+double measure(deque_allocator_type& allocator, int number_of_producers, int data_per_producer, FLUSH const& flush)
+{
+  Consumer consumer(allocator, number_of_producers);
+  auto const start = std::chrono::steady_clock::now();
+  std::vector<std::thread> producers;
+  for (int p = 0; p < number_of_producers; ++p)
+    producers.emplace_back([&, p](){
+      for (int i = 0; i < data_per_producer; ++i)
+        new_data_type::wat(consumer.m_new_data)->push_back({p, i, nullptr});
+      consumer.m_producers_running.fetch_sub(1, std::memory_order_release);
+    });
+  // The consumer; like a task that is woken up by need_action.
+  for (;;)
+  {
+    bool const producers_finished = consumer.m_producers_running.load(std::memory_order_acquire) == 0;
+    flush(consumer);
+    if (producers_finished)
+      break;
+  }
+  for (std::thread& producer : producers)
+    producer.join();
+  auto const stop = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(stop - start).count();
+}
+
+} // namespace
+
+int main()
+{
+  Debug(NAMESPACE_DEBUG::init());
+
+  AIMemoryPagePool mpp;
+  utils::DequeMemoryResource::Initialization dmri(mpp.instance());      // For the internal tables of all std::deque<T, utils::DequeAllocator<T>>'s.
+  utils::NodeMemoryResource deque512_nmr(mpp.instance(), 512);          // Like Application::m_deque512_nmr.
+  deque_allocator_type allocator(deque512_nmr);
+
+  constexpr int number_of_producers = 4;
+  constexpr int data_per_producer = 500000;
+
+  double const per_element_ms = measure(allocator, number_of_producers, data_per_producer, [](Consumer& consumer){
+    consumer.flush_per_element([&](Datum&& datum){ consumer.process(std::move(datum)); });
+  });
+
+  double const batch_ms = measure(allocator, number_of_producers, data_per_producer, [](Consumer& consumer){
+    consumer.flush_batch([&](Datum&& datum){ consumer.process(std::move(datum)); });
+  });
+
+  int const total = number_of_producers * data_per_producer;
+  std::cout << number_of_producers << " producers passing " << total << " data to one consumer:\n";
+  std::cout << "  lock + std::function per datum: " << per_element_ms << " ms (" << (total / per_element_ms / 1000) << " M/s)\n";
+  std::cout << "  batch swap:                     " << batch_ms << " ms (" << (total / batch_ms / 1000) << " M/s)\n";
+  std::cout << "  speed up: " << (per_element_ms / batch_ms) << std::endl;
+}
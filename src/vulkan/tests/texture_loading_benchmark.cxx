@@ -0,0 +1,100 @@
+// Benchmark of loading the test textures (src/tests/*/resources/textures) into staging memory.
+//
+// Compares the old approach (read the whole file into a std::vector with get_binary_file_contents,
+// decode it with stb_image while constructing the ImageData, then copy it into the staging memory
+// in ImageDataFeeder::get_chunks) with the current one (memory map the file and only read the
+// header while constructing the ImageData; in get_chunks, decode PNG images row by row with libpng
+// straight into the staging memory). The old approach copies the file and the decoded image once;
+// the current one copies neither (other formats than PNG are still decoded by stb_image and copied).
+// That both produce the same pixels is tested by image_data_test.
+//
+// A std::vector stands in for the mapped staging memory.
+//
+// Usage: texture_loading_benchmark [<tests directory>]
+
+#include "sys.h"
+#include "vk_utils/ImageData.h"
+#include "vk_utils/get_binary_file_contents.h"
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <vector>
+#include "debug.h"
+
+#ifndef TESTS_DIR
+#define TESTS_DIR "src/tests"
+#endif
+
+namespace {
+
+// This is what ImageData and ImageDataFeeder used to do.
+void load_old(std::filesystem::path const& filename, std::vector<std::byte>& staging_memory)
+{
+  auto const file_data = vk_utils::get_binary_file_contents(filename);
+  int width, height, components;
+  stbi_uc* image_data = stbi_load_from_memory(
+      reinterpret_cast<stbi_uc const*>(file_data.data()), static_cast<int>(file_data.size()), &width, &height, &components, 4);
+  size_t const size = width * height * 4;
+  staging_memory.resize(size);
+  std::memcpy(staging_memory.data(), image_data, size);
+  stbi_image_free(image_data);
+}
+
+// This is what ImageData and ImageDataFeeder do now.
+void load_new(std::filesystem::path const& filename, std::vector<std::byte>& staging_memory)
+{
+  vk_utils::stbi::ImageData image_data(filename, 4);
+  staging_memory.resize(image_data.size());
+  vk_utils::stbi::ImageDataFeeder feeder(std::move(image_data));
+  feeder.next_batch();
+  feeder.get_chunks(reinterpret_cast<unsigned char*>(staging_memory.data()));
+}
+
+template<typename FUNCTION>
+double measure(std::vector<std::filesystem::path> const& textures, int iterations, std::vector<std::vector<std::byte>>& staging_memory, FUNCTION function)
+{
+  staging_memory.resize(textures.size());
+  auto const start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; ++i)
+    for (size_t t = 0; t < textures.size(); ++t)
+      function(textures[t], staging_memory[t]);
+  auto const stop = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(stop - start).count();
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+  Debug(NAMESPACE_DEBUG::init());
+
+  std::filesystem::path const tests_dir = argc > 1 ? argv[1] : TESTS_DIR;
+  constexpr int iterations = 20;
+
+  // Find all textures of all tests.
+  std::vector<std::filesystem::path> textures;
+  for (auto const& test : std::filesystem::directory_iterator(tests_dir))
+  {
+    std::filesystem::path const textures_dir = test.path() / "resources" / "textures";
+    if (!std::filesystem::is_directory(textures_dir))
+      continue;
+    for (auto const& texture : std::filesystem::directory_iterator(textures_dir))
+      textures.push_back(texture.path());
+  }
+  if (textures.empty())
+  {
+    std::cerr << "No textures found in " << tests_dir << "/*/resources/textures" << std::endl;
+    return 1;
+  }
+
+  std::vector<std::vector<std::byte>> old_staging_memory;
+  std::vector<std::vector<std::byte>> new_staging_memory;
+  double const old_ms = measure(textures, iterations, old_staging_memory, load_old);
+  double const new_ms = measure(textures, iterations, new_staging_memory, load_new);
+
+  std::cout << "Loading " << textures.size() << " textures " << iterations << " times:\n";
+  std::cout << "  read + decode + copy:     " << old_ms << " ms\n";
+  std::cout << "  mmap + streaming decode:  " << new_ms << " ms\n";
+  std::cout << "  speed up: " << (old_ms / new_ms) << std::endl;
+}
@@ -1,38 +1,163 @@
 #include "sys.h"
 #define STB_IMAGE_IMPLEMENTATION
 #include "ImageData.h"
-#include "get_binary_file_contents.h"
 #include "utils/AIAlert.h"
+#include <png.h>
+#include <csetjmp>
 #include <cstring>
+#include <limits>
+#include <memory>
 #include <stdexcept>
 #include "debug.h"
 
 namespace vk_utils {
 namespace stbi {
 
-// Load image (texture) data from a specified file.
-ImageData::ImageData(std::filesystem::path const& filename, int requested_components)
+namespace {
+
+// The input of libpng and its last error message.
+struct PngReadState
 {
-  DoutEntering(dc::vulkan, "ImageData::ImageData(" << filename << ", " << requested_components << ")");
+  std::byte const* m_data;
+  size_t m_size;
+  size_t m_offset;
+  char m_error[128];
+};
+
+void png_read_from_memory(png_structp png, png_bytep out, size_t length)
+{
+  PngReadState* state = static_cast<PngReadState*>(png_get_io_ptr(png));
+  if (length > state->m_size - state->m_offset)
+    png_error(png, "unexpected end of file");
+  std::memcpy(out, state->m_data + state->m_offset, length);
+  state->m_offset += length;
+}
+
+[[noreturn]] void png_error_handler(png_structp png, png_const_charp message)
+{
+  PngReadState* state = static_cast<PngReadState*>(png_get_error_ptr(png));
+  std::strncpy(state->m_error, message, sizeof(state->m_error) - 1);
+  png_longjmp(png, 1);
+}
+
+void png_warning_handler(png_structp, png_const_charp)
+{
+}
+
+// Decode the PNG image read by png into dst, with components bytes per pixel, converted the same way as stb_image does.
+// Returns false if libpng reported an error (see PngReadState::m_error).
+//
+// libpng errors longjmp back into this function: it may not have automatic variables with non-trivial destructors.
+bool decode_png_rows(png_structp png, png_infop info, int components, uint32_t row_size, uint32_t height, std::byte* dst)
+{
+  if (setjmp(png_jmpbuf(png)))
+    return false;
+
+  png_read_info(png, info);
+  png_set_expand(png);          // Palette to RGB, gray with less than 8 bits to 8 bits and tRNS chunks to alpha.
+  png_set_strip_16(png);        // Keep the most significant byte of 16 bit samples.
+  int const color_type = png_get_color_type(png, info);
+  bool const has_alpha = (color_type & PNG_COLOR_MASK_ALPHA) || png_get_valid(png, info, PNG_INFO_tRNS);
+  bool const want_alpha = components == 2 || components == 4;
+  if (components >= 3 && !(color_type & PNG_COLOR_MASK_COLOR))
+    png_set_gray_to_rgb(png);
+  if (want_alpha && !has_alpha)
+    png_set_add_alpha(png, 0xff, PNG_FILLER_AFTER);
+  else if (!want_alpha && has_alpha)
+    png_set_strip_alpha(png);
+  int const passes = png_set_interlace_handling(png);
+  png_read_update_info(png, info);
+  if (png_get_rowbytes(png, info) != row_size || png_get_image_height(png, info) != height)
+    png_error(png, "size mismatch");
+
+  // Each pass of an interlaced image combines its pixels with those that are already in dst (reading it back).
+  for (int pass = 0; pass < passes; ++pass)
+    for (uint32_t row = 0; row < height; ++row)
+      png_read_row(png, reinterpret_cast<png_bytep>(dst + size_t{row} * row_size), nullptr);
+  return true;
+}
 
-  auto const file_data = get_binary_file_contents(filename);
+} // namespace
+
+// Map the image (texture) file and read its header.
+ImageData::ImageData(std::filesystem::path const& filename, int requested_components) :
+  m_file(filename), m_requested_components(requested_components)
+{
+  DoutEntering(dc::vulkan, "ImageData::ImageData(" << filename << ", " << requested_components << ")");
 
   int width = 0, height = 0;
-  m_image_data = reinterpret_cast<std::byte*>(stbi_load_from_memory(
-      reinterpret_cast<stbi_uc const*>(file_data.data()), static_cast<int>(file_data.size()), &width, &height, &m_components, requested_components));
+  int const ok = stbi_info_from_memory(
+      reinterpret_cast<stbi_uc const*>(m_file.data()), static_cast<int>(m_file.size()), &width, &height, &m_components);
   // These casts are OK because of the test below.
   m_extent = vk::Extent2D{ static_cast<uint32_t>(width), static_cast<uint32_t>(height) };
 
-  if (m_image_data == nullptr || width <= 0 || height <= 0 || m_components <= 0)
-    THROW_ALERT("Could not get image data for file \"[FILENAME]\"", AIArgs("[FILENAME]", filename));
+  if (!ok || width <= 0 || height <= 0 || m_components <= 0)
+    THROW_ALERT("Could not get image data for file \"[FILENAME]\": [REASON]",
+        AIArgs("[FILENAME]", filename)("[REASON]", stbi_failure_reason() ? stbi_failure_reason() : "invalid header"));
+
+  // Everything that can be checked without decoding the image is checked here, so that decode_into only fails on corrupt image data.
+  if (requested_components < 0 || requested_components > 4)
+    THROW_ALERT("Can not decode \"[FILENAME]\" into [COMPONENTS] components", AIArgs("[FILENAME]", filename)("[COMPONENTS]", requested_components));
+  uint64_t const size = uint64_t{m_extent.width} * m_extent.height * (requested_components > 0 ? requested_components : m_components);
+  if (size > std::numeric_limits<uint32_t>::max())
+    THROW_ALERT("The image \"[FILENAME]\" is too large ([WIDTH]x[HEIGHT])", AIArgs("[FILENAME]", filename)("[WIDTH]", width)("[HEIGHT]", height));
+  m_size = size;
 
-  m_size = width * height * (requested_components > 0 ? requested_components : m_components);
+  // Converting color to gray is left to stb_image.
+  constexpr size_t png_color_type_offset = 25;  // Signature (8), IHDR length (4), "IHDR" (4), width (4), height (4) and bit depth (1).
+  int const components = requested_components > 0 ? requested_components : m_components;
+  m_stream_png = m_file.size() > png_color_type_offset &&
+      png_sig_cmp(reinterpret_cast<png_const_bytep>(m_file.data()), 0, 8) == 0 &&
+      (components >= 3 || !(std::to_integer<int>(m_file.data()[png_color_type_offset]) & PNG_COLOR_MASK_COLOR));
 }
 
-ImageData::~ImageData()
+void ImageData::decode_png_into(std::byte* dst) const
 {
-  if (m_image_data)
-    stbi_image_free(m_image_data);
+  DoutEntering(dc::vulkan, "ImageData::decode_png_into(" << (void*)dst << ")");
+
+  PngReadState state{ m_file.data(), m_file.size(), 0, {} };
+  png_structp png = png_create_read_struct(PNG_LIBPNG_VER_STRING, &state, png_error_handler, png_warning_handler);
+  png_infop info = png ? png_create_info_struct(png) : nullptr;
+  if (!info)
+  {
+    png_destroy_read_struct(&png, nullptr, nullptr);
+    THROW_ALERT("Could not create the libpng read structures");
+  }
+  png_set_read_fn(png, &state, png_read_from_memory);
+
+  // Decoding an interlaced image reads back the rows of the previous passes. Don't do that from dst, which normally
+  // is write-combined (uncached) staging memory: decode those into a buffer of our own and copy that to dst.
+  constexpr size_t png_interlace_method_offset = 28;    // png_color_type_offset (see the constructor) plus the color type, compression method and filter method (one byte each).
+  std::unique_ptr<std::byte[]> interlaced_image;
+  if (std::to_integer<int>(m_file.data()[png_interlace_method_offset]) != PNG_INTERLACE_NONE)
+    interlaced_image = std::make_unique_for_overwrite<std::byte[]>(m_size);
+
+  int const components = m_requested_components > 0 ? m_requested_components : m_components;
+  bool const success = decode_png_rows(png, info, components, m_extent.width * components, m_extent.height,
+      interlaced_image ? interlaced_image.get() : dst);
+  png_destroy_read_struct(&png, &info, nullptr);
+
+  if (!success)
+    THROW_ALERT("Could not decode image data: [REASON]", AIArgs("[REASON]", state.m_error));
+
+  if (interlaced_image)
+    std::memcpy(dst, interlaced_image.get(), m_size);
+}
+
+void ImageData::decode_stb_into(std::byte* dst) const
+{
+  DoutEntering(dc::vulkan, "ImageData::decode_stb_into(" << (void*)dst << ")");
+
+  // stb_image always decodes into a buffer of its own (it has no API to decode into a given buffer); copy that to dst.
+  int width = 0, height = 0, components = 0;
+  std::unique_ptr<stbi_uc, void(*)(void*)> image_data(stbi_load_from_memory(
+      reinterpret_cast<stbi_uc const*>(m_file.data()), static_cast<int>(m_file.size()), &width, &height, &components, m_requested_components),
+      stbi_image_free);
+
+  if (!image_data || static_cast<uint32_t>(width) != m_extent.width || static_cast<uint32_t>(height) != m_extent.height)
+    THROW_ALERT("Could not decode image data: [REASON]", AIArgs("[REASON]", stbi_failure_reason() ? stbi_failure_reason() : "size mismatch"));
+
+  std::memcpy(dst, image_data.get(), m_size);
 }
 
 } // namespace stbi
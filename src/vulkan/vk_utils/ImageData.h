@@ -1,8 +1,7 @@
 #include "stb_image.h"
+#include "MappedFile.h"
 #include "memory/DataFeeder.h"
-#include "utils/Badge.h"
 #include <vulkan/vulkan.hpp>
-#include <vector>
 #include <filesystem>
 #include <cstddef>
 #include "debug.h"
@@ -10,57 +9,55 @@
 namespace vk_utils {
 namespace stbi {
 
-class ImageDataFeeder;
-
+// An image file, of which only the header has been read (and validated).
+//
+// The file is memory mapped; the image is decoded by decode_into, normally while filling the
+// staging memory of an upload (see ImageDataFeeder). PNG images are decoded row by row with
+// libpng, straight into the staging memory (interlaced ones are decoded into a buffer first, because
+// each pass reads back the previous ones). Other formats are decoded by stb_image, which can
+// only decode into a buffer of its own that is then copied into the staging memory; as are PNG
+// images with color that must be converted to gray (stb_image and libpng use different weights).
 class ImageData
 {
  private:
-  std::byte* m_image_data;
+  MappedFile m_file;            // The (encoded) contents of the image file.
   vk::Extent2D m_extent;
-  int m_components{};
-  uint32_t m_size;              // Size in bytes (int is large enough to store an image with 4 components and extent 32768x32768).
+  int m_components{};           // The number of components in the file.
+  int m_requested_components;   // The number of components that decode_into writes per pixel, or 0 to use m_components.
+  uint32_t m_size;              // Size in bytes of the decoded image (int is large enough to store an image with 4 components and extent 32768x32768).
+  bool m_stream_png{};          // Set if decode_into uses libpng.
+
+ private:
+  void decode_png_into(std::byte* dst) const;
+  void decode_stb_into(std::byte* dst) const;
 
  public:
   ImageData(std::filesystem::path const& filename, int requested_components);
-  ~ImageData();
+  ImageData(ImageData&&) = default;
 
   // Accessors.
   vk::Extent2D extent() const { return m_extent; }
   int components() const { return m_components; }
   uint32_t size() const { return m_size; }
-  std::byte* image_data() const { return m_image_data; }
 
-  // Transfer data ownership.
-  std::byte* move_image_data(utils::Badge<ImageDataFeeder>) &&
-  {
-    std::byte* image_data = m_image_data;
-    m_image_data = nullptr;
-    return image_data;
-  }
+  // Decode the image and write it to dst, which must point to at least size() bytes.
+  // Throws if the image data is corrupt (only the header was validated by the constructor).
+  void decode_into(std::byte* dst) const { if (m_stream_png) decode_png_into(dst); else decode_stb_into(dst); }
 };
 
 class ImageDataFeeder final : public vulkan::DataFeeder
 {
  private:
-  std::byte* m_image_data;
-  uint32_t m_size;
+  ImageData m_image_data;
 
  public:
-  ImageDataFeeder(ImageData&& image_data) : m_image_data(std::move(image_data).move_image_data({})), m_size(image_data.size())
-  {
-    // Don't create an ImageDataFeeder from a ImageData that doesn't have data.
-    ASSERT(m_image_data);
-  }
-
-  ~ImageDataFeeder() override
-  {
-    stbi_image_free(m_image_data);
-  }
+  ImageDataFeeder(ImageData&& image_data) : m_image_data(std::move(image_data)) { }
 
-  uint32_t chunk_size() const override { return m_size; }
+  uint32_t chunk_size() const override { return m_image_data.size(); }
   int chunk_count() const override { return 1; }
   int next_batch() override { return 1; }
-  void get_chunks(unsigned char* chunk_ptr) override { std::memcpy(chunk_ptr, m_image_data, m_size); }
+  // Called with a pointer into the mapped staging memory of the upload.
+  void get_chunks(unsigned char* chunk_ptr) override { m_image_data.decode_into(reinterpret_cast<std::byte*>(chunk_ptr)); }
 };
 
 } // namespace stbi
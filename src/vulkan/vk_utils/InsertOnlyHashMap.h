@@ -0,0 +1,129 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <utility>
+#include "debug.h"
+
+namespace vk_utils {
+
+// A concurrent hash map to which elements can be added, but never removed (until destruction).
+//
+// Usage:
+//
+//   vk_utils::InsertOnlyHashMap<Key, Value, Hash, KeyEqual> map;
+//
+//   value_type const* entry = map.find(key);           // Never locks.
+//   if (!entry)
+//   {
+//     Value value = create(key);                       // Not holding any lock.
+//     auto [entry, inserted] = map.insert(Key{key}, std::move(value));
+//     // If inserted is false then another thread inserted an equal key first;
+//     // value was destroyed and entry points to the element of that other thread.
+//   }
+//
+// Each bucket is a singly linked list of nodes that are only ever prepended, using a compare-and-swap
+// on the head of the list. A node is never changed after it was published, so readers don't need a lock.
+// Because nodes are only deleted by the destructor, there is no memory reclamation problem either.
+//
+// Hash and KeyEqual may be transparent (define is_transparent), in which case find accepts any
+// type that they accept.
+//
+// The number of buckets is fixed; this is intended for caches that contain a limited number
+// of elements (like the descriptor set layouts and pipeline layouts of a LogicalDevice).
+template<typename Key, typename Value, typename Hash = std::hash<Key>, typename KeyEqual = std::equal_to<Key>, size_t number_of_buckets = 256>
+class InsertOnlyHashMap
+{
+  static_assert((number_of_buckets & (number_of_buckets - 1)) == 0, "number_of_buckets must be a power of two.");
+
+ public:
+  using value_type = std::pair<Key const, Value>;
+
+ private:
+  struct Node
+  {
+    value_type m_value;
+    size_t m_hash;                                      // Only written before this node is published.
+    Node* m_next;                                       // Idem.
+
+    template<typename K, typename V>
+    Node(K&& key, V&& value) : m_value(std::forward<K>(key), std::forward<V>(value)), m_hash(0), m_next(nullptr) { }
+  };
+
+  std::array<std::atomic<Node*>, number_of_buckets> m_buckets{};
+  [[no_unique_address]] Hash m_hasher;
+  [[no_unique_address]] KeyEqual m_key_equal;
+
+  std::atomic<Node*>& bucket(size_t hash) { return m_buckets[hash & (number_of_buckets - 1)]; }
+  std::atomic<Node*> const& bucket(size_t hash) const { return m_buckets[hash & (number_of_buckets - 1)]; }
+
+  // Search the nodes from first up till (but not including) last.
+  template<typename K>
+  value_type const* find_in_chain(Node const* first, Node const* last, K const& key, size_t hash) const
+  {
+    for (Node const* node = first; node != last; node = node->m_next)
+      if (node->m_hash == hash && m_key_equal(key, node->m_value.first))
+        return &node->m_value;
+    return nullptr;
+  }
+
+ public:
+  InsertOnlyHashMap() = default;
+  InsertOnlyHashMap(InsertOnlyHashMap const&) = delete;
+  InsertOnlyHashMap& operator=(InsertOnlyHashMap const&) = delete;
+
+  ~InsertOnlyHashMap()
+  {
+    for (std::atomic<Node*>& head : m_buckets)
+    {
+      Node* node = head.load(std::memory_order_relaxed);
+      while (node)
+      {
+        Node* next = node->m_next;
+        delete node;
+        node = next;
+      }
+    }
+  }
+
+  // Return the element with a key equal to key, or nullptr if there is no such element.
+  // The returned pointer remains valid until this object is destructed.
+  template<typename K>
+  value_type const* find(K const& key) const
+  {
+    size_t const hash = m_hasher(key);
+    return find_in_chain(bucket(hash).load(std::memory_order_acquire), nullptr, key, hash);
+  }
+
+  // Insert key and value, unless an element with an equal key already exists.
+  // Returns a pointer to the element with that key and true if the element was inserted.
+  // If the element was not inserted then the passed key and value are destroyed.
+  template<typename K, typename V>
+  std::pair<value_type const*, bool> insert(K&& key, V&& value)
+  {
+    Node* const new_node = new Node(std::forward<K>(key), std::forward<V>(value));
+    size_t const hash = m_hasher(new_node->m_value.first);
+    new_node->m_hash = hash;
+    std::atomic<Node*>& head = bucket(hash);
+    Node* expected = head.load(std::memory_order_acquire);
+    Node const* searched_until = nullptr;
+    for (;;)
+    {
+      // Only the nodes that were prepended since the last time we looked need to be searched.
+      if (value_type const* existing = find_in_chain(expected, searched_until, new_node->m_value.first, hash))
+      {
+        // Another thread won the race.
+        delete new_node;
+        return { existing, false };
+      }
+      searched_until = expected;
+      new_node->m_next = expected;
+      if (head.compare_exchange_weak(expected, new_node, std::memory_order_release, std::memory_order_acquire))
+        return { &new_node->m_value, true };
+    }
+  }
+};
+
+} // namespace vk_utils
@@ -0,0 +1,68 @@
+#include "sys.h"
+#include "MappedFile.h"
+#include "utils/AIAlert.h"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "debug.h"
+
+namespace vk_utils {
+
+MappedFile::MappedFile(std::filesystem::path const& filename)
+{
+  DoutEntering(dc::vulkan, "MappedFile::MappedFile(" << filename << ")");
+
+  int const fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd == -1)
+    THROW_ALERT("Could not open [FILENAME] file: [ERROR]", AIArgs("[FILENAME]", filename)("[ERROR]", std::strerror(errno)));
+
+  struct stat st;
+  if (::fstat(fd, &st) == -1)
+  {
+    int const error = errno;
+    ::close(fd);
+    THROW_ALERT("Could not stat [FILENAME]: [ERROR]", AIArgs("[FILENAME]", filename)("[ERROR]", std::strerror(error)));
+  }
+
+  m_size = static_cast<size_t>(st.st_size);
+  // It is not possible to map zero bytes; leave m_data at nullptr in that case.
+  if (m_size > 0)
+  {
+    void* data = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED)
+    {
+      int const error = errno;
+      ::close(fd);
+      THROW_ALERT("Could not map [SIZE] bytes of [FILENAME]: [ERROR]", AIArgs("[SIZE]", m_size)("[FILENAME]", filename)("[ERROR]", std::strerror(error)));
+    }
+    m_data = data;
+    // The file will be read once, from beginning to end.
+    ::madvise(m_data, m_size, MADV_SEQUENTIAL);
+  }
+  // The mapping keeps its own reference to the file.
+  ::close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+  if (m_data)
+    ::munmap(m_data, m_size);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& orig)
+{
+  if (this == &orig)
+    return *this;
+  if (m_data)
+    ::munmap(m_data, m_size);
+  m_data = orig.m_data;
+  m_size = orig.m_size;
+  orig.m_data = nullptr;
+  orig.m_size = 0;
+  return *this;
+}
+
+} // namespace vk_utils
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+
+namespace vk_utils {
+
+// A read-only memory mapping of the contents of a file.
+//
+// Unlike get_binary_file_contents this doesn't copy the file into a heap buffer;
+// the pages are read from the page cache when they are accessed.
+class MappedFile
+{
+ private:
+  void* m_data{};               // The start of the mapping, or nullptr if nothing is mapped.
+  size_t m_size{};              // The size of the file.
+
+ public:
+  MappedFile() = default;
+  explicit MappedFile(std::filesystem::path const& filename);
+  MappedFile(MappedFile&& orig) : m_data(orig.m_data), m_size(orig.m_size) { orig.m_data = nullptr; orig.m_size = 0; }
+  ~MappedFile();
+
+  MappedFile& operator=(MappedFile&& orig);
+
+  // Accessors.
+  std::byte const* data() const { return static_cast<std::byte const*>(m_data); }
+  size_t size() const { return m_size; }
+};
+
+} // namespace vk_utils
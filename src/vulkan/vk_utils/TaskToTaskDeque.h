@@ -5,6 +5,7 @@
 #include "statefultask/DefaultMemoryPagePool.h"
 #include "statefultask/AIStatefulTask.h"
 #include "utils/DequeAllocator.h"
+#include "flush_deque.h"
 #include <deque>
 #include <algorithm>
 
@@ -28,6 +29,9 @@ namespace vk_utils {
 // After the last call to `have_new_datum` it should call `set_producer_finished` (this can be
 // done immediately after that last call).
 //
+// flush_new_data swaps all data that the producers added so far out of the shared deque,
+// taking the mutex only once, and then passes them to the lambda without holding the lock.
+//
 // Each time one of these functions is called, the signal `need_action`
 // is emitted. The consumer task therefore must already have been running,
 // or not wait for that signal before entering the `*_need_action` state
@@ -57,26 +61,18 @@ class TaskToTaskDeque : public BASE
  private:
   utils::DequeAllocator<DATUM> m_datum_allocator{vulkan::Application::instance().deque512_nmr()};
   new_data_type m_new_data{m_datum_allocator};
+  container_type m_consumer_data{m_datum_allocator};                   // Only accessed by the consumer (from flush_new_data).
   std::atomic_bool m_producer_finished = false;
 
  protected:
   using BASE::BASE;
 
   // Called by consumer (derived task).
-  void flush_new_data(std::function<void(Datum&&)> lambda)
+  // Calls lambda(Datum&&) for every datum that was added by the producer(s), in the order they were added.
+  template<typename LAMBDA>
+  void flush_new_data(LAMBDA&& lambda)
   {
-    for (;;)
-    {
-      Datum datum;
-      {
-        typename new_data_type::wat new_data_w(m_new_data);
-        if (new_data_w->empty())
-          break;
-        datum = std::move(new_data_w->front());
-        new_data_w->pop_front();
-      }
-      lambda(std::move(datum));
-    }
+    flush_deque(m_new_data, m_consumer_data, std::forward<LAMBDA>(lambda));
   }
 
   // Called by consumer (derived task).
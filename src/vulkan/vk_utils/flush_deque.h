@@ -0,0 +1,35 @@
+#pragma once
+
+#include <utility>
+
+namespace vk_utils {
+
+// Pass all data that producers pushed onto the deque in the aithreadsafe::Wrapper new_data to lambda,
+// in the order they were added, taking the lock of new_data only once per batch.
+//
+// All data is swapped out of new_data into consumer_data, which is only accessed by the consumer,
+// and then passed to lambda without holding the lock. If both deques use the same allocator
+// this is just a swap of pointers; the memory of the (then empty) consumer_data is reused by the producers.
+//
+// Used by TaskToTaskDeque::flush_new_data.
+template<typename NEW_DATA, typename CONTAINER, typename LAMBDA>
+void flush_deque(NEW_DATA& new_data, CONTAINER& consumer_data, LAMBDA&& lambda)
+{
+  for (;;)
+  {
+    // Process what is left of the previous batch first (this can only happen if lambda threw).
+    while (!consumer_data.empty())
+    {
+      typename CONTAINER::value_type datum = std::move(consumer_data.front());
+      consumer_data.pop_front();
+      lambda(std::move(datum));
+    }
+    // Take all new data at once.
+    typename NEW_DATA::wat new_data_w(new_data);
+    if (new_data_w->empty())
+      break;
+    consumer_data.swap(*new_data_w);
+  }
+}
+
+} // namespace vk_utils
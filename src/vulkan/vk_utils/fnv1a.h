@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace vk_utils {
+
+inline constexpr uint64_t fnv1a_offset_basis = 0xcbf29ce484222325;
+
+// FNV-1a (64 bit).
+//
+// Unlike std::hash and boost::hash, the result only depends on the bytes that are passed,
+// so it is the same for every build; use it for hashes that are stored on disk.
+// To hash more than one object, pass the result of the previous call as hash.
+inline uint64_t fnv1a(void const* data, size_t size, uint64_t hash = fnv1a_offset_basis)
+{
+  unsigned char const* ptr = static_cast<unsigned char const*>(data);
+  for (size_t i = 0; i < size; ++i)
+  {
+    hash ^= ptr[i];
+    hash *= 0x100000001b3;
+  }
+  return hash;
+}
+
+} // namespace vk_utils